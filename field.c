@@ -0,0 +1,336 @@
+/*
+ * Field splitting routines...
+ *
+ * Copyright 2008 by Gray Watson
+ *
+ * This file is part of the sortu package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "field.h"
+
+#define BLOCK_SIZE	16		/* bytes in a vector block */
+
+#ifdef __SSE2__
+
+/*
+ * static unsigned int delim_mask
+ *
+ * DESCRIPTION:
+ *
+ * Compare a block of characters against our delimiters.
+ *
+ * RETURNS:
+ *
+ * Bit mask with bit X set if the character at position X of the block
+ * is a delimiter.
+ *
+ * ARGUMENTS:
+ *
+ * delim_p -> Delimiter characters which separate our fields.
+ *
+ * block_p -> Pointer to the BLOCK_SIZE characters we are comparing.
+ */
+static	unsigned int	delim_mask(const field_delim_t *delim_p,
+				   const char *block_p)
+{
+  __m128i	block, hits;
+  int		char_c;
+  
+  block = _mm_loadu_si128((const __m128i *)block_p);
+  hits = _mm_cmpeq_epi8(block, _mm_set1_epi8(delim_p->fd_chars[0]));
+  for (char_c = 1; char_c < delim_p->fd_char_n; char_c++) {
+    hits = _mm_or_si128(hits,
+			_mm_cmpeq_epi8(block,
+				       _mm_set1_epi8(delim_p->fd_chars[char_c])));
+  }
+  
+  return _mm_movemask_epi8(hits);
+}
+
+/*
+ * static int nth_bit
+ *
+ * DESCRIPTION:
+ *
+ * Find the position of a set bit in a mask.
+ *
+ * RETURNS:
+ *
+ * Position of the nth set bit starting from the low bit.
+ *
+ * ARGUMENTS:
+ *
+ * mask -> Bit mask with at least bit_n bits set.
+ *
+ * bit_n -> Which set bit we are looking for starting at 1.
+ */
+static	int	nth_bit(unsigned int mask, int bit_n)
+{
+  for (; bit_n > 1; bit_n--) {
+    /* clear the lowest set bit */
+    mask &= mask - 1;
+  }
+  return __builtin_ctz(mask);
+}
+
+#endif /* __SSE2__ */
+
+/*
+ * static const char *find_delim
+ *
+ * DESCRIPTION:
+ *
+ * Find a delimiter character in a line.
+ *
+ * RETURNS:
+ *
+ * Success - Pointer to the delim_n delimiter character.
+ *
+ * Failure - NULL if there are not that many delimiters.
+ *
+ * ARGUMENTS:
+ *
+ * delim_p -> Delimiter characters which separate our fields.
+ *
+ * str_p -> Position in the line to start the search.
+ *
+ * bounds_p -> Pointer past the last character of the line.
+ *
+ * delim_n -> Which delimiter we are looking for starting at 1.
+ */
+static	const char	*find_delim(const field_delim_t *delim_p,
+				    const char *str_p, const char *bounds_p,
+				    int delim_n)
+{
+#ifdef __SSE2__
+  unsigned int	mask;
+  int		hit_n;
+  
+  if (delim_p->fd_char_n > 0) {
+    for (; bounds_p - str_p >= BLOCK_SIZE; str_p += BLOCK_SIZE) {
+      mask = delim_mask(delim_p, str_p);
+      hit_n = __builtin_popcount(mask);
+      if (hit_n >= delim_n) {
+	return str_p + nth_bit(mask, delim_n);
+      }
+      delim_n -= hit_n;
+    }
+  }
+#endif
+  
+  /* finish up, or do it all, a character at a time */
+  for (; str_p < bounds_p; str_p++) {
+    if (delim_p->fd_map[*(unsigned char *)str_p]) {
+      delim_n--;
+      if (delim_n == 0) {
+	return str_p;
+      }
+    }
+  }
+  
+  return NULL;
+}
+
+/*
+ * static const char *find_loose
+ *
+ * DESCRIPTION:
+ *
+ * Find a non-empty field in a line.  A field starts at a character
+ * which is not a delimiter and which is at the start of the line or
+ * after a delimiter.
+ *
+ * RETURNS:
+ *
+ * Success - Pointer to the start of the field_n non-empty field.
+ *
+ * Failure - NULL if there are not that many fields.
+ *
+ * ARGUMENTS:
+ *
+ * delim_p -> Delimiter characters which separate our fields.
+ *
+ * line -> Start of the line we are searching.
+ *
+ * line_bounds_p -> Pointer past the last character of the line.
+ *
+ * field_n -> Which field we are looking for starting at 1.
+ */
+static	const char	*find_loose(const field_delim_t *delim_p,
+				    const char *line,
+				    const char *line_bounds_p, int field_n)
+{
+  const char	*str_p = line;
+  int		after_delim_b = 1;
+#ifdef __SSE2__
+  unsigned int	mask, starts;
+  int		start_n;
+  
+  if (delim_p->fd_char_n > 0) {
+    for (; line_bounds_p - str_p >= BLOCK_SIZE; str_p += BLOCK_SIZE) {
+      mask = delim_mask(delim_p, str_p);
+      /* non-delimiters that follow a delimiter or the start of the line */
+      starts = ~mask & ((mask << 1) | after_delim_b) & 0xFFFF;
+      after_delim_b = (mask >> (BLOCK_SIZE - 1)) & 1;
+      start_n = __builtin_popcount(starts);
+      if (start_n >= field_n) {
+	return str_p + nth_bit(starts, field_n);
+      }
+      field_n -= start_n;
+    }
+  }
+#endif
+  
+  /* finish up, or do it all, a character at a time */
+  for (; str_p < line_bounds_p; str_p++) {
+    if (delim_p->fd_map[*(unsigned char *)str_p]) {
+      after_delim_b = 1;
+      continue;
+    }
+    if (after_delim_b) {
+      field_n--;
+      if (field_n == 0) {
+	return str_p;
+      }
+      after_delim_b = 0;
+    }
+  }
+  
+  return NULL;
+}
+
+/*
+ * void field_delim_init
+ *
+ * DESCRIPTION:
+ *
+ * Initialize a set of delimiter characters for field_find.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * delim_p <- Pointer to the delimiter set which we are initializing.
+ *
+ * delim -> List of delimiter characters which separate our fields.
+ */
+void	field_delim_init(field_delim_t *delim_p, const char *delim)
+{
+  const char	*delim_char_p;
+  
+  memset(delim_p, 0, sizeof(*delim_p));
+  
+  for (delim_char_p = delim; *delim_char_p != '\0'; delim_char_p++) {
+    if (delim_p->fd_map[*(unsigned char *)delim_char_p]) {
+      /* duplicate character */
+      continue;
+    }
+    delim_p->fd_map[*(unsigned char *)delim_char_p] = 1;
+  
+    if (delim_p->fd_char_n < 0) {
+      continue;
+    }
+    if (delim_p->fd_char_n >= FIELD_VECTOR_MAX) {
+      /* too many characters to compare so we use the map */
+      delim_p->fd_char_n = -1;
+      continue;
+    }
+    delim_p->fd_chars[delim_p->fd_char_n++] = *delim_char_p;
+  }
+}
+
+/*
+ * int field_find
+ *
+ * DESCRIPTION:
+ *
+ * Locate a field in a line.  This is the same as calling strsep
+ * field number of times but the line is not changed and the
+ * delimiters are searched for 16 bytes at a time when the machine
+ * supports it.
+ *
+ * This will count the true number of delimiter characters in the line
+ * so two delimiter characters in a row surround an empty field unless
+ * loose_b is set in which case empty fields are not counted.
+ *
+ * RETURNS:
+ *
+ * Success - 1 if the field was found.
+ *
+ * Failure - 0 if the line does not have that many fields.
+ *
+ * ARGUMENTS:
+ *
+ * delim_p -> Delimiter characters which separate our fields.
+ *
+ * line -> Start of the line we are searching.
+ *
+ * line_bounds_p -> Pointer past the last character of the line.
+ *
+ * field -> Number of the field we are finding starting at 1.
+ *
+ * loose_b -> Set to 1 to not count empty fields.
+ *
+ * tok_p <- Pointer which, if not NULL, will be set to the start of
+ * the field.
+ *
+ * tok_bounds_pp <- Pointer which, if not NULL, will be set to the
+ * position past the last character of the field.
+ */
+int	field_find(const field_delim_t *delim_p, const char *line,
+		   const char *line_bounds_p, const int field,
+		   const int loose_b, const char **tok_p,
+		   const char **tok_bounds_pp)
+{
+  const char	*tok, *tok_bounds_p;
+  
+  if (loose_b) {
+    tok = find_loose(delim_p, line, line_bounds_p, (field < 1 ? 1 : field));
+  }
+  else if (field <= 1) {
+    tok = line;
+  }
+  else {
+    /* the field starts after the delimiter before it */
+    tok = find_delim(delim_p, line, line_bounds_p, field - 1);
+    if (tok != NULL) {
+      tok++;
+    }
+  }
+  if (tok == NULL) {
+    return 0;
+  }
+  
+  tok_bounds_p = find_delim(delim_p, tok, line_bounds_p, 1);
+  if (tok_bounds_p == NULL) {
+    tok_bounds_p = line_bounds_p;
+  }
+  
+  if (tok_p != NULL) {
+    *tok_p = tok;
+  }
+  if (tok_bounds_pp != NULL) {
+    *tok_bounds_pp = tok_bounds_p;
+  }
+  return 1;
+}
@@ -0,0 +1,106 @@
+/*
+ * Field splitting routines...
+ *
+ * Copyright 2008 by Gray Watson
+ *
+ * This file is part of the sortu package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * The author may be contacted via http://256.com/gray/
+ */
+
+#ifndef __FIELD_H__
+#define __FIELD_H__
+
+/*
+ * Max number of delimiter characters that we compare with vector
+ * instructions.  Larger sets use the byte map instead.
+ */
+#define FIELD_VECTOR_MAX	4
+
+/* set of delimiter characters */
+typedef struct {
+  char		fd_map[256];		/* 1 if char is a delimiter */
+  unsigned char	fd_chars[FIELD_VECTOR_MAX]; /* delimiter chars */
+  int		fd_char_n;		/* number of chars or -1 if many */
+} field_delim_t;
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/*
+ * void field_delim_init
+ *
+ * DESCRIPTION:
+ *
+ * Initialize a set of delimiter characters for field_find.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * delim_p <- Pointer to the delimiter set which we are initializing.
+ *
+ * delim -> List of delimiter characters which separate our fields.
+ */
+extern
+void	field_delim_init(field_delim_t *delim_p, const char *delim);
+
+/*
+ * int field_find
+ *
+ * DESCRIPTION:
+ *
+ * Locate a field in a line.  This is the same as calling strsep
+ * field number of times but the line is not changed and the
+ * delimiters are searched for 16 bytes at a time when the machine
+ * supports it.
+ *
+ * This will count the true number of delimiter characters in the line
+ * so two delimiter characters in a row surround an empty field unless
+ * loose_b is set in which case empty fields are not counted.
+ *
+ * RETURNS:
+ *
+ * Success - 1 if the field was found.
+ *
+ * Failure - 0 if the line does not have that many fields.
+ *
+ * ARGUMENTS:
+ *
+ * delim_p -> Delimiter characters which separate our fields.
+ *
+ * line -> Start of the line we are searching.
+ *
+ * line_bounds_p -> Pointer past the last character of the line.
+ *
+ * field -> Number of the field we are finding starting at 1.
+ *
+ * loose_b -> Set to 1 to not count empty fields.
+ *
+ * tok_p <- Pointer which, if not NULL, will be set to the start of
+ * the field.
+ *
+ * tok_bounds_pp <- Pointer which, if not NULL, will be set to the
+ * position past the last character of the field.
+ */
+extern
+int	field_find(const field_delim_t *delim_p, const char *line,
+		   const char *line_bounds_p, const int field,
+		   const int loose_b, const char **tok_p,
+		   const char **tok_bounds_pp);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#endif /* __FIELD_H__ */
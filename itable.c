@@ -0,0 +1,788 @@
+/*
+ * Integer keyed hash table routines...
+ *
+ * Copyright 2008 by Gray Watson
+ *
+ * This file is part of the sortu package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * This is a much simpler table than the one in table.c for keys which
+ * are longs.  The entries are fixed size and are stored right in an
+ * open addressing slot array which is probed linearly.  There is no
+ * key size or hash stored in the entries and keys are compared as
+ * integers.
+ *
+ * A range of keys can also be counted densely in an array indexed by
+ * the key which is faster still and needs no sorting for key order.
+ * Keys outside of the range spill into the hashed slots.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ITABLE_MAIN
+
+#include "table.h"
+#include "itable.h"
+#include "itable_loc.h"
+
+/*
+ * static unsigned int int_hash
+ *
+ * DESCRIPTION:
+ *
+ * Mix the bits of an integer key so that keys which are close
+ * together spread out across the slots.
+ *
+ * RETURNS:
+ *
+ * Hash value of the key.
+ *
+ * ARGUMENTS:
+ *
+ * key - Key that we are hashing.
+ */
+static	unsigned int	int_hash(const long key)
+{
+  unsigned long long	val = (unsigned long)key;
+  
+  val ^= val >> 33;
+  val *= IMIX_PRIME0;
+  val ^= val >> 33;
+  val *= IMIX_PRIME1;
+  val ^= val >> 33;
+  
+  return (unsigned int)val;
+}
+
+/*
+ * static itable_entry_t *find_slot
+ *
+ * DESCRIPTION:
+ *
+ * Find the slot of a key or the empty slot where it would go.
+ *
+ * RETURNS:
+ *
+ * Pointer to the key's entry or to an empty entry.
+ *
+ * ARGUMENTS:
+ *
+ * itab_p - Table that we are searching.
+ *
+ * key - Key that we are looking for.
+ */
+static	itable_entry_t	*find_slot(const itable_t *itab_p, const long key)
+{
+  itable_entry_t	*entry_p;
+  unsigned int		slot, mask;
+  
+  if (key == 0) {
+    /* the 0 key has its own slot past the others */
+    return ITABLE_ENTRY(itab_p, itab_p->it_slot_n);
+  }
+  
+  mask = itab_p->it_slot_n - 1;
+  for (slot = int_hash(key) & mask; ; slot = (slot + 1) & mask) {
+    entry_p = ITABLE_ENTRY(itab_p, slot);
+    if (entry_p->ie_key == key || entry_p->ie_key == 0) {
+      return entry_p;
+    }
+  }
+}
+
+/*
+ * static int resize
+ *
+ * DESCRIPTION:
+ *
+ * Reallocate the slots of the table and put the entries back into
+ * them.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * itab_p - Table that we are resizing.
+ *
+ * slot_n - Number of slots that we need.  It will be rounded up to a
+ * power of 2.
+ */
+static	int	resize(itable_t *itab_p, const unsigned int slot_n)
+{
+  itable_t		old;
+  itable_entry_t	*entry_p, *new_p;
+  unsigned int		size, slot_c;
+  
+  for (size = ITABLE_MIN_SIZE; size < slot_n; size *= 2) {
+  }
+  
+  old = *itab_p;
+  
+  /* there is an extra slot for the 0 key */
+  itab_p->it_slots = (unsigned char *)calloc(size + 1, itab_p->it_entry_size);
+  if (itab_p->it_slots == NULL) {
+    *itab_p = old;
+    return TABLE_ERROR_ALLOC;
+  }
+  itab_p->it_slot_n = size;
+  
+  if (old.it_slots == NULL) {
+    return TABLE_ERROR_NONE;
+  }
+  
+  /* the slot after the last is the 0 key and goes across as is */
+  for (slot_c = 0; slot_c <= old.it_slot_n; slot_c++) {
+    entry_p = ITABLE_ENTRY(&old, slot_c);
+    if (entry_p->ie_key == 0 && slot_c < old.it_slot_n) {
+      continue;
+    }
+    new_p = find_slot(itab_p, entry_p->ie_key);
+    memcpy(new_p, entry_p, itab_p->it_entry_size);
+  }
+  
+  free(old.it_slots);
+  
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * static int dense_alloc
+ *
+ * DESCRIPTION:
+ *
+ * Allocate the entries of the dense range the first time that a key
+ * lands in it.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * itab_p - Table whose dense entries we are allocating.
+ */
+static	int	dense_alloc(itable_t *itab_p)
+{
+  unsigned long	index;
+  
+  itab_p->it_dense = (unsigned char *)malloc(itab_p->it_dense_n *
+					     itab_p->it_entry_size);
+  if (itab_p->it_dense == NULL) {
+    return TABLE_ERROR_ALLOC;
+  }
+  
+  /* mark them unused with a key that does not match their index */
+  for (index = 0; index < itab_p->it_dense_n; index++) {
+    DENSE_ENTRY(itab_p, index)->ie_key =
+      (long)((unsigned long)itab_p->it_dense_min + index + 1);
+  }
+  
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * static int key_compare
+ *
+ * DESCRIPTION:
+ *
+ * Compare two entries by their keys for itable_order.
+ *
+ * RETURNS:
+ *
+ * -1, 0, or 1 if key1 is <, ==, or > than key2.
+ *
+ * ARGUMENTS:
+ *
+ * key1 - The first key.
+ *
+ * data1 - Data of the first key, unused.
+ *
+ * key2 - The second key.
+ *
+ * data2 - Data of the second key, unused.
+ */
+static	int	key_compare(const long key1, const void *data1,
+			    const long key2, const void *data2)
+{
+  return (key1 > key2) - (key1 < key2);
+}
+
+/*
+ * static void sort_entries
+ *
+ * DESCRIPTION:
+ *
+ * Sort an array of entry pointers.  Larger sections are split around
+ * the median of their first, middle, and last entries and the smaller
+ * side is sorted first so the stack stays small.  Small sections are
+ * finished with an insertion sort.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * first_p - Pointer to the first entry in the section.
+ *
+ * last_p - Pointer to the last entry in the section.
+ *
+ * compare - Function which compares two of the entries.
+ */
+static	void	sort_entries(itable_entry_t **first_p, itable_entry_t **last_p,
+			     itable_compare_t compare)
+{
+  itable_entry_t	**left_p, **right_p, **mid_p, *pivot_p, *swap_p;
+  
+#define ENTRY_COMPARE(e1_p, e2_p)	\
+	compare((e1_p)->ie_key, IENTRY_DATA(e1_p), \
+		(e2_p)->ie_key, IENTRY_DATA(e2_p))
+#define ENTRY_SWAP(e1_pp, e2_pp)	\
+	do { swap_p = *(e1_pp); *(e1_pp) = *(e2_pp); *(e2_pp) = swap_p; } \
+	while (0)
+  
+  while (last_p - first_p >= ITABLE_SORT_MIN) {
+  
+    /* order the first, middle, and last so the middle is the median */
+    mid_p = first_p + (last_p - first_p) / 2;
+    if (ENTRY_COMPARE(*mid_p, *first_p) < 0) {
+      ENTRY_SWAP(mid_p, first_p);
+    }
+    if (ENTRY_COMPARE(*last_p, *mid_p) < 0) {
+      ENTRY_SWAP(last_p, mid_p);
+      if (ENTRY_COMPARE(*mid_p, *first_p) < 0) {
+	ENTRY_SWAP(mid_p, first_p);
+      }
+    }
+    pivot_p = *mid_p;
+  
+    left_p = first_p + 1;
+    right_p = last_p - 1;
+    while (left_p <= right_p) {
+      while (ENTRY_COMPARE(*left_p, pivot_p) < 0) {
+	left_p++;
+      }
+      while (ENTRY_COMPARE(pivot_p, *right_p) < 0) {
+	right_p--;
+      }
+      if (left_p <= right_p) {
+	ENTRY_SWAP(left_p, right_p);
+	left_p++;
+	right_p--;
+      }
+    }
+  
+    if (right_p - first_p < last_p - left_p) {
+      sort_entries(first_p, right_p, compare);
+      first_p = left_p;
+    }
+    else {
+      sort_entries(left_p, last_p, compare);
+      last_p = right_p;
+    }
+  }
+  
+  /* finish up with an insertion sort */
+  for (left_p = first_p + 1; left_p <= last_p; left_p++) {
+    pivot_p = *left_p;
+    for (right_p = left_p;
+	 right_p > first_p && ENTRY_COMPARE(pivot_p, *(right_p - 1)) < 0;
+	 right_p--) {
+      *right_p = *(right_p - 1);
+    }
+    *right_p = pivot_p;
+  }
+  
+#undef ENTRY_COMPARE
+#undef ENTRY_SWAP
+}
+
+/*
+ * itable_t *itable_alloc
+ *
+ * DESCRIPTION:
+ *
+ * Allocate a new integer table structure.
+ *
+ * RETURNS:
+ *
+ * A pointer to the new table structure which must be passed to
+ * itable_free to be deallocated.  On an error a NULL is returned.
+ *
+ * ARGUMENTS:
+ *
+ * slot_n - Number of slots for the table.  Set to 0 to take the
+ * library default.  It will be rounded up to a power of 2.
+ *
+ * data_size - Size of the data stored with each key.
+ *
+ * error_p - Pointer to an integer which, if not NULL, will contain a
+ * table error code.
+ */
+itable_t	*itable_alloc(const unsigned int slot_n, const int data_size,
+			      int *error_p)
+{
+  itable_t	*itab_p;
+  int		ret;
+  
+  if (data_size < 0) {
+    SET_POINTER(error_p, TABLE_ERROR_SIZE);
+    return NULL;
+  }
+  
+  itab_p = (itable_t *)malloc(sizeof(itable_t));
+  if (itab_p == NULL) {
+    SET_POINTER(error_p, TABLE_ERROR_ALLOC);
+    return NULL;
+  }
+  
+  itab_p->it_magic = ITABLE_MAGIC;
+  itab_p->it_slot_n = 0;
+  itab_p->it_entry_n = 0;
+  itab_p->it_data_size = data_size;
+  /* keep the entries long aligned */
+  itab_p->it_entry_size = sizeof(itable_entry_t)
+    + (data_size + sizeof(long) - 1) / sizeof(long) * sizeof(long);
+  itab_p->it_dense_entry_n = 0;
+  itab_p->it_zero_b = 0;
+  itab_p->it_slots = NULL;
+  itab_p->it_dense_min = 0;
+  itab_p->it_dense_n = 0;
+  itab_p->it_dense = NULL;
+  
+  ret = resize(itab_p, slot_n);
+  if (ret != TABLE_ERROR_NONE) {
+    free(itab_p);
+    SET_POINTER(error_p, ret);
+    return NULL;
+  }
+  
+  SET_POINTER(error_p, TABLE_ERROR_NONE);
+  return itab_p;
+}
+
+/*
+ * int itable_free
+ *
+ * DESCRIPTION:
+ *
+ * Deallocates an integer table structure.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * itab_p - Table structure pointer that we will be freeing.
+ */
+int	itable_free(itable_t *itab_p)
+{
+  if (itab_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (itab_p->it_magic != ITABLE_MAGIC) {
+    return TABLE_ERROR_PNT;
+  }
+  
+  free(itab_p->it_slots);
+  if (itab_p->it_dense != NULL) {
+    free(itab_p->it_dense);
+  }
+  itab_p->it_magic = 0;
+  free(itab_p);
+  
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * int itable_set_range
+ *
+ * DESCRIPTION:
+ *
+ * Count the keys from min to max in an array indexed by the key
+ * instead of in the hashed slots.  This is much faster for keys which
+ * fall in a small range such as status codes or hours of the day.
+ * The array is not allocated until a key lands in the range.  This
+ * must be called before any keys are inserted.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * itab_p - Table structure pointer whose range we are setting.
+ *
+ * min - First key of the dense range.
+ *
+ * max - Last key of the dense range.
+ */
+int	itable_set_range(itable_t *itab_p, const long min, const long max)
+{
+  if (itab_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (itab_p->it_magic != ITABLE_MAGIC) {
+    return TABLE_ERROR_PNT;
+  }
+  if (itab_p->it_entry_n > 0) {
+    return TABLE_ERROR_NOT_EMPTY;
+  }
+  if (min > max
+      || (unsigned long)max - (unsigned long)min >= ITABLE_DENSE_MAX) {
+    return TABLE_ERROR_SIZE;
+  }
+  
+  if (itab_p->it_dense != NULL) {
+    free(itab_p->it_dense);
+    itab_p->it_dense = NULL;
+  }
+  itab_p->it_dense_min = min;
+  itab_p->it_dense_n = (unsigned long)max - (unsigned long)min + 1;
+  
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * int itable_insert
+ *
+ * DESCRIPTION:
+ *
+ * Add a key and its data into the table.  If the key already exists
+ * then its data is not overwritten.
+ *
+ * NOTE: The entries move when the table grows so the data pointer is
+ * only good until the next insert.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.  TABLE_ERROR_OVERWRITE if the key
+ * already exists in which case data_buf_p is set to its data.
+ *
+ * ARGUMENTS:
+ *
+ * itab_p - Table structure pointer into which we are adding the key.
+ *
+ * key - Key that we are adding.
+ *
+ * data_buf - Data that we are copying in with the key.  If NULL then
+ * the data is zeroed.
+ *
+ * data_buf_p - Pointer which, if not NULL, will be set to the
+ * location of the data in the table.
+ */
+int	itable_insert(itable_t *itab_p, const long key, const void *data_buf,
+		      void **data_buf_p)
+{
+  itable_entry_t	*entry_p;
+  unsigned long		index;
+  int			ret;
+  
+  if (itab_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (itab_p->it_magic != ITABLE_MAGIC) {
+    return TABLE_ERROR_PNT;
+  }
+  
+  index = DENSE_INDEX(itab_p, key);
+  if (index < itab_p->it_dense_n) {
+    if (itab_p->it_dense == NULL) {
+      ret = dense_alloc(itab_p);
+      if (ret != TABLE_ERROR_NONE) {
+	return ret;
+      }
+    }
+    entry_p = DENSE_ENTRY(itab_p, index);
+    if (entry_p->ie_key == key) {
+      SET_POINTER(data_buf_p, IENTRY_DATA(entry_p));
+      return TABLE_ERROR_OVERWRITE;
+    }
+    itab_p->it_dense_entry_n++;
+  }
+  else {
+    entry_p = find_slot(itab_p, key);
+    if (key == 0 ? itab_p->it_zero_b : entry_p->ie_key == key) {
+      SET_POINTER(data_buf_p, IENTRY_DATA(entry_p));
+      return TABLE_ERROR_OVERWRITE;
+    }
+  
+    /* grow before we add so the data pointer we return stays good */
+    if (key != 0 && SHOULD_ITABLE_GROW(itab_p)) {
+      ret = resize(itab_p, itab_p->it_slot_n * 2);
+      if (ret != TABLE_ERROR_NONE) {
+	return ret;
+      }
+      entry_p = find_slot(itab_p, key);
+    }
+    if (key == 0) {
+      itab_p->it_zero_b = 1;
+    }
+  }
+  
+  entry_p->ie_key = key;
+  if (data_buf == NULL) {
+    memset(IENTRY_DATA(entry_p), 0, itab_p->it_data_size);
+  }
+  else {
+    memcpy(IENTRY_DATA(entry_p), data_buf, itab_p->it_data_size);
+  }
+  itab_p->it_entry_n++;
+  
+  SET_POINTER(data_buf_p, IENTRY_DATA(entry_p));
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * int itable_retrieve
+ *
+ * DESCRIPTION:
+ *
+ * Find a key in the table.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * itab_p - Table structure pointer that we are searching.
+ *
+ * key - Key that we are looking for.
+ *
+ * data_buf_p - Pointer which, if not NULL, will be set to the
+ * location of the key's data in the table.
+ */
+int	itable_retrieve(itable_t *itab_p, const long key, void **data_buf_p)
+{
+  itable_entry_t	*entry_p;
+  unsigned long		index;
+  
+  if (itab_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (itab_p->it_magic != ITABLE_MAGIC) {
+    return TABLE_ERROR_PNT;
+  }
+  
+  index = DENSE_INDEX(itab_p, key);
+  if (index < itab_p->it_dense_n) {
+    if (itab_p->it_dense == NULL) {
+      return TABLE_ERROR_NOT_FOUND;
+    }
+    entry_p = DENSE_ENTRY(itab_p, index);
+    if (entry_p->ie_key != key) {
+      return TABLE_ERROR_NOT_FOUND;
+    }
+  }
+  else {
+    entry_p = find_slot(itab_p, key);
+    if (key == 0 ? (! itab_p->it_zero_b) : entry_p->ie_key != key) {
+      return TABLE_ERROR_NOT_FOUND;
+    }
+  }
+  
+  SET_POINTER(data_buf_p, IENTRY_DATA(entry_p));
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * itable_entry_t **itable_order
+ *
+ * DESCRIPTION:
+ *
+ * Order the entries of the table with a comparison function.  The
+ * returned array should be freed with itable_order_free.
+ *
+ * NOTE: Inserting into the table may move the entries so the array
+ * is only good until then.
+ *
+ * RETURNS:
+ *
+ * Success - An allocated list of table entries.
+ *
+ * Failure - NULL
+ *
+ * ARGUMENTS:
+ *
+ * itab_p - Table structure pointer that we are ordering.
+ *
+ * compare - Comparison function for the entries.  If NULL then the
+ * entries are ordered by key and the dense range is already in order
+ * so only the spilled keys are sorted.
+ *
+ * num_entries_p - Pointer to an integer which, if not NULL, will
+ * contain the number of entries in the returned array.
+ *
+ * error_p - Pointer to an integer which, if not NULL, will contain a
+ * table error code.
+ */
+itable_entry_t	**itable_order(itable_t *itab_p, itable_compare_t compare,
+			       int *num_entries_p, int *error_p)
+{
+  itable_entry_t	**entries, **entries_p, *entry_p;
+  unsigned int		slot_c, hashed_n, below_n;
+  unsigned long		index;
+  
+  if (itab_p == NULL) {
+    SET_POINTER(error_p, TABLE_ERROR_ARG_NULL);
+    return NULL;
+  }
+  if (itab_p->it_magic != ITABLE_MAGIC) {
+    SET_POINTER(error_p, TABLE_ERROR_PNT);
+    return NULL;
+  }
+  if (itab_p->it_entry_n == 0) {
+    SET_POINTER(error_p, TABLE_ERROR_EMPTY);
+    return NULL;
+  }
+  
+  entries = (itable_entry_t **)malloc(itab_p->it_entry_n *
+				      sizeof(itable_entry_t *));
+  if (entries == NULL) {
+    SET_POINTER(error_p, TABLE_ERROR_ALLOC);
+    return NULL;
+  }
+  
+  entries_p = entries;
+  for (slot_c = 0; slot_c < itab_p->it_slot_n; slot_c++) {
+    entry_p = ITABLE_ENTRY(itab_p, slot_c);
+    if (entry_p->ie_key != 0) {
+      *entries_p++ = entry_p;
+    }
+  }
+  if (itab_p->it_zero_b) {
+    *entries_p++ = ITABLE_ENTRY(itab_p, itab_p->it_slot_n);
+  }
+  hashed_n = entries_p - entries;
+  
+  if (compare == NULL) {
+    /* sort the spilled keys and put the dense range in the middle */
+    if (hashed_n > 1) {
+      sort_entries(entries, entries + hashed_n - 1, key_compare);
+    }
+    for (below_n = 0;
+	 below_n < hashed_n
+	   && entries[below_n]->ie_key < itab_p->it_dense_min;
+	 below_n++) {
+    }
+    entries_p = entries + below_n;
+    memmove(entries_p + itab_p->it_dense_entry_n, entries_p,
+	    (hashed_n - below_n) * sizeof(itable_entry_t *));
+  }
+  
+  if (itab_p->it_dense_entry_n > 0) {
+    for (index = 0; index < itab_p->it_dense_n; index++) {
+      entry_p = DENSE_ENTRY(itab_p, index);
+      if (DENSE_INDEX(itab_p, entry_p->ie_key) == index) {
+	*entries_p++ = entry_p;
+      }
+    }
+  }
+  
+  if (compare != NULL) {
+    sort_entries(entries, entries + itab_p->it_entry_n - 1, compare);
+  }
+  
+  SET_POINTER(num_entries_p, itab_p->it_entry_n);
+  SET_POINTER(error_p, TABLE_ERROR_NONE);
+  return entries;
+}
+
+/*
+ * int itable_order_free
+ *
+ * DESCRIPTION:
+ *
+ * Free the array returned by itable_order.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * itab_p - Table structure pointer that was ordered.
+ *
+ * entries - Array of entries that we are freeing.
+ */
+int	itable_order_free(itable_t *itab_p, itable_entry_t **entries)
+{
+  if (itab_p == NULL || entries == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (itab_p->it_magic != ITABLE_MAGIC) {
+    return TABLE_ERROR_PNT;
+  }
+  
+  free(entries);
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * int itable_entry
+ *
+ * DESCRIPTION:
+ *
+ * Get the key and data of an entry from itable_order.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * itab_p - Table structure pointer that the entry is from.
+ *
+ * entry_p - Entry that we are getting the information from.
+ *
+ * key_p - Pointer which, if not NULL, will be set to the location of
+ * the key in the entry.
+ *
+ * data_buf_p - Pointer which, if not NULL, will be set to the
+ * location of the data in the entry.
+ */
+int	itable_entry(itable_t *itab_p, itable_entry_t *entry_p, long **key_p,
+		     void **data_buf_p)
+{
+  if (itab_p == NULL || entry_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (itab_p->it_magic != ITABLE_MAGIC) {
+    return TABLE_ERROR_PNT;
+  }
+  
+  SET_POINTER(key_p, &entry_p->ie_key);
+  SET_POINTER(data_buf_p, IENTRY_DATA(entry_p));
+  return TABLE_ERROR_NONE;
+}
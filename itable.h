@@ -0,0 +1,297 @@
+/*
+ * Integer keyed hash table routines...
+ *
+ * Copyright 2008 by Gray Watson
+ *
+ * This file is part of the sortu package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+#ifndef __ITABLE_H__
+#define __ITABLE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * The routines return the TABLE_ERROR_* codes from table.h which can
+ * be turned into strings with table_strerror.
+ */
+
+/*
+ * int (*itable_compare_t)
+ *
+ * DESCRIPTION
+ *
+ * Comparison function which compares two key/data pairs for
+ * itable_order.
+ *
+ * RETURNS:
+ *
+ * -1, 0, or 1 if key1 is <, ==, or > than key2.
+ *
+ * ARGUMENTS:
+ *
+ * key1 - The first key.
+ *
+ * data1 - Pointer to the first data entry.
+ *
+ * key2 - The second key.
+ *
+ * data2 - Pointer to the second data entry.
+ */
+typedef int	(*itable_compare_t)(const long key1, const void *data1,
+				    const long key2, const void *data2);
+
+#ifdef ITABLE_MAIN
+
+#include "itable_loc.h"
+
+#else
+
+/* generic integer table type */
+typedef void	itable_t;
+
+/* generic integer table entry type */
+typedef void	itable_entry_t;
+
+#endif
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/*
+ * itable_t *itable_alloc
+ *
+ * DESCRIPTION:
+ *
+ * Allocate a new integer table structure.
+ *
+ * RETURNS:
+ *
+ * A pointer to the new table structure which must be passed to
+ * itable_free to be deallocated.  On an error a NULL is returned.
+ *
+ * ARGUMENTS:
+ *
+ * slot_n - Number of slots for the table.  Set to 0 to take the
+ * library default.  It will be rounded up to a power of 2.
+ *
+ * data_size - Size of the data stored with each key.
+ *
+ * error_p - Pointer to an integer which, if not NULL, will contain a
+ * table error code.
+ */
+extern
+itable_t	*itable_alloc(const unsigned int slot_n, const int data_size,
+			      int *error_p);
+
+/*
+ * int itable_free
+ *
+ * DESCRIPTION:
+ *
+ * Deallocates an integer table structure.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * itab_p - Table structure pointer that we will be freeing.
+ */
+extern
+int	itable_free(itable_t *itab_p);
+
+/*
+ * int itable_set_range
+ *
+ * DESCRIPTION:
+ *
+ * Count the keys from min to max in an array indexed by the key
+ * instead of in the hashed slots.  This is much faster for keys which
+ * fall in a small range such as status codes or hours of the day.
+ * The array is not allocated until a key lands in the range.  This
+ * must be called before any keys are inserted.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * itab_p - Table structure pointer whose range we are setting.
+ *
+ * min - First key of the dense range.
+ *
+ * max - Last key of the dense range.
+ */
+extern
+int	itable_set_range(itable_t *itab_p, const long min, const long max);
+
+/*
+ * int itable_insert
+ *
+ * DESCRIPTION:
+ *
+ * Add a key and its data into the table.  If the key already exists
+ * then its data is not overwritten.
+ *
+ * NOTE: The entries move when the table grows so the data pointer is
+ * only good until the next insert.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.  TABLE_ERROR_OVERWRITE if the key
+ * already exists in which case data_buf_p is set to its data.
+ *
+ * ARGUMENTS:
+ *
+ * itab_p - Table structure pointer into which we are adding the key.
+ *
+ * key - Key that we are adding.
+ *
+ * data_buf - Data that we are copying in with the key.  If NULL then
+ * the data is zeroed.
+ *
+ * data_buf_p - Pointer which, if not NULL, will be set to the
+ * location of the data in the table.
+ */
+extern
+int	itable_insert(itable_t *itab_p, const long key, const void *data_buf,
+		      void **data_buf_p);
+
+/*
+ * int itable_retrieve
+ *
+ * DESCRIPTION:
+ *
+ * Find a key in the table.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * itab_p - Table structure pointer that we are searching.
+ *
+ * key - Key that we are looking for.
+ *
+ * data_buf_p - Pointer which, if not NULL, will be set to the
+ * location of the key's data in the table.
+ */
+extern
+int	itable_retrieve(itable_t *itab_p, const long key, void **data_buf_p);
+
+/*
+ * itable_entry_t **itable_order
+ *
+ * DESCRIPTION:
+ *
+ * Order the entries of the table with a comparison function.  The
+ * returned array should be freed with itable_order_free.
+ *
+ * NOTE: Inserting into the table may move the entries so the array
+ * is only good until then.
+ *
+ * RETURNS:
+ *
+ * Success - An allocated list of table entries.
+ *
+ * Failure - NULL
+ *
+ * ARGUMENTS:
+ *
+ * itab_p - Table structure pointer that we are ordering.
+ *
+ * compare - Comparison function for the entries.  If NULL then the
+ * entries are left in the order of the slots.
+ *
+ * num_entries_p - Pointer to an integer which, if not NULL, will
+ * contain the number of entries in the returned array.
+ *
+ * error_p - Pointer to an integer which, if not NULL, will contain a
+ * table error code.
+ */
+extern
+itable_entry_t	**itable_order(itable_t *itab_p, itable_compare_t compare,
+			       int *num_entries_p, int *error_p);
+
+/*
+ * int itable_order_free
+ *
+ * DESCRIPTION:
+ *
+ * Free the array returned by itable_order.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * itab_p - Table structure pointer that was ordered.
+ *
+ * entries - Array of entries that we are freeing.
+ */
+extern
+int	itable_order_free(itable_t *itab_p, itable_entry_t **entries);
+
+/*
+ * int itable_entry
+ *
+ * DESCRIPTION:
+ *
+ * Get the key and data of an entry from itable_order.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * itab_p - Table structure pointer that the entry is from.
+ *
+ * entry_p - Entry that we are getting the information from.
+ *
+ * key_p - Pointer which, if not NULL, will be set to the location of
+ * the key in the entry.
+ *
+ * data_buf_p - Pointer which, if not NULL, will be set to the
+ * location of the data in the entry.
+ */
+extern
+int	itable_entry(itable_t *itab_p, itable_entry_t *entry_p, long **key_p,
+		     void **data_buf_p);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* ! __ITABLE_H__ */
@@ -0,0 +1,104 @@
+/*
+ * local defines for the integer table module
+ *
+ * Copyright 2008 by Gray Watson
+ *
+ * This file is part of the sortu package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+#ifndef __ITABLE_LOC_H__
+#define __ITABLE_LOC_H__
+
+#define ITABLE_MAGIC	0x1B0D1E5	/* integer table magic number */
+#define ITABLE_MIN_SIZE	16		/* min number of slots */
+
+/* max number of keys in a dense range, 16m entries */
+#define ITABLE_DENSE_MAX	(16 * 1024 * 1024)
+
+/*
+ * Number of entries below which we sort with insertion instead of
+ * splitting them again.
+ */
+#define ITABLE_SORT_MIN	12
+
+/* odd 64-bit constants from the murmur3 finalizer to mix the keys */
+#define IMIX_PRIME0	0xff51afd7ed558ccdULL
+#define IMIX_PRIME1	0xc4ceb9fe1a85ec53ULL
+
+/*
+ * Macros.
+ */
+
+/* set the pointer if it is not NULL */
+#define SET_POINTER(pnt, val) \
+	do { \
+	  if ((pnt) != NULL) { \
+	    (*(pnt)) = (val); \
+          } \
+        } while(0)
+
+/* returns 1 when another entry would make the slots 3/4ths used */
+#define SHOULD_ITABLE_GROW(tab)	\
+	((tab)->it_entry_n - (tab)->it_dense_entry_n + 1	\
+	 > (tab)->it_slot_n / 4 * 3)
+
+/*
+ * Index of a key in the dense range.  Keys outside of the range wrap
+ * around to large values so one unsigned comparison checks both ends.
+ */
+#define DENSE_INDEX(tab, key)	\
+	((unsigned long)(key) - (unsigned long)(tab)->it_dense_min)
+
+/*
+ * Entry in a slot.  There is an extra slot past the last one for the
+ * 0 key since a 0 key marks the other slots as empty.
+ */
+#define ITABLE_ENTRY(tab, slot)	\
+	((itable_entry_t *)((tab)->it_slots + (slot) * (tab)->it_entry_size))
+
+/*
+ * Entry in the dense range.  An unused entry has a key which does not
+ * match its index so there is no need for a separate empty marker.
+ */
+#define DENSE_ENTRY(tab, index)	\
+	((itable_entry_t *)((tab)->it_dense + (index) * (tab)->it_entry_size))
+
+/* pointer to the data which follows the key in an entry */
+#define IENTRY_DATA(entry_p)	((void *)((entry_p) + 1))
+
+/*
+ * Integer table structures.
+ */
+
+/* entry with its data right after it */
+typedef struct itable_entry_st {
+  long			ie_key;		/* key, 0 if slot is empty */
+} itable_entry_t;
+
+/* main integer table structure */
+typedef struct itable_st {
+  unsigned int		it_magic;	/* magic number */
+  unsigned int		it_slot_n;	/* number of slots, 2^X */
+  unsigned int		it_entry_n;	/* number of entries */
+  unsigned int		it_dense_entry_n; /* entries in the dense range */
+  unsigned int		it_data_size;	/* size of each entry's data */
+  unsigned int		it_entry_size;	/* size of each slot */
+  int			it_zero_b;	/* 1 if the 0 key is in the table */
+  unsigned char		*it_slots;	/* slot_n + 1 slots of entries */
+  long			it_dense_min;	/* first key in the dense range */
+  unsigned long		it_dense_n;	/* number of keys in the range */
+  unsigned char		*it_dense;	/* entries indexed by key - min */
+} itable_t;
+
+#endif /* ! __ITABLE_LOC_H__ */
@@ -0,0 +1,665 @@
+/*
+ * Sharded hash table routines...
+ *
+ * Copyright 2008 by Gray Watson
+ *
+ * This file is part of the sortu package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ *
+ * This splits the keys across a number of independent tables from
+ * table.c by the high bits of their hash.  Each sub-table has its own
+ * lock and arena so threads inserting different keys rarely wait on
+ * each other.  When ordering, the sub-tables are sorted in parallel
+ * and then merged into one array.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SHARD_MAIN
+
+#include "table.h"
+#include "shard.h"
+#include "shard_loc.h"
+
+/*
+ * static int entry_compare
+ *
+ * DESCRIPTION:
+ *
+ * Compare the next entries of two of the ordered sub-tables.
+ *
+ * RETURNS:
+ *
+ * -1, 0, or 1 if the entry of part1 is <, ==, or > than the entry of
+ * part2.
+ *
+ * ARGUMENTS:
+ *
+ * part1_p - First sub-table whose next entry we are comparing.
+ *
+ * part2_p - Second sub-table whose next entry we are comparing.
+ *
+ * compare - Comparison function for the entries.  If NULL then the
+ * keys are compared like table_order does.
+ */
+static	int	entry_compare(const shard_part_t *part1_p,
+			      const shard_part_t *part2_p,
+			      table_compare_t compare)
+{
+  void	*key1_p, *key2_p, *data1_p, *data2_p;
+  int	key1_size, key2_size, data1_size, data2_size, size, cmp;
+  
+  (void)table_entry(part1_p->sp_table,
+		    part1_p->sp_entries[part1_p->sp_entry_c],
+		    &key1_p, &key1_size, &data1_p, &data1_size);
+  (void)table_entry(part2_p->sp_table,
+		    part2_p->sp_entries[part2_p->sp_entry_c],
+		    &key2_p, &key2_size, &data2_p, &data2_size);
+  
+  if (compare != NULL) {
+    return compare(key1_p, key1_size, data1_p, data1_size,
+		   key2_p, key2_size, data2_p, data2_size);
+  }
+  
+  /* compare as many bytes as we can and then the longer is larger */
+  size = key1_size;
+  if (key2_size < size) {
+    size = key2_size;
+  }
+  cmp = memcmp(key1_p, key2_p, size);
+  if (cmp == 0) {
+    cmp = key1_size - key2_size;
+  }
+  return cmp;
+}
+
+/*
+ * static void *order_part
+ *
+ * DESCRIPTION:
+ *
+ * Order the entries of one of the sub-tables.  This is run in a
+ * thread for each of the sub-tables.
+ *
+ * RETURNS:
+ *
+ * NULL
+ *
+ * ARGUMENTS:
+ *
+ * arg - Sub-table that we are ordering.
+ */
+static	void	*order_part(void *arg)
+{
+  shard_part_t	*part_p = arg;
+  
+  part_p->sp_entry_n = 0;
+  part_p->sp_entry_c = 0;
+  part_p->sp_entries = table_order(part_p->sp_table, part_p->sp_compare,
+				   &part_p->sp_entry_n, &part_p->sp_error);
+  
+  /* an empty sub-table just has nothing to merge */
+  if (part_p->sp_entries == NULL && part_p->sp_error == TABLE_ERROR_EMPTY) {
+    part_p->sp_entry_n = 0;
+    part_p->sp_error = TABLE_ERROR_NONE;
+  }
+  
+  return NULL;
+}
+
+/*
+ * static void heap_down
+ *
+ * DESCRIPTION:
+ *
+ * Move a sub-table down the merge heap until its next entry is not
+ * larger than the next entries of the sub-tables below it.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * heap - Array of sub-tables that still have entries to merge.
+ *
+ * heap_n - Number of sub-tables in the heap.
+ *
+ * pos - Position of the sub-table that we are moving.
+ *
+ * compare - Comparison function for the entries.
+ */
+static	void	heap_down(shard_part_t **heap, const int heap_n, int pos,
+			  table_compare_t compare)
+{
+  shard_part_t	*part_p = heap[pos];
+  int		child;
+  
+  for (child = pos * 2 + 1; child < heap_n; child = pos * 2 + 1) {
+    if (child + 1 < heap_n
+	&& entry_compare(heap[child + 1], heap[child], compare) < 0) {
+      child++;
+    }
+    if (entry_compare(part_p, heap[child], compare) <= 0) {
+      break;
+    }
+    heap[pos] = heap[child];
+    pos = child;
+  }
+  heap[pos] = part_p;
+}
+
+/*
+ * shard_t *shard_alloc
+ *
+ * DESCRIPTION:
+ *
+ * Allocate a new sharded table made up of a number of sub-tables.
+ * Each of the sub-tables allocates its entries from its own arena.
+ * The sub-tables should all be set up the same way with shard_table
+ * before any keys are inserted.
+ *
+ * RETURNS:
+ *
+ * A pointer to the new sharded table which must be passed to
+ * shard_free to be deallocated.  On an error a NULL is returned.
+ *
+ * ARGUMENTS:
+ *
+ * shard_n - Number of sub-tables.
+ *
+ * chunk_size - Size of the arena chunks of each sub-table.  Set to 0
+ * to take the table library default.
+ *
+ * huge_pages_b - Set to 1 to allocate the arena chunks in huge pages
+ * if the system supports them.
+ *
+ * error_p - Pointer to an integer which, if not NULL, will contain a
+ * table error code.
+ */
+shard_t	*shard_alloc(const int shard_n, const unsigned int chunk_size,
+		     const int huge_pages_b, int *error_p)
+{
+  shard_t	*shard_p;
+  shard_part_t	*part_p;
+  int		part_c, ret;
+  
+  if (shard_n <= 0 || shard_n > SHARD_MAX) {
+    SET_POINTER(error_p, TABLE_ERROR_SIZE);
+    return NULL;
+  }
+  
+  shard_p = (shard_t *)malloc(sizeof(shard_t));
+  if (shard_p == NULL) {
+    SET_POINTER(error_p, TABLE_ERROR_ALLOC);
+    return NULL;
+  }
+  shard_p->sh_parts = (shard_part_t *)calloc(shard_n, sizeof(shard_part_t));
+  if (shard_p->sh_parts == NULL) {
+    free(shard_p);
+    SET_POINTER(error_p, TABLE_ERROR_ALLOC);
+    return NULL;
+  }
+  shard_p->sh_magic = SHARD_MAGIC;
+  shard_p->sh_part_n = 0;
+  
+  for (part_c = 0; part_c < shard_n; part_c++) {
+    part_p = shard_p->sh_parts + part_c;
+    part_p->sp_table = table_alloc_in_arena(0, chunk_size, huge_pages_b,
+					    &ret);
+    if (part_p->sp_table == NULL) {
+      (void)shard_free(shard_p);
+      SET_POINTER(error_p, ret);
+      return NULL;
+    }
+#ifndef NO_THREADS
+    (void)pthread_mutex_init(&part_p->sp_lock, NULL);
+#endif
+    shard_p->sh_part_n++;
+  }
+  
+  SET_POINTER(error_p, TABLE_ERROR_NONE);
+  return shard_p;
+}
+
+/*
+ * int shard_free
+ *
+ * DESCRIPTION:
+ *
+ * Deallocates a sharded table and all of its sub-tables.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * shard_p - Sharded table that we are freeing.
+ */
+int	shard_free(shard_t *shard_p)
+{
+  shard_part_t	*part_p, *bounds_p;
+  int		ret, final = TABLE_ERROR_NONE;
+  
+  if (shard_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (shard_p->sh_magic != SHARD_MAGIC) {
+    return TABLE_ERROR_PNT;
+  }
+  
+  bounds_p = shard_p->sh_parts + shard_p->sh_part_n;
+  for (part_p = shard_p->sh_parts; part_p < bounds_p; part_p++) {
+    ret = table_free(part_p->sp_table);
+    if (ret != TABLE_ERROR_NONE) {
+      final = ret;
+    }
+#ifndef NO_THREADS
+    (void)pthread_mutex_destroy(&part_p->sp_lock);
+#endif
+  }
+  
+  free(shard_p->sh_parts);
+  shard_p->sh_magic = 0;
+  free(shard_p);
+  
+  return final;
+}
+
+/*
+ * table_t *shard_table
+ *
+ * DESCRIPTION:
+ *
+ * Get one of the sub-tables so its flags, data alignment, etc. can be
+ * set with the usual table routines.
+ *
+ * NOTE: All of the sub-tables must have the same TABLE_FLAG_FAST_HASH
+ * setting since the hash of a key picks its sub-table and is then used
+ * to insert it.
+ *
+ * RETURNS:
+ *
+ * Success - Pointer to the sub-table.
+ *
+ * Failure - NULL
+ *
+ * ARGUMENTS:
+ *
+ * shard_p - Sharded table whose sub-table we are getting.
+ *
+ * index - Number of the sub-table from 0 to shard_n - 1.
+ */
+table_t	*shard_table(shard_t *shard_p, const int index)
+{
+  if (shard_p == NULL || shard_p->sh_magic != SHARD_MAGIC) {
+    return NULL;
+  }
+  if (index < 0 || index >= shard_p->sh_part_n) {
+    return NULL;
+  }
+  
+  return shard_p->sh_parts[index].sp_table;
+}
+
+/*
+ * int shard_insert
+ *
+ * DESCRIPTION:
+ *
+ * Add a key/data pair to the sub-table picked by the key's hash.
+ * This may be called by a number of threads at once.  If the key is
+ * already in the table then the merge function is called to combine
+ * the new data with the old.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE if the key was added.
+ *
+ * Failure - Table error code.  TABLE_ERROR_OVERWRITE if the key
+ * already existed and its data was merged.
+ *
+ * ARGUMENTS:
+ *
+ * shard_p - Sharded table that we are inserting into.
+ *
+ * key_buf - Buffer of bytes of the key that we are inserting.
+ *
+ * key_size - Size of the key_buf buffer.  If set to < 0 then the
+ * library will do a strlen of key_buf and add 1 for the '\0'.
+ *
+ * data_buf - Buffer of bytes of the data that we are inserting.
+ *
+ * data_size - Size of the data_buf buffer.
+ *
+ * merge_func - Function which merges the data into the data of an
+ * existing key.  If NULL then the existing data is left alone.
+ */
+int	shard_insert(shard_t *shard_p, const void *key_buf, const int key_size,
+		     const void *data_buf, const int data_size,
+		     table_merge_t merge_func)
+{
+  shard_part_t	*part_p;
+  void		*data_p;
+  unsigned int	hash_val;
+  int		ret;
+  
+  if (shard_p == NULL || key_buf == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (shard_p->sh_magic != SHARD_MAGIC) {
+    return TABLE_ERROR_PNT;
+  }
+  
+  /* the hash picks the sub-table and is then used to insert the key */
+  hash_val = table_hash(shard_p->sh_parts[0].sp_table, key_buf, key_size);
+  part_p = shard_p->sh_parts + HASH_SHARD(shard_p, hash_val);
+  
+#ifndef NO_THREADS
+  (void)pthread_mutex_lock(&part_p->sp_lock);
+#endif
+  ret = table_insert_hash(part_p->sp_table, key_buf, key_size, hash_val,
+			  data_buf, data_size, &data_p, 0);
+  if (ret == TABLE_ERROR_OVERWRITE && merge_func != NULL && data_p != NULL) {
+    merge_func(data_p, data_buf, data_size);
+  }
+#ifndef NO_THREADS
+  (void)pthread_mutex_unlock(&part_p->sp_lock);
+#endif
+  
+  return ret;
+}
+
+/*
+ * int shard_info
+ *
+ * DESCRIPTION:
+ *
+ * Get the number of entries in all of the sub-tables.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * shard_p - Sharded table that we are getting the information about.
+ *
+ * num_entries_p - Pointer to an integer which, if not NULL, will be
+ * set to the number of entries.
+ */
+int	shard_info(shard_t *shard_p, int *num_entries_p)
+{
+  shard_part_t	*part_p, *bounds_p;
+  int		entry_n, total = 0, ret;
+  
+  if (shard_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (shard_p->sh_magic != SHARD_MAGIC) {
+    return TABLE_ERROR_PNT;
+  }
+  
+  bounds_p = shard_p->sh_parts + shard_p->sh_part_n;
+  for (part_p = shard_p->sh_parts; part_p < bounds_p; part_p++) {
+    ret = table_info(part_p->sp_table, NULL, &entry_n);
+    if (ret != TABLE_ERROR_NONE) {
+      return ret;
+    }
+    total += entry_n;
+  }
+  
+  SET_POINTER(num_entries_p, total);
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * table_entry_t **shard_order
+ *
+ * DESCRIPTION:
+ *
+ * Order the entries of all of the sub-tables into one array.  Each of
+ * the sub-tables is sorted in its own thread and then the sorted
+ * entries are merged.  The returned array should be freed with
+ * shard_order_free.
+ *
+ * WARNING: This must not be called while other threads are inserting.
+ *
+ * RETURNS:
+ *
+ * Success - An allocated list of table entries.
+ *
+ * Failure - NULL
+ *
+ * ARGUMENTS:
+ *
+ * shard_p - Sharded table that we are ordering.
+ *
+ * compare - Comparison function for the entries.  If NULL then the
+ * keys are compared like table_order does.
+ *
+ * num_entries_p - Pointer to an integer which, if not NULL, will
+ * contain the number of entries in the returned array.
+ *
+ * error_p - Pointer to an integer which, if not NULL, will contain a
+ * table error code.
+ */
+table_entry_t	**shard_order(shard_t *shard_p, table_compare_t compare,
+			      int *num_entries_p, int *error_p)
+{
+  shard_part_t	*part_p, *bounds_p, **heap;
+  table_entry_t	**entries, **entries_p;
+  int		heap_n, entry_n, ret;
+#ifndef NO_THREADS
+  pthread_t	*threads;
+  int		part_c;
+#endif
+  
+  if (shard_p == NULL) {
+    SET_POINTER(error_p, TABLE_ERROR_ARG_NULL);
+    return NULL;
+  }
+  if (shard_p->sh_magic != SHARD_MAGIC) {
+    SET_POINTER(error_p, TABLE_ERROR_PNT);
+    return NULL;
+  }
+  
+  ret = shard_info(shard_p, &entry_n);
+  if (ret != TABLE_ERROR_NONE) {
+    SET_POINTER(error_p, ret);
+    return NULL;
+  }
+  if (entry_n == 0) {
+    SET_POINTER(error_p, TABLE_ERROR_EMPTY);
+    return NULL;
+  }
+  
+  entries = (table_entry_t **)malloc(entry_n * sizeof(table_entry_t *));
+  heap = (shard_part_t **)malloc(shard_p->sh_part_n * sizeof(shard_part_t *));
+  if (entries == NULL || heap == NULL) {
+    free(entries);
+    free(heap);
+    SET_POINTER(error_p, TABLE_ERROR_ALLOC);
+    return NULL;
+  }
+  
+  bounds_p = shard_p->sh_parts + shard_p->sh_part_n;
+  for (part_p = shard_p->sh_parts; part_p < bounds_p; part_p++) {
+    part_p->sp_compare = compare;
+  }
+  
+  /* sort each of the sub-tables, in parallel if we can */
+#ifdef NO_THREADS
+  for (part_p = shard_p->sh_parts; part_p < bounds_p; part_p++) {
+    (void)order_part(part_p);
+  }
+#else
+  threads = (pthread_t *)malloc(shard_p->sh_part_n * sizeof(pthread_t));
+  for (part_c = 0; part_c < shard_p->sh_part_n; part_c++) {
+    if (threads == NULL
+	|| pthread_create(threads + part_c, NULL, order_part,
+			  shard_p->sh_parts + part_c) != 0) {
+      /* no thread so do it ourselves */
+      (void)order_part(shard_p->sh_parts + part_c);
+      if (threads != NULL) {
+	threads[part_c] = pthread_self();
+      }
+    }
+  }
+  if (threads != NULL) {
+    for (part_c = 0; part_c < shard_p->sh_part_n; part_c++) {
+      if (! pthread_equal(threads[part_c], pthread_self())) {
+	(void)pthread_join(threads[part_c], NULL);
+      }
+    }
+    free(threads);
+  }
+#endif
+  
+  /* build a heap of the sub-tables by their next entry */
+  ret = TABLE_ERROR_NONE;
+  heap_n = 0;
+  for (part_p = shard_p->sh_parts; part_p < bounds_p; part_p++) {
+    if (part_p->sp_error != TABLE_ERROR_NONE) {
+      ret = part_p->sp_error;
+    }
+    else if (part_p->sp_entry_n > 0) {
+      heap[heap_n++] = part_p;
+    }
+  }
+  
+  if (ret == TABLE_ERROR_NONE) {
+    for (entry_n = heap_n / 2 - 1; entry_n >= 0; entry_n--) {
+      heap_down(heap, heap_n, entry_n, compare);
+    }
+  
+    /* take the smallest next entry until all of the sub-tables are done */
+    entries_p = entries;
+    while (heap_n > 0) {
+      part_p = heap[0];
+      *entries_p++ = part_p->sp_entries[part_p->sp_entry_c++];
+      if (part_p->sp_entry_c >= part_p->sp_entry_n) {
+	heap[0] = heap[--heap_n];
+      }
+      if (heap_n > 0) {
+	heap_down(heap, heap_n, 0, compare);
+      }
+    }
+    entry_n = entries_p - entries;
+  }
+  
+  /* the merged array has all of the entries now */
+  for (part_p = shard_p->sh_parts; part_p < bounds_p; part_p++) {
+    if (part_p->sp_entries != NULL) {
+      (void)table_order_free(part_p->sp_table, part_p->sp_entries,
+			     part_p->sp_entry_n);
+      part_p->sp_entries = NULL;
+    }
+  }
+  free(heap);
+  
+  if (ret != TABLE_ERROR_NONE) {
+    free(entries);
+    SET_POINTER(error_p, ret);
+    return NULL;
+  }
+  
+  SET_POINTER(num_entries_p, entry_n);
+  SET_POINTER(error_p, TABLE_ERROR_NONE);
+  return entries;
+}
+
+/*
+ * int shard_order_free
+ *
+ * DESCRIPTION:
+ *
+ * Free the array returned by shard_order.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * shard_p - Sharded table that was ordered.
+ *
+ * entries - Array of entries that we are freeing.
+ */
+int	shard_order_free(shard_t *shard_p, table_entry_t **entries)
+{
+  if (shard_p == NULL || entries == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (shard_p->sh_magic != SHARD_MAGIC) {
+    return TABLE_ERROR_PNT;
+  }
+  
+  free(entries);
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * int shard_entry
+ *
+ * DESCRIPTION:
+ *
+ * Get the key and data of an entry from shard_order.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * shard_p - Sharded table that the entry is from.
+ *
+ * entry_p - Entry that we are getting the information from.
+ *
+ * key_buf_p - Pointer which, if not NULL, will be set to the key of
+ * the entry.
+ *
+ * key_size_p - Pointer to an integer which, if not NULL, will be set
+ * to the size of the key.
+ *
+ * data_buf_p - Pointer which, if not NULL, will be set to the data of
+ * the entry.
+ *
+ * data_size_p - Pointer to an integer which, if not NULL, will be set
+ * to the size of the data.
+ */
+int	shard_entry(shard_t *shard_p, table_entry_t *entry_p,
+		    void **key_buf_p, int *key_size_p,
+		    void **data_buf_p, int *data_size_p)
+{
+  if (shard_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (shard_p->sh_magic != SHARD_MAGIC) {
+    return TABLE_ERROR_PNT;
+  }
+  
+  /* the sub-tables are all set up the same so any of them will do */
+  return table_entry(shard_p->sh_parts[0].sp_table, entry_p, key_buf_p,
+		     key_size_p, data_buf_p, data_size_p);
+}
@@ -0,0 +1,285 @@
+/*
+ * Sharded hash table routines...
+ *
+ * Copyright 2008 by Gray Watson
+ *
+ * This file is part of the sortu package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+#ifndef __SHARD_H__
+#define __SHARD_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * The routines return the TABLE_ERROR_* codes from table.h which can
+ * be turned into strings with table_strerror.  The keys, data,
+ * comparison, and merge functions work like they do in table.h.
+ */
+
+#ifdef SHARD_MAIN
+
+#include "shard_loc.h"
+
+#else
+
+/* generic sharded table type */
+typedef void	shard_t;
+
+#endif
+
+/*<<<<<<<<<<  The below prototypes are auto-generated by fillproto */
+
+/*
+ * shard_t *shard_alloc
+ *
+ * DESCRIPTION:
+ *
+ * Allocate a new sharded table made up of a number of sub-tables.
+ * Each of the sub-tables allocates its entries from its own arena.
+ * The sub-tables should all be set up the same way with shard_table
+ * before any keys are inserted.
+ *
+ * RETURNS:
+ *
+ * A pointer to the new sharded table which must be passed to
+ * shard_free to be deallocated.  On an error a NULL is returned.
+ *
+ * ARGUMENTS:
+ *
+ * shard_n - Number of sub-tables.
+ *
+ * chunk_size - Size of the arena chunks of each sub-table.  Set to 0
+ * to take the table library default.
+ *
+ * huge_pages_b - Set to 1 to allocate the arena chunks in huge pages
+ * if the system supports them.
+ *
+ * error_p - Pointer to an integer which, if not NULL, will contain a
+ * table error code.
+ */
+extern
+shard_t	*shard_alloc(const int shard_n, const unsigned int chunk_size,
+		     const int huge_pages_b, int *error_p);
+
+/*
+ * int shard_free
+ *
+ * DESCRIPTION:
+ *
+ * Deallocates a sharded table and all of its sub-tables.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * shard_p - Sharded table that we are freeing.
+ */
+extern
+int	shard_free(shard_t *shard_p);
+
+/*
+ * table_t *shard_table
+ *
+ * DESCRIPTION:
+ *
+ * Get one of the sub-tables so its flags, data alignment, etc. can be
+ * set with the usual table routines.
+ *
+ * NOTE: All of the sub-tables must have the same TABLE_FLAG_FAST_HASH
+ * setting since the hash of a key picks its sub-table and is then used
+ * to insert it.
+ *
+ * RETURNS:
+ *
+ * Success - Pointer to the sub-table.
+ *
+ * Failure - NULL
+ *
+ * ARGUMENTS:
+ *
+ * shard_p - Sharded table whose sub-table we are getting.
+ *
+ * index - Number of the sub-table from 0 to shard_n - 1.
+ */
+extern
+table_t	*shard_table(shard_t *shard_p, const int index);
+
+/*
+ * int shard_insert
+ *
+ * DESCRIPTION:
+ *
+ * Add a key/data pair to the sub-table picked by the key's hash.
+ * This may be called by a number of threads at once.  If the key is
+ * already in the table then the merge function is called to combine
+ * the new data with the old.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE if the key was added.
+ *
+ * Failure - Table error code.  TABLE_ERROR_OVERWRITE if the key
+ * already existed and its data was merged.
+ *
+ * ARGUMENTS:
+ *
+ * shard_p - Sharded table that we are inserting into.
+ *
+ * key_buf - Buffer of bytes of the key that we are inserting.
+ *
+ * key_size - Size of the key_buf buffer.  If set to < 0 then the
+ * library will do a strlen of key_buf and add 1 for the '\0'.
+ *
+ * data_buf - Buffer of bytes of the data that we are inserting.
+ *
+ * data_size - Size of the data_buf buffer.
+ *
+ * merge_func - Function which merges the data into the data of an
+ * existing key.  If NULL then the existing data is left alone.
+ */
+extern
+int	shard_insert(shard_t *shard_p, const void *key_buf, const int key_size,
+		     const void *data_buf, const int data_size,
+		     table_merge_t merge_func);
+
+/*
+ * int shard_info
+ *
+ * DESCRIPTION:
+ *
+ * Get the number of entries in all of the sub-tables.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * shard_p - Sharded table that we are getting the information about.
+ *
+ * num_entries_p - Pointer to an integer which, if not NULL, will be
+ * set to the number of entries.
+ */
+extern
+int	shard_info(shard_t *shard_p, int *num_entries_p);
+
+/*
+ * table_entry_t **shard_order
+ *
+ * DESCRIPTION:
+ *
+ * Order the entries of all of the sub-tables into one array.  Each of
+ * the sub-tables is sorted in its own thread and then the sorted
+ * entries are merged.  The returned array should be freed with
+ * shard_order_free.
+ *
+ * WARNING: This must not be called while other threads are inserting.
+ *
+ * RETURNS:
+ *
+ * Success - An allocated list of table entries.
+ *
+ * Failure - NULL
+ *
+ * ARGUMENTS:
+ *
+ * shard_p - Sharded table that we are ordering.
+ *
+ * compare - Comparison function for the entries.  If NULL then the
+ * keys are compared like table_order does.
+ *
+ * num_entries_p - Pointer to an integer which, if not NULL, will
+ * contain the number of entries in the returned array.
+ *
+ * error_p - Pointer to an integer which, if not NULL, will contain a
+ * table error code.
+ */
+extern
+table_entry_t	**shard_order(shard_t *shard_p, table_compare_t compare,
+			      int *num_entries_p, int *error_p);
+
+/*
+ * int shard_order_free
+ *
+ * DESCRIPTION:
+ *
+ * Free the array returned by shard_order.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * shard_p - Sharded table that was ordered.
+ *
+ * entries - Array of entries that we are freeing.
+ */
+extern
+int	shard_order_free(shard_t *shard_p, table_entry_t **entries);
+
+/*
+ * int shard_entry
+ *
+ * DESCRIPTION:
+ *
+ * Get the key and data of an entry from shard_order.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * shard_p - Sharded table that the entry is from.
+ *
+ * entry_p - Entry that we are getting the information from.
+ *
+ * key_buf_p - Pointer which, if not NULL, will be set to the key of
+ * the entry.
+ *
+ * key_size_p - Pointer to an integer which, if not NULL, will be set
+ * to the size of the key.
+ *
+ * data_buf_p - Pointer which, if not NULL, will be set to the data of
+ * the entry.
+ *
+ * data_size_p - Pointer to an integer which, if not NULL, will be set
+ * to the size of the data.
+ */
+extern
+int	shard_entry(shard_t *shard_p, table_entry_t *entry_p,
+		    void **key_buf_p, int *key_size_p,
+		    void **data_buf_p, int *data_size_p);
+
+/*<<<<<<<<<<   This is end of the auto-generated output from fillproto. */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* ! __SHARD_H__ */
@@ -0,0 +1,74 @@
+/*
+ * local defines for the sharded table module
+ *
+ * Copyright 2008 by Gray Watson
+ *
+ * This file is part of the sortu package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+#ifndef __SHARD_LOC_H__
+#define __SHARD_LOC_H__
+
+#ifndef NO_THREADS
+#include <pthread.h>
+#endif
+
+#define SHARD_MAGIC	0x5AD0BED	/* sharded table magic number */
+#define SHARD_MAX	1024		/* max number of shards */
+
+/*
+ * Macros.
+ */
+
+/* set the pointer if it is not NULL */
+#define SET_POINTER(pnt, val) \
+	do { \
+	  if ((pnt) != NULL) { \
+	    (*(pnt)) = (val); \
+          } \
+        } while(0)
+
+/*
+ * Shard of a hash value.  The high bits pick the shard so the low
+ * bits, which the sub-table uses for its buckets, stay well spread.
+ */
+#define HASH_SHARD(shard_p, hash)	\
+	((unsigned int)(((unsigned long long)(hash) * (shard_p)->sh_part_n) \
+			>> 32))
+
+/*
+ * Sharded table structures.
+ */
+
+/* one of the independent sub-tables */
+typedef struct {
+  table_t		*sp_table;	/* sub-table with its own arena */
+#ifndef NO_THREADS
+  pthread_mutex_t	sp_lock;	/* lock for inserting into table */
+#endif
+  table_compare_t	sp_compare;	/* compare function when ordering */
+  table_entry_t		**sp_entries;	/* ordered entries of the table */
+  int			sp_entry_n;	/* number of ordered entries */
+  int			sp_entry_c;	/* next entry to merge */
+  int			sp_error;	/* error from ordering the table */
+} shard_part_t;
+
+/* main sharded table structure */
+typedef struct shard_st {
+  unsigned int		sh_magic;	/* magic number */
+  unsigned int		sh_part_n;	/* number of sub-tables */
+  shard_part_t		*sh_parts;	/* array of sub-tables */
+} shard_t;
+
+#endif /* ! __SHARD_LOC_H__ */
@@ -19,45 +19,178 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if defined __unix__ || defined __APPLE__
+
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#else
+
+#include <io.h>
+
+#define NO_MMAP
+#define NO_THREADS
+
+#endif
+
 #include "argv.h"
+#include "field.h"
+#include "itable.h"
 #include "table.h"
+#include "shard.h"
 
 #define DEFAULT_DELIM	" "
 #define VERSION_STRING	"2.1.2"
-#define LINE_SIZE	1024
+#define BLOCK_SIZE	(1024 * 1024)	/* size of our stream reads */
+#define CHUNK_MIN	(16 * 1024 * 1024) /* min size of a file chunk */
+#define THREAD_CHUNKS	4		/* file chunks for each thread */
+#define NUMBER_SIZE	64		/* max chars of a -n or -N field */
+#define RANGE_MIN	0		/* first -n key counted densely */
+#define RANGE_MAX	65535		/* last -n key counted densely */
+#define BATCH_SIZE	32		/* keys inserted into a table at once */
+#define SAMPLE_SIZE	(4 * 1024 * 1024) /* bytes sampled to estimate keys */
+#define HLL_BITS	12		/* hash bits picking a sketch register */
+#define HLL_SIZE	(1 << HLL_BITS)	/* registers in our key sketch */
+#define EXPECTED_MAX	(1L << 30)	/* most keys we size the table for */
+#define KEY_SIZE_GUESS	16		/* average key size if not sampled */
+#define ENTRY_OVERHEAD	48		/* table space of a key past its bytes */
+#define ARENA_MIN	(1024 * 1024)	/* smallest arena chunk we ask for */
+#define ARENA_MAX	(256 * 1024 * 1024) /* largest arena chunk we ask for */
+#define STATE_MAGIC	0x5047D00E	/* end of our --state files */
+#define TAIL_SIZE	(64 * 1024)	/* block read looking for the last \n */
 
 /* struct for the order/count stuff */
 typedef struct {
   unsigned long	so_count;		/* count that we have seen the item */
-  int		so_order;		/* order that we get it for -o */
+  unsigned long	so_offset;		/* offset of its first line for -o */
+  int		so_file;		/* file of its first line for -o */
 } sortu_t;
 
+/* returns 1 if sortu1 was seen before sortu2 */
+#define SORTU_BEFORE(sortu1_p, sortu2_p)				\
+	((sortu1_p)->so_file < (sortu2_p)->so_file			\
+	 || ((sortu1_p)->so_file == (sortu2_p)->so_file			\
+	     && (sortu1_p)->so_offset < (sortu2_p)->so_offset))
+
+/* a file or a chunk of one for our threads to process */
+typedef struct {
+  int		jo_file;		/* which file to process */
+  unsigned long	jo_start;		/* offset of the start of the chunk */
+  unsigned long	jo_end;			/* end of the chunk or 0 for all */
+} job_t;
+
+/* position of an input file recorded in our --state file */
+typedef struct {
+  unsigned long long	sf_dev;		/* device of the file */
+  unsigned long long	sf_inode;	/* inode of the file */
+  unsigned long long	sf_offset;	/* offset we have processed up to */
+} state_file_t;
+
+/* options that pick the keys which the counts of a --state file used */
+typedef struct {
+  int		sk_field;		/* field from -f */
+  int		sk_start_offset;	/* offset from -s */
+  int		sk_stop_offset;		/* offset from -S */
+  int		sk_loose_fields_b;	/* -l flag */
+  int		sk_case_insens_b;	/* -i flag */
+  int		sk_numbers_float_b;	/* -N flag */
+  int		sk_ignore_blanks_b;	/* -b flag */
+  char		sk_delims[256];		/* 1 if char is a -d delimiter */
+} state_key_t;
+
+/* end of a --state file after the saved table and the file positions */
+typedef struct {
+  state_key_t		se_key;		/* key options of the counts */
+  unsigned int		se_magic;	/* STATE_MAGIC */
+  unsigned int		se_file_n;	/* number of file positions */
+} state_end_t;
+
+/* part of an input file that we process with --state */
+typedef struct {
+  int		ra_state;		/* file position and -o file number */
+  unsigned long	ra_start;		/* offset we start processing at */
+  unsigned long	ra_end;			/* offset past its last full line */
+} range_t;
+
+/* line processing state for each of our threads */
+typedef struct {
+  table_t	*sc_table;		/* table we are adding keys to */
+  itable_t	*sc_itable;		/* table we are adding -n keys to */
+  shard_t	*sc_shards;		/* sharded table or NULL */
+  int		sc_file;		/* which file we are processing */
+  char		*sc_lower_buf;		/* buffer for -i keys */
+  int		sc_lower_size;		/* size of the lower buffer */
+  const void	*sc_batch_keys[BATCH_SIZE]; /* keys waiting to be inserted */
+  int		sc_batch_sizes[BATCH_SIZE]; /* sizes of the waiting keys */
+  sortu_t	sc_batch[BATCH_SIZE];	/* information of the waiting keys */
+  int		sc_batch_n;		/* number of keys waiting */
+  char		*sc_key_buf;		/* copies of waiting -i and -N keys */
+  int		sc_key_size;		/* size of the key buffer */
+  int		sc_key_len;		/* amount of the key buffer used */
+} scan_t;
+
 /* argument variables */
+static	int		huge_pages_b = 0;	/* use huge pages for table */
 static	int		ignore_blanks_b = 0;	/* ignore blank lines */
 static	int		cumulative_b = 0;	/* show cumulative numbers */
+static	int		estimate_keys_b = 0;	/* estimate keys from a sample */
+static	long		expected_keys = 0;	/* number of keys to size for */
 static	int		no_counts_b = 0;	/* don't output str counts */
 static	char		*delim_str = DEFAULT_DELIM; /* field delim char */
 static	int		field = -1;		/* field to use */
 static	char		*format_string = 0L;	/* format argument */
 static	int		case_insens_b = 0;	/* case insensitive matches */
+static	long		chunk_min = CHUNK_MIN;	/* min size of a file chunk */
 static	int		help_b = 0;		/* help message */
+static	int		inline_keys = 0;	/* max key size in the slots */
 static	int		key_sort_b = 0;		/* sort by key not count */
 static	int		loose_fields_b = 0;	/* loose field match */
+static	char		*lookup_file = NULL;	/* saved table to look in */
 static	int		min_matches = 0;	/* minimum number of matches */
+static	char		*number_range = NULL;	/* -n keys counted densely */
 static	int		max_matches = 0;	/* max number of matches */
+static	int		merge_b = 0;		/* merge counts of other runs */
 static	int		numbers_b = 0;		/* fields are numbers */
 static	int		numbers_float_b = 0;	/* fields are floats */
+static	int		open_table_b = 0;	/* open addressing table */
 static	int		order_sort_b = 0;	/* keep order when sorting */
+static	char		*partial_file = NULL;	/* partial result to write */
 static	int		show_percentage_b = 0;	/* show percentage vals */
 static	int		reverse_sort_b = 0;	/* reverse the sort order */
+static	char		*save_file = NULL;	/* file to save table to */
+static	int		shard_n = 0;		/* number of table shards */
+static	int		shared_table_b = 0;	/* threads share one table */
 static	int		start_offset = 0;	/* field starts at offset */
+static	char		*state_path = NULL;	/* counts and file positions */
+static	int		table_stats_b = 0;	/* print table statistics */
 static	int		stop_offset = -1;	/* field stops at offset */
+static	int		thread_n = 1;		/* number of threads */
 static	int		verbose_b = 0;		/* verbose flag */
+static	long		range_min = RANGE_MIN;	/* first dense -n key */
+static	long		range_max = RANGE_MAX;	/* last dense -n key */
+static	int		key_size_guess = KEY_SIZE_GUESS; /* average key size */
 static	argv_array_t	files;			/* work files */
 
+/* line processing variables */
+static	field_delim_t	delims;			/* our delimiter characters */
+static	state_file_t	*states = NULL;		/* positions from --state */
+static	int		state_n = 0;		/* number of file positions */
+static	range_t		*ranges = NULL;		/* parts of files for --state */
+#ifndef NO_THREADS
+static	pthread_mutex_t	job_lock = PTHREAD_MUTEX_INITIALIZER;
+static	job_t		*jobs = NULL;		/* work for our threads */
+static	int		job_n = 0;		/* number of jobs */
+static	int		job_c = 0;		/* next job for our threads */
+#endif
+
 /* argument array */
 static	argv_t	args[] = {
   { 'b',	"blank-ignore",	ARGV_BOOL_INT,		&ignore_blanks_b,
@@ -74,6 +207,8 @@ static	argv_t	args[] = {
     "format",		"output format: %k %n %l %p %c" },
   { 'h',	"help",		ARGV_BOOL_INT,		&help_b,
     NULL,		"help message" },
+  { 'j',	"jobs",		ARGV_INT,		&thread_n,
+    "number",		"process files with # threads" },
   { 'k',	"key-sort",	ARGV_BOOL_INT,		&key_sort_b,
     NULL,		"sort by key not count" },
   { 'l',	"loose-fields",	ARGV_BOOL_INT,		&loose_fields_b,
@@ -101,6 +236,36 @@ static	argv_t	args[] = {
     "offset",		"field stops at offset" },
   { 'v',	"verbose",	ARGV_BOOL_INT,		&verbose_b,
     NULL,		"verbose mode" },
+  { '\0',	"open-table",	ARGV_BOOL_INT,		&open_table_b,
+    NULL,		"use open addressing hash table" },
+  { '\0',	"huge-pages",	ARGV_BOOL_INT,		&huge_pages_b,
+    NULL,		"allocate table entries in huge pages" },
+  { '\0',	"inline-keys",	ARGV_INT,		&inline_keys,
+    "size",		"store keys up to size in open table" },
+  { '\0',	"shards",	ARGV_INT,		&shard_n,
+    "number",		"split table into # locked shards" },
+  { '\0',	"shared-table",	ARGV_BOOL_INT,		&shared_table_b,
+    NULL,		"threads insert into one shared table" },
+  { '\0',	"chunk-size",	ARGV_SIZE,		&chunk_min,
+    "size",		"min size of a file chunk for -j" },
+  { '\0',	"number-range",	ARGV_CHAR_P,		&number_range,
+    "min,max",		"count -n keys in range in an array" },
+  { '\0',	"expected-keys", ARGV_SIZE,		&expected_keys,
+    "number",		"size the table for # keys" },
+  { '\0',	"estimate-keys", ARGV_BOOL_INT,		&estimate_keys_b,
+    NULL,		"size the table from a sample of files" },
+  { '\0',	"table-stats",	ARGV_BOOL_INT,		&table_stats_b,
+    NULL,		"print hash table statistics to stderr" },
+  { '\0',	"save-table",	ARGV_CHAR_P,		&save_file,
+    "file",		"save the counts to a table file" },
+  { '\0',	"lookup",	ARGV_CHAR_P,		&lookup_file,
+    "file",		"print counts of keys from a saved table" },
+  { '\0',	"state",	ARGV_CHAR_P,		&state_path,
+    "file",		"only count lines added since the last run" },
+  { '\0',	"emit-partial",	ARGV_CHAR_P,		&partial_file,
+    "file",		"write counts for --merge instead of output" },
+  { '\0',	"merge",	ARGV_BOOL_INT,		&merge_b,
+    NULL,		"add up partial results and count outputs" },
   { ARGV_MAYBE,	NULL,		ARGV_CHAR_P | ARGV_FLAG_ARRAY, &files,
     "file(s)",		"file(s) to process else stdin" },
   { ARGV_LAST }
@@ -225,7 +390,12 @@ static	int	count_compare(const void *key1_p, const int key1_size,
   
   if (order_sort_b) {
     /* the order will always be uniq */
-    return sortu1_p->so_order - sortu2_p->so_order;
+    if (SORTU_BEFORE(sortu1_p, sortu2_p)) {
+      return -1;
+    }
+    else {
+      return 1;
+    }
   }
   
   /* if we aren't sorting by key then sort the count */
@@ -282,202 +452,2354 @@ static	int	count_compare(const void *key1_p, const int key1_size,
     }
   }
   else {
-    /* forward string sort */
+    /* forward string sort, the keys are not \0 terminated */
     str1_p = key1_p;
     str2_p = key2_p;
+    if (key1_size < key2_size) {
+      result = memcmp(str1_p, str2_p, key1_size);
+    }
+    else {
+      result = memcmp(str1_p, str2_p, key2_size);
+    }
+    /* if common-size equal, then if next more bytes, it is larger */
+    if (result == 0) {
+      result = key1_size - key2_size;
+    }
     if (reverse_sort_b) {
-      return strcmp(str2_p, str1_p);
+      return -result;
     }
     else {
-      return strcmp(str1_p, str2_p);
+      return result;
     }
   }
 }
 
-int	main(int argc, char **argv)
+/*
+ * static int number_order_compare
+ *
+ * DESCRIPTION:
+ *
+ * Compare the entries of our integer table by the order that they
+ * were found in the files.
+ *
+ * RETURNS:
+ *
+ * -1 or 1 if key1 was found before or after key2.
+ *
+ * ARGUMENTS:
+ *
+ * key1 -> The first key.
+ *
+ * data1 -> Pointer to the first data entry.
+ *
+ * key2 -> The second key.
+ *
+ * data2 -> Pointer to the second data entry.
+ */
+static	int	number_order_compare(const long key1, const void *data1_p,
+				     const long key2, const void *data2_p)
 {
-  FILE		*infile;
-  char		*filename, line[LINE_SIZE], *tok, *line_p, *line_bounds_p;
-  int		file_c, ret, field_c, key_size, entry_n;
-  unsigned long	total, subtotal, perc;
-  long		value;
-  double	double_value;
-  void		*key_p;
-  table_t	*tab;
-  sortu_t	sortu, *sortu_p;
-  table_entry_t	**entries, **entries_p;
+  if (SORTU_BEFORE((const sortu_t *)data1_p, (const sortu_t *)data2_p)) {
+    return -1;
+  }
+  else {
+    return 1;
+  }
+}
+
+/*
+ * static int number_key_compare
+ *
+ * DESCRIPTION:
+ *
+ * Compare the keys of our integer table.
+ *
+ * RETURNS:
+ *
+ * -1, 0, or 1 if key1 is <, ==, or > than key2.
+ *
+ * ARGUMENTS:
+ *
+ * key1 -> The first key.
+ *
+ * data1 -> Pointer to the first data entry.
+ *
+ * key2 -> The second key.
+ *
+ * data2 -> Pointer to the second data entry.
+ */
+static	int	number_key_compare(const long key1, const void *data1_p,
+				   const long key2, const void *data2_p)
+{
+  int	result;
   
-  argv_version_string = VERSION_STRING;
-  argv_process(args, argc, argv);
+  result = (key1 > key2) - (key1 < key2);
+  if (reverse_sort_b) {
+    return -result;
+  }
+  else {
+    return result;
+  }
+}
+
+/*
+ * static int number_count_compare
+ *
+ * DESCRIPTION:
+ *
+ * Compare the counts of the entries of our integer table and then
+ * their keys if the counts are the same.
+ *
+ * RETURNS:
+ *
+ * -1, 0, or 1 if key1 is <, ==, or > than key2.
+ *
+ * ARGUMENTS:
+ *
+ * key1 -> The first key.
+ *
+ * data1 -> Pointer to the first data entry.
+ *
+ * key2 -> The second key.
+ *
+ * data2 -> Pointer to the second data entry.
+ */
+static	int	number_count_compare(const long key1, const void *data1_p,
+				     const long key2, const void *data2_p)
+{
+  unsigned long	count1 = ((const sortu_t *)data1_p)->so_count;
+  unsigned long	count2 = ((const sortu_t *)data2_p)->so_count;
+  int		result;
   
-  if (help_b) {
-    (void)printf("Sortu Utility: http://256.com/sources/sortu/\n");
-    (void)printf("  This utility is a replacement for the sort and uniq programs.\n");
-    (void)printf("  For a list of the command-line options enter: %s --usage\n",
-                 argv_argv[0]);
-    exit(0);
+  result = (count1 > count2) - (count1 < count2);
+  if (result == 0) {
+    result = (key1 > key2) - (key1 < key2);
+  }
+  if (reverse_sort_b) {
+    return -result;
   }
+  else {
+    return result;
+  }
+}
+
+/*
+ * static void merge_sortu
+ *
+ * DESCRIPTION:
+ *
+ * Merge the count information of a key that is being inserted into
+ * our shared table into the information of the key in the table.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * old_p <-> Count information in the table that we are updating.
+ *
+ * new_p -> Count information that was being inserted.
+ *
+ * size -> Size of the information.
+ */
+static	void	merge_sortu(void *old_p, const void *new_p, const int size)
+{
+  sortu_t	*sortu_p = old_p;
+  const sortu_t	*from_p = new_p;
   
-  /* if we aren't showing the counts, we might as well sort by the key */
-  if (no_counts_b) {
-    key_sort_b = 1;
+  sortu_p->so_count += from_p->so_count;
+  /* the other threads may have seen later lines first */
+  if (SORTU_BEFORE(from_p, sortu_p)) {
+    sortu_p->so_offset = from_p->so_offset;
+    sortu_p->so_file = from_p->so_file;
   }
+}
 
-  /* allocate table */
-  tab = table_alloc(0, &ret);
-  if (tab == NULL) {
-    (void)fprintf(stderr, "%s: could not allocate table: %s\n",
-		  argv_program, table_strerror(ret));
-    exit(1);
+/*
+ * static void flush_batch
+ *
+ * DESCRIPTION:
+ *
+ * Insert the keys that are waiting in our batch into our table.  This
+ * needs to be done before the buffer that the keys point into goes
+ * away.
+ *
+ * RETURNS:
+ *
+ * None.  Exits on error.
+ *
+ * ARGUMENTS:
+ *
+ * scan_p <-> Line processing state of our thread.
+ */
+static	void	flush_batch(scan_t *scan_p)
+{
+  int	ret;
+  
+  if (scan_p->sc_batch_n == 0) {
+    return;
   }
   
-  /* set auto-adjust flag */
-  ret = table_attr(tab, TABLE_FLAG_AUTO_ADJUST);
+  ret = table_insert_batch(scan_p->sc_table, scan_p->sc_batch_keys,
+			   scan_p->sc_batch_sizes, scan_p->sc_batch,
+			   sizeof(sortu_t), scan_p->sc_batch_n, merge_sortu);
   if (ret != TABLE_ERROR_NONE) {
-    (void)fprintf(stderr, "%s: could not set auto-adjust for table: %s\n",
+    (void)fprintf(stderr, "%s: could not add key to table: %s\n",
 		  argv_program, table_strerror(ret));
     exit(1);
   }
+  scan_p->sc_batch_n = 0;
+  scan_p->sc_key_len = 0;
+}
+
+/*
+ * static void batch_key
+ *
+ * DESCRIPTION:
+ *
+ * Add a key to our batch of keys waiting to be inserted into our
+ * table, inserting the batch if it is full.
+ *
+ * RETURNS:
+ *
+ * None.  Exits on error.
+ *
+ * ARGUMENTS:
+ *
+ * scan_p <-> Line processing state of our thread.
+ *
+ * key_p -> Key that we are adding.
+ *
+ * key_size -> Size of the key.
+ *
+ * copy_b -> Set to 1 if the key is not in the line and needs to be
+ * copied since its buffer is about to be reused.
+ *
+ * offset -> Offset of the key's line in the file.
+ */
+static	void	batch_key(scan_t *scan_p, const char *key_p, const int key_size,
+			  const int copy_b, const unsigned long offset)
+{
+  sortu_t	*sortu_p;
   
-  /* set table alignment */
-  ret = table_set_data_alignment(tab, sizeof(long));
-  if (ret != TABLE_ERROR_NONE) {
-    (void)fprintf(stderr, "%s: could not set table alignment: %s\n",
-		  argv_program, table_strerror(ret));
-    exit(1);
+  if (copy_b) {
+    if (scan_p->sc_key_len + key_size > scan_p->sc_key_size) {
+      /* the waiting keys point into the buffer so insert them first */
+      flush_batch(scan_p);
+      if (key_size > scan_p->sc_key_size) {
+	scan_p->sc_key_size = key_size * BATCH_SIZE;
+	scan_p->sc_key_buf = realloc(scan_p->sc_key_buf, scan_p->sc_key_size);
+	if (scan_p->sc_key_buf == NULL) {
+	  (void)fprintf(stderr, "%s: could not allocate %d bytes\n",
+			argv_program, scan_p->sc_key_size);
+	  exit(1);
+	}
+      }
+    }
+    memcpy(scan_p->sc_key_buf + scan_p->sc_key_len, key_p, key_size);
+    key_p = scan_p->sc_key_buf + scan_p->sc_key_len;
+    scan_p->sc_key_len += key_size;
   }
   
-  /* initialize our sortu insert structure */
-  sortu.so_count = 1;
-  sortu.so_order = 0;
+  scan_p->sc_batch_keys[scan_p->sc_batch_n] = key_p;
+  scan_p->sc_batch_sizes[scan_p->sc_batch_n] = key_size;
+  sortu_p = scan_p->sc_batch + scan_p->sc_batch_n;
+  sortu_p->so_count = 1;
+  sortu_p->so_offset = offset;
+  sortu_p->so_file = scan_p->sc_file;
+  scan_p->sc_batch_n++;
   
-  file_c = 0;
-  while (1) {
-    
-    /* process each of the files */
-    if (file_c == 0 && ARGV_ARRAY_COUNT(files) == 0) {
-      filename = "stdin";
-      infile = stdin;
-    }
-    else {
-      filename = ARGV_ARRAY_ENTRY(files, char *, file_c);
-      infile = fopen(filename, "r");
-      if (infile == NULL) {
-	(void)fprintf(stderr, "%s: could not open file '%s': %s\n",
-		      argv_program, filename, strerror(errno));
-	exit(1);
-      }
+  if (scan_p->sc_batch_n == BATCH_SIZE) {
+    flush_batch(scan_p);
+  }
+}
+
+/*
+ * static int line_key
+ *
+ * DESCRIPTION:
+ *
+ * Find the key in a line of input.  The line is not modified so it
+ * can point directly into a read-only mapping of the input file.
+ *
+ * RETURNS:
+ *
+ * 1 if the line has a key otherwise 0 if it should be skipped.
+ *
+ * ARGUMENTS:
+ *
+ * scan_p <-> Line processing state of our thread.
+ *
+ * line -> Start of the line.
+ *
+ * line_bounds_p -> Pointer to the \n at the end of the line or just
+ * past the last character of the line.
+ *
+ * value_p <- Pointer to a long which will be set to the -n number.
+ * The key will then point to it.
+ *
+ * double_p <- Pointer to a double which will be set to the -N number.
+ * The key will then point to it.
+ *
+ * key_pp <- Pointer which will be set to the start of the key.
+ *
+ * key_size_p <- Pointer to an integer which will be set to the size
+ * of the key.
+ */
+static	int	line_key(scan_t *scan_p, const char *line,
+			 const char *line_bounds_p, long *value_p,
+			 double *double_p, const char **key_pp, int *key_size_p)
+{
+  const char	*tok, *tok_bounds_p, *key_p;
+  char		number[NUMBER_SIZE];
+  int		field_c, key_size;
+  
+  if (stop_offset >= 0 && line_bounds_p > line + stop_offset + 1) {
+    /* it is +1 because stop offset of 3 means 4 is the bounds */
+    line_bounds_p = line + stop_offset + 1;
+  }
+  
+  /* if blank line then maybe ignore it */
+  if (line == line_bounds_p && ignore_blanks_b) {
+    return 0;
+  }
+  
+  /* default is the entire line */
+  tok = line;
+  tok_bounds_p = line_bounds_p;
+  if (field > 0
+      && (! field_find(&delims, line, line_bounds_p, field, loose_fields_b,
+		       &tok, &tok_bounds_p))) {
+    /* oh well, no specified field */
+    return 0;
+  }
+  
+  if (numbers_b || numbers_float_b) {
+    /* copy the number out since the field is not \0 terminated */
+    key_size = tok_bounds_p - tok;
+    if (key_size >= sizeof(number)) {
+      key_size = sizeof(number) - 1;
     }
-    
+    memcpy(number, tok, key_size);
+    number[key_size] = '\0';
     if (numbers_b) {
-      key_p = &value;
-      key_size = sizeof(value);
+      *value_p = atol(number);
+      key_p = (char *)value_p;
+      key_size = sizeof(*value_p);
     }
-    else if (numbers_float_b) {
-      key_p = &double_value;
-      key_size = sizeof(double_value);
+    else {
+      *double_p = atof(number);
+      key_p = (char *)double_p;
+      key_size = sizeof(*double_p);
     }
-    
-    while (fgets(line, sizeof(line), infile) != NULL) {
-      
-      /* cut off the \n */
-      for (line_bounds_p = line;
-	   *line_bounds_p != '\n' && *line_bounds_p != '\0';
-	   line_bounds_p++) {
-      }
-      if (stop_offset >= 0 && line_bounds_p > line + stop_offset + 1) {
-	/* it is +1 because stop offset of 3 means 4 is the bounds */
-	line_bounds_p = line + stop_offset + 1;
-      }
-      *line_bounds_p = '\0';
-      
-      /* if blank line then maybe ignore it */
-      if (line[0] == '\0' && ignore_blanks_b) {
-	continue;
-      }
-      
-      /* default is the entire line */
-      tok = line;
-      line_p = line;
-      for (field_c = field - 1; field_c >= 0;) {
-	
-	/* find the correct field in the line if necessary */ 
-	tok = strsep(&line_p, delim_str);
-	if (tok == NULL) {
-	  break;
-	}
-	/*
-	 * we only decrement the field counter if loose-fields is not
-	 * on and we have an empty token
-	 */
-	if (! (loose_fields_b && *tok == '\0')) {
-	  field_c--;
-	}
-	
-	/* reset the line bounds */
-	for (line_bounds_p = tok; *line_bounds_p != '\0'; line_bounds_p++) {
-	}
-      }
-      
-      /* oh well, no specified field */
-      if (tok == NULL) {
-	continue;
-      }
-      
-      if (numbers_b) {
-	value = atol(tok);
-      }
-      else if (numbers_float_b) {
-	double_value = atof(tok);
-      }
-      else {
-	key_p = tok + start_offset;
-	if (case_insens_b) {
-	  /* lower case the string */
-	  for (; line_p < line_bounds_p; line_p++) {
-	    *line_p = tolower(*line_p);
-	  }
-	}
-	key_size = line_bounds_p - (char *)key_p;
-	/* check to make sure we have a field */
-	if (key_size <= 0) {
-	  continue;
-	}
-      }
-      
-      /* add it into the table */
-      ret = table_insert(tab, key_p, key_size, &sortu, sizeof(sortu),
-			 (void *)&sortu_p, 0);
-      if (ret == TABLE_ERROR_NONE) {
-	sortu.so_order++;
-      }
-      else {
-	if (ret != TABLE_ERROR_OVERWRITE) {
-	  (void)fprintf(stderr, "%s: could not add key to table: %s\n",
-			argv_program, table_strerror(ret));
+  }
+  else {
+    key_p = tok + start_offset;
+    key_size = tok_bounds_p - key_p;
+    /* check to make sure we have a field */
+    if (key_size <= 0) {
+      return 0;
+    }
+    if (case_insens_b) {
+      /* lower case the key into our buffer */
+      if (key_size > scan_p->sc_lower_size) {
+	scan_p->sc_lower_buf = realloc(scan_p->sc_lower_buf, key_size);
+	if (scan_p->sc_lower_buf == NULL) {
+	  (void)fprintf(stderr, "%s: could not allocate %d bytes\n",
+			argv_program, key_size);
 	  exit(1);
 	}
-	
-	/* it exists already so add one to the count */
-	sortu_p->so_count++;
+	scan_p->sc_lower_size = key_size;
       }
-    }
-    
-    if (infile != stdin) {
-      (void)fclose(infile);
-    }
-    
-    /* we don't do a for() loop because the 1st is special */
-    file_c++;
-    if (file_c >= ARGV_ARRAY_COUNT(files)) {
-      break;
+      for (field_c = 0; field_c < key_size; field_c++) {
+	scan_p->sc_lower_buf[field_c] =
+	  tolower(*(unsigned char *)(key_p + field_c));
+      }
+      key_p = scan_p->sc_lower_buf;
     }
   }
   
-  if (verbose_b && (! no_counts_b)) {
-    (void)printf("%10.10s", "Count:");
-    if (cumulative_b) {
-      (void)printf(" %10.10s", "Cumulate:");
+  *key_pp = key_p;
+  *key_size_p = key_size;
+  return 1;
+}
+
+/*
+ * static void lookup_key
+ *
+ * DESCRIPTION:
+ *
+ * Print the count of a key from the saved table that we are looking
+ * keys up in.  Keys that are not in the table have a count of 0.
+ *
+ * RETURNS:
+ *
+ * None.  Exits on error.
+ *
+ * ARGUMENTS:
+ *
+ * scan_p -> Line processing state with the mapped table.
+ *
+ * key_p -> Key that we are looking up.
+ *
+ * key_size -> Size of the key.
+ */
+static	void	lookup_key(const scan_t *scan_p, const char *key_p,
+			   const int key_size)
+{
+  sortu_t	*sortu_p;
+  unsigned long	count;
+  int		ret;
+  
+  ret = table_retrieve(scan_p->sc_table, key_p, key_size, (void **)&sortu_p,
+		       NULL);
+  if (ret == TABLE_ERROR_NONE) {
+    count = sortu_p->so_count;
+  }
+  else if (ret == TABLE_ERROR_NOT_FOUND) {
+    count = 0;
+  }
+  else {
+    (void)fprintf(stderr, "%s: could not look up key in %s: %s\n",
+		  argv_program, lookup_file, table_strerror(ret));
+    exit(1);
+  }
+  
+  if (numbers_float_b) {
+    (void)printf("%10lu %10.2f\n", count, *(double *)key_p);
+  }
+  else {
+    (void)printf("%10lu %.*s\n", count, key_size, key_p);
+  }
+}
+
+/*
+ * static int number_column
+ *
+ * DESCRIPTION:
+ *
+ * See if the text after the count of an output line starts with the
+ * cumulative count column of -c or the percentage column of -p.
+ * These are right justified to 10 and 4 characters and followed by a
+ * space.
+ *
+ * RETURNS:
+ *
+ * 1 if it does else 0.
+ *
+ * ARGUMENTS:
+ *
+ * text_p -> Start of the text after the space following the count.
+ *
+ * bounds_p -> Pointer just past the end of the text.
+ */
+static	int	number_column(const char *text_p, const char *bounds_p)
+{
+  const char	*column_p = text_p, *digit_p;
+  
+  /* the columns are justified so they start with at least one space */
+  if (text_p == bounds_p || *text_p != ' ') {
+    return 0;
+  }
+  for (; text_p < bounds_p && *text_p == ' '; text_p++) {
+  }
+  for (digit_p = text_p;
+       text_p < bounds_p && isdigit(*(unsigned char *)text_p);
+       text_p++) {
+  }
+  if (text_p == digit_p || text_p == bounds_p) {
+    return 0;
+  }
+  
+  if (text_p - column_p == 10 && *text_p == ' ') {
+    return 1;
+  }
+  if (text_p - column_p == 4 && *text_p == '%'
+      && text_p + 1 < bounds_p && *(text_p + 1) == ' ') {
+    return 1;
+  }
+  return 0;
+}
+
+/*
+ * static void merge_line
+ *
+ * DESCRIPTION:
+ *
+ * Add the count and key from a line of our own "count key" output
+ * into our table for --merge.  The key is everything after the single
+ * space which follows the count.  Lines with another number or
+ * percentage column after the count from -c or -p are refused as are
+ * counts that are too large.
+ *
+ * RETURNS:
+ *
+ * None.  Exits on error.
+ *
+ * ARGUMENTS:
+ *
+ * scan_p -> Line processing state with the table we are merging into.
+ *
+ * line -> Start of the line.
+ *
+ * line_bounds_p -> Pointer to the \n at the end of the line or just
+ * past the last character of the line.
+ *
+ * offset -> Offset of the line in the file.
+ */
+static	void	merge_line(const scan_t *scan_p, const char *line,
+			   const char *line_bounds_p,
+			   const unsigned long offset)
+{
+  const char	*line_p, *key_p;
+  char		number[NUMBER_SIZE];
+  int		key_size, ret;
+  double	double_value;
+  sortu_t	sortu, *sortu_p;
+  
+  /* the count is right justified */
+  for (line_p = line; line_p < line_bounds_p && *line_p == ' '; line_p++) {
+  }
+  if (line_p == line_bounds_p) {
+    return;
+  }
+  if (! isdigit(*(unsigned char *)line_p)) {
+    (void)fprintf(stderr, "%s: merged line has no count: %.*s\n",
+		  argv_program, (int)(line_bounds_p - line), line);
+    exit(1);
+  }
+  
+  /* the line is not terminated so copy the count out to convert it */
+  for (key_p = line_p;
+       line_p < line_bounds_p && isdigit(*(unsigned char *)line_p);
+       line_p++) {
+  }
+  key_size = line_p - key_p;
+  if (key_size >= sizeof(number)) {
+    key_size = sizeof(number) - 1;
+  }
+  memcpy(number, key_p, key_size);
+  number[key_size] = '\0';
+  errno = 0;
+  sortu.so_count = strtoul(number, NULL, 10);
+  if (errno == ERANGE) {
+    (void)fprintf(stderr, "%s: merged line count is too large: %.*s\n",
+		  argv_program, (int)(line_bounds_p - line), line);
+    exit(1);
+  }
+  
+  /* the key is after the single space following the count */
+  if (line_p == line_bounds_p
+      || *line_p != ' '
+      || number_column(line_p + 1, line_bounds_p)) {
+    (void)fprintf(stderr, "%s: merged line is not a count and key: %.*s\n",
+		  argv_program, (int)(line_bounds_p - line), line);
+    exit(1);
+  }
+  key_p = line_p + 1;
+  key_size = line_bounds_p - key_p;
+  if (key_size <= 0) {
+    return;
+  }
+  if (numbers_float_b) {
+    if (key_size >= sizeof(number)) {
+      key_size = sizeof(number) - 1;
+    }
+    memcpy(number, key_p, key_size);
+    number[key_size] = '\0';
+    double_value = atof(number);
+    key_p = (char *)&double_value;
+    key_size = sizeof(double_value);
+  }
+  
+  sortu.so_offset = offset;
+  sortu.so_file = scan_p->sc_file;
+  ret = table_insert(scan_p->sc_table, key_p, key_size, &sortu, sizeof(sortu),
+		     (void **)&sortu_p, 0);
+  if (ret == TABLE_ERROR_OVERWRITE) {
+    merge_sortu(sortu_p, &sortu, sizeof(sortu));
+  }
+  else if (ret != TABLE_ERROR_NONE) {
+    (void)fprintf(stderr, "%s: could not add key to table: %s\n",
+		  argv_program, table_strerror(ret));
+    exit(1);
+  }
+}
+
+/*
+ * static void process_line
+ *
+ * DESCRIPTION:
+ *
+ * Find the key in a line of input and add it into our table.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * scan_p <-> Line processing state of our thread.
+ *
+ * line -> Start of the line.
+ *
+ * line_bounds_p -> Pointer to the \n at the end of the line or just
+ * past the last character of the line.
+ *
+ * offset -> Offset of the line in the file which is recorded with new
+ * keys for -o.
+ */
+static	void	process_line(scan_t *scan_p, const char *line,
+			     const char *line_bounds_p,
+			     const unsigned long offset)
+{
+  const char	*key_p;
+  int		key_size, ret;
+  long		value;
+  double	double_value;
+  sortu_t	sortu, *found_p;
+  
+  /* the lines already have their keys counted */
+  if (merge_b) {
+    merge_line(scan_p, line, line_bounds_p, offset);
+    return;
+  }
+  
+  if (! line_key(scan_p, line, line_bounds_p, &value, &double_value, &key_p,
+		 &key_size)) {
+    return;
+  }
+  
+  if (lookup_file != NULL) {
+    lookup_key(scan_p, key_p, key_size);
+    return;
+  }
+  
+  if (numbers_b) {
+    /* integers go into their own table */
+    sortu.so_count = 1;
+    sortu.so_offset = offset;
+    sortu.so_file = scan_p->sc_file;
+    ret = itable_insert(scan_p->sc_itable, value, &sortu, (void *)&found_p);
+    if (ret == TABLE_ERROR_OVERWRITE) {
+      found_p->so_count++;
+    }
+    else if (ret != TABLE_ERROR_NONE) {
+      (void)fprintf(stderr, "%s: could not add key to table: %s\n",
+		    argv_program, table_strerror(ret));
+      exit(1);
+    }
+    return;
+  }
+  
+  /* add it into the table */
+  if (scan_p->sc_shards == NULL && (! shared_table_b)) {
+    /* the keys are inserted a batch at a time to overlap cache misses */
+    batch_key(scan_p, key_p, key_size, case_insens_b || numbers_float_b,
+	      offset);
+    return;
+  }
+  
+  /* the other tables merge our information into the key's */
+  sortu.so_count = 1;
+  sortu.so_offset = offset;
+  sortu.so_file = scan_p->sc_file;
+  if (scan_p->sc_shards != NULL) {
+    /* the shard picked by the key's hash is locked while we insert */
+    ret = shard_insert(scan_p->sc_shards, key_p, key_size, &sortu,
+		       sizeof(sortu), merge_sortu);
+  }
+  else {
+    /* the other threads are inserting into the table too */
+    ret = table_insert_concurrent(scan_p->sc_table, key_p, key_size, &sortu,
+				  sizeof(sortu), merge_sortu);
+  }
+  if (ret != TABLE_ERROR_NONE && ret != TABLE_ERROR_OVERWRITE) {
+    (void)fprintf(stderr, "%s: could not add key to table: %s\n",
+		  argv_program, table_strerror(ret));
+    exit(1);
+  }
+}
+
+/*
+ * static void process_stream
+ *
+ * DESCRIPTION:
+ *
+ * Read in large blocks from a file descriptor and process each of
+ * the lines in them.  A partial line at the end of a block is carried
+ * over to the front of the buffer and the buffer is grown if a line
+ * does not fit so lines of any length are handled.  This is used for
+ * pipes, stdin, and anything else that we cannot mmap.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * scan_p <-> Line processing state of our thread.
+ *
+ * fd -> File descriptor that we are reading from.
+ *
+ * filename -> Name of the file for error messages.
+ */
+static	void	process_stream(scan_t *scan_p, const int fd,
+			       const char *filename)
+{
+  char		*buf, *line_p, *search_p, *bounds_p, *newline_p;
+  size_t	buf_size, len;
+  long		ret;
+  unsigned long	offset;
+  
+  buf_size = BLOCK_SIZE;
+  buf = malloc(buf_size);
+  if (buf == NULL) {
+    (void)fprintf(stderr, "%s: could not allocate %lu bytes\n",
+		  argv_program, (unsigned long)buf_size);
+    exit(1);
+  }
+  
+  /* len is the size of the partial line at the front of the buffer */
+  len = 0;
+  /* offset in the file of the front of the buffer */
+  offset = 0;
+  while (1) {
+    ret = read(fd, buf + len, buf_size - len);
+    if (ret < 0) {
+      if (errno == EINTR) {
+	continue;
+      }
+      (void)fprintf(stderr, "%s: could not read from '%s': %s\n",
+		    argv_program, filename, strerror(errno));
+      exit(1);
+    }
+    if (ret == 0) {
+      break;
+    }
+    
+    /* the partial line has no \n so we can start looking after it */
+    line_p = buf;
+    search_p = buf + len;
+    bounds_p = buf + len + ret;
+    while (1) {
+      newline_p = memchr(search_p, '\n', bounds_p - search_p);
+      if (newline_p == NULL) {
+	break;
+      }
+      process_line(scan_p, line_p, newline_p, offset + (line_p - buf));
+      line_p = newline_p + 1;
+      search_p = line_p;
+    }
+    
+    /* the batched keys point into the buffer we are about to change */
+    flush_batch(scan_p);
+    
+    len = bounds_p - line_p;
+    offset += line_p - buf;
+    if (len == buf_size) {
+      /* the line is larger than our buffer so grow it */
+      buf_size *= 2;
+      buf = realloc(buf, buf_size);
+      if (buf == NULL) {
+	(void)fprintf(stderr, "%s: could not allocate %lu bytes\n",
+		      argv_program, (unsigned long)buf_size);
+	exit(1);
+      }
+    }
+    else if (len > 0 && line_p != buf) {
+      /* move the partial line to the front of the buffer */
+      memmove(buf, line_p, len);
+    }
+  }
+  
+  /* last line has no \n */
+  if (len > 0) {
+    process_line(scan_p, buf, buf + len, offset);
+  }
+  flush_batch(scan_p);
+  
+  free(buf);
+}
+
+#ifndef NO_MMAP
+
+/*
+ * static int process_mapped
+ *
+ * DESCRIPTION:
+ *
+ * Mmap a regular file and process its lines in place which saves
+ * copying the file through the stdio buffers and our line buffer.
+ *
+ * A chunk of the file can be processed instead.  Each line belongs to
+ * the chunk holding its first character so the lines of a file split
+ * into chunks are each processed exactly once.
+ *
+ * RETURNS:
+ *
+ * 1 if the file was processed otherwise 0 if it could not be mapped
+ * and should be read as a stream instead.
+ *
+ * ARGUMENTS:
+ *
+ * scan_p <-> Line processing state of our thread.
+ *
+ * fd -> Open file descriptor of the file we are processing.
+ *
+ * start -> Offset of the start of the chunk to process.
+ *
+ * end -> Offset of the end of the chunk or 0 for the end of the file.
+ */
+static	int	process_mapped(scan_t *scan_p, const int fd,
+			       const unsigned long start,
+			       const unsigned long end)
+{
+  struct stat	sbuf;
+  const char	*mapping, *line_p, *end_p, *bounds_p, *newline_p;
+  size_t	size, page_size, advise_start;
+  
+  if (fstat(fd, &sbuf) != 0 || ! S_ISREG(sbuf.st_mode)) {
+    return 0;
+  }
+  size = sbuf.st_size;
+  if (size == 0 || start >= size) {
+    /* nothing to do and mmap does not like 0 sized maps */
+    return 1;
+  }
+  
+  mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapping == (char *)MAP_FAILED) {
+    return 0;
+  }
+  bounds_p = mapping + size;
+  if (end == 0 || end > size) {
+    end_p = bounds_p;
+  }
+  else {
+    end_p = mapping + end;
+  }
+  
+#ifdef MADV_SEQUENTIAL
+  /* advise from the page holding the start of our chunk */
+  page_size = sysconf(_SC_PAGESIZE);
+  advise_start = start - start % page_size;
+  (void)madvise((void *)(mapping + advise_start), size - advise_start,
+		MADV_SEQUENTIAL);
+#endif
+  
+  line_p = mapping + start;
+  if (start > 0 && *(line_p - 1) != '\n') {
+    /* the line at the start of the chunk belongs to the previous one */
+    line_p = memchr(line_p, '\n', bounds_p - line_p);
+    if (line_p == NULL) {
+      line_p = bounds_p;
+    }
+    else {
+      line_p++;
+    }
+  }
+  
+  for (; line_p < end_p; line_p = newline_p + 1) {
+    newline_p = memchr(line_p, '\n', bounds_p - line_p);
+    if (newline_p == NULL) {
+      /* last line has no \n */
+      newline_p = bounds_p;
+    }
+    process_line(scan_p, line_p, newline_p, line_p - mapping);
+    if (newline_p == bounds_p) {
+      break;
+    }
+  }
+  flush_batch(scan_p);
+  
+  (void)munmap((void *)mapping, size);
+  return 1;
+}
+
+#endif /* ! NO_MMAP */
+
+/*
+ * static void process_file
+ *
+ * DESCRIPTION:
+ *
+ * Process the lines in a file, mmap-ing it if possible.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * scan_p <-> Line processing state of our thread.
+ *
+ * filename -> Path of the file we are processing.
+ *
+ * start -> Offset of the start of the chunk to process.
+ *
+ * end -> Offset of the end of the chunk or 0 for the end of the file.
+ */
+static	void	process_file(scan_t *scan_p, const char *filename,
+			     const unsigned long start, const unsigned long end)
+{
+  int	fd;
+  
+  fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    (void)fprintf(stderr, "%s: could not open file '%s': %s\n",
+		  argv_program, filename, strerror(errno));
+    exit(1);
+  }
+  
+#ifndef NO_MMAP
+  if (process_mapped(scan_p, fd, start, end)) {
+    (void)close(fd);
+    return;
+  }
+#endif
+  
+  /* we only make chunks out of files that we can mmap */
+  if (start > 0 || end > 0) {
+    (void)fprintf(stderr, "%s: could not mmap chunk of file '%s'\n",
+		  argv_program, filename);
+    exit(1);
+  }
+  
+  /* fall back to reading it as a stream */
+  process_stream(scan_p, fd, filename);
+  
+  (void)close(fd);
+}
+
+/*
+ * static unsigned long last_line_end
+ *
+ * DESCRIPTION:
+ *
+ * Find the end of the last full line of a file by reading backwards
+ * from its end for the last \n.
+ *
+ * RETURNS:
+ *
+ * The offset after the last \n or start if there is none after it.
+ * Exits on error.
+ *
+ * ARGUMENTS:
+ *
+ * fd -> Open file descriptor of the file.
+ *
+ * filename -> Name of the file for error messages.
+ *
+ * start -> Offset that we don't look before.
+ *
+ * size -> Size of the file.
+ */
+static	unsigned long	last_line_end(const int fd, const char *filename,
+				      const unsigned long start,
+				      const unsigned long size)
+{
+  char		buf[TAIL_SIZE], *buf_p;
+  unsigned long	pos, len;
+  
+  for (pos = size; pos > start; pos -= len) {
+    len = pos - start;
+    if (len > sizeof(buf)) {
+      len = sizeof(buf);
+    }
+    if (lseek(fd, pos - len, SEEK_SET) < 0
+	|| read(fd, buf, len) != (int)len) {
+      (void)fprintf(stderr, "%s: could not read from '%s': %s\n",
+		    argv_program, filename, strerror(errno));
+      exit(1);
+    }
+    for (buf_p = buf + len; buf_p > buf; buf_p--) {
+      if (*(buf_p - 1) == '\n') {
+	return pos - len + (buf_p - buf);
+      }
+    }
+  }
+  
+  return start;
+}
+
+/*
+ * static void state_key_init
+ *
+ * DESCRIPTION:
+ *
+ * Record the options which pick our keys for our --state file.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * key_p <- Pointer to the key options that we are setting.
+ */
+static	void	state_key_init(state_key_t *key_p)
+{
+  memset(key_p, 0, sizeof(*key_p));
+  key_p->sk_field = field;
+  key_p->sk_start_offset = start_offset;
+  key_p->sk_stop_offset = stop_offset;
+  key_p->sk_loose_fields_b = loose_fields_b;
+  key_p->sk_case_insens_b = case_insens_b;
+  key_p->sk_numbers_float_b = numbers_float_b;
+  key_p->sk_ignore_blanks_b = ignore_blanks_b;
+  memcpy(key_p->sk_delims, delims.fd_map, sizeof(key_p->sk_delims));
+}
+
+/*
+ * static table_t *read_state
+ *
+ * DESCRIPTION:
+ *
+ * Read in our --state file which has the counts from the last run
+ * saved by table_write followed by the device, inode, and processed
+ * offset of each of the files that it read and the options that
+ * picked its keys.  Each of our files is then given the range from
+ * where the last run stopped to the end of its last full line.  A
+ * partial last line is left for the next run when it has been
+ * finished.  The options must be the same as ours otherwise we would
+ * be adding other keys to the counts.
+ *
+ * RETURNS:
+ *
+ * The table of saved counts or NULL if there is no state file yet.
+ * Exits on error.
+ *
+ * ARGUMENTS:
+ *
+ * None.
+ */
+static	table_t	*read_state(void)
+{
+  struct stat	sbuf;
+  state_end_t	end;
+  state_key_t	key;
+  table_t	*tab = NULL;
+  range_t	*range_p;
+  const char	*filename;
+  off_t		size = 0;
+  int		fd, file_c, state_c, ret;
+  
+  fd = open(state_path, O_RDONLY);
+  if (fd < 0 && errno != ENOENT) {
+    (void)fprintf(stderr, "%s: could not open state file '%s': %s\n",
+		  argv_program, state_path, strerror(errno));
+    exit(1);
+  }
+  
+  /* the file positions are at the end after the saved table */
+  state_n = 0;
+  if (fd >= 0) {
+    size = lseek(fd, -(off_t)sizeof(end), SEEK_END);
+    if (size < 0
+	|| read(fd, &end, sizeof(end)) != sizeof(end)
+	|| end.se_magic != STATE_MAGIC
+	|| size < (off_t)(end.se_file_n * sizeof(state_file_t))) {
+      (void)fprintf(stderr, "%s: state file '%s' is not valid\n",
+		    argv_program, state_path);
+      exit(1);
+    }
+    state_n = end.se_file_n;
+  
+    state_key_init(&key);
+    if (memcmp(&end.se_key, &key, sizeof(key)) != 0) {
+      (void)fprintf(stderr,
+		    "%s: state file '%s' was made with other key options\n",
+		    argv_program, state_path);
+      exit(1);
+    }
+  }
+  
+  /* leave room for the positions of new files */
+  states = malloc(sizeof(state_file_t) * (state_n + ARGV_ARRAY_COUNT(files)));
+  ranges = malloc(sizeof(range_t) * ARGV_ARRAY_COUNT(files));
+  if (states == NULL || ranges == NULL) {
+    (void)fprintf(stderr, "%s: could not allocate file positions\n",
+		  argv_program);
+    exit(1);
+  }
+  
+  if (fd >= 0) {
+    size -= state_n * sizeof(state_file_t);
+    if (lseek(fd, size, SEEK_SET) < 0
+	|| read(fd, states, state_n * sizeof(state_file_t))
+	!= (int)(state_n * sizeof(state_file_t))) {
+      (void)fprintf(stderr, "%s: could not read state file '%s': %s\n",
+		    argv_program, state_path, strerror(errno));
+      exit(1);
+    }
+    (void)close(fd);
+  
+    tab = table_read(state_path, &ret);
+    if (tab == NULL) {
+      (void)fprintf(stderr, "%s: could not read state file '%s': %s\n",
+		    argv_program, state_path, table_strerror(ret));
+      exit(1);
+    }
+  }
+  
+  for (file_c = 0; file_c < ARGV_ARRAY_COUNT(files); file_c++) {
+    filename = ARGV_ARRAY_ENTRY(files, char *, file_c);
+    range_p = ranges + file_c;
+  
+    fd = open(filename, O_RDONLY);
+    if (fd < 0 || fstat(fd, &sbuf) != 0) {
+      (void)fprintf(stderr, "%s: could not open file '%s': %s\n",
+		    argv_program, filename, strerror(errno));
+      exit(1);
+    }
+    if (! S_ISREG(sbuf.st_mode)) {
+      (void)fprintf(stderr, "%s: --state only works with regular files: '%s'\n",
+		    argv_program, filename);
+      exit(1);
+    }
+  
+    /* find where we stopped in the file which may have been renamed */
+    for (state_c = 0; state_c < state_n; state_c++) {
+      if (states[state_c].sf_dev == sbuf.st_dev
+	  && states[state_c].sf_inode == sbuf.st_ino) {
+	break;
+      }
+    }
+    if (state_c == state_n) {
+      states[state_n].sf_dev = sbuf.st_dev;
+      states[state_n].sf_inode = sbuf.st_ino;
+      states[state_n].sf_offset = 0;
+      state_n++;
+    }
+  
+    range_p->ra_state = state_c;
+    range_p->ra_start = states[state_c].sf_offset;
+    /* a file that got shorter was truncated so start it over */
+    if (range_p->ra_start > sbuf.st_size) {
+      range_p->ra_start = 0;
+    }
+    range_p->ra_end = last_line_end(fd, filename, range_p->ra_start,
+				    sbuf.st_size);
+    /* a file given twice starts where the first one ends so is skipped */
+    states[state_c].sf_offset = range_p->ra_end;
+  
+    (void)close(fd);
+  }
+  
+  return tab;
+}
+
+/*
+ * static void write_state
+ *
+ * DESCRIPTION:
+ *
+ * Write our counts and file positions to our --state file.  It is
+ * written to a temporary file which is renamed over the old state so
+ * an interrupted run leaves the old state alone.
+ *
+ * RETURNS:
+ *
+ * None.  Exits on error.
+ *
+ * ARGUMENTS:
+ *
+ * tab -> Table of our counts.
+ */
+static	void	write_state(const table_t *tab)
+{
+  state_end_t	end;
+  char		*tmp_path;
+  int		fd, ret;
+  
+  tmp_path = malloc(strlen(state_path) + 5);
+  if (tmp_path == NULL) {
+    (void)fprintf(stderr, "%s: could not allocate state path\n",
+		  argv_program);
+    exit(1);
+  }
+  (void)sprintf(tmp_path, "%s.tmp", state_path);
+  
+  ret = table_write(tab, tmp_path, 0666);
+  if (ret != TABLE_ERROR_NONE) {
+    (void)fprintf(stderr, "%s: could not write state to '%s': %s\n",
+		  argv_program, tmp_path, table_strerror(ret));
+    (void)unlink(tmp_path);
+    exit(1);
+  }
+  
+  /* add the file positions and our key options after the table */
+  state_key_init(&end.se_key);
+  end.se_magic = STATE_MAGIC;
+  end.se_file_n = state_n;
+  fd = open(tmp_path, O_WRONLY | O_APPEND);
+  if (fd < 0
+      || write(fd, states, state_n * sizeof(state_file_t))
+      != (int)(state_n * sizeof(state_file_t))
+      || write(fd, &end, sizeof(end)) != sizeof(end)
+      || fsync(fd) != 0
+      || close(fd) != 0
+      || rename(tmp_path, state_path) != 0) {
+    (void)fprintf(stderr, "%s: could not write state to '%s': %s\n",
+		  argv_program, tmp_path, strerror(errno));
+    (void)unlink(tmp_path);
+    exit(1);
+  }
+  
+  free(tmp_path);
+}
+
+/*
+ * static void hll_add
+ *
+ * DESCRIPTION:
+ *
+ * Add the hash of a key to our HyperLogLog sketch of the distinct
+ * keys.  The high bits of the hash pick a register which remembers
+ * the longest run of leading 0 bits in the rest of the hash that it
+ * has seen.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * regs <-> Registers of the sketch.
+ *
+ * hash -> Hash of the key we are adding.
+ */
+static	void	hll_add(unsigned char *regs, const unsigned int hash)
+{
+  unsigned int	bits, reg;
+  unsigned char	rank;
+  
+  reg = hash >> (32 - HLL_BITS);
+  bits = hash << HLL_BITS;
+  for (rank = 1; rank <= 32 - HLL_BITS && (bits & 0x80000000) == 0; rank++) {
+    bits <<= 1;
+  }
+  if (rank > regs[reg]) {
+    regs[reg] = rank;
+  }
+}
+
+/*
+ * static double hll_count
+ *
+ * DESCRIPTION:
+ *
+ * Estimate the number of distinct keys added to our HyperLogLog
+ * sketch.
+ *
+ * RETURNS:
+ *
+ * The estimated number of keys.
+ *
+ * ARGUMENTS:
+ *
+ * regs -> Registers of the sketch.
+ */
+static	double	hll_count(const unsigned char *regs)
+{
+  double	sum = 0.0, est;
+  int		reg_c, zero_n = 0;
+  
+  for (reg_c = 0; reg_c < HLL_SIZE; reg_c++) {
+    sum += 1.0 / (double)(1L << regs[reg_c]);
+    if (regs[reg_c] == 0) {
+      zero_n++;
+    }
+  }
+  est = 0.7213 / (1.0 + 1.079 / HLL_SIZE) * HLL_SIZE * HLL_SIZE / sum;
+  
+  /* small counts are better estimated from the empty registers */
+  if (est <= 2.5 * HLL_SIZE && zero_n > 0) {
+    est = HLL_SIZE * log((double)HLL_SIZE / zero_n);
+  }
+  
+  return est;
+}
+
+/*
+ * static long estimate_keys
+ *
+ * DESCRIPTION:
+ *
+ * Estimate the number of distinct keys in our files by sketching the
+ * keys at the start of them.  How much the keys of the second half of
+ * the sample add over the first half tells us how fast new keys are
+ * showing up which we use to scale the estimate to the size of the
+ * files.  This also sets the average key size that we guess the
+ * table's arena with.
+ *
+ * RETURNS:
+ *
+ * The estimated number of keys or 0 if we could not sample the files.
+ *
+ * ARGUMENTS:
+ *
+ * None.
+ */
+static	long	estimate_keys(void)
+{
+  scan_t	scan;
+  table_t	*tab;
+  struct stat	sbuf;
+  unsigned char	regs[HLL_SIZE];
+  char		*buf, *line_p, *newline_p, *bounds_p, *half_p;
+  const char	*key_p;
+  long		value, key_n = 0, key_bytes = 0;
+  double	double_value, half_est = 0.0, est, growth;
+  unsigned long	total = 0;
+  int		file_c, fd, len = 0, ret, key_size;
+  
+  if (ARGV_ARRAY_COUNT(files) == 0) {
+    return 0;
+  }
+  for (file_c = 0; file_c < ARGV_ARRAY_COUNT(files); file_c++) {
+    if (stat(ARGV_ARRAY_ENTRY(files, char *, file_c), &sbuf) != 0
+	|| ! S_ISREG(sbuf.st_mode)) {
+      /* we can't sample pipes and the like without eating them */
+      return 0;
+    }
+    total += sbuf.st_size;
+  }
+  
+  buf = malloc(SAMPLE_SIZE);
+  if (buf == NULL) {
+    (void)fprintf(stderr, "%s: could not allocate %d bytes\n",
+		  argv_program, SAMPLE_SIZE);
+    exit(1);
+  }
+  
+  /* read the start of the files, one after the other */
+  for (file_c = 0; file_c < ARGV_ARRAY_COUNT(files) && len < SAMPLE_SIZE;
+       file_c++) {
+    fd = open(ARGV_ARRAY_ENTRY(files, char *, file_c), O_RDONLY);
+    if (fd < 0) {
+      continue;
+    }
+    while (len < SAMPLE_SIZE) {
+      ret = read(fd, buf + len, SAMPLE_SIZE - len);
+      if (ret <= 0) {
+	break;
+      }
+      len += ret;
+    }
+    (void)close(fd);
+  }
+  
+  /* only use whole lines unless we read all of the files */
+  bounds_p = buf + len;
+  if (len < total) {
+    while (bounds_p > buf && *(bounds_p - 1) != '\n') {
+      bounds_p--;
+    }
+  }
+  
+  /* hash the keys the same way as our table */
+  tab = table_alloc(0, &ret);
+  if (tab == NULL) {
+    (void)fprintf(stderr, "%s: could not allocate table: %s\n",
+		  argv_program, table_strerror(ret));
+    exit(1);
+  }
+  (void)table_attr(tab, TABLE_FLAG_FAST_HASH);
+  
+  memset(&scan, 0, sizeof(scan));
+  memset(regs, 0, sizeof(regs));
+  half_p = buf + (bounds_p - buf) / 2;
+  for (line_p = buf; line_p < bounds_p; line_p = newline_p + 1) {
+    if (half_est == 0.0 && line_p >= half_p) {
+      half_est = hll_count(regs);
+    }
+    newline_p = memchr(line_p, '\n', bounds_p - line_p);
+    if (newline_p == NULL) {
+      newline_p = bounds_p;
+    }
+    if (line_key(&scan, line_p, newline_p, &value, &double_value, &key_p,
+		 &key_size)) {
+      hll_add(regs, table_hash(tab, key_p, key_size));
+      key_n++;
+      key_bytes += key_size;
+    }
+  }
+  est = hll_count(regs);
+  
+  /*
+   * If the second half of the sample added N times the keys of the
+   * first then we guess each doubling of the input does the same.
+   */
+  if (bounds_p - buf < total && bounds_p > buf && half_est > 0.0) {
+    growth = log(est / half_est) / log(2.0);
+    if (growth < 0.0) {
+      growth = 0.0;
+    }
+    else if (growth > 1.0) {
+      growth = 1.0;
+    }
+    est *= pow((double)total / (double)(bounds_p - buf), growth);
+  }
+  
+  if (key_n > 0) {
+    key_size_guess = key_bytes / key_n;
+  }
+  
+  (void)table_free(tab);
+  if (scan.sc_lower_buf != NULL) {
+    free(scan.sc_lower_buf);
+  }
+  free(buf);
+  
+  if (est > EXPECTED_MAX) {
+    return EXPECTED_MAX;
+  }
+  return (long)est;
+}
+
+/*
+ * static unsigned int arena_size
+ *
+ * DESCRIPTION:
+ *
+ * Figure out the size of the arena chunks of a table so that the keys
+ * we expect fit in a single one.
+ *
+ * RETURNS:
+ *
+ * The chunk size or 0 for the library default.
+ *
+ * ARGUMENTS:
+ *
+ * key_n -> Number of keys expected in the table.
+ */
+static	unsigned int	arena_size(const long key_n)
+{
+  double	size;
+  
+  size = (double)key_n * (key_size_guess + ENTRY_OVERHEAD);
+  if (size < ARENA_MIN) {
+    return 0;
+  }
+  if (size > ARENA_MAX) {
+    return ARENA_MAX;
+  }
+  return (unsigned int)size;
+}
+
+/*
+ * static void setup_table
+ *
+ * DESCRIPTION:
+ *
+ * Configure a table to hold our keys.
+ *
+ * RETURNS:
+ *
+ * None.  Exits on error.
+ *
+ * ARGUMENTS:
+ *
+ * tab -> Table that we are configuring.
+ *
+ * key_n -> Number of keys to size the table for or 0 to let it grow.
+ */
+static	void	setup_table(table_t *tab, const long key_n)
+{
+  int		ret, flags;
+  
+  /*
+   * set auto-adjust and use the faster hash unless the table is going
+   * to be written to a file where the default hash does not depend on
+   * the byte order of the machine
+   */
+  flags = TABLE_FLAG_AUTO_ADJUST;
+  if (save_file == NULL && state_path == NULL && partial_file == NULL) {
+    flags |= TABLE_FLAG_FAST_HASH;
+  }
+  if (open_table_b || inline_keys > 0) {
+    flags |= TABLE_FLAG_OPEN_ADDRESS;
+  }
+  ret = table_attr(tab, flags);
+  if (ret != TABLE_ERROR_NONE) {
+    (void)fprintf(stderr, "%s: could not set flags for table: %s\n",
+		  argv_program, table_strerror(ret));
+    exit(1);
+  }
+  
+  /* set table alignment */
+  ret = table_set_data_alignment(tab, sizeof(long));
+  if (ret != TABLE_ERROR_NONE) {
+    (void)fprintf(stderr, "%s: could not set table alignment: %s\n",
+		  argv_program, table_strerror(ret));
+    exit(1);
+  }
+  
+  /* all of our threads insert into the one table */
+  if (shared_table_b) {
+    ret = table_set_concurrent(tab, 0);
+    if (ret != TABLE_ERROR_NONE) {
+      (void)fprintf(stderr, "%s: could not share table between threads: %s\n",
+		    argv_program, table_strerror(ret));
+      exit(1);
+    }
+  }
+  
+  /* short keys and their counts go right in the table slots */
+  if (inline_keys > 0) {
+    ret = table_set_inline_size(tab, inline_keys, sizeof(sortu_t));
+    if (ret != TABLE_ERROR_NONE) {
+      (void)fprintf(stderr, "%s: could not set table inline size: %s\n",
+		    argv_program, table_strerror(ret));
+      exit(1);
+    }
+  }
+  
+  /* size it once instead of growing it over and over */
+  if (key_n > 0) {
+    ret = table_reserve(tab, key_n);
+    if (ret != TABLE_ERROR_NONE) {
+      (void)fprintf(stderr, "%s: could not size table for %ld keys: %s\n",
+		    argv_program, key_n, table_strerror(ret));
+      exit(1);
+    }
+  }
+}
+
+/*
+ * static table_t *alloc_table
+ *
+ * DESCRIPTION:
+ *
+ * Allocate and configure a table to hold our keys.
+ *
+ * RETURNS:
+ *
+ * The new table.  Exits on error.
+ *
+ * ARGUMENTS:
+ *
+ * key_n -> Number of keys to size the table for or 0 to let it grow.
+ */
+static	table_t	*alloc_table(const long key_n)
+{
+  table_t	*tab;
+  int		ret;
+  
+  /* allocate table with its entries in an arena */
+  tab = table_alloc_in_arena(0, arena_size(key_n), huge_pages_b, &ret);
+  if (tab == NULL) {
+    (void)fprintf(stderr, "%s: could not allocate table: %s\n",
+		  argv_program, table_strerror(ret));
+    exit(1);
+  }
+  setup_table(tab, key_n);
+  
+  return tab;
+}
+
+/*
+ * static shard_t *alloc_shards
+ *
+ * DESCRIPTION:
+ *
+ * Allocate a sharded table to hold our keys and configure each of its
+ * sub-tables like alloc_table does.
+ *
+ * RETURNS:
+ *
+ * The new sharded table.  Exits on error.
+ *
+ * ARGUMENTS:
+ *
+ * key_n -> Number of keys to size the shards for or 0 to let them
+ * grow.
+ */
+static	shard_t	*alloc_shards(const long key_n)
+{
+  shard_t	*shards;
+  int		ret, shard_c;
+  
+  shards = shard_alloc(shard_n, arena_size(key_n / shard_n), huge_pages_b,
+		       &ret);
+  if (shards == NULL) {
+    (void)fprintf(stderr, "%s: could not allocate %d table shards: %s\n",
+		  argv_program, shard_n, table_strerror(ret));
+    exit(1);
+  }
+  for (shard_c = 0; shard_c < shard_n; shard_c++) {
+    setup_table(shard_table(shards, shard_c), key_n / shard_n);
+  }
+  
+  return shards;
+}
+
+/*
+ * static itable_t *alloc_itable
+ *
+ * DESCRIPTION:
+ *
+ * Allocate an integer table to hold our -n keys.
+ *
+ * RETURNS:
+ *
+ * The new table.  Exits on error.
+ *
+ * ARGUMENTS:
+ *
+ * key_n -> Number of keys to size the table for or 0 to let it grow.
+ */
+static	itable_t	*alloc_itable(const long key_n)
+{
+  itable_t	*itab;
+  int		ret;
+  
+  /* the table grows when it is 3/4ths full */
+  itab = itable_alloc(key_n / 3 * 4 + 1, sizeof(sortu_t), &ret);
+  if (itab == NULL) {
+    (void)fprintf(stderr, "%s: could not allocate integer table: %s\n",
+		  argv_program, table_strerror(ret));
+    exit(1);
+  }
+  
+  /* keys in the range are counted in an array and need no hashing */
+  ret = itable_set_range(itab, range_min, range_max);
+  if (ret != TABLE_ERROR_NONE) {
+    (void)fprintf(stderr, "%s: could not set number range %ld,%ld: %s\n",
+		  argv_program, range_min, range_max, table_strerror(ret));
+    exit(1);
+  }
+  
+  return itab;
+}
+
+/*
+ * static int merge_table
+ *
+ * DESCRIPTION:
+ *
+ * Merge the keys from one of our thread tables, or a saved table,
+ * into another table.  The counts are summed and the earliest line is
+ * kept for -o.
+ *
+ * RETURNS:
+ *
+ * The number of files that the merged keys were first seen in.
+ *
+ * ARGUMENTS:
+ *
+ * tab -> Table that we are merging the keys into.
+ *
+ * from_tab -> Table whose keys we are merging.
+ *
+ * file_base -> Number added to the file numbers of the merged keys so
+ * they are ordered after the files of an earlier table.
+ */
+static	int	merge_table(table_t *tab, table_t *from_tab,
+			    const int file_base)
+{
+  table_linear_t	linear;
+  void			*key_p;
+  int			key_size, ret, file_n = 0;
+  sortu_t		from, *from_p, *sortu_p;
+  
+  for (ret = table_first_r(from_tab, &linear, &key_p, &key_size,
+			   (void **)&from_p, NULL);
+       ret == TABLE_ERROR_NONE;
+       ret = table_next_r(from_tab, &linear, &key_p, &key_size,
+			  (void **)&from_p, NULL)) {
+    /* the table may be a read-only mapping so we change a copy */
+    from = *from_p;
+    from.so_file += file_base;
+    if (from_p->so_file >= file_n) {
+      file_n = from_p->so_file + 1;
+    }
+    ret = table_insert(tab, key_p, key_size, &from, sizeof(from),
+		       (void **)&sortu_p, 0);
+    if (ret == TABLE_ERROR_NONE) {
+      continue;
+    }
+    if (ret != TABLE_ERROR_OVERWRITE) {
+      (void)fprintf(stderr, "%s: could not add key to table: %s\n",
+		    argv_program, table_strerror(ret));
+      exit(1);
+    }
+    sortu_p->so_count += from.so_count;
+    if (SORTU_BEFORE(&from, sortu_p)) {
+      sortu_p->so_offset = from.so_offset;
+      sortu_p->so_file = from.so_file;
+    }
+  }
+  
+  if (ret != TABLE_ERROR_NOT_FOUND) {
+    (void)fprintf(stderr, "%s: could not merge tables: %s\n",
+		  argv_program, table_strerror(ret));
+    exit(1);
+  }
+  
+  return file_n;
+}
+
+/*
+ * static int merge_file
+ *
+ * DESCRIPTION:
+ *
+ * Add the counts from one of our --merge files into our table.  A
+ * partial result from --emit-partial is mapped and walked so only the
+ * pages being merged need to be in memory.  Anything else is taken to
+ * be "count key" lines of our output and is streamed through
+ * merge_line.
+ *
+ * RETURNS:
+ *
+ * The file number to use for the next file.  Exits on error.
+ *
+ * ARGUMENTS:
+ *
+ * scan_p <-> Line processing state with the table we are merging into.
+ *
+ * filename -> Path of the file we are merging.
+ *
+ * file_base -> File number of the file's first file for -o.
+ */
+static	int	merge_file(scan_t *scan_p, const char *filename,
+			   const int file_base)
+{
+  table_t	*part;
+  int		file_n, ret;
+  
+  part = table_mmap(filename, &ret);
+  if (part != NULL) {
+    file_n = merge_table(scan_p->sc_table, part, file_base);
+    (void)table_munmap(part);
+    return file_base + file_n;
+  }
+  if (ret != TABLE_ERROR_FILE) {
+    (void)fprintf(stderr, "%s: could not map partial result '%s': %s\n",
+		  argv_program, filename, table_strerror(ret));
+    exit(1);
+  }
+  
+  scan_p->sc_file = file_base;
+  process_file(scan_p, filename, 0, 0);
+  return file_base + 1;
+}
+
+#ifndef NO_THREADS
+
+/*
+ * static void merge_itable
+ *
+ * DESCRIPTION:
+ *
+ * Merge the keys from one of our thread integer tables into another
+ * table.  The counts are summed and the earliest line is kept for -o.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * itab -> Table that we are merging the keys into.
+ *
+ * from_itab -> Table whose keys we are merging.
+ */
+static	void	merge_itable(itable_t *itab, itable_t *from_itab)
+{
+  itable_entry_t	**entries;
+  long			*key_p;
+  int			entry_c, entry_n, ret;
+  sortu_t		*from_p, *sortu_p;
+  
+  entries = itable_order(from_itab, NULL, &entry_n, &ret);
+  if (entries == NULL) {
+    if (ret == TABLE_ERROR_EMPTY) {
+      return;
+    }
+    (void)fprintf(stderr, "%s: could not merge tables: %s\n",
+		  argv_program, table_strerror(ret));
+    exit(1);
+  }
+  
+  for (entry_c = 0; entry_c < entry_n; entry_c++) {
+    (void)itable_entry(from_itab, entries[entry_c], &key_p,
+		       (void **)&from_p);
+    ret = itable_insert(itab, *key_p, from_p, (void **)&sortu_p);
+    if (ret == TABLE_ERROR_NONE) {
+      continue;
+    }
+    if (ret != TABLE_ERROR_OVERWRITE) {
+      (void)fprintf(stderr, "%s: could not add key to table: %s\n",
+		    argv_program, table_strerror(ret));
+      exit(1);
+    }
+    sortu_p->so_count += from_p->so_count;
+    if (SORTU_BEFORE(from_p, sortu_p)) {
+      sortu_p->so_offset = from_p->so_offset;
+      sortu_p->so_file = from_p->so_file;
+    }
+  }
+  
+  (void)itable_order_free(from_itab, entries);
+}
+
+/*
+ * static void *process_thread
+ *
+ * DESCRIPTION:
+ *
+ * Thread which takes the next unprocessed job and adds the keys from
+ * its file or file chunk into the thread's table until there are no
+ * more jobs.
+ *
+ * RETURNS:
+ *
+ * NULL
+ *
+ * ARGUMENTS:
+ *
+ * arg <-> Pointer to the scan_t for this thread.
+ */
+static	void	*process_thread(void *arg)
+{
+  scan_t	*scan_p = arg;
+  job_t		*job_p;
+  
+  while (1) {
+    (void)pthread_mutex_lock(&job_lock);
+    if (job_c >= job_n) {
+      job_p = NULL;
+    }
+    else {
+      job_p = jobs + job_c++;
+    }
+    (void)pthread_mutex_unlock(&job_lock);
+    
+    if (job_p == NULL) {
+      break;
+    }
+    if (ranges == NULL) {
+      scan_p->sc_file = job_p->jo_file;
+    }
+    else {
+      scan_p->sc_file = ranges[job_p->jo_file].ra_state;
+    }
+    process_file(scan_p, ARGV_ARRAY_ENTRY(files, char *, job_p->jo_file),
+		 job_p->jo_start, job_p->jo_end);
+  }
+  
+  return NULL;
+}
+
+/*
+ * static void build_jobs
+ *
+ * DESCRIPTION:
+ *
+ * Build the list of jobs for our threads.  Large regular files are
+ * split into chunks so a single file can be processed by all of the
+ * threads.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * None.
+ */
+static	void	build_jobs(void)
+{
+  struct stat	sbuf;
+  unsigned long	chunk_size, start, first, last, size;
+  int		file_c, job_max;
+  
+  job_max = ARGV_ARRAY_COUNT(files);
+  jobs = malloc(sizeof(job_t) * job_max);
+  if (jobs == NULL) {
+    (void)fprintf(stderr, "%s: could not allocate thread jobs\n",
+		  argv_program);
+    exit(1);
+  }
+  
+  job_n = 0;
+  for (file_c = 0; file_c < ARGV_ARRAY_COUNT(files); file_c++) {
+    
+    /* with --state only the lines added since the last run are processed */
+    if (ranges == NULL) {
+      first = 0;
+      last = 0;
+    }
+    else if (ranges[file_c].ra_end > ranges[file_c].ra_start) {
+      first = ranges[file_c].ra_start;
+      last = ranges[file_c].ra_end;
+    }
+    else {
+      continue;
+    }
+    
+    chunk_size = 0;
+    size = 0;
+#ifndef NO_MMAP
+    if (stat(ARGV_ARRAY_ENTRY(files, char *, file_c), &sbuf) == 0
+	&& S_ISREG(sbuf.st_mode)) {
+      /* a last of 0 is the end of the file */
+      size = (last > 0 ? last : sbuf.st_size) - first;
+    }
+    if (size >= chunk_min * 2) {
+      chunk_size = size / (thread_n * THREAD_CHUNKS);
+      if (chunk_size < chunk_min) {
+	chunk_size = chunk_min;
+      }
+    }
+#endif
+    
+    if (chunk_size == 0) {
+      /* process the whole file */
+      jobs[job_n].jo_file = file_c;
+      jobs[job_n].jo_start = first;
+      jobs[job_n].jo_end = last;
+      job_n++;
+      continue;
+    }
+    
+    job_max += size / chunk_size + 1;
+    jobs = realloc(jobs, sizeof(job_t) * job_max);
+    if (jobs == NULL) {
+      (void)fprintf(stderr, "%s: could not allocate thread jobs\n",
+		    argv_program);
+      exit(1);
+    }
+    for (start = first; start < first + size; start += chunk_size) {
+      jobs[job_n].jo_file = file_c;
+      jobs[job_n].jo_start = start;
+      if (start + chunk_size >= first + size) {
+	jobs[job_n].jo_end = last;
+      }
+      else {
+	jobs[job_n].jo_end = start + chunk_size;
+      }
+      job_n++;
+    }
+  }
+}
+
+/*
+ * static void process_threads
+ *
+ * DESCRIPTION:
+ *
+ * Process our files in parallel.  Each thread adds its keys into its
+ * own table and the tables are merged when they have all finished.
+ * Since the keys record the file and offset of their first line, the
+ * output is the same as if the files were processed serially.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * main_p -> Line processing state of the main thread whose tables
+ * the keys end up in.
+ */
+static	void	process_threads(scan_t *main_p)
+{
+  pthread_t	*threads;
+  scan_t	*scans;
+  int		thread_c, ret;
+  
+  build_jobs();
+  /* --state may have found no new lines */
+  if (job_n == 0) {
+    free(jobs);
+    return;
+  }
+  if (thread_n > job_n) {
+    thread_n = job_n;
+  }
+  
+  threads = malloc(sizeof(pthread_t) * thread_n);
+  scans = calloc(thread_n, sizeof(scan_t));
+  if (threads == NULL || scans == NULL) {
+    (void)fprintf(stderr, "%s: could not allocate thread information\n",
+		  argv_program);
+    exit(1);
+  }
+  
+  for (thread_c = 0; thread_c < thread_n; thread_c++) {
+    /* the first thread uses the main table to save a merge */
+    if (thread_c == 0) {
+      scans[thread_c].sc_table = main_p->sc_table;
+      scans[thread_c].sc_itable = main_p->sc_itable;
+      scans[thread_c].sc_shards = main_p->sc_shards;
+    }
+    else if (numbers_b) {
+      scans[thread_c].sc_itable = alloc_itable(0);
+    }
+    else if (main_p->sc_shards != NULL) {
+      scans[thread_c].sc_shards = main_p->sc_shards;
+    }
+    else if (shared_table_b) {
+      scans[thread_c].sc_table = main_p->sc_table;
+    }
+    else {
+      scans[thread_c].sc_table = alloc_table(0);
+    }
+    ret = pthread_create(threads + thread_c, NULL, process_thread,
+			 scans + thread_c);
+    if (ret != 0) {
+      (void)fprintf(stderr, "%s: could not create thread: %s\n",
+		    argv_program, strerror(ret));
+      exit(1);
+    }
+  }
+  
+  for (thread_c = 0; thread_c < thread_n; thread_c++) {
+    (void)pthread_join(threads[thread_c], NULL);
+  }
+  
+  for (thread_c = 0; thread_c < thread_n; thread_c++) {
+    if (thread_c > 0 && numbers_b) {
+      merge_itable(main_p->sc_itable, scans[thread_c].sc_itable);
+      (void)itable_free(scans[thread_c].sc_itable);
+    }
+    else if (thread_c > 0 && scans[thread_c].sc_table != main_p->sc_table) {
+      (void)merge_table(main_p->sc_table, scans[thread_c].sc_table, 0);
+      (void)table_free(scans[thread_c].sc_table);
+    }
+    if (scans[thread_c].sc_lower_buf != NULL) {
+      free(scans[thread_c].sc_lower_buf);
+    }
+    if (scans[thread_c].sc_key_buf != NULL) {
+      free(scans[thread_c].sc_key_buf);
+    }
+  }
+  
+  free(scans);
+  free(threads);
+  free(jobs);
+}
+
+#endif /* ! NO_THREADS */
+
+/*
+ * static void get_entry
+ *
+ * DESCRIPTION:
+ *
+ * Get the key and count of one of our ordered entries from whichever
+ * table it is in.
+ *
+ * RETURNS:
+ *
+ * None.  Exits on error.
+ *
+ * ARGUMENTS:
+ *
+ * scan_p -> Line processing state with the tables of our keys.
+ *
+ * entry_p -> Entry from the table's order array.
+ *
+ * key_pp <- Pointer which will be set to the key of the entry.
+ *
+ * key_size_p <- Pointer which will be set to the size of the key.
+ *
+ * sortu_pp <- Pointer which will be set to the count information.
+ */
+static	void	get_entry(const scan_t *scan_p, void *entry_p, void **key_pp,
+			  int *key_size_p, sortu_t **sortu_pp)
+{
+  int	ret;
+  
+  if (numbers_b) {
+    ret = itable_entry(scan_p->sc_itable, entry_p, (long **)key_pp,
+		       (void **)sortu_pp);
+    *key_size_p = sizeof(long);
+  }
+  else if (scan_p->sc_shards != NULL) {
+    ret = shard_entry(scan_p->sc_shards, entry_p, key_pp, key_size_p,
+		      (void **)sortu_pp, NULL);
+  }
+  else {
+    ret = table_entry(scan_p->sc_table, entry_p, key_pp, key_size_p, (void **)sortu_pp,
+		      NULL);
+  }
+  if (ret != TABLE_ERROR_NONE) {
+    (void)fprintf(stderr, "%s: could not get table entry: %s\n",
+		  argv_program, table_strerror(ret));
+    exit(1);
+  }
+}
+
+/*
+ * static void print_stats
+ *
+ * DESCRIPTION:
+ *
+ * Print the statistics of a table to stderr to see how well it is
+ * being used.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * tab -> Table whose statistics we are printing.
+ *
+ * name -> Name of the table to print.
+ */
+static	void	print_stats(table_t *tab, const char *name)
+{
+  table_stats_t	stats;
+  int		ret, len_c;
+  
+  ret = table_stats(tab, &stats);
+  if (ret != TABLE_ERROR_NONE) {
+    (void)fprintf(stderr, "%s: could not get %s statistics: %s\n",
+		  argv_program, name, table_strerror(ret));
+    return;
+  }
+  
+  (void)fprintf(stderr, "%s: %d entries in %d buckets, load %.2f, %.1f%% empty",
+		name, stats.ts_entry_n, stats.ts_bucket_n, stats.ts_load,
+		100.0 * stats.ts_empty_n / stats.ts_bucket_n);
+  if (stats.ts_deleted_n > 0) {
+    (void)fprintf(stderr, ", %d deleted", stats.ts_deleted_n);
+  }
+  (void)fprintf(stderr, "\n%s: lengths", name);
+  for (len_c = 0; len_c < TABLE_STATS_CHAIN_N; len_c++) {
+    (void)fprintf(stderr, " %d%s=%d", len_c,
+		  (len_c == TABLE_STATS_CHAIN_N - 1 ? "+" : ""),
+		  stats.ts_chains[len_c]);
+  }
+  (void)fprintf(stderr, ", max %d\n", stats.ts_chain_max);
+  (void)fprintf(stderr,
+		"%s: %lu entry bytes (%lu padding), %lu bucket bytes, "
+		"%lu arena bytes\n",
+		name, stats.ts_entry_bytes, stats.ts_padding_bytes,
+		stats.ts_bucket_bytes, stats.ts_arena_bytes);
+  (void)fprintf(stderr, "%s: %d resizes in %.6f secs\n",
+		name, stats.ts_adjust_n, stats.ts_adjust_secs);
+}
+
+int	main(int argc, char **argv)
+{
+  int		file_c, shard_c, ret, key_size, entry_n, file_base;
+  unsigned long	total, subtotal, perc;
+  char		name[32];
+  void		*key_p;
+  table_t	*tab = NULL, *state_tab = NULL;
+  itable_t	*itab = NULL;
+  shard_t	*shards = NULL;
+  itable_compare_t	number_compare;
+  scan_t	scan;
+  sortu_t	*sortu_p;
+  table_entry_t	**entries, **entries_p;
+  
+  argv_version_string = VERSION_STRING;
+  argv_process(args, argc, argv);
+  
+  if (help_b) {
+    (void)printf("Sortu Utility: http://256.com/sources/sortu/\n");
+    (void)printf("  This utility is a replacement for the sort and uniq programs.\n");
+    (void)printf("  For a list of the command-line options enter: %s --usage\n",
+                 argv_argv[0]);
+    exit(0);
+  }
+  
+  /* if we aren't showing the counts, we might as well sort by the key */
+  if (no_counts_b) {
+    key_sort_b = 1;
+  }
+  
+#ifdef NO_THREADS
+  /* there are no other threads to share the table with */
+  shared_table_b = 0;
+#endif
+  /* the shards have their own locks */
+  if (shard_n > 0) {
+    shared_table_b = 0;
+  }
+  
+  /* -n keys and shards are not in one table that we can save */
+  if ((save_file != NULL || lookup_file != NULL || state_path != NULL
+       || partial_file != NULL || merge_b)
+      && (numbers_b || shard_n > 0)) {
+    (void)fprintf(stderr, "%s: saved tables are not used with -n or --shards\n",
+		  argv_program);
+    exit(1);
+  }
+  if (state_path != NULL
+      && (lookup_file != NULL || ARGV_ARRAY_COUNT(files) == 0)) {
+    (void)fprintf(stderr,
+		  "%s: --state needs files and is not used with --lookup\n",
+		  argv_program);
+    exit(1);
+  }
+  if (merge_b && (lookup_file != NULL || state_path != NULL)) {
+    (void)fprintf(stderr, "%s: --merge is not used with --lookup or --state\n",
+		  argv_program);
+    exit(1);
+  }
+  /* the keys are looked up or merged in the order that they are read */
+  if (lookup_file != NULL || merge_b) {
+    thread_n = 1;
+    estimate_keys_b = 0;
+  }
+  
+  if (number_range != NULL
+      && sscanf(number_range, "%ld,%ld", &range_min, &range_max) != 2) {
+    (void)fprintf(stderr, "%s: number range should be min,max: %s\n",
+		  argv_program, number_range);
+    exit(1);
+  }
+  if (chunk_min < 1) {
+    (void)fprintf(stderr, "%s: chunk size should be at least 1: %ld\n",
+		  argv_program, chunk_min);
+    exit(1);
+  }
+
+  field_delim_init(&delims, delim_str);
+  
+  /* pick up the counts and file positions from the last run */
+  if (state_path != NULL) {
+    state_tab = read_state();
+  }
+  
+  /* sample the start of the files to guess how many keys are coming */
+  if (state_tab != NULL) {
+    (void)table_info(state_tab, NULL, &entry_n);
+    if (expected_keys < entry_n) {
+      expected_keys = entry_n;
+    }
+  }
+  else if (estimate_keys_b && expected_keys == 0) {
+    expected_keys = estimate_keys();
+  }
+  if (expected_keys > EXPECTED_MAX) {
+    expected_keys = EXPECTED_MAX;
+  }
+  
+  /* -n keys go in a table just for integers */
+  if (numbers_b) {
+    itab = alloc_itable(expected_keys);
+  }
+  else if (lookup_file != NULL) {
+    /* the saved table is used right out of the file */
+    tab = table_mmap(lookup_file, &ret);
+    if (tab == NULL) {
+      (void)fprintf(stderr, "%s: could not map table %s: %s\n",
+		    argv_program, lookup_file, table_strerror(ret));
+      exit(1);
+    }
+  }
+  else if (shard_n > 0) {
+    shards = alloc_shards(expected_keys);
+  }
+  else {
+    tab = alloc_table(expected_keys);
+  }
+  /* the saved counts go in a table set up for this run */
+  if (state_tab != NULL) {
+    (void)merge_table(tab, state_tab, 0);
+    (void)table_free(state_tab);
+  }
+  
+  scan.sc_table = tab;
+  scan.sc_itable = itab;
+  scan.sc_shards = shards;
+  scan.sc_file = 0;
+  scan.sc_lower_buf = NULL;
+  scan.sc_lower_size = 0;
+  scan.sc_batch_n = 0;
+  scan.sc_key_buf = NULL;
+  scan.sc_key_size = 0;
+  scan.sc_key_len = 0;
+  
+  if (ARGV_ARRAY_COUNT(files) == 0) {
+    process_stream(&scan, fileno(stdin), "stdin");
+  }
+  else if (merge_b) {
+    /* the partial results and outputs in the order we were given them */
+    file_base = 0;
+    for (file_c = 0; file_c < ARGV_ARRAY_COUNT(files); file_c++) {
+      file_base = merge_file(&scan, ARGV_ARRAY_ENTRY(files, char *, file_c),
+			     file_base);
+    }
+  }
+#ifndef NO_THREADS
+  else if (thread_n > 1) {
+    process_threads(&scan);
+  }
+#endif
+  else {
+    /* process each of the files */
+    for (file_c = 0; file_c < ARGV_ARRAY_COUNT(files); file_c++) {
+      if (ranges == NULL) {
+	scan.sc_file = file_c;
+	process_file(&scan, ARGV_ARRAY_ENTRY(files, char *, file_c), 0, 0);
+      }
+      else if (ranges[file_c].ra_end > ranges[file_c].ra_start) {
+	/* only the lines added since the last run */
+	scan.sc_file = ranges[file_c].ra_state;
+	process_file(&scan, ARGV_ARRAY_ENTRY(files, char *, file_c),
+		     ranges[file_c].ra_start, ranges[file_c].ra_end);
+      }
+    }
+  }
+  
+  /* the counts were printed as the keys were looked up */
+  if (lookup_file != NULL) {
+    (void)table_munmap(tab);
+    exit(0);
+  }
+  
+  if (save_file != NULL) {
+    ret = table_write(tab, save_file, 0666);
+    if (ret != TABLE_ERROR_NONE) {
+      (void)fprintf(stderr, "%s: could not save table to %s: %s\n",
+		    argv_program, save_file, table_strerror(ret));
+      exit(1);
+    }
+  }
+  if (state_path != NULL) {
+    write_state(tab);
+  }
+  
+  /* the partial result is added up with others by --merge later */
+  if (partial_file != NULL) {
+    ret = table_write(tab, partial_file, 0666);
+    if (ret != TABLE_ERROR_NONE) {
+      (void)fprintf(stderr, "%s: could not write partial result to %s: %s\n",
+		    argv_program, partial_file, table_strerror(ret));
+      exit(1);
+    }
+    (void)table_free(tab);
+    exit(0);
+  }
+  
+  /* the -n keys are not in a hash table */
+  if (table_stats_b && shards != NULL) {
+    for (shard_c = 0; shard_c < shard_n; shard_c++) {
+      (void)sprintf(name, "shard %d", shard_c);
+      print_stats(shard_table(shards, shard_c), name);
+    }
+  }
+  else if (table_stats_b && tab != NULL) {
+    print_stats(tab, "table");
+  }
+  
+  if (verbose_b && (! no_counts_b)) {
+    (void)printf("%10.10s", "Count:");
+    if (cumulative_b) {
+      (void)printf(" %10.10s", "Cumulate:");
     }
     if (show_percentage_b) {
       (void)printf(" %5.5s", "%:");
@@ -505,7 +2827,29 @@ int	main(int argc, char **argv)
   }
   
   /* order the table */
-  entries = table_order(tab, count_compare, &entry_n, &ret);
+  if (numbers_b) {
+    if (order_sort_b) {
+      number_compare = number_order_compare;
+    }
+    else if (key_sort_b && reverse_sort_b) {
+      number_compare = number_key_compare;
+    }
+    else if (key_sort_b) {
+      /* the table orders by key itself without sorting the dense keys */
+      number_compare = NULL;
+    }
+    else {
+      number_compare = number_count_compare;
+    }
+    entries = itable_order(itab, number_compare, &entry_n, &ret);
+  }
+  else if (shards != NULL) {
+    /* the shards are sorted in parallel and then merged */
+    entries = shard_order(shards, count_compare, &entry_n, &ret);
+  }
+  else {
+    entries = table_order(tab, count_compare, &entry_n, &ret);
+  }
   if (entries == NULL) {
     if (ret == TABLE_ERROR_EMPTY) {
       entry_n = 0;
@@ -521,13 +2865,7 @@ int	main(int argc, char **argv)
   total = 0;
   for (entries_p = entries; entries_p < entries + entry_n; entries_p++) {
     /* get each entry to print */
-    ret = table_entry(tab, *entries_p, (void **)&key_p, &key_size,
-		      (void *)&sortu_p, NULL);
-    if (ret != TABLE_ERROR_NONE) {
-      (void)fprintf(stderr, "%s: could not get table entry: %s\n",
-		    argv_program, table_strerror(ret));
-      exit(1);
-    }
+    get_entry(&scan, *entries_p, &key_p, &key_size, &sortu_p);
     
     /* limit the matches if necessary */
     if (sortu_p->so_count < min_matches
@@ -541,13 +2879,7 @@ int	main(int argc, char **argv)
   subtotal = 0;
   for (entries_p = entries; entries_p < entries + entry_n; entries_p++) {
     /* get each entry to print */
-    ret = table_entry(tab, *entries_p, (void **)&key_p, &key_size,
-		      (void *)&sortu_p, NULL);
-    if (ret != TABLE_ERROR_NONE) {
-      (void)fprintf(stderr, "%s: could not get table entry: %s\n",
-		    argv_program, table_strerror(ret));
-      exit(1);
-    }
+    get_entry(&scan, *entries_p, &key_p, &key_size, &sortu_p);
     
     /* limit the matches if necessary */
     if (sortu_p->so_count < min_matches
@@ -632,10 +2964,34 @@ int	main(int argc, char **argv)
     }
   }
   
-  if (entries != NULL) {
-    (void)table_order_free(tab, entries, entry_n);
+  if (numbers_b) {
+    if (entries != NULL) {
+      (void)itable_order_free(itab, entries);
+    }
+    (void)itable_free(itab);
+  }
+  else if (shards != NULL) {
+    if (entries != NULL) {
+      (void)shard_order_free(shards, entries);
+    }
+    (void)shard_free(shards);
+  }
+  else {
+    if (entries != NULL) {
+      (void)table_order_free(tab, entries, entry_n);
+    }
+    (void)table_free(tab);
+  }
+  if (scan.sc_lower_buf != NULL) {
+    free(scan.sc_lower_buf);
+  }
+  if (scan.sc_key_buf != NULL) {
+    free(scan.sc_key_buf);
+  }
+  if (ranges != NULL) {
+    free(ranges);
+    free(states);
   }
-  (void)table_free(tab);
   
   argv_cleanup(args);
   exit(0);
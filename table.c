@@ -32,6 +32,8 @@
 
 #if defined __unix__ || defined __APPLE__
 
+#include <sys/mman.h>
+#include <sys/time.h>
 #include <unistd.h>
 
 #else
@@ -41,6 +43,10 @@
 
 #endif
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #define TABLE_MAIN
 
 #include "table.h"
@@ -52,6 +58,57 @@
 
 /****************************** local functions ******************************/
 
+/*
+ * static table_entry_t *file_entry
+ *
+ * DESCRIPTION:
+ *
+ * Turn a file offset from the directory or an entry of a mapped table
+ * into a pointer to its entry.  The offset is checked against the
+ * file so a corrupted file cannot send us outside of the mapping.
+ *
+ * RETURNS:
+ *
+ * Success: A pointer to the entry in the mapping.
+ *
+ * Failure: NULL if the offset or the entry's sizes are bad.
+ *
+ * ARGUMENTS:
+ *
+ * table_p -> Mapped table whose entry we are finding.
+ *
+ * offset -> File offset of the entry.
+ *
+ * min_offset -> Lowest file offset that the entry can be at.
+ */
+static	table_entry_t	*file_entry(const table_t *table_p,
+				    const unsigned long offset,
+				    const unsigned long min_offset)
+{
+  table_entry_t		*entry_p;
+  unsigned long long	size, left;
+  
+  if (offset < min_offset
+      || offset > table_p->ta_file_size - sizeof(table_shell_t)
+      || (offset & (sizeof(table_entry_t *) - 1)) != 0) {
+    return NULL;
+  }
+  entry_p = (table_entry_t *)((char *)table_p->ta_mmap + offset);
+  
+  /* the key and data must also be in the file */
+  left = table_p->ta_file_size - offset;
+  size = sizeof(table_shell_t) + (unsigned long long)entry_p->te_key_size;
+  if (table_p->ta_data_align > 0) {
+    size = FILE_ROUND(size, table_p->ta_data_align);
+  }
+  size += entry_p->te_data_size;
+  if (size > left) {
+    return NULL;
+  }
+  
+  return entry_p;
+}
+
 /*
  * static table_entry_t *first_entry
  *
@@ -72,28 +129,88 @@
  *
  * linear_p <-> Pointer to a linear structure which we will advance
  * and then find the corresponding entry.
+ *
+ * error_p <- Pointer to an integer which, if not NULL, will contain a
+ * table error code when the routine returns.
  */
 static	table_entry_t	*first_entry(const table_t *table_p,
-				     table_linear_t *linear_p)
+				     table_linear_t *linear_p, int *error_p)
 {
   table_entry_t	*entry_p;
   unsigned int	bucket_c = 0;
   
   /* look for the first non-empty bucket */
   for (bucket_c = 0; bucket_c < table_p->ta_bucket_n; bucket_c++) {
-    entry_p = table_p->ta_buckets[bucket_c];
+    entry_p = TABLE_HEAD(table_p, table_p->ta_buckets[bucket_c]);
     if (entry_p != NULL) {
       if (linear_p != NULL) {
 	linear_p->tl_bucket_c = bucket_c;
 	linear_p->tl_entry_c = 0;
       }
+      SET_POINTER(error_p, TABLE_ERROR_NONE);
       return entry_p;
     }
+    if (table_p->ta_buckets[bucket_c] != NULL) {
+      SET_POINTER(error_p, TABLE_ERROR_FILE);
+      return NULL;
+    }
   }
   
+  SET_POINTER(error_p, TABLE_ERROR_NOT_FOUND);
   return NULL;
 }
 
+/*
+ * static table_entry_t *nth_entry
+ *
+ * DESCRIPTION:
+ *
+ * Return the entry at a position in one of the buckets of the table.
+ *
+ * RETURNS:
+ *
+ * Success: A pointer to the entry.
+ *
+ * Failure: NULL if the bucket is not that long or the table's file is
+ * corrupted.
+ *
+ * ARGUMENTS:
+ *
+ * table_p -> Table whose entry we are finding.
+ *
+ * bucket_c -> Bucket that the entry is in.
+ *
+ * entry_c -> Position of the entry in the bucket.
+ *
+ * error_p <- Pointer to an integer which when the routine returns
+ * will contain a table error code.
+ */
+static	table_entry_t	*nth_entry(const table_t *table_p,
+				   const unsigned int bucket_c, int entry_c,
+				   int *error_p)
+{
+  table_entry_t	*entry_p, *next_p;
+  
+  next_p = table_p->ta_buckets[bucket_c];
+  entry_p = TABLE_HEAD(table_p, next_p);
+  /* NOTE: we swap the order here to be more efficient */
+  for (; entry_c > 0 && entry_p != NULL; entry_c--) {
+    next_p = entry_p->te_next_p;
+    entry_p = TABLE_NEXT(table_p, entry_p);
+  }
+  
+  if (entry_p != NULL) {
+    *error_p = TABLE_ERROR_NONE;
+  }
+  else if (next_p != NULL) {
+    *error_p = TABLE_ERROR_FILE;
+  }
+  else {
+    *error_p = TABLE_ERROR_NOT_FOUND;
+  }
+  return entry_p;
+}
+
 /*
  * static table_entry_t *next_entry
  *
@@ -122,7 +239,7 @@ static	table_entry_t	*next_entry(const table_t *table_p,
 				    table_linear_t *linear_p, int *error_p)
 {
   table_entry_t	*entry_p;
-  int		entry_c;
+  int		ret;
   
   /* can't next if we haven't first-ed */
   if (linear_p == NULL) {
@@ -142,19 +259,12 @@ static	table_entry_t	*next_entry(const table_t *table_p,
   linear_p->tl_entry_c++;
   
   /* find the entry which is the nth in the list */
-  entry_p = table_p->ta_buckets[linear_p->tl_bucket_c];
-  /* NOTE: we swap the order here to be more efficient */
-  for (entry_c = linear_p->tl_entry_c; entry_c > 0; entry_c--) {
-    /* did we reach the end of the list? */
-    if (entry_p == NULL) {
-      break;
-    }
-    entry_p = entry_p->te_next_p;
-  }
+  entry_p = nth_entry(table_p, linear_p->tl_bucket_c, linear_p->tl_entry_c,
+		      &ret);
   
   /* did we find an entry in the current bucket? */
-  if (entry_p != NULL) {
-    SET_POINTER(error_p, TABLE_ERROR_NONE);
+  if (ret != TABLE_ERROR_NOT_FOUND) {
+    SET_POINTER(error_p, ret);
     return entry_p;
   }
   
@@ -163,11 +273,15 @@ static	table_entry_t	*next_entry(const table_t *table_p,
   linear_p->tl_entry_c = 0;
   for (linear_p->tl_bucket_c++; linear_p->tl_bucket_c < table_p->ta_bucket_n;
        linear_p->tl_bucket_c++) {
-    entry_p = table_p->ta_buckets[linear_p->tl_bucket_c];
+    entry_p = TABLE_HEAD(table_p, table_p->ta_buckets[linear_p->tl_bucket_c]);
     if (entry_p != NULL) {
       SET_POINTER(error_p, TABLE_ERROR_NONE);
       return entry_p;
     }
+    if (table_p->ta_buckets[linear_p->tl_bucket_c] != NULL) {
+      SET_POINTER(error_p, TABLE_ERROR_FILE);
+      return NULL;
+    }
   }
   
   SET_POINTER(error_p, TABLE_ERROR_NOT_FOUND);
@@ -203,7 +317,7 @@ static	table_entry_t	*this_entry(const table_t *table_p,
 				    int *error_p)
 {
   table_entry_t	*entry_p;
-  int		entry_c;
+  int		ret;
   
   /* can't next if we haven't first-ed */
   if (linear_p == NULL) {
@@ -221,26 +335,10 @@ static	table_entry_t	*this_entry(const table_t *table_p,
   }
   
   /* find the entry which is the nth in the list */
-  entry_p = table_p->ta_buckets[linear_p->tl_bucket_c];
-  
-  /* NOTE: we swap the order here to be more efficient */
-  for (entry_c = linear_p->tl_entry_c; entry_c > 0; entry_c--) {
-    /* did we reach the end of the list? */
-    if (entry_p == NULL) {
-      break;
-    }
-    entry_p = entry_p->te_next_p;
-  }
-  
-  /* did we find an entry in the current bucket? */
-  if (entry_p == NULL) {
-    SET_POINTER(error_p, TABLE_ERROR_NOT_FOUND);
-    return NULL;
-  }
-  else {
-    SET_POINTER(error_p, TABLE_ERROR_NONE);
-    return entry_p;
-  }
+  entry_p = nth_entry(table_p, linear_p->tl_bucket_c, linear_p->tl_entry_c,
+		      &ret);
+  SET_POINTER(error_p, ret);
+  return entry_p;
 }
 
 /*
@@ -344,416 +442,413 @@ static	unsigned int	hash(const unsigned char *key,
 }
 
 /*
- * static int entry_size
+ * static unsigned long long wy_mum
  *
  * DESCRIPTION:
  *
- * Calculates the appropriate size of an entry to include the key and
- * data sizes as well as any associated alignment to the data.
+ * Multiply two 64-bit values into 128 bits and fold the high half
+ * into the low half.
  *
  * RETURNS:
  *
- * The associated size of the entry.
+ * The folded 64-bit product.
  *
  * ARGUMENTS:
  *
- * table_p - Table associated with the entries whose size we are
- * determining.
- *
- * key_size - Size of the entry key.
+ * a - First value to multiply.
  *
- * data - Size of the entry data.
+ * b - Second value to multiply.
  */
-static	int	entry_size(const table_t *table_p, const unsigned int key_size,
-			   const unsigned int data_size)
+static	unsigned long long	wy_mum(const unsigned long long a,
+				       const unsigned long long b)
 {
-  int	size, left;
+#ifdef __SIZEOF_INT128__
+  __uint128_t	prod;
   
-  /* initial size -- key is already aligned if right after struct */
-  size = sizeof(struct table_shell_st) + key_size;
-  
-  /* if there is no alignment then it is easy */
-  if (table_p->ta_data_align == 0) {
-    return size + data_size;
-  }
-  
-  /* add in our alignement */
-  left = size & (table_p->ta_data_align - 1);
-  if (left > 0) {
-    size += table_p->ta_data_align - left;
-  }
-  
-  /* we add the data size here after the alignment */
-  size += data_size;
-  
-  return size;
+  prod = (__uint128_t)a * b;
+  return (unsigned long long)prod ^ (unsigned long long)(prod >> 64);
+#else
+  unsigned long long	a_hi, a_lo, b_hi, b_lo, hi, lo, mid1, mid2, carry;
+  
+  /* do it the long way with 32-bit halves */
+  a_hi = a >> 32;
+  a_lo = (unsigned int)a;
+  b_hi = b >> 32;
+  b_lo = (unsigned int)b;
+  hi = a_hi * b_hi;
+  mid1 = a_hi * b_lo;
+  mid2 = a_lo * b_hi;
+  lo = a_lo * b_lo;
+  carry = ((unsigned long long)(unsigned int)mid1 + (unsigned int)mid2
+	   + (lo >> 32)) >> 32;
+  hi += (mid1 >> 32) + (mid2 >> 32) + carry;
+  lo += (mid1 << 32) + (mid2 << 32);
+  return lo ^ hi;
+#endif
 }
 
 /*
- * static unsigned char *entry_data_buf
+ * static unsigned long long wy_read
  *
  * DESCRIPTION:
  *
- * Companion to the ENTRY_DATA_BUF macro but this handles any
- * associated alignment to the data in the entry.
- *
- * NOTE: we assume here that the data-alignment is > 0.
+ * Load bytes of a key in native byte order without worrying about
+ * alignment.
  *
  * RETURNS:
  *
- * Pointer to the data segment of the entry.
+ * The loaded value.
  *
  * ARGUMENTS:
  *
- * table_p - Table associated with the entry.
+ * key_p - Pointer to the bytes that we are loading.
  *
- * entry_p - Entry whose data pointer we are determining.
+ * size - Number of bytes to load, either 4 or 8.
  */
-static	unsigned char	*entry_data_buf(const table_t *table_p,
-					const table_entry_t *entry_p)
+static	unsigned long long	wy_read(const unsigned char *key_p,
+					const int size)
 {
-  const unsigned char	*buf_p;
-  unsigned int		size, pad;
+  unsigned long long	val8;
+  unsigned int		val4;
   
-  buf_p = entry_p->te_key_buf + entry_p->te_key_size;
-  
-  /* we need the size of the space before the data */
-  size = sizeof(struct table_shell_st) + entry_p->te_key_size;
-  
-  /* add in our alignment */
-  pad = size & (table_p->ta_data_align - 1);
-  if (pad > 0) {
-    pad = table_p->ta_data_align - pad;
+  if (size == 8) {
+    memcpy(&val8, key_p, sizeof(val8));
+    return val8;
+  }
+  else {
+    memcpy(&val4, key_p, sizeof(val4));
+    return val4;
   }
-  
-  return (unsigned char *)buf_p + pad;
 }
 
-/******************************* sort routines *******************************/
-
 /*
- * static int local_compare
+ * static unsigned int fast_hash
  *
  * DESCRIPTION:
  *
- * Compare two entries by calling user's compare program or by using
- * memcmp.
+ * Hash a variable-length key with a 64-bit multiply-and-fold hash in
+ * the style of wyhash.  It loads the key 8 bytes at a time and
+ * consumes 48 bytes per round for long keys, which makes it much
+ * faster than hash() on modern machines.  Since it loads in native
+ * byte order the values differ between little and big endian hosts,
+ * so hash() is still the default for tables which may be written to
+ * disk.
  *
  * RETURNS:
  *
- * < 0, == 0, or > 0 depending on whether p1 is > p2, == p2, < p2.
+ * Returns a 32-bit hash value folded from the 64-bit result.
  *
  * ARGUMENTS:
  *
- * p1 - First entry pointer to compare.
- *
- * p2 - Second entry pointer to compare.
- *
- * compare - User comparison function.  Ignored.
+ * key - Key (the unaligned variable-length array of bytes) that we
+ * are hashing.
  *
- * table_p - Associated table being ordered.  Ignored.
+ * length - Length of the key in bytes.
  *
- * err_bp - Pointer to an integer which will be set with 1 if an error
- * has occurred.  It cannot be NULL.
+ * init_val - Initialization value of the hash.
  */
-static int	local_compare(const void *p1, const void *p2,
-			      table_compare_t compare, const table_t *table_p,
-			      int *err_bp)
+static	unsigned int	fast_hash(const unsigned char *key,
+				  const unsigned int length,
+				  const unsigned int init_val)
 {
-  const table_entry_t	* const *ent1_p = p1, * const *ent2_p = p2;
-  int			cmp;
-  unsigned int		size;
-  
-  /* compare as many bytes as we can */
-  size = (*ent1_p)->te_key_size;
-  if ((*ent2_p)->te_key_size < size) {
-    size = (*ent2_p)->te_key_size;
+  const unsigned char	*key_p = key;
+  unsigned long long	seed, see1, see2, a, b;
+  unsigned int		len;
+  
+  seed = init_val;
+  seed ^= wy_mum(seed ^ WY_PRIME0, WY_PRIME1);
+  
+  if (length <= 16) {
+    if (length >= 4) {
+      /* two possibly overlapping pairs of 4 byte loads */
+      a = (wy_read(key_p, 4) << 32)
+	| wy_read(key_p + ((length >> 3) << 2), 4);
+      b = (wy_read(key_p + length - 4, 4) << 32)
+	| wy_read(key_p + length - 4 - ((length >> 3) << 2), 4);
+    }
+    else if (length > 0) {
+      a = ((unsigned long long)key_p[0] << 16)
+	| ((unsigned long long)key_p[length >> 1] << 8)
+	| key_p[length - 1];
+      b = 0;
+    }
+    else {
+      a = 0;
+      b = 0;
+    }
   }
-  cmp = memcmp(ENTRY_KEY_BUF(*ent1_p), ENTRY_KEY_BUF(*ent2_p), size);
-  /* if common-size equal, then if next more bytes, it is larger */
-  if (cmp == 0) {
-    cmp = (*ent1_p)->te_key_size - (*ent2_p)->te_key_size;
+  else {
+    len = length;
+    if (len > 48) {
+      /* three independent lanes so the multiplies can overlap */
+      see1 = seed;
+      see2 = seed;
+      do {
+	seed = wy_mum(wy_read(key_p, 8) ^ WY_PRIME1,
+		      wy_read(key_p + 8, 8) ^ seed);
+	see1 = wy_mum(wy_read(key_p + 16, 8) ^ WY_PRIME2,
+		      wy_read(key_p + 24, 8) ^ see1);
+	see2 = wy_mum(wy_read(key_p + 32, 8) ^ WY_PRIME3,
+		      wy_read(key_p + 40, 8) ^ see2);
+	key_p += 48;
+	len -= 48;
+      } while (len > 48);
+      seed ^= see1 ^ see2;
+    }
+    for (; len > 16; len -= 16) {
+      seed = wy_mum(wy_read(key_p, 8) ^ WY_PRIME1,
+		    wy_read(key_p + 8, 8) ^ seed);
+      key_p += 16;
+    }
+    /* the last 16 bytes which may overlap what we have done */
+    a = wy_read(key_p + len - 16, 8);
+    b = wy_read(key_p + len - 8, 8);
   }
   
-  *err_bp = 0;
-  return cmp;
+  a = wy_mum(a ^ WY_PRIME1, b ^ seed);
+  a = wy_mum(a ^ WY_PRIME0 ^ length, a ^ WY_PRIME1);
+  
+  return (unsigned int)(a ^ (a >> 32));
 }
 
 /*
- * static int local_compare_pos
+ * static unsigned long long usecs_now
  *
  * DESCRIPTION:
  *
- * Compare two entries by calling user's compare program or by using
- * memcmp.
+ * Get the current time so we can see how long resizing takes.
  *
  * RETURNS:
  *
- * < 0, == 0, or > 0 depending on whether p1 is > p2, == p2, < p2.
+ * The time in microseconds or 0 if we can't tell.
  *
  * ARGUMENTS:
  *
- * p1 - First entry pointer to compare.
- *
- * p2 - Second entry pointer to compare.
- *
- * compare - User comparison function.  Ignored.
- *
- * table_p - Associated table being ordered.
- *
- * err_bp - Pointer to an integer which will be set with 1 if an error
- * has occurred.  It cannot be NULL.
+ * None.
  */
-static int	local_compare_pos(const void *p1, const void *p2,
-				  table_compare_t compare,
-				  const table_t *table_p, int *err_bp)
+static	unsigned long long	usecs_now(void)
 {
-  const table_linear_t	*lin1_p = p1, *lin2_p = p2;
-  const table_entry_t	*ent1_p, *ent2_p;
-  int			cmp, ret;
-  unsigned int		size;
+#if defined __unix__ || defined __APPLE__
+  struct timeval	now;
   
-  /* get entry pointers */
-  ent1_p = this_entry(table_p, lin1_p, &ret);
-  ent2_p = this_entry(table_p, lin2_p, &ret);
-  if (ent1_p == NULL || ent2_p == NULL) {
-    *err_bp = 1;
+  if (gettimeofday(&now, NULL) != 0) {
     return 0;
   }
-  
-  /* compare as many bytes as we can */
-  size = ent1_p->te_key_size;
-  if (ent2_p->te_key_size < size) {
-    size = ent2_p->te_key_size;
-  }
-  cmp = memcmp(ENTRY_KEY_BUF(ent1_p), ENTRY_KEY_BUF(ent2_p), size);
-  /* if common-size equal, then if next more bytes, it is larger */
-  if (cmp == 0) {
-    cmp = ent1_p->te_key_size - ent2_p->te_key_size;
-  }
-  
-  *err_bp = 0;
-  return cmp;
+  return (unsigned long long)now.tv_sec * 1000000 + now.tv_usec;
+#else
+  return 0;
+#endif
 }
 
 /*
- * static int external_compare
+ * static void adjust_count
  *
  * DESCRIPTION:
  *
- * Compare two entries by calling user's compare program or by using
- * memcmp.
+ * Record that a table was resized for table_stats.  Resizing a table
+ * without any entries does not count since nothing was rehashed.
  *
  * RETURNS:
  *
- * < 0, == 0, or > 0 depending on whether p1 is > p2, == p2, < p2.
+ * None.
  *
  * ARGUMENTS:
  *
- * p1 - First entry pointer to compare.
- *
- * p2 - Second entry pointer to compare.
- *
- * user_compare - User comparison function.
- *
- * table_p - Associated table being ordered.
+ * table_p - Table which was resized.
  *
- * err_bp - Pointer to an integer which will be set with 1 if an error
- * has occurred.  It cannot be NULL.
+ * start - Time from usecs_now when the resizing started.
  */
-static int	external_compare(const void *p1, const void *p2,
-				 table_compare_t user_compare,
-				 const table_t *table_p, int *err_bp)
+static	void	adjust_count(table_t *table_p, const unsigned long long start)
 {
-  const table_entry_t	* const *ent1_p = p1, * const *ent2_p = p2;
-  /* since we know we are not aligned we can use the EXTRY_DATA_BUF macro */
-  *err_bp = 0;
-  return user_compare(ENTRY_KEY_BUF(*ent1_p), (*ent1_p)->te_key_size,
-		      ENTRY_DATA_BUF(table_p, *ent1_p),
-		      (*ent1_p)->te_data_size,
-		      ENTRY_KEY_BUF(*ent2_p), (*ent2_p)->te_key_size,
-		      ENTRY_DATA_BUF(table_p, *ent2_p),
-		      (*ent2_p)->te_data_size);
+  if (table_p->ta_entry_n > 0) {
+    table_p->ta_adjust_n++;
+    table_p->ta_adjust_usecs += usecs_now() - start;
+  }
 }
 
 /*
- * static int external_compare_pos
+ * static unsigned int key_hash
  *
  * DESCRIPTION:
  *
- * Compare two entries by calling user's compare program or by using
- * memcmp.
+ * Hash a key with the hash function selected for the table.
  *
  * RETURNS:
  *
- * < 0, == 0, or > 0 depending on whether p1 is > p2, == p2, < p2.
+ * Returns a 32-bit hash value.
  *
  * ARGUMENTS:
  *
- * p1 - First entry pointer to compare.
- *
- * p2 - Second entry pointer to compare.
- *
- * user_compare - User comparison function.
+ * table_p - Table whose hash function we are using.
  *
- * table_p - Associated table being ordered.
+ * key - Key that we are hashing.
  *
- * err_bp - Pointer to an integer which will be set with 1 if an error
- * has occurred.  It cannot be NULL.
-*/
-static int	external_compare_pos(const void *p1, const void *p2,
-				     table_compare_t user_compare,
-				     const table_t *table_p, int *err_bp)
+ * length - Length of the key in bytes.
+ */
+static	unsigned int	key_hash(const table_t *table_p, const void *key,
+				 const unsigned int length)
 {
-  const table_linear_t	*lin1_p = p1, *lin2_p = p2;
-  const table_entry_t	*ent1_p, *ent2_p;
-  int			ret;
-  
-  /* get entry pointers */
-  ent1_p = this_entry(table_p, lin1_p, &ret);
-  ent2_p = this_entry(table_p, lin2_p, &ret);
-  if (ent1_p == NULL || ent2_p == NULL) {
-    *err_bp = 1;
-    return 0;
+  if (table_p->ta_flags & TABLE_FLAG_FAST_HASH) {
+    return fast_hash(key, length, 0);
+  }
+  else {
+    return hash(key, length, 0);
   }
-  
-  /* since we know we are not aligned we can use the EXTRY_DATA_BUF macro */
-  *err_bp = 0;
-  return user_compare(ENTRY_KEY_BUF(ent1_p), (ent1_p)->te_key_size,
-		      ENTRY_DATA_BUF(table_p, ent1_p), ent1_p->te_data_size,
-		      ENTRY_KEY_BUF(ent2_p), ent2_p->te_key_size,
-		      ENTRY_DATA_BUF(table_p, ent2_p), ent2_p->te_data_size);
 }
 
 /*
- * static int external_compare_align
+ * static unsigned int bucket_index
  *
  * DESCRIPTION:
  *
- * Compare two entries by calling user's compare program or by using
- * memcmp.  Alignment information is necessary.
+ * Turn a hash value into a bucket number.  If the number of buckets
+ * is a power of 2 then we fold the high bits of the hash into the low
+ * ones and mask instead of doing a slow mod.
  *
  * RETURNS:
  *
- * < 0, == 0, or > 0 depending on whether p1 is > p2, == p2, < p2.
+ * The bucket number for the hash.
  *
  * ARGUMENTS:
  *
- * p1 - First entry pointer to compare.
- *
- * p2 - Second entry pointer to compare.
- *
- * user_compare - User comparison function.
+ * hash_val - Full hash value of the key.
  *
- * table_p - Associated table being ordered.
+ * bucket_n - Number of buckets in the table.
  *
- * err_bp - Pointer to an integer which will be set with 1 if an error
- * has occurred.  It cannot be NULL.
+ * bucket_mask - Mask for the buckets or 0 if bucket_n is not a power
+ * of 2.
  */
-static int	external_compare_align(const void *p1, const void *p2,
-				       table_compare_t user_compare,
-				       const table_t *table_p, int *err_bp)
+static	unsigned int	bucket_index(unsigned int hash_val,
+				     const unsigned int bucket_n,
+				     const unsigned int bucket_mask)
 {
-  const table_entry_t	* const *ent1_p = p1, * const *ent2_p = p2;
-  /* since we are aligned we have to use the entry_data_buf function */
-  *err_bp = 0;
-  return user_compare(ENTRY_KEY_BUF(*ent1_p), (*ent1_p)->te_key_size,
-		      entry_data_buf(table_p, *ent1_p),
-		      (*ent1_p)->te_data_size,
-		      ENTRY_KEY_BUF(*ent2_p), (*ent2_p)->te_key_size,
-		      entry_data_buf(table_p, *ent2_p),
-		      (*ent2_p)->te_data_size);
+  if (bucket_mask == 0) {
+    return hash_val % bucket_n;
+  }
+  
+  /* so keys which only differ in their high hash bits still spread */
+  hash_val ^= hash_val >> 16;
+  hash_val *= 0x85EBCA6B;
+  hash_val ^= hash_val >> 13;
+  
+  return hash_val & bucket_mask;
 }
 
 /*
- * static int external_compare_align_pos
+ * static table_entry_t **bucket_head
  *
  * DESCRIPTION:
  *
- * Compare two entries by calling user's compare program or by using
- * memcmp.  Alignment information is necessary.
+ * Find the bucket list which holds, or would hold, a key.  If the
+ * table is incrementally growing then the key's bucket in the old
+ * bucket array may not have been moved into the new one yet.
  *
  * RETURNS:
  *
- * < 0, == 0, or > 0 depending on whether p1 is > p2, == p2, < p2.
+ * Pointer to the head of the key's bucket list.
  *
  * ARGUMENTS:
  *
- * p1 - First entry pointer to compare.
- *
- * p2 - Second entry pointer to compare.
- *
- * user_compare - User comparison function.
- *
- * table_p - Associated table being ordered.
+ * table_p - Table whose bucket we are finding.
  *
- * err_bp - Pointer to an integer which will be set with 1 if an error
- * has occurred.  It cannot be NULL.
+ * hash_val - Full hash value of the key.
  */
-static int	external_compare_align_pos(const void *p1, const void *p2,
-					   table_compare_t user_compare,
-					   const table_t *table_p, int *err_bp)
+static	table_entry_t	**bucket_head(const table_t *table_p,
+				      const unsigned int hash_val)
 {
-  const table_linear_t	*lin1_p = p1, *lin2_p = p2;
-  const table_entry_t	*ent1_p, *ent2_p;
-  int			ret;
+  unsigned int	bucket;
   
-  /* get entry pointers */
-  ent1_p = this_entry(table_p, lin1_p, &ret);
-  ent2_p = this_entry(table_p, lin2_p, &ret);
-  if (ent1_p == NULL || ent2_p == NULL) {
-    *err_bp = 1;
-    return 0;
+  if (table_p->ta_old_buckets != NULL) {
+    bucket = bucket_index(hash_val, table_p->ta_old_bucket_n,
+			  table_p->ta_old_bucket_mask);
+    if (bucket >= table_p->ta_migrate_c) {
+      return table_p->ta_old_buckets + bucket;
+    }
   }
   
-  /* since we are aligned we have to use the entry_data_buf function */
-  *err_bp = 0;
-  return user_compare(ENTRY_KEY_BUF(ent1_p), ent1_p->te_key_size,
-		      entry_data_buf(table_p, ent1_p), ent1_p->te_data_size,
-		      ENTRY_KEY_BUF(ent2_p), ent2_p->te_key_size,
-		      entry_data_buf(table_p, ent2_p), ent2_p->te_data_size);
+  return table_p->ta_buckets + bucket_index(hash_val, table_p->ta_bucket_n,
+					    table_p->ta_bucket_mask);
 }
 
 /*
- * static void swap_bytes
+ * static int migrate_buckets
  *
  * DESCRIPTION:
  *
- * Swap the values between two items of a specified size.
+ * Move the entries of some buckets from the old bucket array of an
+ * incrementally growing table into the new one.  When all of the old
+ * buckets have been moved the old array is freed.
  *
  * RETURNS:
  *
- * None.
+ * Success - TABLE_ERROR_NONE
  *
- * ARGUMENTS:
+ * Failure - Table error code.
  *
- * item1_p -> Pointer to the first item.
+ * ARGUMENTS:
  *
- * item2_p -> Pointer to the first item.
+ * table_p - Table whose buckets we are moving.
  *
- * ele_size -> Size of the two items.
+ * bucket_n - Number of old buckets to move.
  */
-static	void	swap_bytes(unsigned char *item1_p, unsigned char *item2_p,
-			   int ele_size)
+static	int	migrate_buckets(table_t *table_p, const unsigned int bucket_n)
 {
-  unsigned char	char_temp;
+  table_entry_t	*entry_p, *next_p, **old_p, **bounds_p, **head_p;
   
-  for (; ele_size > 0; ele_size--) {
-    char_temp = *item1_p;
-    *item1_p = *item2_p;
-    *item2_p = char_temp;
-    item1_p++;
-    item2_p++;
+  if (table_p->ta_old_buckets == NULL) {
+    return TABLE_ERROR_NONE;
+  }
+  
+  old_p = table_p->ta_old_buckets + table_p->ta_migrate_c;
+  bounds_p = table_p->ta_old_buckets + table_p->ta_old_bucket_n;
+  if (bounds_p - old_p > bucket_n) {
+    bounds_p = old_p + bucket_n;
+  }
+  
+  for (; old_p < bounds_p; old_p++) {
+    for (entry_p = *old_p; entry_p != NULL; entry_p = next_p) {
+      next_p = entry_p->te_next_p;
+      head_p = table_p->ta_buckets
+	+ bucket_index(entry_p->te_hash, table_p->ta_bucket_n,
+		       table_p->ta_bucket_mask);
+      entry_p->te_next_p = *head_p;
+      *head_p = entry_p;
+    }
+    *old_p = NULL;
+  }
+  table_p->ta_migrate_c = old_p - table_p->ta_old_buckets;
+  
+  if (table_p->ta_migrate_c < table_p->ta_old_bucket_n) {
+    return TABLE_ERROR_NONE;
+  }
+  
+  /* we are done so free the old buckets */
+  if (table_p->ta_free_func == NULL) {
+    free(table_p->ta_old_buckets);
+  }
+  else if (! table_p->ta_free_func(table_p->ta_mem_pool,
+				   table_p->ta_old_buckets,
+				   table_p->ta_old_bucket_n *
+				   sizeof(table_entry_t *))) {
+    table_p->ta_old_buckets = NULL;
+    return TABLE_ERROR_FREE;
   }
+  table_p->ta_old_buckets = NULL;
+  table_p->ta_old_bucket_n = 0;
+  table_p->ta_old_bucket_mask = 0;
+  table_p->ta_migrate_c = 0;
+  
+  return TABLE_ERROR_NONE;
 }
 
 /*
- * static void insert_sort
+ * static int migrate_start
  *
  * DESCRIPTION:
  *
- * Do an insertion sort which is faster for small numbers of items and
- * better if the items are already sorted.
+ * Start growing a table incrementally.  The current buckets become
+ * the old ones and inserts move a few of them at a time into the new
+ * larger bucket array.
  *
  * RETURNS:
  *
@@ -763,558 +858,339 @@ static	void	swap_bytes(unsigned char *item1_p, unsigned char *item2_p,
  *
  * ARGUMENTS:
  *
- * first_p <-> Start of the list that we are splitting.
- *
- * last_p <-> Last entry in the list that we are splitting.
- *
- * holder_p <-> Location of hold area we can store an entry.
- *
- * ele_size -> Size of the each element in the list.
- *
- * compare -> Our comparison function.
- *
- * user_compare -> User comparison function.  Could be NULL if we are
- * just using a local comparison function.
+ * table_p - Table which we are growing.
  *
- * table_p -> Associated table being sorted.
+ * bucket_n - Minimum number of buckets in the new array.  It will be
+ * rounded up to a power of 2.
  */
-static	int	insert_sort(unsigned char *first_p, unsigned char *last_p,
-			    unsigned char *holder_p,
-			    const unsigned int ele_size, compare_t compare,
-			    table_compare_t user_compare, table_t *table_p)
+static	int	migrate_start(table_t *table_p, const unsigned int bucket_n)
 {
-  unsigned char	*inner_p, *outer_p;
-  int		ret, err_b;
+  table_entry_t	**buckets;
+  unsigned int	buck_n, bucket_size;
+  unsigned long long	start;
+  int		ret;
   
-  for (outer_p = first_p + ele_size; outer_p <= last_p; ) {
-    
-    /* look for the place to insert the entry */
-    for (inner_p = outer_p - ele_size;
-	 inner_p >= first_p;
-	 inner_p -= ele_size) {
-      ret = compare(outer_p, inner_p, user_compare, table_p, &err_b);
-      if (err_b) {
-	return TABLE_ERROR_COMPARE;
-      }
-      if (ret >= 0) {
-	break;
-      }
-    }
-    inner_p += ele_size;
-    
-    /* do we need to insert the entry in? */
-    if (outer_p != inner_p) {
-      /*
-       * Now we shift the entry down into its place in the already
-       * sorted list.
-       */
-      memcpy(holder_p, outer_p, ele_size);
-      memmove(inner_p + ele_size, inner_p, outer_p - inner_p);
-      memcpy(inner_p, holder_p, ele_size);
-    }
-    
-    outer_p += ele_size;
+  /* this should have finished already but just in case */
+  ret = migrate_buckets(table_p, table_p->ta_old_bucket_n);
+  if (ret != TABLE_ERROR_NONE) {
+    return ret;
+  }
+  
+  start = usecs_now();
+  for (buck_n = 1; buck_n < bucket_n; buck_n *= 2) {
+  }
+  
+  bucket_size = buck_n * sizeof(table_entry_t *);
+  if (table_p->ta_alloc_func == NULL) {
+    buckets = (table_entry_t **)malloc(bucket_size);
+  }
+  else {
+    buckets =
+      (table_entry_t **)table_p->ta_alloc_func(table_p->ta_mem_pool,
+					       bucket_size);
   }
+  if (buckets == NULL) {
+    return TABLE_ERROR_ALLOC;
+  }
+  memset(buckets, 0, bucket_size);
+  
+  table_p->ta_old_buckets = table_p->ta_buckets;
+  table_p->ta_old_bucket_n = table_p->ta_bucket_n;
+  table_p->ta_old_bucket_mask = table_p->ta_bucket_mask;
+  table_p->ta_migrate_c = 0;
+  table_p->ta_buckets = buckets;
+  table_p->ta_bucket_n = buck_n;
+  table_p->ta_bucket_mask = buck_n - 1;
+  adjust_count(table_p, start);
   
   return TABLE_ERROR_NONE;
 }
 
 /*
- * static int split
+ * static int entry_size
  *
  * DESCRIPTION:
  *
- * This sorts an array of longs via the quick sort algorithm (it's
- * pretty quick)
+ * Calculates the appropriate size of an entry to include the key and
+ * data sizes as well as any associated alignment to the data.
  *
  * RETURNS:
  *
- * None.
+ * The associated size of the entry.
  *
  * ARGUMENTS:
  *
- * first_p -> Start of the list that we are splitting.
- *
- * last_p -> Last entry in the list that we are splitting.
- *
- * ele_size -> Size of the each element in the list.
- *
- * compare -> Our comparison function.
+ * table_p - Table associated with the entries whose size we are
+ * determining.
  *
- * user_compare -> User comparison function.  Could be NULL if we are
- * just using a local comparison function.
+ * key_size - Size of the entry key.
  *
- * table_p -> Associated table being sorted.
+ * data - Size of the entry data.
  */
-static	int	split(unsigned char *first_p, unsigned char *last_p,
-		      const unsigned int ele_size, compare_t compare,
-		      table_compare_t user_compare, table_t *table_p)
+static	int	entry_size(const table_t *table_p, const unsigned int key_size,
+			   const unsigned int data_size)
 {
-  unsigned char	*left_p, *right_p, *pivot_p, *left_last_p, *right_first_p;
-  unsigned char	*firsts[MAX_QSORT_SPLITS], *lasts[MAX_QSORT_SPLITS], *pivot;
-  unsigned int	width, split_c = 0;
-  int		size1, size2, min_qsort_size;
-  int		ret, err_b;
+  int	size, left;
   
-  /*
-   * Allocate some space for our pivot value.  We also use this as
-   * holder space for our insert sort.
-   */
-  pivot = alloca(ele_size);
-  if (pivot == NULL) {
-    /* what else can we do? */
-    abort();
-  }
+  /* initial size -- key is already aligned if right after struct */
+  size = sizeof(struct table_shell_st) + key_size;
   
-  min_qsort_size = MAX_QSORT_MANY * ele_size;
+  /* if there is no alignment then it is easy */
+  if (table_p->ta_data_align == 0) {
+    return size + data_size;
+  }
   
-  while (1) {
-    
-    /* find the left, right, and mid point */
-    left_p = first_p;
-    right_p = last_p;
-    /* is there a faster way to find this? */
-    width = (last_p - first_p) / ele_size;
-    pivot_p = first_p + ele_size * (width >> 1);
-    
-    /*
-     * Find which of the left, middle, and right elements is the
-     * median (Knuth vol3 p123).
-      */
-    ret = compare(first_p, pivot_p, user_compare, table_p, &err_b);
-    if (err_b) {
-      return TABLE_ERROR_COMPARE;
-    }
-    if (ret > 0) {
-      swap_bytes(first_p, pivot_p, ele_size);
-    }
-    ret = compare(pivot_p, last_p, user_compare, table_p, &err_b);
-    if (err_b) {
-      return TABLE_ERROR_COMPARE;
-    }
-    if (ret > 0) {
-      swap_bytes(pivot_p, last_p, ele_size);
-      ret = compare(first_p, pivot_p, user_compare, table_p, &err_b);
-      if (err_b) {
-	return TABLE_ERROR_COMPARE;
-      }
-      if (ret > 0) {
-	swap_bytes(first_p, pivot_p, ele_size);
-      }
-    }
-    
-    /*
-     * save our pivot so we don't have to worry about hitting and
-     * swapping it elsewhere while we iterate across the list below.
-     */
-    memcpy(pivot, pivot_p, ele_size);
-    
-    do {
-      
-      /* shift the left side up until we reach the pivot value */
-      while (1) {
-	ret = compare(left_p, pivot, user_compare, table_p, &err_b);
-	if (err_b) {
-	  return TABLE_ERROR_COMPARE;
-	}
-	if (ret >= 0) {
-	  break;
-	}
-	left_p += ele_size;
-      }
-      /* shift the right side down until we reach the pivot value */
-      while (1) {
-	ret = compare(pivot, right_p, user_compare, table_p, &err_b);
-	if (err_b) {
-	  return TABLE_ERROR_COMPARE;
-	}
-	if (ret >= 0) {
-	  break;
-	}
-	right_p -= ele_size;
-      }
-      
-      /* if we met in the middle then we are done */
-      if (left_p == right_p) {
-	left_p += ele_size;
-	right_p -= ele_size;
-	break;
-      }
-      else if (left_p < right_p) {
-	/*
-	 * swap the left and right since they both were on the wrong
-	 * size of the pivot and continue
-	 */
-	swap_bytes(left_p, right_p, ele_size);
-	left_p += ele_size;
-	right_p -= ele_size;
-      }
-    } while (left_p <= right_p);
-    
-    /* Rename variables to make more sense.  This will get optimized out. */
-    right_first_p = left_p;
-    left_last_p = right_p;
-    
-    /* determine the size of the left and right hand parts */
-    size1 = left_last_p - first_p;
-    size2 = last_p - right_first_p;
-    
-    /* is the 1st half small enough to just insert-sort? */
-    if (size1 < min_qsort_size) {
-      
-      /* use the pivot as our temporary space */
-      ret = insert_sort(first_p, left_last_p, pivot, ele_size, compare,
-			user_compare, table_p);
-      if (ret != TABLE_ERROR_NONE) {
-	return ret;
-      }
-      
-      /* is the 2nd part small as well? */
-      if (size2 < min_qsort_size) {
-	
-	/* use the pivot as our temporary space */
-	ret = insert_sort(right_first_p, last_p, pivot, ele_size, compare,
-			  user_compare, table_p);
-	if (ret != TABLE_ERROR_NONE) {
-	  return ret;
-	}
-	
-	/* pop a partition off our stack */
-	if (split_c == 0) {
-	  /* we are done */
-	  return TABLE_ERROR_NONE;
-	}
-	split_c--;
-	first_p = firsts[split_c];
-	last_p = lasts[split_c];
-      }
-      else {
-	/* we can just handle the right side immediately */
-	first_p = right_first_p;
-	/* last_p = last_p */
-      }
-    }
-    else if (size2 < min_qsort_size) {
-      
-      /* use the pivot as our temporary space */
-      ret = insert_sort(right_first_p, last_p, pivot, ele_size, compare,
-			user_compare, table_p);
-      if (ret != TABLE_ERROR_NONE) {
-	return ret;
-      }
-      
-      /* we can just handle the left side immediately */
-      /* first_p = first_p */
-      last_p = left_last_p;
-    }
-    else {
-      /*
-       * neither partition is small, we'll have to push the larger one
-       * of them on the stack
-       */
-      if (split_c >= MAX_QSORT_SPLITS) {
-	/* sanity check here -- we should never get here */
-	abort();
-      }
-      if (size1 > size2) {
-	/* push the left partition on the stack */
-	firsts[split_c] = first_p;
-	lasts[split_c] = left_last_p;
-	split_c++;
-	/* continue handling the right side */
-	first_p = right_first_p;
-	/* last_p = last_p */
-      }
-      else {
-	/* push the right partition on the stack */
-	firsts[split_c] = right_first_p;
-	lasts[split_c] = last_p;
-	split_c++;
-	/* continue handling the left side */
-	/* first_p = first_p */
-	last_p = left_last_p;
-      }
-    }
+  /* add in our alignement */
+  left = size & (table_p->ta_data_align - 1);
+  if (left > 0) {
+    size += table_p->ta_data_align - left;
   }
   
-  return TABLE_ERROR_NONE;
+  /* we add the data size here after the alignment */
+  size += data_size;
+  
+  return size;
 }
 
-/*************************** exported routines *******************************/
-
 /*
- * table_t *table_alloc
+ * static unsigned char *entry_data_buf
  *
  * DESCRIPTION:
  *
- * Allocate a new table structure.
+ * Companion to the ENTRY_DATA_BUF macro but this handles any
+ * associated alignment to the data in the entry.
+ *
+ * NOTE: we assume here that the data-alignment is > 0.
  *
  * RETURNS:
  *
- * A pointer to the new table structure which must be passed to
- * table_free to be deallocated.  On error a NULL is returned.
+ * Pointer to the data segment of the entry.
  *
  * ARGUMENTS:
  *
- * bucket_n - Number of buckets for the hash table.  Our current hash
- * value works best with base two numbers.  Set to 0 to take the
- * library default of 1024.
+ * table_p - Table associated with the entry.
  *
- * error_p - Pointer to an integer which, if not NULL, will contain a
- * table error code.
+ * entry_p - Entry whose data pointer we are determining.
  */
-table_t		*table_alloc(const unsigned int bucket_n, int *error_p)
+static	unsigned char	*entry_data_buf(const table_t *table_p,
+					const table_entry_t *entry_p)
 {
-  table_t	*table_p = NULL;
-  unsigned int	buck_n;
+  const unsigned char	*buf_p;
+  unsigned int		size, pad;
   
-  /* allocate a table structure */
-  table_p = malloc(sizeof(table_t));
-  if (table_p == NULL) {
-    SET_POINTER(error_p, TABLE_ERROR_ALLOC);
-    return NULL;
-  }
+  buf_p = entry_p->te_key_buf + entry_p->te_key_size;
   
-  if (bucket_n > 0) {
-    buck_n = bucket_n;
-  }
-  else {
-    buck_n = DEFAULT_SIZE;
-  }
+  /* we need the size of the space before the data */
+  size = sizeof(struct table_shell_st) + entry_p->te_key_size;
   
-  /* allocate the buckets which are NULLed */
-  table_p->ta_buckets = (table_entry_t **)calloc(buck_n,
-						 sizeof(table_entry_t *));
-  if (table_p->ta_buckets == NULL) {
-    SET_POINTER(error_p, TABLE_ERROR_ALLOC);
-    free(table_p);
-    return NULL;
+  /* add in our alignment */
+  pad = size & (table_p->ta_data_align - 1);
+  if (pad > 0) {
+    pad = table_p->ta_data_align - pad;
   }
   
-  /* initialize structure */
-  table_p->ta_magic = TABLE_MAGIC;
-  table_p->ta_flags = 0;
-  table_p->ta_bucket_n = buck_n;
-  table_p->ta_entry_n = 0;
-  table_p->ta_data_align = 0;
-  table_p->ta_linear.tl_magic = 0;
-  table_p->ta_linear.tl_bucket_c = 0;
-  table_p->ta_linear.tl_entry_c = 0;
-  table_p->ta_file_size = 0;
-  table_p->ta_mem_pool = NULL;
-  table_p->ta_alloc_func = NULL;
-  table_p->ta_resize_func = NULL;
-  table_p->ta_free_func = NULL;
-  
-  SET_POINTER(error_p, TABLE_ERROR_NONE);
-  return table_p;
+  return (unsigned char *)buf_p + pad;
 }
 
+/****************************** arena routines *******************************/
+
 /*
- * table_t *table_alloc_in_pool
+ * static arena_chunk_t *arena_chunk
  *
  * DESCRIPTION:
  *
- * Allocate a new table structure in a memory pool or using
- * alternative allocation and free functions.
+ * Allocate a new chunk of memory for an arena and add it to the
+ * arena's list of chunks.  If the arena wants huge pages then we map
+ * them directly if the system has some reserved otherwise we ask for
+ * transparent huge pages.
  *
  * RETURNS:
  *
- * A pointer to the new table structure which must be passed to
- * table_free to be deallocated.  On error a NULL is returned.
+ * Success - Pointer to the new chunk.
+ *
+ * Failure - NULL if we could not allocate the memory.
  *
  * ARGUMENTS:
  *
- * bucket_n - Number of buckets for the hash table.  Our current hash
- * value works best with base two numbers.  Set to 0 to take the
- * library default of 1024.
+ * arena_p - Arena we are allocating the chunk for.
  *
- * mem_pool <-> Memory pool to associate with the table.  Can be NULL.
- *
- * alloc_func -> Allocate function we are overriding malloc() with.
- *
- * resize_func -> Resize function we are overriding the standard
- * memory resize/realloc with.  This can be NULL in which cause the
- * library will allocate, copy, and free itself.
- *
- * free_func -> Free function we are overriding free() with.
- *
- * error_p - Pointer to an integer which, if not NULL, will contain a
- * table error code.
+ * size - Number of bytes that we need in the chunk.
  */
-table_t		*table_alloc_in_pool(const unsigned int bucket_n,
-				     void *mem_pool,
-				     table_mem_alloc_t alloc_func,
-				     table_mem_resize_t resize_func,
-				     table_mem_free_t free_func, int *error_p)
+static	arena_chunk_t	*arena_chunk(arena_t *arena_p, const size_t size)
 {
-  table_t	*table_p = NULL;
-  unsigned int	buck_n, size;
-  
-  /* make sure we have real functions, mem_pool and resize_func can be NULL */
-  if (alloc_func == NULL || free_func == NULL) {
-    SET_POINTER(error_p, TABLE_ERROR_ARG_NULL);
-    return NULL;
-  }
-  
-  /* allocate a table structure */
-  table_p = alloc_func(mem_pool, sizeof(table_t));
-  if (table_p == NULL) {
-    SET_POINTER(error_p, TABLE_ERROR_ALLOC);
-    return NULL;
-  }
-  
-  if (bucket_n > 0) {
-    buck_n = bucket_n;
-  }
-  else {
-    buck_n = DEFAULT_SIZE;
+  arena_chunk_t	*chunk_p = NULL;
+  size_t	total;
+  
+  total = ARENA_HEADER_SIZE + size;
+  
+#if !defined NO_MMAP && defined MAP_ANONYMOUS
+  if (arena_p->ar_huge_b) {
+    /* round up to a whole number of huge pages */
+    total = (total + ARENA_HUGE_SIZE - 1) & ~(size_t)(ARENA_HUGE_SIZE - 1);
+    chunk_p = (arena_chunk_t *)MAP_FAILED;
+#ifdef MAP_HUGETLB
+    chunk_p = (arena_chunk_t *)mmap(NULL, total, PROT_READ | PROT_WRITE,
+				    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+				    -1, 0);
+#endif
+    if (chunk_p == (arena_chunk_t *)MAP_FAILED) {
+      chunk_p = (arena_chunk_t *)mmap(NULL, total, PROT_READ | PROT_WRITE,
+				      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (chunk_p == (arena_chunk_t *)MAP_FAILED) {
+	return NULL;
+      }
+#ifdef MADV_HUGEPAGE
+      (void)madvise(chunk_p, total, MADV_HUGEPAGE);
+#endif
+    }
+    chunk_p->ac_mmap_b = 1;
   }
+#endif
   
-  /* allocate the buckets which are NULLed */
-  size = buck_n * sizeof(table_entry_t *);
-  table_p->ta_buckets = (table_entry_t **)alloc_func(mem_pool, size);
-  if (table_p->ta_buckets == NULL) {
-    SET_POINTER(error_p, TABLE_ERROR_ALLOC);
-    (void)free_func(mem_pool, table_p, sizeof(table_t));
-    return NULL;
+  if (chunk_p == NULL) {
+    chunk_p = (arena_chunk_t *)malloc(total);
+    if (chunk_p == NULL) {
+      return NULL;
+    }
+    chunk_p->ac_mmap_b = 0;
   }
-  /*
-   * We zero it ourselves to save the necessity of having a
-   * table_mem_calloc_t memory override function.
-   */
-  memset(table_p->ta_buckets, 0, size);
   
-  /* initialize structure */
-  table_p->ta_magic = TABLE_MAGIC;
-  table_p->ta_flags = 0;
-  table_p->ta_bucket_n = buck_n;
-  table_p->ta_entry_n = 0;
-  table_p->ta_data_align = 0;
-  table_p->ta_linear.tl_magic = 0;
-  table_p->ta_linear.tl_bucket_c = 0;
-  table_p->ta_linear.tl_entry_c = 0;
-  table_p->ta_file_size = 0;
-  table_p->ta_mem_pool = mem_pool;
-  table_p->ta_alloc_func = alloc_func;
-  table_p->ta_resize_func = resize_func;
-  table_p->ta_free_func = free_func;
+  chunk_p->ac_size = total;
+  chunk_p->ac_next_p = arena_p->ar_chunks;
+  arena_p->ar_chunks = chunk_p;
   
-  SET_POINTER(error_p, TABLE_ERROR_NONE);
-  return table_p;
+  return chunk_p;
 }
 
 /*
- * int table_attr
+ * static void *arena_alloc
  *
  * DESCRIPTION:
  *
- * Set the attributes for the table.  The available attributes are
- * specified at the top of table.h.
+ * Carve an allocation out of the current chunk of an arena, starting
+ * a new chunk if it does not fit.  Allocations which are a large part
+ * of a chunk get a chunk of their own so we don't waste the rest of
+ * the current one.
  *
  * RETURNS:
  *
- * Success - TABLE_ERROR_NONE
+ * Success - Pointer to the allocated memory.
  *
- * Failure - Table error code.
+ * Failure - NULL if we could not allocate a new chunk.
  *
  * ARGUMENTS:
  *
- * table_p - Pointer to a table structure which we will be altering.
+ * arena_p - Arena we are allocating from.
  *
- * attr - Attribute(s) that we will be applying to the table.
+ * size - Number of bytes to allocate.
  */
-int	table_attr(table_t *table_p, const int attr)
+static	void	*arena_alloc(arena_t *arena_p, const size_t size)
 {
-  if (table_p == NULL) {
-    return TABLE_ERROR_ARG_NULL;
+  arena_chunk_t	*chunk_p;
+  char		*mem_p;
+  
+  mem_p = ARENA_ALIGN(arena_p->ar_next_p, arena_p->ar_align);
+  if (mem_p != NULL && mem_p + size <= arena_p->ar_bounds_p) {
+    arena_p->ar_next_p = mem_p + size;
+    return mem_p;
   }
-  if (table_p->ta_magic != TABLE_MAGIC) {
-    return TABLE_ERROR_PNT;
+  
+  if (size + arena_p->ar_align > arena_p->ar_chunk_size / 4) {
+    /* big allocation gets its own chunk */
+    chunk_p = arena_chunk(arena_p, size + arena_p->ar_align);
+    if (chunk_p == NULL) {
+      return NULL;
+    }
+    return ARENA_ALIGN(ARENA_CHUNK_BUF(chunk_p), arena_p->ar_align);
   }
   
-  table_p->ta_flags = attr;
+  chunk_p = arena_chunk(arena_p, arena_p->ar_chunk_size);
+  if (chunk_p == NULL) {
+    return NULL;
+  }
+  mem_p = ARENA_ALIGN(ARENA_CHUNK_BUF(chunk_p), arena_p->ar_align);
+  arena_p->ar_next_p = mem_p + size;
+  arena_p->ar_bounds_p = (char *)chunk_p + chunk_p->ac_size;
   
-  return TABLE_ERROR_NONE;
+  return mem_p;
 }
 
 /*
- * int table_set_data_alignment
+ * static void arena_clear
  *
  * DESCRIPTION:
  *
- * Set the alignment for the data in the table.  This is used when you
- * want to store binary data types and refer to them directly out of
- * the table storage.  For instance if you are storing integers as
- * data in the table and want to be able to retrieve the location of
- * the interger and then increment it as (*loc_p)++.  Otherwise you
- * would have to memcpy it out to an integer, increment it, and memcpy
- * it back.  If you are storing character data, no alignment is
- * necessary.
+ * Free all of the chunks in an arena which frees all of the
+ * allocations in it at once.
  *
- * For most data elements, sizeof(long) is recommended unless you use
- * smaller data types exclusively.
+ * RETURNS:
  *
- * WARNING: If necessary, you must set the data alignment before any
- * data gets put into the table.  Otherwise a TABLE_ERROR_NOT_EMPTY
- * error will be returned.
+ * None.
  *
- * NOTE: there is no way to set the key data alignment although it
- * should automatically be long aligned.
+ * ARGUMENTS:
+ *
+ * arena_p - Arena we are clearing.
+ */
+static	void	arena_clear(arena_t *arena_p)
+{
+  arena_chunk_t	*chunk_p, *next_p;
+  
+  for (chunk_p = arena_p->ar_chunks; chunk_p != NULL; chunk_p = next_p) {
+    next_p = chunk_p->ac_next_p;
+#if !defined NO_MMAP && defined MAP_ANONYMOUS
+    if (chunk_p->ac_mmap_b) {
+      (void)munmap(chunk_p, chunk_p->ac_size);
+      continue;
+    }
+#endif
+    free(chunk_p);
+  }
+  
+  arena_p->ar_chunks = NULL;
+  arena_p->ar_next_p = NULL;
+  arena_p->ar_bounds_p = NULL;
+}
+
+/*
+ * static table_entry_t *entry_alloc
+ *
+ * DESCRIPTION:
+ *
+ * Allocate the space for an entry from the arena, the user's memory
+ * functions, or the heap.
  *
  * RETURNS:
  *
- * Success - TABLE_ERROR_NONE
+ * Success - Pointer to the new entry.
  *
- * Failure - Table error code.
+ * Failure - NULL
  *
  * ARGUMENTS:
  *
- * table_p - Pointer to a table structure which we will be altering.
+ * table_p - Table that the entry is for.
  *
- * alignment - Alignment requested for the data.  Must be a power of
- * 2.  Set to 0 for none.
+ * size - Size of the entry from entry_size.
  */
-int	table_set_data_alignment(table_t *table_p, const int alignment)
+static	table_entry_t	*entry_alloc(table_t *table_p, const unsigned int size)
 {
-  int		val;
-  
-  if (table_p == NULL) {
-    return TABLE_ERROR_ARG_NULL;
-  }
-  if (table_p->ta_magic != TABLE_MAGIC) {
-    return TABLE_ERROR_PNT;
-  }
-  if (table_p->ta_entry_n > 0) {
-    return TABLE_ERROR_NOT_EMPTY;
+  if (table_p->ta_arena != NULL) {
+    return (table_entry_t *)arena_alloc(table_p->ta_arena, size);
   }
-  
-  /* defaults */
-  if (alignment < 2) {
-    table_p->ta_data_align = 0;
+  else if (table_p->ta_alloc_func == NULL) {
+    return (table_entry_t *)malloc(size);
   }
   else {
-    /* verify we have a base 2 number */
-    for (val = 2; val < MAX_ALIGNMENT; val *= 2) {
-      if (val == alignment) {
-	break;
-      }
-    }
-    if (val >= MAX_ALIGNMENT) {
-      return TABLE_ERROR_ALIGNMENT;
-    }
-    table_p->ta_data_align = alignment;
+    return (table_entry_t *)table_p->ta_alloc_func(table_p->ta_mem_pool,
+						   size);
   }
-  
-  return TABLE_ERROR_NONE;
 }
 
 /*
- * int table_clear
+ * static int locks_free
  *
  * DESCRIPTION:
  *
- * Clear out and free all elements in a table structure.
+ * Destroy and free the locks of a concurrent table.
  *
  * RETURNS:
  *
@@ -1324,423 +1200,4598 @@ int	table_set_data_alignment(table_t *table_p, const int alignment)
  *
  * ARGUMENTS:
  *
- * table_p - Table structure pointer that we will be clearing.
+ * table_p - Table whose locks we are freeing.
  */
-int	table_clear(table_t *table_p)
+static	int	locks_free(table_t *table_p)
 {
-  int		final = TABLE_ERROR_NONE;
-  table_entry_t	*entry_p, *next_p;
-  table_entry_t	**bucket_p, **bounds_p;
+#ifndef NO_THREADS
+  table_locks_t	*locks_p = table_p->ta_locks;
+  unsigned int	stripe_c;
   
-  if (table_p == NULL) {
-    return TABLE_ERROR_ARG_NULL;
-  }
-  if (table_p->ta_magic != TABLE_MAGIC) {
-    return TABLE_ERROR_PNT;
+  if (locks_p == NULL) {
+    return TABLE_ERROR_NONE;
   }
   
-  /* free the table allocation and table structure */
-  bounds_p = table_p->ta_buckets + table_p->ta_bucket_n;
-  for (bucket_p = table_p->ta_buckets; bucket_p < bounds_p; bucket_p++) {
-    for (entry_p = *bucket_p; entry_p != NULL; entry_p = next_p) {
-      /* record the next pointer before we free */
-      next_p = entry_p->te_next_p;
-      if (table_p->ta_free_func == NULL) {
-	free(entry_p);
-      }
-      else if (! table_p->ta_free_func(table_p->ta_mem_pool, entry_p,
-				       entry_size(table_p,
-						  entry_p->te_key_size,
-						  entry_p->te_data_size))) {
-	final = TABLE_ERROR_FREE;
-      }
-    }
-    
-    /* clear the bucket entry after we free its entries */
-    *bucket_p = NULL;
+  for (stripe_c = 0; stripe_c < locks_p->lo_stripe_n; stripe_c++) {
+    (void)pthread_mutex_destroy(locks_p->lo_stripes + stripe_c);
   }
+  (void)pthread_mutex_destroy(&locks_p->lo_alloc_lock);
+  (void)pthread_rwlock_destroy(&locks_p->lo_grow_lock);
+  free(locks_p->lo_stripes);
+  free(locks_p);
+  table_p->ta_locks = NULL;
+#endif
   
-  /* reset table state info */
-  table_p->ta_entry_n = 0;
-  table_p->ta_linear.tl_magic = 0;
-  table_p->ta_linear.tl_bucket_c = 0;
-  table_p->ta_linear.tl_entry_c = 0;
-  
-  return final;
+  return TABLE_ERROR_NONE;
 }
 
+/*********************** open addressing routines ****************************/
+
 /*
- * int table_free
+ * static unsigned int group_match
  *
  * DESCRIPTION:
  *
- * Deallocates a table structure.
+ * Compare a group of control bytes against a value.
  *
  * RETURNS:
  *
- * Success - TABLE_ERROR_NONE
- *
- * Failure - Table error code.
+ * Bit mask with bit X set if control byte X of the group matches.
  *
  * ARGUMENTS:
  *
- * table_p - Table structure pointer that we will be freeing.
+ * ctrl_p -> Pointer to the OPEN_GROUP_SIZE control bytes of a group.
+ *
+ * val -> Control byte value we are looking for.
  */
-int	table_free(table_t *table_p)
+static	unsigned int	group_match(const unsigned char *ctrl_p,
+				    const unsigned char val)
 {
-  int	ret;
-  
-  if (table_p == NULL) {
-    return TABLE_ERROR_ARG_NULL;
-  }
-  if (table_p->ta_magic != TABLE_MAGIC) {
-    return TABLE_ERROR_PNT;
-  }
+#ifdef __SSE2__
+  __m128i	group;
   
-  ret = table_clear(table_p);
+  group = _mm_loadu_si128((const __m128i *)ctrl_p);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(val)));
+#else
+  unsigned int	mask = 0;
+  int		slot_c;
   
-  if (table_p->ta_buckets != NULL) {
-    if (table_p->ta_free_func == NULL) {
-      free(table_p->ta_buckets);
-    }
-    else if (! table_p->ta_free_func(table_p->ta_mem_pool,
-				     table_p->ta_buckets,
-				     table_p->ta_bucket_n *
-				     sizeof(table_entry_t *))) {
-      return TABLE_ERROR_FREE;
-    }
-  }
-  table_p->ta_magic = 0;
-  if (table_p->ta_free_func == NULL) {
-    free(table_p);
-  }
-  else if (! table_p->ta_free_func(table_p->ta_mem_pool, table_p,
-				   sizeof(table_t))) {
-    if (ret == TABLE_ERROR_NONE) {
-      ret = TABLE_ERROR_FREE;
+  for (slot_c = 0; slot_c < OPEN_GROUP_SIZE; slot_c++) {
+    if (ctrl_p[slot_c] == val) {
+      mask |= 1 << slot_c;
     }
   }
-  
-  return ret;
+  return mask;
+#endif
 }
 
 /*
- * int table_insert_kd
+ * static unsigned int group_free
  *
  * DESCRIPTION:
  *
- * Like table_insert except it passes back a pointer to the key and
- * the data buffers after they have been inserted into the table
- * structure.
- *
- * This routine adds a key/data pair both of which are made up of a
- * buffer of bytes and an associated size.  Both the key and the data
- * will be copied into buffers allocated inside the table.  If the key
- * exists already, the associated data will be replaced if the
- * overwrite flag is set, otherwise an error is returned.
- *
- * NOTE: be very careful changing the values since the table library
- * provides the pointers to its memory.  The key can _never_ be
- * changed otherwise you will not find it again.  The data can be
- * changed but its length can never be altered unless you delete and
- * re-insert it into the table.
- *
- * WARNING: The pointers to the key and data are not in any specific
- * alignment.  Accessing the key and/or data as an short, integer, or
- * long pointer directly can cause problems.
- *
- * WARNING: Replacing a data cell (not inserting) will cause the table
- * linked list to be temporarily invalid.  Care must be taken with
- * multiple threaded programs which are relying on the first/next
- * linked list to be always valid.
+ * Find the empty or deleted slots in a group.
  *
  * RETURNS:
  *
- * Success - TABLE_ERROR_NONE
+ * Bit mask with bit X set if slot X of the group has no entry.
  *
- * Failure - Table error code.
+ * ARGUMENTS:
+ *
+ * ctrl_p -> Pointer to the OPEN_GROUP_SIZE control bytes of a group.
+ */
+static	unsigned int	group_free(const unsigned char *ctrl_p)
+{
+#ifdef __SSE2__
+  /* free slots are the only ones with the high bit set */
+  return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl_p));
+#else
+  unsigned int	mask = 0;
+  int		slot_c;
+  
+  for (slot_c = 0; slot_c < OPEN_GROUP_SIZE; slot_c++) {
+    if (ctrl_p[slot_c] & 0x80) {
+      mask |= 1 << slot_c;
+    }
+  }
+  return mask;
+#endif
+}
+
+/*
+ * static int lowest_bit
+ *
+ * DESCRIPTION:
+ *
+ * Find the lowest set bit in a group mask.
+ *
+ * RETURNS:
+ *
+ * Position of the lowest set bit.
+ *
+ * ARGUMENTS:
+ *
+ * mask -> Group mask which must have at least one bit set.
+ */
+static	int	lowest_bit(const unsigned int mask)
+{
+#if defined __GNUC__
+  return __builtin_ctz(mask);
+#else
+  int	bit_c;
+  
+  for (bit_c = 0; (mask & (1 << bit_c)) == 0; bit_c++) {
+  }
+  return bit_c;
+#endif
+}
+
+/*
+ * static int open_find
+ *
+ * DESCRIPTION:
+ *
+ * Probe an open addressing table for a key.  We start at the group
+ * picked by the hash and compare the tags of a whole group of slots
+ * at once, only looking at the entries whose tags match.  A group
+ * with an empty slot ends the probing since the key would have been
+ * put there.
+ *
+ * RETURNS:
+ *
+ * Success - Slot number of the key's entry.
+ *
+ * Failure - -1 if the key is not in the table.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table we are searching.
+ *
+ * key_buf - Buffer of bytes of the key that we are looking for.
+ *
+ * key_size - Size of the key_buf buffer.
+ *
+ * hash_val - Full hash value of the key.
+ *
+ * free_p - Pointer to an integer which, if not NULL, will be set to
+ * the first free slot where the key can be inserted if not found.
+ */
+static	int	open_find(const table_t *table_p, const void *key_buf,
+			  const unsigned int key_size,
+			  const unsigned int hash_val, int *free_p)
+{
+  unsigned int	group, group_mask, step, mask;
+  int		slot;
+  unsigned char	*ctrl_p;
+  table_entry_t	*entry_p;
+  
+  if (free_p != NULL) {
+    *free_p = -1;
+  }
+  
+  group_mask = table_p->ta_bucket_n / OPEN_GROUP_SIZE - 1;
+  group = OPEN_GROUP(table_p, hash_val);
+  
+  /* triangular steps which visit every group once */
+  for (step = 1; step <= group_mask + 1; step++) {
+    ctrl_p = table_p->ta_ctrl + group * OPEN_GROUP_SIZE;
+    
+    /* look at the entries with our tag */
+    for (mask = group_match(ctrl_p, OPEN_TAG(hash_val));
+	 mask != 0;
+	 mask &= mask - 1) {
+      slot = group * OPEN_GROUP_SIZE + lowest_bit(mask);
+      
+      /* look at slot entries in place to save following the pointer */
+      entry_p = NULL;
+      if (table_p->ta_inline != NULL) {
+	entry_p = INLINE_ENTRY(table_p, slot);
+      }
+      if (entry_p == NULL || entry_p->te_key_size == 0) {
+	entry_p = table_p->ta_buckets[slot];
+      }
+      if (entry_p->te_hash == hash_val
+	  && entry_p->te_key_size == key_size
+	  && memcmp(ENTRY_KEY_BUF(entry_p), key_buf, key_size) == 0) {
+	return slot;
+      }
+    }
+    
+    /* record the first free slot in case we need to insert */
+    if (free_p != NULL && *free_p < 0) {
+      mask = group_free(ctrl_p);
+      if (mask != 0) {
+	*free_p = group * OPEN_GROUP_SIZE + lowest_bit(mask);
+      }
+    }
+    
+    /* an empty slot means the key would have stopped here */
+    if (group_match(ctrl_p, OPEN_EMPTY) != 0) {
+      break;
+    }
+    
+    group = (group + step) & group_mask;
+  }
+  
+  return -1;
+}
+
+/*
+ * static int inline_free
+ *
+ * DESCRIPTION:
+ *
+ * Free the slot entries of an open addressing table.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table whose slot entries we are freeing.
+ */
+static	int	inline_free(table_t *table_p)
+{
+  if (table_p->ta_inline == NULL) {
+    return TABLE_ERROR_NONE;
+  }
+  
+  if (table_p->ta_free_func == NULL) {
+    free(table_p->ta_inline);
+  }
+  else if (! table_p->ta_free_func(table_p->ta_mem_pool, table_p->ta_inline,
+				   table_p->ta_bucket_n *
+				   table_p->ta_inline_size)) {
+    return TABLE_ERROR_FREE;
+  }
+  table_p->ta_inline = NULL;
+  
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * static void open_arrays_free
+ *
+ * DESCRIPTION:
+ *
+ * Free the new slot arrays of an open_resize that could not finish.
+ * Either of them may be NULL.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table whose slots we were resizing.
+ *
+ * slots - New array of slot pointers or NULL.
+ *
+ * ctrl - New array of slot control bytes or NULL.
+ *
+ * size - Number of slots in the new arrays.
+ */
+static	void	open_arrays_free(table_t *table_p, table_entry_t **slots,
+				 unsigned char *ctrl, const unsigned int size)
+{
+  if (table_p->ta_free_func == NULL) {
+    free(slots);
+    free(ctrl);
+    return;
+  }
+  
+  if (slots != NULL) {
+    (void)table_p->ta_free_func(table_p->ta_mem_pool, slots,
+				size * sizeof(table_entry_t *));
+  }
+  if (ctrl != NULL) {
+    (void)table_p->ta_free_func(table_p->ta_mem_pool, ctrl, size);
+  }
+}
+
+/*
+ * static int open_resize
+ *
+ * DESCRIPTION:
+ *
+ * Reallocate the slots of an open addressing table and put the
+ * entries back into them using their stored hash values.  This also
+ * removes any deleted slots.  It is used to convert an empty table
+ * to open addressing as well.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table whose slots we are resizing.
+ *
+ * slot_n - Minimum number of slots to allocate.  It will be rounded
+ * up to a power of 2 with room for all of the entries.
+ */
+static	int	open_resize(table_t *table_p, const unsigned int slot_n)
+{
+  table_entry_t	**slots, **bucket_p, **bounds_p, *entry_p, *next_p;
+  unsigned char	*ctrl, *ctrl_p, *inline_p = NULL;
+  unsigned int	size, group, group_mask, step, mask;
+  unsigned long long	start;
+  int		slot, ret;
+  
+  start = usecs_now();
+  for (size = OPEN_MIN_SIZE;
+       size < slot_n || size / 8 * 7 < table_p->ta_entry_n;
+       size *= 2) {
+  }
+  
+  if (table_p->ta_alloc_func == NULL) {
+    slots = (table_entry_t **)malloc(size * sizeof(table_entry_t *));
+    ctrl = (unsigned char *)malloc(size);
+  }
+  else {
+    slots = (table_entry_t **)
+      table_p->ta_alloc_func(table_p->ta_mem_pool,
+			     size * sizeof(table_entry_t *));
+    ctrl = (unsigned char *)table_p->ta_alloc_func(table_p->ta_mem_pool,
+						   size);
+  }
+  if (slots == NULL || ctrl == NULL) {
+    open_arrays_free(table_p, slots, ctrl, size);
+    return TABLE_ERROR_ALLOC;
+  }
+  memset(slots, 0, size * sizeof(table_entry_t *));
+  memset(ctrl, OPEN_EMPTY, size);
+  
+  if (table_p->ta_inline_size > 0) {
+    if (table_p->ta_alloc_func == NULL) {
+      inline_p = (unsigned char *)malloc(size * table_p->ta_inline_size);
+    }
+    else {
+      inline_p = (unsigned char *)
+	table_p->ta_alloc_func(table_p->ta_mem_pool,
+			       size * table_p->ta_inline_size);
+    }
+    if (inline_p == NULL) {
+      open_arrays_free(table_p, slots, ctrl, size);
+      return TABLE_ERROR_ALLOC;
+    }
+  }
+  
+  /* put each entry into the first free slot along its probe path */
+  group_mask = size / OPEN_GROUP_SIZE - 1;
+  bounds_p = table_p->ta_buckets + table_p->ta_bucket_n;
+  for (bucket_p = table_p->ta_buckets; bucket_p < bounds_p; bucket_p++) {
+    for (entry_p = *bucket_p; entry_p != NULL; entry_p = next_p) {
+      next_p = entry_p->te_next_p;
+      group = (entry_p->te_hash >> 7) & group_mask;
+      for (step = 1; ; step++) {
+	ctrl_p = ctrl + group * OPEN_GROUP_SIZE;
+	mask = group_free(ctrl_p);
+	if (mask != 0) {
+	  break;
+	}
+	group = (group + step) & group_mask;
+      }
+      slot = group * OPEN_GROUP_SIZE + lowest_bit(mask);
+      ctrl[slot] = OPEN_TAG(entry_p->te_hash);
+      entry_p->te_next_p = NULL;
+      if (ENTRY_INLINE(table_p, entry_p)) {
+	/* the entry moves along with its slot */
+	memcpy(inline_p + slot * table_p->ta_inline_size, entry_p,
+	       table_p->ta_inline_size);
+	entry_p = (table_entry_t *)(inline_p + slot * table_p->ta_inline_size);
+      }
+      else if (inline_p != NULL) {
+	((table_entry_t *)(inline_p + slot * table_p->ta_inline_size))
+	  ->te_key_size = 0;
+      }
+      slots[slot] = entry_p;
+    }
+  }
+  
+  ret = inline_free(table_p);
+  if (ret != TABLE_ERROR_NONE) {
+    return ret;
+  }
+  
+  /* replace the old slots */
+  if (table_p->ta_free_func == NULL) {
+    free(table_p->ta_buckets);
+    if (table_p->ta_ctrl != NULL) {
+      free(table_p->ta_ctrl);
+    }
+  }
+  else {
+    if (! table_p->ta_free_func(table_p->ta_mem_pool, table_p->ta_buckets,
+				table_p->ta_bucket_n *
+				sizeof(table_entry_t *))) {
+      return TABLE_ERROR_FREE;
+    }
+    if (table_p->ta_ctrl != NULL
+	&& (! table_p->ta_free_func(table_p->ta_mem_pool, table_p->ta_ctrl,
+				    table_p->ta_bucket_n))) {
+      return TABLE_ERROR_FREE;
+    }
+  }
+  table_p->ta_buckets = slots;
+  table_p->ta_ctrl = ctrl;
+  table_p->ta_inline = inline_p;
+  table_p->ta_bucket_n = size;
+  table_p->ta_bucket_mask = size - 1;
+  table_p->ta_deleted_n = 0;
+  adjust_count(table_p, start);
+  
+  return TABLE_ERROR_NONE;
+}
+
+/******************************* insert routines *****************************/
+
+/*
+ * static int insert_hashed
+ *
+ * DESCRIPTION:
+ *
+ * Add a key/data pair to a table whose key has already been hashed.
+ * This is the guts of table_insert_kd which is where the arguments
+ * are checked.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.  TABLE_ERROR_OVERWRITE if the key
+ * already exists and overwrite_b is not set unless created_bp is
+ * passed in.
  *
  * ARGUMENTS:
  *
  * table_p - Table structure pointer into which we will be inserting a
  * new key/data pair.
  *
- * key_buf - Buffer of bytes of the key that we are inserting.  If you
- * are storing an (int) as the key (for example) then key_buf should
- * be a (int *).
+ * key_buf - Buffer of bytes of the key that we are inserting.
  *
- * key_size - Size of the key_buf buffer.  If set to < 0 then the
- * library will do a strlen of key_buf and add 1 for the '\0'.  If you
- * are storing an (int) as the key (for example) then key_size should
- * be sizeof(int).
+ * ksize - Size of the key_buf buffer.
  *
- * data_buf - Buffer of bytes of the data that we are inserting.  If
- * it is NULL then the library will allocate space for the data in the
- * table without copying in any information.  If data_buf is NULL and
- * data_size is 0 then the library will associate a NULL data pointer
- * with the key.  If you are storing a (long) as the data (for
- * example) then data_buf should be a (long *).
+ * hash_val - Full hash value of the key.
  *
- * data_size - Size of the data_buf buffer.  If set to < 0 then the
- * library will do a strlen of data_buf and add 1 for the '\0'.  If
- * you are storing an (long) as the key (for example) then key_size
- * should be sizeof(long).
+ * data_buf - Buffer of bytes of the data that we are inserting or
+ * NULL to not copy in any information.
+ *
+ * dsize - Size of the data.
  *
  * key_buf_p - Pointer which, if not NULL, will be set to the address
- * of the key storage that was allocated in the table.  If you are
- * storing an (int) as the key (for example) then key_buf_p should be
- * (int **) i.e. the address of a (int *).
+ * of the key storage in the table.
  *
  * data_buf_p - Pointer which, if not NULL, will be set to the address
- * of the data storage that was allocated in the table.  If you are
- * storing an (long) as the data (for example) then data_buf_p should
- * be (long **) i.e. the address of a (long *).
+ * of the data storage in the table.
  *
- * overwrite - Flag which, if set to 1, will allow the overwriting of
+ * overwrite_b - Flag which, if set to 1, will allow the overwriting of
  * the data in the table with the new data if the key already exists
  * in the table.
+ *
+ * created_bp - Pointer to an integer which, if not NULL, will be set
+ * to 1 if the key was added or 0 if it was already in the table.  An
+ * existing key is then not an error.
  */
-int	table_insert_kd(table_t *table_p,
-			const void *key_buf, const int key_size,
-			const void *data_buf, const int data_size,
-			void **key_buf_p, void **data_buf_p,
-			const char overwrite_b)
+static	int	insert_hashed(table_t *table_p, const void *key_buf,
+			      const unsigned int ksize,
+			      const unsigned int hash_val,
+			      const void *data_buf, const unsigned int dsize,
+			      void **key_buf_p, void **data_buf_p,
+			      const char overwrite_b, int *created_bp)
+{
+  int		bucket, slot, ret;
+  unsigned int	new_size, old_size, copy_size;
+  table_entry_t	*entry_p, *last_p, *new_entry_p, **bucket_p;
+  void		*key_copy_p, *data_copy_p;
+  
+  last_p = NULL;
+  
+  if (table_p->ta_flags & TABLE_FLAG_OPEN_ADDRESS) {
+    /*
+     * The slot works as a bucket with a single entry.  If not found
+     * then the bucket is the free slot where we will insert.
+     */
+    slot = open_find(table_p, key_buf, ksize, hash_val, &bucket);
+    
+    /*
+     * Grow before we add a new entry since growing moves the entries
+     * in the slots and we are about to return pointers into ours.
+     */
+    if (slot < 0
+	&& table_p->ta_ctrl[bucket] == OPEN_EMPTY
+	&& SHOULD_OPEN_GROW(table_p)) {
+      ret = open_resize(table_p, (table_p->ta_entry_n + 1) * 2);
+      if (ret != TABLE_ERROR_NONE) {
+	return ret;
+      }
+      slot = open_find(table_p, key_buf, ksize, hash_val, &bucket);
+    }
+    
+    if (slot < 0) {
+      entry_p = NULL;
+    }
+    else {
+      bucket = slot;
+      entry_p = table_p->ta_buckets[bucket];
+    }
+    bucket_p = table_p->ta_buckets + bucket;
+  }
+  else {
+    /* give the incremental growing a push */
+    if (table_p->ta_old_buckets != NULL) {
+      ret = migrate_buckets(table_p, MIGRATE_BUCKET_N);
+      if (ret != TABLE_ERROR_NONE) {
+	return ret;
+      }
+    }
+    bucket_p = bucket_head(table_p, hash_val);
+    
+    /* look for the entry in this bucket, only check keys of the same hash */
+    for (entry_p = *bucket_p;
+	 entry_p != NULL;
+	 last_p = entry_p, entry_p = entry_p->te_next_p) {
+      if (entry_p->te_hash == hash_val
+	  && entry_p->te_key_size == ksize
+	  && memcmp(ENTRY_KEY_BUF(entry_p), key_buf, ksize) == 0) {
+	break;
+      }
+    }
+  }
+  
+  /* did we find it?  then we are in replace mode. */
+  if (entry_p != NULL) {
+    
+    /* can we not overwrite existing data? */
+    if (! overwrite_b) {
+      SET_POINTER(key_buf_p, ENTRY_KEY_BUF(entry_p));
+      if (data_buf_p != NULL) {
+	if (entry_p->te_data_size == 0) {
+	  *data_buf_p = NULL;
+	}
+	else {
+	  if (table_p->ta_data_align == 0) {
+	    *data_buf_p = ENTRY_DATA_BUF(table_p, entry_p);
+	  }
+	  else {
+	    *data_buf_p = entry_data_buf(table_p, entry_p);
+	  }
+	}
+      }
+      if (created_bp != NULL) {
+	*created_bp = 0;
+	return TABLE_ERROR_NONE;
+      }
+      return TABLE_ERROR_OVERWRITE;
+    }
+    
+    /* re-alloc entry's data if the new size != the old */
+    if (dsize != entry_p->te_data_size) {
+      
+      /*
+       * First we delete it from the list to keep the list whole.
+       * This properly preserves the linked list in case we have a
+       * thread marching through the linked list while we are
+       * inserting.  Maybe this is an unnecessary protection but it
+       * should not harm that much.
+       */
+      if (last_p == NULL) {
+	*bucket_p = entry_p->te_next_p;
+      }
+      else {
+	last_p->te_next_p = entry_p->te_next_p;
+      }
+      
+      /*
+       * Realloc the structure which may change its pointer. NOTE:
+       * this may change any previous data_key_p and data_copy_p
+       * pointers.
+       */
+      new_size = entry_size(table_p, entry_p->te_key_size, dsize);
+      if (ENTRY_INLINE(table_p, entry_p)) {
+	/* move it out of its slot if it no longer fits */
+	if (new_size > table_p->ta_inline_size) {
+	  old_size = new_size - dsize + entry_p->te_data_size;
+	  new_entry_p = entry_alloc(table_p, new_size);
+	  if (new_entry_p == NULL) {
+	    return TABLE_ERROR_ALLOC;
+	  }
+	  memcpy(new_entry_p, entry_p, old_size);
+	  /* mark the slot as no longer holding the entry */
+	  entry_p->te_key_size = 0;
+	  entry_p = new_entry_p;
+	}
+      }
+      else if (table_p->ta_arena != NULL) {
+	/* the old entry's space is reclaimed when the arena is cleared */
+	old_size = new_size - dsize + entry_p->te_data_size;
+	new_entry_p = (table_entry_t *)arena_alloc(table_p->ta_arena,
+						   new_size);
+	if (new_entry_p == NULL) {
+	  return TABLE_ERROR_ALLOC;
+	}
+	if (new_size > old_size) {
+	  copy_size = old_size;
+	}
+	else {
+	  copy_size = new_size;
+	}
+	memcpy(new_entry_p, entry_p, copy_size);
+	entry_p = new_entry_p;
+      }
+      else if (table_p->ta_resize_func == NULL) {
+	/* if the alloc function has not been overriden do realloc */
+	if (table_p->ta_alloc_func == NULL) {
+	  entry_p = (table_entry_t *)realloc(entry_p, new_size);
+	  if (entry_p == NULL) {
+	    return TABLE_ERROR_ALLOC;
+	  }
+	}
+	else {
+	  old_size = new_size - dsize + entry_p->te_data_size;
+	  /*
+	   * if the user did override alloc but not resize, assume
+	   * that the user's allocation functions can't grok realloc
+	   * and do it ourselves the hard way.
+	   */
+	  new_entry_p =
+	    (table_entry_t *)table_p->ta_alloc_func(table_p->ta_mem_pool,
+						    new_size);
+	  if (new_entry_p == NULL) {
+	    return TABLE_ERROR_ALLOC;
+	  }
+	  if (new_size > old_size) {
+	    copy_size = old_size;
+	  }
+	  else {
+	    copy_size = new_size;
+	  }
+	  memcpy(new_entry_p, entry_p, copy_size);
+	  if (! table_p->ta_free_func(table_p->ta_mem_pool, entry_p,
+				      old_size)) {
+	    return TABLE_ERROR_FREE;
+	  }
+	  entry_p = new_entry_p;
+	}
+      }
+      else {
+	old_size = new_size - dsize + entry_p->te_data_size;
+	entry_p = (table_entry_t *)
+	  table_p->ta_resize_func(table_p->ta_mem_pool, entry_p,
+				  old_size, new_size);
+	if (entry_p == NULL) {
+	  return TABLE_ERROR_ALLOC;
+	}
+      }
+      
+      /* add it back to the front of the list */
+      entry_p->te_data_size = dsize;
+      entry_p->te_next_p = *bucket_p;
+      *bucket_p = entry_p;
+    }
+    
+    /* copy or replace data in storage */
+    if (dsize > 0) {
+      if (table_p->ta_data_align == 0) {
+	data_copy_p = ENTRY_DATA_BUF(table_p, entry_p);
+      }
+      else {
+	data_copy_p = entry_data_buf(table_p, entry_p);
+      }
+      if (data_buf != NULL) {
+	memcpy(data_copy_p, data_buf, dsize);
+      }
+    }
+    else {
+      data_copy_p = NULL;
+    }
+    
+    SET_POINTER(key_buf_p, ENTRY_KEY_BUF(entry_p));
+    SET_POINTER(data_buf_p, data_copy_p);
+    
+    /* returning from the section where we were overwriting table data */
+    return TABLE_ERROR_NONE;
+  }
+  
+  /*
+   * It is a new entry.
+   */
+  
+  /* allocate a new entry or use its slot if it fits */
+  new_size = entry_size(table_p, ksize, dsize);
+  if (table_p->ta_inline != NULL && new_size <= table_p->ta_inline_size) {
+    entry_p = INLINE_ENTRY(table_p, bucket);
+  }
+  else {
+    entry_p = entry_alloc(table_p, new_size);
+    if (table_p->ta_inline != NULL) {
+      INLINE_ENTRY(table_p, bucket)->te_key_size = 0;
+    }
+  }
+  if (entry_p == NULL) {
+    return TABLE_ERROR_ALLOC;
+  }
+  
+  /* copy key into storage */
+  entry_p->te_key_size = ksize;
+  entry_p->te_hash = hash_val;
+  key_copy_p = ENTRY_KEY_BUF(entry_p);
+  memcpy(key_copy_p, key_buf, ksize);
+  
+  /* copy data in */
+  entry_p->te_data_size = dsize;
+  if (dsize > 0) {
+    if (table_p->ta_data_align == 0) {
+      data_copy_p = ENTRY_DATA_BUF(table_p, entry_p);
+    }
+    else {
+      data_copy_p = entry_data_buf(table_p, entry_p);
+    }
+    if (data_buf != NULL) {
+      memcpy(data_copy_p, data_buf, dsize);
+    }
+  }
+  else {
+    data_copy_p = NULL;
+  }
+  
+  SET_POINTER(key_buf_p, key_copy_p);
+  SET_POINTER(data_buf_p, data_copy_p);
+  SET_POINTER(created_bp, 1);
+  
+  /* insert into list, no need to append */
+  entry_p->te_next_p = *bucket_p;
+  *bucket_p = entry_p;
+  
+  table_p->ta_entry_n++;
+  
+  if (table_p->ta_flags & TABLE_FLAG_OPEN_ADDRESS) {
+    if (table_p->ta_ctrl[bucket] == OPEN_DELETED) {
+      table_p->ta_deleted_n--;
+    }
+    table_p->ta_ctrl[bucket] = OPEN_TAG(hash_val);
+    return TABLE_ERROR_NONE;
+  }
+  
+  /* do we need auto-adjust? */
+  if ((table_p->ta_flags & TABLE_FLAG_AUTO_ADJUST)
+      && SHOULD_TABLE_GROW(table_p)) {
+    if (table_p->ta_flags & TABLE_FLAG_INCREMENTAL) {
+      return migrate_start(table_p, table_p->ta_entry_n);
+    }
+    return table_adjust(table_p, table_p->ta_entry_n);
+  }
+  
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * static void prefetch_bucket
+ *
+ * DESCRIPTION:
+ *
+ * Start loading the memory where a key would be found into the cache
+ * so the misses of a batch of keys overlap instead of each insert
+ * waiting for its own.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table that we are going to insert the key into.
+ *
+ * hash_val - Full hash value of the key.
+ */
+static	void	prefetch_bucket(const table_t *table_p,
+				const unsigned int hash_val)
+{
+  unsigned int	slot;
+  
+  if (table_p->ta_flags & TABLE_FLAG_OPEN_ADDRESS) {
+    /* the tags of the first group and the slots that go with them */
+    slot = OPEN_GROUP(table_p, hash_val) * OPEN_GROUP_SIZE;
+    PREFETCH(table_p->ta_ctrl + slot);
+    if (table_p->ta_inline == NULL) {
+      PREFETCH(table_p->ta_buckets + slot);
+    }
+    else {
+      PREFETCH(INLINE_ENTRY(table_p, slot));
+    }
+  }
+  else {
+    PREFETCH(bucket_head(table_p, hash_val));
+  }
+}
+
+/******************************* file routines *******************************/
+
+/*
+ * static unsigned int file_checksum
+ *
+ * DESCRIPTION:
+ *
+ * Checksum part of a table file.  The buffer is hashed in blocks of
+ * FILE_BLOCK_SIZE so the file can be checksummed a block at a time as
+ * it is written.
+ *
+ * RETURNS:
+ *
+ * The checksum of the file up to the end of the buffer.
+ *
+ * ARGUMENTS:
+ *
+ * buf - Buffer of the file that we are checksumming.
+ *
+ * size - Number of bytes in the buffer.
+ *
+ * sum - Checksum of the file before the buffer or 0 at the start.
+ */
+static	unsigned int	file_checksum(const unsigned char *buf,
+				      unsigned long long size, unsigned int sum)
+{
+  unsigned int	len;
+  
+  for (; size > 0; buf += len, size -= len) {
+    if (size > FILE_BLOCK_SIZE) {
+      len = FILE_BLOCK_SIZE;
+    }
+    else {
+      len = size;
+    }
+    sum = hash(buf, len, sum);
+  }
+  
+  return sum;
+}
+
+/*
+ * static unsigned int file_header_checksum
+ *
+ * DESCRIPTION:
+ *
+ * Add the header of a table file to the checksum of the rest of the
+ * file so a change to its flags, sizes, or offsets is caught too.
+ * The header is checksummed with its tf_checksum as 0.
+ *
+ * RETURNS:
+ *
+ * The checksum of the whole file.
+ *
+ * ARGUMENTS:
+ *
+ * header_p - Header of the file.
+ *
+ * sum - Checksum of the file after the header.
+ */
+static	unsigned int	file_header_checksum(const table_file_t *header_p,
+					     const unsigned int sum)
+{
+  table_file_t	header;
+  
+  header = *header_p;
+  header.tf_checksum = 0;
+  return file_checksum((unsigned char *)&header, sizeof(header), sum);
+}
+
+/*
+ * static int file_flush
+ *
+ * DESCRIPTION:
+ *
+ * Checksum and write out the bytes waiting in a file write buffer.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * write_p - Write buffer that we are flushing.
+ */
+static	int	file_flush(file_write_t *write_p)
+{
+  unsigned char	*buf_p, *bounds_p;
+  int		ret;
+  
+  write_p->fw_sum = file_checksum(write_p->fw_buf, write_p->fw_len,
+				  write_p->fw_sum);
+  
+  bounds_p = write_p->fw_buf + write_p->fw_len;
+  for (buf_p = write_p->fw_buf; buf_p < bounds_p; buf_p += ret) {
+    ret = write(write_p->fw_fd, buf_p, bounds_p - buf_p);
+    if (ret <= 0) {
+      return TABLE_ERROR_WRITE;
+    }
+  }
+  write_p->fw_len = 0;
+  
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * static int file_write
+ *
+ * DESCRIPTION:
+ *
+ * Add bytes to a file write buffer, flushing each block as it fills.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * write_p - Write buffer that we are adding to.
+ *
+ * buf - Bytes that we are writing or NULL to write 0s for padding.
+ *
+ * size - Number of bytes that we are writing.
+ */
+static	int	file_write(file_write_t *write_p, const void *buf,
+			   unsigned int size)
+{
+  const unsigned char	*buf_p = (const unsigned char *)buf;
+  unsigned int		len;
+  int			ret;
+  
+  while (size > 0) {
+    len = FILE_BLOCK_SIZE - write_p->fw_len;
+    if (len > size) {
+      len = size;
+    }
+    if (buf_p == NULL) {
+      memset(write_p->fw_buf + write_p->fw_len, 0, len);
+    }
+    else {
+      memcpy(write_p->fw_buf + write_p->fw_len, buf_p, len);
+      buf_p += len;
+    }
+    write_p->fw_len += len;
+    size -= len;
+  
+    if (write_p->fw_len == FILE_BLOCK_SIZE) {
+      ret = file_flush(write_p);
+      if (ret != TABLE_ERROR_NONE) {
+	return ret;
+      }
+    }
+  }
+  
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * static void file_sort
+ *
+ * DESCRIPTION:
+ *
+ * Count the entries in a range of buckets by the file directory
+ * bucket that they go in.  Once the counts have been turned into the
+ * position of each directory bucket's first entry, this is called
+ * again to put the entries in directory order.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * bucket_p - First of the buckets or slots.
+ *
+ * bounds_p - Just past the last of the buckets or slots.
+ *
+ * bucket_n - Number of directory buckets which is 2^X.
+ *
+ * counts - Counts or positions of the directory buckets.
+ *
+ * entries - Array of entries that we are filling or NULL to count.
+ */
+static	void	file_sort(table_entry_t **bucket_p, table_entry_t **bounds_p,
+			  const unsigned int bucket_n, unsigned int *counts,
+			  table_entry_t **entries)
+{
+  table_entry_t	*entry_p;
+  unsigned int	bucket, mask;
+  
+  mask = BUCKET_MASK(bucket_n);
+  for (; bucket_p < bounds_p; bucket_p++) {
+    for (entry_p = *bucket_p; entry_p != NULL; entry_p = entry_p->te_next_p) {
+      bucket = bucket_index(entry_p->te_hash, bucket_n, mask);
+      if (entries == NULL) {
+	counts[bucket]++;
+      }
+      else {
+	entries[counts[bucket]++] = entry_p;
+      }
+    }
+  }
+}
+
+/*
+ * static int file_write_entries
+ *
+ * DESCRIPTION:
+ *
+ * Write the directory and the entries of a table to its file after
+ * the header.  The checksum of the header and the rest of the file is
+ * added to the header.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table that we are writing.
+ *
+ * fd - File that we are writing to.
+ *
+ * header_p - Header of the file which has been laid out.
+ *
+ * offsets - Directory of the file offsets of the buckets.
+ *
+ * entries - Entries of the table in directory order.
+ */
+static	int	file_write_entries(const table_t *table_p, const int fd,
+				   table_file_t *header_p,
+				   table_entry_t **offsets, table_entry_t **entries)
+{
+  file_write_t		*write_p;
+  table_shell_t		shell;
+  table_entry_t		*entry_p;
+  unsigned char		*data_p;
+  unsigned long long	offset, size;
+  unsigned int		mask, align, entry_c;
+  int			ret;
+  
+  /* too big for the stack */
+  write_p = (file_write_t *)malloc(sizeof(file_write_t));
+  if (write_p == NULL) {
+    return TABLE_ERROR_ALLOC;
+  }
+  write_p->fw_fd = fd;
+  write_p->fw_sum = 0;
+  write_p->fw_len = 0;
+  
+  mask = BUCKET_MASK(header_p->tf_bucket_n);
+  align = FILE_ALIGN(table_p);
+  offset = sizeof(table_file_t) + header_p->tf_bucket_n * sizeof(*offsets);
+  
+  ret = file_write(write_p, offsets, offset - sizeof(table_file_t));
+  if (ret == TABLE_ERROR_NONE) {
+    ret = file_write(write_p, NULL, header_p->tf_entries_off - offset);
+  }
+  offset = header_p->tf_entries_off;
+  
+  for (entry_c = 0;
+       entry_c < header_p->tf_entry_n && ret == TABLE_ERROR_NONE;
+       entry_c++) {
+    entry_p = entries[entry_c];
+    size = FILE_ROUND(entry_size(table_p, entry_p->te_key_size,
+				 entry_p->te_data_size), align);
+  
+    /* the next entry in the bucket is stored as its file offset */
+    memset(&shell, 0, sizeof(shell));
+    shell.te_key_size = entry_p->te_key_size;
+    shell.te_data_size = entry_p->te_data_size;
+    shell.te_hash = entry_p->te_hash;
+    if (entry_c + 1 < header_p->tf_entry_n
+	&& bucket_index(entries[entry_c + 1]->te_hash, header_p->tf_bucket_n,
+			mask)
+	== bucket_index(entry_p->te_hash, header_p->tf_bucket_n, mask)) {
+      shell.te_next_p = (struct table_shell_st *)(size_t)(offset + size);
+    }
+    else {
+      shell.te_next_p = NULL;
+    }
+  
+    /* write the padding as 0s so the same table makes the same file */
+    if (table_p->ta_data_align == 0) {
+      data_p = ENTRY_DATA_BUF(table_p, entry_p);
+    }
+    else {
+      data_p = entry_data_buf(table_p, entry_p);
+    }
+    ret = file_write(write_p, &shell, sizeof(shell));
+    if (ret == TABLE_ERROR_NONE) {
+      ret = file_write(write_p, ENTRY_KEY_BUF(entry_p), entry_p->te_key_size);
+    }
+    if (ret == TABLE_ERROR_NONE) {
+      ret = file_write(write_p, NULL,
+		       data_p - ENTRY_KEY_BUF(entry_p) - entry_p->te_key_size);
+    }
+    if (ret == TABLE_ERROR_NONE) {
+      ret = file_write(write_p, data_p, entry_p->te_data_size);
+    }
+    if (ret == TABLE_ERROR_NONE) {
+      ret = file_write(write_p, NULL, size - (data_p - (unsigned char *)entry_p)
+		       - entry_p->te_data_size);
+    }
+    offset += size;
+  }
+  
+  if (ret == TABLE_ERROR_NONE) {
+    ret = file_flush(write_p);
+  }
+  header_p->tf_checksum = file_header_checksum(header_p, write_p->fw_sum);
+  
+  free(write_p);
+  return ret;
+}
+
+/*
+ * static int file_read
+ *
+ * DESCRIPTION:
+ *
+ * Read a number of bytes from a table file.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * fd - File that we are reading from.
+ *
+ * buf - Buffer that we are reading into.
+ *
+ * size - Number of bytes that we must read.
+ */
+static	int	file_read(const int fd, void *buf, unsigned long long size)
+{
+  unsigned char	*buf_p = (unsigned char *)buf;
+  int		ret;
+  
+  for (; size > 0; buf_p += ret, size -= ret) {
+    if (size > FILE_BLOCK_SIZE) {
+      ret = read(fd, buf_p, FILE_BLOCK_SIZE);
+    }
+    else {
+      ret = read(fd, buf_p, size);
+    }
+    if (ret < 0) {
+      return TABLE_ERROR_READ;
+    }
+    /* a file that ends early is not one of ours */
+    if (ret == 0) {
+      return TABLE_ERROR_FILE;
+    }
+  }
+  
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * static int file_header_check
+ *
+ * DESCRIPTION:
+ *
+ * Make sure that a header read from a file is from a table file that
+ * we can use.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * header_p - Header that we are checking.
+ */
+static	int	file_header_check(const table_file_t *header_p)
+{
+  unsigned long long	dir_size;
+  
+  /* the file must be from a system with the same byte order and pointers */
+  if (header_p->tf_magic != TABLE_FILE_MAGIC
+      || header_p->tf_version != TABLE_FILE_VERSION
+      || header_p->tf_pointer_size != sizeof(table_entry_t *)) {
+    return TABLE_ERROR_FILE;
+  }
+  
+  dir_size = (unsigned long long)header_p->tf_bucket_n
+    * sizeof(table_entry_t *);
+  if (header_p->tf_bucket_n == 0
+      || (header_p->tf_bucket_n & (header_p->tf_bucket_n - 1)) != 0
+      || (header_p->tf_data_align & (header_p->tf_data_align - 1)) != 0
+      || header_p->tf_data_align > MAX_ALIGNMENT
+      || header_p->tf_entries_off < sizeof(table_file_t) + dir_size
+      || header_p->tf_file_size < header_p->tf_entries_off) {
+    return TABLE_ERROR_FILE;
+  }
+  
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * static int file_insert_entries
+ *
+ * DESCRIPTION:
+ *
+ * Insert the entries read from a table file into a table.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table that we are inserting into.
+ *
+ * header_p - Header of the file.
+ *
+ * buf - The file after the header.
+ */
+static	int	file_insert_entries(table_t *table_p,
+				    const table_file_t *header_p,
+				    const unsigned char *buf)
+{
+  table_entry_t		*entry_p;
+  void			*data_p;
+  unsigned long long	offset, size, left;
+  unsigned int		align, entry_c;
+  int			ret;
+  
+  align = FILE_ALIGN(table_p);
+  entry_c = 0;
+  for (offset = header_p->tf_entries_off;
+       offset < header_p->tf_file_size;
+       offset += size) {
+    entry_p = (table_entry_t *)(buf + offset - sizeof(table_file_t));
+  
+    /* make sure that the entry is all in the file */
+    left = header_p->tf_file_size - offset;
+    if (left < sizeof(table_shell_t)
+	|| entry_p->te_key_size > left
+	|| entry_p->te_data_size > left) {
+      return TABLE_ERROR_FILE;
+    }
+    size = FILE_ROUND(entry_size(table_p, entry_p->te_key_size,
+				 entry_p->te_data_size), align);
+    if (size > left) {
+      return TABLE_ERROR_FILE;
+    }
+  
+    if (entry_p->te_data_size == 0) {
+      data_p = NULL;
+    }
+    else if (table_p->ta_data_align == 0) {
+      data_p = ENTRY_DATA_BUF(table_p, entry_p);
+    }
+    else {
+      data_p = entry_data_buf(table_p, entry_p);
+    }
+    ret = insert_hashed(table_p, ENTRY_KEY_BUF(entry_p), entry_p->te_key_size,
+			entry_p->te_hash, data_p, entry_p->te_data_size,
+			NULL, NULL, 0, NULL);
+    if (ret != TABLE_ERROR_NONE) {
+      return ret;
+    }
+    entry_c++;
+  }
+  
+  if (entry_c != header_p->tf_entry_n) {
+    return TABLE_ERROR_FILE;
+  }
+  
+  return TABLE_ERROR_NONE;
+}
+
+/******************************* sort routines *******************************/
+
+/*
+ * static int local_compare
+ *
+ * DESCRIPTION:
+ *
+ * Compare two entries by calling user's compare program or by using
+ * memcmp.
+ *
+ * RETURNS:
+ *
+ * < 0, == 0, or > 0 depending on whether p1 is > p2, == p2, < p2.
+ *
+ * ARGUMENTS:
+ *
+ * p1 - First entry pointer to compare.
+ *
+ * p2 - Second entry pointer to compare.
+ *
+ * compare - User comparison function.  Ignored.
+ *
+ * table_p - Associated table being ordered.  Ignored.
+ *
+ * err_bp - Pointer to an integer which will be set with 1 if an error
+ * has occurred.  It cannot be NULL.
+ */
+static int	local_compare(const void *p1, const void *p2,
+			      table_compare_t compare, const table_t *table_p,
+			      int *err_bp)
+{
+  const table_entry_t	* const *ent1_p = p1, * const *ent2_p = p2;
+  int			cmp;
+  unsigned int		size;
+  
+  /* compare as many bytes as we can */
+  size = (*ent1_p)->te_key_size;
+  if ((*ent2_p)->te_key_size < size) {
+    size = (*ent2_p)->te_key_size;
+  }
+  cmp = memcmp(ENTRY_KEY_BUF(*ent1_p), ENTRY_KEY_BUF(*ent2_p), size);
+  /* if common-size equal, then if next more bytes, it is larger */
+  if (cmp == 0) {
+    cmp = (*ent1_p)->te_key_size - (*ent2_p)->te_key_size;
+  }
+  
+  *err_bp = 0;
+  return cmp;
+}
+
+/*
+ * static int local_compare_pos
+ *
+ * DESCRIPTION:
+ *
+ * Compare two entries by calling user's compare program or by using
+ * memcmp.
+ *
+ * RETURNS:
+ *
+ * < 0, == 0, or > 0 depending on whether p1 is > p2, == p2, < p2.
+ *
+ * ARGUMENTS:
+ *
+ * p1 - First entry pointer to compare.
+ *
+ * p2 - Second entry pointer to compare.
+ *
+ * compare - User comparison function.  Ignored.
+ *
+ * table_p - Associated table being ordered.
+ *
+ * err_bp - Pointer to an integer which will be set with 1 if an error
+ * has occurred.  It cannot be NULL.
+ */
+static int	local_compare_pos(const void *p1, const void *p2,
+				  table_compare_t compare,
+				  const table_t *table_p, int *err_bp)
+{
+  const table_linear_t	*lin1_p = p1, *lin2_p = p2;
+  const table_entry_t	*ent1_p, *ent2_p;
+  int			cmp, ret;
+  unsigned int		size;
+  
+  /* get entry pointers */
+  ent1_p = this_entry(table_p, lin1_p, &ret);
+  ent2_p = this_entry(table_p, lin2_p, &ret);
+  if (ent1_p == NULL || ent2_p == NULL) {
+    *err_bp = 1;
+    return 0;
+  }
+  
+  /* compare as many bytes as we can */
+  size = ent1_p->te_key_size;
+  if (ent2_p->te_key_size < size) {
+    size = ent2_p->te_key_size;
+  }
+  cmp = memcmp(ENTRY_KEY_BUF(ent1_p), ENTRY_KEY_BUF(ent2_p), size);
+  /* if common-size equal, then if next more bytes, it is larger */
+  if (cmp == 0) {
+    cmp = ent1_p->te_key_size - ent2_p->te_key_size;
+  }
+  
+  *err_bp = 0;
+  return cmp;
+}
+
+/*
+ * static int external_compare
+ *
+ * DESCRIPTION:
+ *
+ * Compare two entries by calling user's compare program or by using
+ * memcmp.
+ *
+ * RETURNS:
+ *
+ * < 0, == 0, or > 0 depending on whether p1 is > p2, == p2, < p2.
+ *
+ * ARGUMENTS:
+ *
+ * p1 - First entry pointer to compare.
+ *
+ * p2 - Second entry pointer to compare.
+ *
+ * user_compare - User comparison function.
+ *
+ * table_p - Associated table being ordered.
+ *
+ * err_bp - Pointer to an integer which will be set with 1 if an error
+ * has occurred.  It cannot be NULL.
+ */
+static int	external_compare(const void *p1, const void *p2,
+				 table_compare_t user_compare,
+				 const table_t *table_p, int *err_bp)
+{
+  const table_entry_t	* const *ent1_p = p1, * const *ent2_p = p2;
+  /* since we know we are not aligned we can use the EXTRY_DATA_BUF macro */
+  *err_bp = 0;
+  return user_compare(ENTRY_KEY_BUF(*ent1_p), (*ent1_p)->te_key_size,
+		      ENTRY_DATA_BUF(table_p, *ent1_p),
+		      (*ent1_p)->te_data_size,
+		      ENTRY_KEY_BUF(*ent2_p), (*ent2_p)->te_key_size,
+		      ENTRY_DATA_BUF(table_p, *ent2_p),
+		      (*ent2_p)->te_data_size);
+}
+
+/*
+ * static int external_compare_pos
+ *
+ * DESCRIPTION:
+ *
+ * Compare two entries by calling user's compare program or by using
+ * memcmp.
+ *
+ * RETURNS:
+ *
+ * < 0, == 0, or > 0 depending on whether p1 is > p2, == p2, < p2.
+ *
+ * ARGUMENTS:
+ *
+ * p1 - First entry pointer to compare.
+ *
+ * p2 - Second entry pointer to compare.
+ *
+ * user_compare - User comparison function.
+ *
+ * table_p - Associated table being ordered.
+ *
+ * err_bp - Pointer to an integer which will be set with 1 if an error
+ * has occurred.  It cannot be NULL.
+*/
+static int	external_compare_pos(const void *p1, const void *p2,
+				     table_compare_t user_compare,
+				     const table_t *table_p, int *err_bp)
+{
+  const table_linear_t	*lin1_p = p1, *lin2_p = p2;
+  const table_entry_t	*ent1_p, *ent2_p;
+  int			ret;
+  
+  /* get entry pointers */
+  ent1_p = this_entry(table_p, lin1_p, &ret);
+  ent2_p = this_entry(table_p, lin2_p, &ret);
+  if (ent1_p == NULL || ent2_p == NULL) {
+    *err_bp = 1;
+    return 0;
+  }
+  
+  /* since we know we are not aligned we can use the EXTRY_DATA_BUF macro */
+  *err_bp = 0;
+  return user_compare(ENTRY_KEY_BUF(ent1_p), (ent1_p)->te_key_size,
+		      ENTRY_DATA_BUF(table_p, ent1_p), ent1_p->te_data_size,
+		      ENTRY_KEY_BUF(ent2_p), ent2_p->te_key_size,
+		      ENTRY_DATA_BUF(table_p, ent2_p), ent2_p->te_data_size);
+}
+
+/*
+ * static int external_compare_align
+ *
+ * DESCRIPTION:
+ *
+ * Compare two entries by calling user's compare program or by using
+ * memcmp.  Alignment information is necessary.
+ *
+ * RETURNS:
+ *
+ * < 0, == 0, or > 0 depending on whether p1 is > p2, == p2, < p2.
+ *
+ * ARGUMENTS:
+ *
+ * p1 - First entry pointer to compare.
+ *
+ * p2 - Second entry pointer to compare.
+ *
+ * user_compare - User comparison function.
+ *
+ * table_p - Associated table being ordered.
+ *
+ * err_bp - Pointer to an integer which will be set with 1 if an error
+ * has occurred.  It cannot be NULL.
+ */
+static int	external_compare_align(const void *p1, const void *p2,
+				       table_compare_t user_compare,
+				       const table_t *table_p, int *err_bp)
+{
+  const table_entry_t	* const *ent1_p = p1, * const *ent2_p = p2;
+  /* since we are aligned we have to use the entry_data_buf function */
+  *err_bp = 0;
+  return user_compare(ENTRY_KEY_BUF(*ent1_p), (*ent1_p)->te_key_size,
+		      entry_data_buf(table_p, *ent1_p),
+		      (*ent1_p)->te_data_size,
+		      ENTRY_KEY_BUF(*ent2_p), (*ent2_p)->te_key_size,
+		      entry_data_buf(table_p, *ent2_p),
+		      (*ent2_p)->te_data_size);
+}
+
+/*
+ * static int external_compare_align_pos
+ *
+ * DESCRIPTION:
+ *
+ * Compare two entries by calling user's compare program or by using
+ * memcmp.  Alignment information is necessary.
+ *
+ * RETURNS:
+ *
+ * < 0, == 0, or > 0 depending on whether p1 is > p2, == p2, < p2.
+ *
+ * ARGUMENTS:
+ *
+ * p1 - First entry pointer to compare.
+ *
+ * p2 - Second entry pointer to compare.
+ *
+ * user_compare - User comparison function.
+ *
+ * table_p - Associated table being ordered.
+ *
+ * err_bp - Pointer to an integer which will be set with 1 if an error
+ * has occurred.  It cannot be NULL.
+ */
+static int	external_compare_align_pos(const void *p1, const void *p2,
+					   table_compare_t user_compare,
+					   const table_t *table_p, int *err_bp)
+{
+  const table_linear_t	*lin1_p = p1, *lin2_p = p2;
+  const table_entry_t	*ent1_p, *ent2_p;
+  int			ret;
+  
+  /* get entry pointers */
+  ent1_p = this_entry(table_p, lin1_p, &ret);
+  ent2_p = this_entry(table_p, lin2_p, &ret);
+  if (ent1_p == NULL || ent2_p == NULL) {
+    *err_bp = 1;
+    return 0;
+  }
+  
+  /* since we are aligned we have to use the entry_data_buf function */
+  *err_bp = 0;
+  return user_compare(ENTRY_KEY_BUF(ent1_p), ent1_p->te_key_size,
+		      entry_data_buf(table_p, ent1_p), ent1_p->te_data_size,
+		      ENTRY_KEY_BUF(ent2_p), ent2_p->te_key_size,
+		      entry_data_buf(table_p, ent2_p), ent2_p->te_data_size);
+}
+
+/*
+ * static void swap_bytes
+ *
+ * DESCRIPTION:
+ *
+ * Swap the values between two items of a specified size.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * item1_p -> Pointer to the first item.
+ *
+ * item2_p -> Pointer to the first item.
+ *
+ * ele_size -> Size of the two items.
+ */
+static	void	swap_bytes(unsigned char *item1_p, unsigned char *item2_p,
+			   int ele_size)
+{
+  unsigned char	char_temp;
+  
+  for (; ele_size > 0; ele_size--) {
+    char_temp = *item1_p;
+    *item1_p = *item2_p;
+    *item2_p = char_temp;
+    item1_p++;
+    item2_p++;
+  }
+}
+
+/*
+ * static void insert_sort
+ *
+ * DESCRIPTION:
+ *
+ * Do an insertion sort which is faster for small numbers of items and
+ * better if the items are already sorted.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * first_p <-> Start of the list that we are splitting.
+ *
+ * last_p <-> Last entry in the list that we are splitting.
+ *
+ * holder_p <-> Location of hold area we can store an entry.
+ *
+ * ele_size -> Size of the each element in the list.
+ *
+ * compare -> Our comparison function.
+ *
+ * user_compare -> User comparison function.  Could be NULL if we are
+ * just using a local comparison function.
+ *
+ * table_p -> Associated table being sorted.
+ */
+static	int	insert_sort(unsigned char *first_p, unsigned char *last_p,
+			    unsigned char *holder_p,
+			    const unsigned int ele_size, compare_t compare,
+			    table_compare_t user_compare, table_t *table_p)
+{
+  unsigned char	*inner_p, *outer_p;
+  int		ret, err_b;
+  
+  for (outer_p = first_p + ele_size; outer_p <= last_p; ) {
+    
+    /* look for the place to insert the entry */
+    for (inner_p = outer_p - ele_size;
+	 inner_p >= first_p;
+	 inner_p -= ele_size) {
+      ret = compare(outer_p, inner_p, user_compare, table_p, &err_b);
+      if (err_b) {
+	return TABLE_ERROR_COMPARE;
+      }
+      if (ret >= 0) {
+	break;
+      }
+    }
+    inner_p += ele_size;
+    
+    /* do we need to insert the entry in? */
+    if (outer_p != inner_p) {
+      /*
+       * Now we shift the entry down into its place in the already
+       * sorted list.
+       */
+      memcpy(holder_p, outer_p, ele_size);
+      memmove(inner_p + ele_size, inner_p, outer_p - inner_p);
+      memcpy(inner_p, holder_p, ele_size);
+    }
+    
+    outer_p += ele_size;
+  }
+  
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * static int split
+ *
+ * DESCRIPTION:
+ *
+ * This sorts an array of longs via the quick sort algorithm (it's
+ * pretty quick)
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * first_p -> Start of the list that we are splitting.
+ *
+ * last_p -> Last entry in the list that we are splitting.
+ *
+ * ele_size -> Size of the each element in the list.
+ *
+ * compare -> Our comparison function.
+ *
+ * user_compare -> User comparison function.  Could be NULL if we are
+ * just using a local comparison function.
+ *
+ * table_p -> Associated table being sorted.
+ */
+static	int	split(unsigned char *first_p, unsigned char *last_p,
+		      const unsigned int ele_size, compare_t compare,
+		      table_compare_t user_compare, table_t *table_p)
+{
+  unsigned char	*left_p, *right_p, *pivot_p, *left_last_p, *right_first_p;
+  unsigned char	*firsts[MAX_QSORT_SPLITS], *lasts[MAX_QSORT_SPLITS], *pivot;
+  unsigned int	width, split_c = 0;
+  int		size1, size2, min_qsort_size;
+  int		ret, err_b;
+  
+  /*
+   * Allocate some space for our pivot value.  We also use this as
+   * holder space for our insert sort.
+   */
+  pivot = alloca(ele_size);
+  if (pivot == NULL) {
+    /* what else can we do? */
+    abort();
+  }
+  
+  min_qsort_size = MAX_QSORT_MANY * ele_size;
+  
+  while (1) {
+    
+    /* find the left, right, and mid point */
+    left_p = first_p;
+    right_p = last_p;
+    /* is there a faster way to find this? */
+    width = (last_p - first_p) / ele_size;
+    pivot_p = first_p + ele_size * (width >> 1);
+    
+    /*
+     * Find which of the left, middle, and right elements is the
+     * median (Knuth vol3 p123).
+      */
+    ret = compare(first_p, pivot_p, user_compare, table_p, &err_b);
+    if (err_b) {
+      return TABLE_ERROR_COMPARE;
+    }
+    if (ret > 0) {
+      swap_bytes(first_p, pivot_p, ele_size);
+    }
+    ret = compare(pivot_p, last_p, user_compare, table_p, &err_b);
+    if (err_b) {
+      return TABLE_ERROR_COMPARE;
+    }
+    if (ret > 0) {
+      swap_bytes(pivot_p, last_p, ele_size);
+      ret = compare(first_p, pivot_p, user_compare, table_p, &err_b);
+      if (err_b) {
+	return TABLE_ERROR_COMPARE;
+      }
+      if (ret > 0) {
+	swap_bytes(first_p, pivot_p, ele_size);
+      }
+    }
+    
+    /*
+     * save our pivot so we don't have to worry about hitting and
+     * swapping it elsewhere while we iterate across the list below.
+     */
+    memcpy(pivot, pivot_p, ele_size);
+    
+    do {
+      
+      /* shift the left side up until we reach the pivot value */
+      while (1) {
+	ret = compare(left_p, pivot, user_compare, table_p, &err_b);
+	if (err_b) {
+	  return TABLE_ERROR_COMPARE;
+	}
+	if (ret >= 0) {
+	  break;
+	}
+	left_p += ele_size;
+      }
+      /* shift the right side down until we reach the pivot value */
+      while (1) {
+	ret = compare(pivot, right_p, user_compare, table_p, &err_b);
+	if (err_b) {
+	  return TABLE_ERROR_COMPARE;
+	}
+	if (ret >= 0) {
+	  break;
+	}
+	right_p -= ele_size;
+      }
+      
+      /* if we met in the middle then we are done */
+      if (left_p == right_p) {
+	left_p += ele_size;
+	right_p -= ele_size;
+	break;
+      }
+      else if (left_p < right_p) {
+	/*
+	 * swap the left and right since they both were on the wrong
+	 * size of the pivot and continue
+	 */
+	swap_bytes(left_p, right_p, ele_size);
+	left_p += ele_size;
+	right_p -= ele_size;
+      }
+    } while (left_p <= right_p);
+    
+    /* Rename variables to make more sense.  This will get optimized out. */
+    right_first_p = left_p;
+    left_last_p = right_p;
+    
+    /* determine the size of the left and right hand parts */
+    size1 = left_last_p - first_p;
+    size2 = last_p - right_first_p;
+    
+    /* is the 1st half small enough to just insert-sort? */
+    if (size1 < min_qsort_size) {
+      
+      /* use the pivot as our temporary space */
+      ret = insert_sort(first_p, left_last_p, pivot, ele_size, compare,
+			user_compare, table_p);
+      if (ret != TABLE_ERROR_NONE) {
+	return ret;
+      }
+      
+      /* is the 2nd part small as well? */
+      if (size2 < min_qsort_size) {
+	
+	/* use the pivot as our temporary space */
+	ret = insert_sort(right_first_p, last_p, pivot, ele_size, compare,
+			  user_compare, table_p);
+	if (ret != TABLE_ERROR_NONE) {
+	  return ret;
+	}
+	
+	/* pop a partition off our stack */
+	if (split_c == 0) {
+	  /* we are done */
+	  return TABLE_ERROR_NONE;
+	}
+	split_c--;
+	first_p = firsts[split_c];
+	last_p = lasts[split_c];
+      }
+      else {
+	/* we can just handle the right side immediately */
+	first_p = right_first_p;
+	/* last_p = last_p */
+      }
+    }
+    else if (size2 < min_qsort_size) {
+      
+      /* use the pivot as our temporary space */
+      ret = insert_sort(right_first_p, last_p, pivot, ele_size, compare,
+			user_compare, table_p);
+      if (ret != TABLE_ERROR_NONE) {
+	return ret;
+      }
+      
+      /* we can just handle the left side immediately */
+      /* first_p = first_p */
+      last_p = left_last_p;
+    }
+    else {
+      /*
+       * neither partition is small, we'll have to push the larger one
+       * of them on the stack
+       */
+      if (split_c >= MAX_QSORT_SPLITS) {
+	/* sanity check here -- we should never get here */
+	abort();
+      }
+      if (size1 > size2) {
+	/* push the left partition on the stack */
+	firsts[split_c] = first_p;
+	lasts[split_c] = left_last_p;
+	split_c++;
+	/* continue handling the right side */
+	first_p = right_first_p;
+	/* last_p = last_p */
+      }
+      else {
+	/* push the right partition on the stack */
+	firsts[split_c] = right_first_p;
+	lasts[split_c] = last_p;
+	split_c++;
+	/* continue handling the left side */
+	/* first_p = first_p */
+	last_p = left_last_p;
+      }
+    }
+  }
+  
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * static int sort_less
+ *
+ * DESCRIPTION:
+ *
+ * Compare two entries for our entry sort.
+ *
+ * RETURNS:
+ *
+ * 1 if the first entry sorts before the second otherwise 0.
+ *
+ * ARGUMENTS:
+ *
+ * sort_p <-> How we are comparing the entries.  Its error flag is set
+ * if the comparison failed.
+ *
+ * ent1_pp -> Pointer to the first entry pointer.
+ *
+ * ent2_pp -> Pointer to the second entry pointer.
+ */
+static	int	sort_less(entry_sort_t *sort_p, table_entry_t **ent1_pp,
+			  table_entry_t **ent2_pp)
+{
+  int	ret, err_b;
+  
+  ret = sort_p->es_compare(ent1_pp, ent2_pp, sort_p->es_user_compare,
+			   sort_p->es_table, &err_b);
+  if (err_b) {
+    sort_p->es_error_b = 1;
+  }
+  return (ret < 0);
+}
+
+/*
+ * static void sort_swap
+ *
+ * DESCRIPTION:
+ *
+ * Swap two entry pointers.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * ent1_pp <-> Pointer to the first entry pointer.
+ *
+ * ent2_pp <-> Pointer to the second entry pointer.
+ */
+static	void	sort_swap(table_entry_t **ent1_pp, table_entry_t **ent2_pp)
+{
+  table_entry_t	*entry_p;
+  
+  entry_p = *ent1_pp;
+  *ent1_pp = *ent2_pp;
+  *ent2_pp = entry_p;
+}
+
+/*
+ * static void sort_three
+ *
+ * DESCRIPTION:
+ *
+ * Sort 3 entries in place so the median of them is in the middle.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * sort_p <-> How we are comparing the entries.
+ *
+ * ent1_pp <-> Entry which will get the smallest of the 3.
+ *
+ * ent2_pp <-> Entry which will get the median of the 3.
+ *
+ * ent3_pp <-> Entry which will get the largest of the 3.
+ */
+static	void	sort_three(entry_sort_t *sort_p, table_entry_t **ent1_pp,
+			   table_entry_t **ent2_pp, table_entry_t **ent3_pp)
+{
+  if (sort_less(sort_p, ent2_pp, ent1_pp)) {
+    sort_swap(ent1_pp, ent2_pp);
+  }
+  if (sort_less(sort_p, ent3_pp, ent2_pp)) {
+    sort_swap(ent2_pp, ent3_pp);
+    if (sort_less(sort_p, ent2_pp, ent1_pp)) {
+      sort_swap(ent1_pp, ent2_pp);
+    }
+  }
+}
+
+/*
+ * static int sort_insert
+ *
+ * DESCRIPTION:
+ *
+ * Insertion sort a run of entries which is faster for small numbers
+ * of them and for ones that are already mostly sorted.
+ *
+ * RETURNS:
+ *
+ * 1 if the entries were sorted or 0 if we gave up because more than
+ * max entries had to be moved.
+ *
+ * ARGUMENTS:
+ *
+ * sort_p <-> How we are comparing the entries.
+ *
+ * first_p <-> First of the entries to sort.
+ *
+ * bounds_p -> Just past the last of the entries to sort.
+ *
+ * guard_b -> Set to 0 if the entry before first_p is known to be no
+ * larger than any of the entries so we don't have to check for the
+ * start of the run.
+ *
+ * max -> Maximum number of entry moves or -1 for no limit.
+ */
+static	int	sort_insert(entry_sort_t *sort_p, table_entry_t **first_p,
+			    table_entry_t **bounds_p, const int guard_b,
+			    const int max)
+{
+  table_entry_t	**outer_p, **inner_p, *entry_p;
+  int		move_n = 0;
+  
+  for (outer_p = first_p + 1; outer_p < bounds_p; outer_p++) {
+    if (! sort_less(sort_p, outer_p, outer_p - 1)) {
+      continue;
+    }
+  
+    /* shift the larger entries up to make room for this one */
+    entry_p = *outer_p;
+    inner_p = outer_p;
+    do {
+      *inner_p = *(inner_p - 1);
+      inner_p--;
+    } while ((inner_p > first_p || ! guard_b)
+	     && sort_less(sort_p, &entry_p, inner_p - 1));
+    *inner_p = entry_p;
+  
+    move_n += outer_p - inner_p;
+    if (max >= 0 && move_n > max) {
+      return 0;
+    }
+  }
+  
+  return 1;
+}
+
+/*
+ * static void sort_heap
+ *
+ * DESCRIPTION:
+ *
+ * Heap sort a run of entries.  It is slower than our quick sort but
+ * can never go quadratic so we fall back to it when the partitions
+ * keep coming out badly.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * sort_p <-> How we are comparing the entries.
+ *
+ * first_p <-> First of the entries to sort.
+ *
+ * entry_n -> Number of entries to sort.
+ */
+static	void	sort_heap(entry_sort_t *sort_p, table_entry_t **first_p,
+			  const unsigned int entry_n)
+{
+  unsigned int	start, end, parent, child;
+  
+  /* build a heap with the largest entry at the top then pull them off */
+  for (start = entry_n / 2, end = entry_n; end > 1; ) {
+    if (start > 0) {
+      start--;
+    }
+    else {
+      end--;
+      sort_swap(first_p, first_p + end);
+    }
+  
+    /* sift the entry at the start down into its place in the heap */
+    for (parent = start; (child = parent * 2 + 1) < end; parent = child) {
+      if (child + 1 < end
+	  && sort_less(sort_p, first_p + child, first_p + child + 1)) {
+	child++;
+      }
+      if (! sort_less(sort_p, first_p + parent, first_p + child)) {
+	break;
+      }
+      sort_swap(first_p + parent, first_p + child);
+    }
+  }
+}
+
+/*
+ * static table_entry_t **sort_partition
+ *
+ * DESCRIPTION:
+ *
+ * Partition a run of entries around the pivot at its start.  The
+ * entries less than the pivot end up to its left and the rest to its
+ * right.  The run must have an entry at the end that is no less than
+ * the pivot to stop our scans.
+ *
+ * RETURNS:
+ *
+ * Pointer to the pivot in its final place.
+ *
+ * ARGUMENTS:
+ *
+ * sort_p <-> How we are comparing the entries.
+ *
+ * first_p <-> First of the entries which is the pivot.
+ *
+ * bounds_p -> Just past the last of the entries.
+ *
+ * sorted_bp <- Pointer to an integer which will be set to 1 if no
+ * entries had to be swapped.
+ */
+static	table_entry_t	**sort_partition(entry_sort_t *sort_p,
+					 table_entry_t **first_p,
+					 table_entry_t **bounds_p,
+					 int *sorted_bp)
+{
+  table_entry_t	**left_p, **right_p, *pivot;
+  
+  pivot = *first_p;
+  left_p = first_p + 1;
+  right_p = bounds_p - 1;
+  
+  /* find the first entry from the left that is not less than the pivot */
+  while (sort_less(sort_p, left_p, &pivot)) {
+    left_p++;
+  }
+  /* find the first entry from the right that is less than the pivot */
+  if (left_p == first_p + 1) {
+    while (left_p < right_p && (! sort_less(sort_p, right_p, &pivot))) {
+      right_p--;
+    }
+  }
+  else {
+    while (! sort_less(sort_p, right_p, &pivot)) {
+      right_p--;
+    }
+  }
+  
+  *sorted_bp = (left_p >= right_p);
+  while (left_p < right_p) {
+    sort_swap(left_p, right_p);
+    do {
+      left_p++;
+    } while (sort_less(sort_p, left_p, &pivot));
+    do {
+      right_p--;
+    } while (! sort_less(sort_p, right_p, &pivot));
+  }
+  
+  /* move the pivot in between the partitions */
+  left_p--;
+  *first_p = *left_p;
+  *left_p = pivot;
+  return left_p;
+}
+
+/*
+ * static table_entry_t **sort_partition_equal
+ *
+ * DESCRIPTION:
+ *
+ * Partition a run of entries around the pivot at its start with the
+ * entries equal to the pivot going to the left.  We use this when the
+ * pivot is equal to the entry before the run, which is known to be no
+ * larger than any entry in it, so all of the entries on the left are
+ * equal and need no more sorting.
+ *
+ * RETURNS:
+ *
+ * Pointer to the last of the entries equal to the pivot.
+ *
+ * ARGUMENTS:
+ *
+ * sort_p <-> How we are comparing the entries.
+ *
+ * first_p <-> First of the entries which is the pivot.
+ *
+ * bounds_p -> Just past the last of the entries.
+ */
+static	table_entry_t	**sort_partition_equal(entry_sort_t *sort_p,
+					       table_entry_t **first_p,
+					       table_entry_t **bounds_p)
+{
+  table_entry_t	**left_p, **right_p, *pivot;
+  
+  pivot = *first_p;
+  left_p = first_p;
+  right_p = bounds_p - 1;
+  
+  while (sort_less(sort_p, &pivot, right_p)) {
+    right_p--;
+  }
+  if (right_p == bounds_p - 1) {
+    while (left_p < right_p && (! sort_less(sort_p, &pivot, left_p + 1))) {
+      left_p++;
+    }
+    left_p++;
+  }
+  else {
+    do {
+      left_p++;
+    } while (! sort_less(sort_p, &pivot, left_p));
+  }
+  
+  while (left_p < right_p) {
+    sort_swap(left_p, right_p);
+    do {
+      right_p--;
+    } while (sort_less(sort_p, &pivot, right_p));
+    do {
+      left_p++;
+    } while (! sort_less(sort_p, &pivot, left_p));
+  }
+  
+  *first_p = *right_p;
+  *right_p = pivot;
+  return right_p;
+}
+
+/*
+ * static void sort_break_pattern
+ *
+ * DESCRIPTION:
+ *
+ * Swap some entries of a partition around after a badly unbalanced
+ * partitioning so a pattern in the entries does not keep giving us
+ * bad pivots.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * first_p <-> First of the entries of the partition.
+ *
+ * bounds_p <-> Just past the last of the entries of the partition.
+ */
+static	void	sort_break_pattern(table_entry_t **first_p,
+				   table_entry_t **bounds_p)
+{
+  unsigned int	entry_n, quarter;
+  
+  entry_n = bounds_p - first_p;
+  if (entry_n < SORT_INSERT_MANY) {
+    return;
+  }
+  
+  quarter = entry_n / 4;
+  sort_swap(first_p, first_p + quarter);
+  sort_swap(bounds_p - 1, bounds_p - quarter);
+  if (entry_n > SORT_NINTHER_MANY) {
+    sort_swap(first_p + 1, first_p + quarter + 1);
+    sort_swap(first_p + 2, first_p + quarter + 2);
+    sort_swap(bounds_p - 2, bounds_p - quarter - 1);
+    sort_swap(bounds_p - 3, bounds_p - quarter - 2);
+  }
+}
+
+/*
+ * static void sort_run
+ *
+ * DESCRIPTION:
+ *
+ * Pattern-defeating quick sort of a run of entries.  It is a quick
+ * sort that handles runs of equal entries in linear time, notices
+ * partitions that are already sorted, breaks up patterns that give
+ * it bad pivots, and falls back to a heap sort if the partitions
+ * still keep coming out badly so it can never go quadratic.  We
+ * recurse into the smaller partition and loop on the larger one so
+ * the stack stays small.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * sort_p <-> How we are comparing the entries.
+ *
+ * first_p <-> First of the entries to sort.
+ *
+ * bounds_p -> Just past the last of the entries to sort.
+ *
+ * bad_n -> Number of badly unbalanced partitions we allow before
+ * falling back to the heap sort.
+ *
+ * leftmost_b -> Set to 1 if there is no entry before first_p in the
+ * array.  Otherwise that entry is no larger than any of ours.
+ */
+static	void	sort_run(entry_sort_t *sort_p, table_entry_t **first_p,
+			 table_entry_t **bounds_p, int bad_n, int leftmost_b)
+{
+  table_entry_t	**pivot_p;
+  unsigned int	entry_n, half, left_n, right_n;
+  int		sorted_b;
+  
+  while (1) {
+    entry_n = bounds_p - first_p;
+    if (entry_n < SORT_INSERT_MANY) {
+      (void)sort_insert(sort_p, first_p, bounds_p, leftmost_b, -1);
+      return;
+    }
+  
+    /* move the median of 3, or of 3 medians of 3, to the start */
+    half = entry_n / 2;
+    if (entry_n > SORT_NINTHER_MANY) {
+      sort_three(sort_p, first_p, first_p + half, bounds_p - 1);
+      sort_three(sort_p, first_p + 1, first_p + half - 1, bounds_p - 2);
+      sort_three(sort_p, first_p + 2, first_p + half + 1, bounds_p - 3);
+      sort_three(sort_p, first_p + half - 1, first_p + half,
+		 first_p + half + 1);
+      sort_swap(first_p, first_p + half);
+    }
+    else {
+      sort_three(sort_p, first_p + half, first_p, bounds_p - 1);
+    }
+  
+    /*
+     * If the pivot is equal to the entry before us then it is the
+     * smallest so the entries equal to it are already in place.
+     */
+    if ((! leftmost_b) && (! sort_less(sort_p, first_p - 1, first_p))) {
+      first_p = sort_partition_equal(sort_p, first_p, bounds_p) + 1;
+      continue;
+    }
+  
+    pivot_p = sort_partition(sort_p, first_p, bounds_p, &sorted_b);
+    left_n = pivot_p - first_p;
+    right_n = bounds_p - (pivot_p + 1);
+  
+    if (left_n < entry_n / 8 || right_n < entry_n / 8) {
+      /* too many bad pivots so we heap sort what is left */
+      bad_n--;
+      if (bad_n <= 0) {
+	sort_heap(sort_p, first_p, entry_n);
+	return;
+      }
+      sort_break_pattern(first_p, pivot_p);
+      sort_break_pattern(pivot_p + 1, bounds_p);
+    }
+    else if (sorted_b
+	     && sort_insert(sort_p, first_p, pivot_p, leftmost_b,
+			    SORT_PARTIAL_MAX)
+	     && sort_insert(sort_p, pivot_p + 1, bounds_p, 0,
+			    SORT_PARTIAL_MAX)) {
+      /* nothing had to be swapped and both sides were nearly sorted */
+      return;
+    }
+  
+    if (left_n < right_n) {
+      sort_run(sort_p, first_p, pivot_p, bad_n, leftmost_b);
+      first_p = pivot_p + 1;
+      leftmost_b = 0;
+    }
+    else {
+      sort_run(sort_p, pivot_p + 1, bounds_p, bad_n, 0);
+      bounds_p = pivot_p;
+    }
+  }
+}
+
+/*
+ * static int entry_sort
+ *
+ * DESCRIPTION:
+ *
+ * Sort an array of entry pointers.  Since the array just holds
+ * pointers, we move them around a pointer at a time instead of byte
+ * by byte like split.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * entries <-> Array of entry pointers to sort.
+ *
+ * entry_n -> Number of entries in the array.
+ *
+ * compare -> Our comparison function.
+ *
+ * user_compare -> User comparison function.  Could be NULL if we are
+ * just using a local comparison function.
+ *
+ * table_p -> Associated table being sorted.
+ */
+static	int	entry_sort(table_entry_t **entries, const unsigned int entry_n,
+			   compare_t compare, table_compare_t user_compare,
+			   table_t *table_p)
+{
+  entry_sort_t	sort;
+  unsigned int	val;
+  int		bad_n;
+  
+  sort.es_compare = compare;
+  sort.es_user_compare = user_compare;
+  sort.es_table = table_p;
+  sort.es_error_b = 0;
+  
+  /* allow log2 of the number of entries of bad partitions */
+  for (bad_n = 1, val = entry_n; val > 1; val >>= 1) {
+    bad_n++;
+  }
+  
+  sort_run(&sort, entries, entries + entry_n, bad_n, 1);
+  
+  if (sort.es_error_b) {
+    return TABLE_ERROR_COMPARE;
+  }
+  return TABLE_ERROR_NONE;
+}
+
+/*************************** exported routines *******************************/
+
+/*
+ * table_t *table_alloc
+ *
+ * DESCRIPTION:
+ *
+ * Allocate a new table structure.
+ *
+ * RETURNS:
+ *
+ * A pointer to the new table structure which must be passed to
+ * table_free to be deallocated.  On error a NULL is returned.
+ *
+ * ARGUMENTS:
+ *
+ * bucket_n - Number of buckets for the hash table.  Our current hash
+ * value works best with base two numbers.  Set to 0 to take the
+ * library default of 1024.
+ *
+ * error_p - Pointer to an integer which, if not NULL, will contain a
+ * table error code.
+ */
+table_t		*table_alloc(const unsigned int bucket_n, int *error_p)
+{
+  table_t	*table_p = NULL;
+  unsigned int	buck_n;
+  
+  /* allocate a table structure */
+  table_p = malloc(sizeof(table_t));
+  if (table_p == NULL) {
+    SET_POINTER(error_p, TABLE_ERROR_ALLOC);
+    return NULL;
+  }
+  
+  if (bucket_n > 0) {
+    buck_n = bucket_n;
+  }
+  else {
+    buck_n = DEFAULT_SIZE;
+  }
+  
+  /* allocate the buckets which are NULLed */
+  table_p->ta_buckets = (table_entry_t **)calloc(buck_n,
+						 sizeof(table_entry_t *));
+  if (table_p->ta_buckets == NULL) {
+    SET_POINTER(error_p, TABLE_ERROR_ALLOC);
+    free(table_p);
+    return NULL;
+  }
+  
+  /* initialize structure */
+  table_p->ta_magic = TABLE_MAGIC;
+  table_p->ta_flags = 0;
+  table_p->ta_bucket_n = buck_n;
+  table_p->ta_bucket_mask = BUCKET_MASK(buck_n);
+  table_p->ta_entry_n = 0;
+  table_p->ta_ctrl = NULL;
+  table_p->ta_deleted_n = 0;
+  table_p->ta_old_buckets = NULL;
+  table_p->ta_old_bucket_n = 0;
+  table_p->ta_old_bucket_mask = 0;
+  table_p->ta_migrate_c = 0;
+  table_p->ta_inline = NULL;
+  table_p->ta_inline_size = 0;
+  table_p->ta_data_align = 0;
+  table_p->ta_linear.tl_magic = 0;
+  table_p->ta_linear.tl_bucket_c = 0;
+  table_p->ta_linear.tl_entry_c = 0;
+  table_p->ta_file_size = 0;
+  table_p->ta_entries_off = 0;
+  table_p->ta_mmap = NULL;
+  table_p->ta_mem_pool = NULL;
+  table_p->ta_alloc_func = NULL;
+  table_p->ta_resize_func = NULL;
+  table_p->ta_free_func = NULL;
+  table_p->ta_arena = NULL;
+  table_p->ta_locks = NULL;
+  table_p->ta_adjust_n = 0;
+  table_p->ta_adjust_usecs = 0;
+  
+  SET_POINTER(error_p, TABLE_ERROR_NONE);
+  return table_p;
+}
+
+/*
+ * table_t *table_alloc_in_pool
+ *
+ * DESCRIPTION:
+ *
+ * Allocate a new table structure in a memory pool or using
+ * alternative allocation and free functions.
+ *
+ * RETURNS:
+ *
+ * A pointer to the new table structure which must be passed to
+ * table_free to be deallocated.  On error a NULL is returned.
+ *
+ * ARGUMENTS:
+ *
+ * bucket_n - Number of buckets for the hash table.  Our current hash
+ * value works best with base two numbers.  Set to 0 to take the
+ * library default of 1024.
+ *
+ * mem_pool <-> Memory pool to associate with the table.  Can be NULL.
+ *
+ * alloc_func -> Allocate function we are overriding malloc() with.
+ *
+ * resize_func -> Resize function we are overriding the standard
+ * memory resize/realloc with.  This can be NULL in which cause the
+ * library will allocate, copy, and free itself.
+ *
+ * free_func -> Free function we are overriding free() with.
+ *
+ * error_p - Pointer to an integer which, if not NULL, will contain a
+ * table error code.
+ */
+table_t		*table_alloc_in_pool(const unsigned int bucket_n,
+				     void *mem_pool,
+				     table_mem_alloc_t alloc_func,
+				     table_mem_resize_t resize_func,
+				     table_mem_free_t free_func, int *error_p)
+{
+  table_t	*table_p = NULL;
+  unsigned int	buck_n, size;
+  
+  /* make sure we have real functions, mem_pool and resize_func can be NULL */
+  if (alloc_func == NULL || free_func == NULL) {
+    SET_POINTER(error_p, TABLE_ERROR_ARG_NULL);
+    return NULL;
+  }
+  
+  /* allocate a table structure */
+  table_p = alloc_func(mem_pool, sizeof(table_t));
+  if (table_p == NULL) {
+    SET_POINTER(error_p, TABLE_ERROR_ALLOC);
+    return NULL;
+  }
+  
+  if (bucket_n > 0) {
+    buck_n = bucket_n;
+  }
+  else {
+    buck_n = DEFAULT_SIZE;
+  }
+  
+  /* allocate the buckets which are NULLed */
+  size = buck_n * sizeof(table_entry_t *);
+  table_p->ta_buckets = (table_entry_t **)alloc_func(mem_pool, size);
+  if (table_p->ta_buckets == NULL) {
+    SET_POINTER(error_p, TABLE_ERROR_ALLOC);
+    (void)free_func(mem_pool, table_p, sizeof(table_t));
+    return NULL;
+  }
+  /*
+   * We zero it ourselves to save the necessity of having a
+   * table_mem_calloc_t memory override function.
+   */
+  memset(table_p->ta_buckets, 0, size);
+  
+  /* initialize structure */
+  table_p->ta_magic = TABLE_MAGIC;
+  table_p->ta_flags = 0;
+  table_p->ta_bucket_n = buck_n;
+  table_p->ta_bucket_mask = BUCKET_MASK(buck_n);
+  table_p->ta_entry_n = 0;
+  table_p->ta_ctrl = NULL;
+  table_p->ta_deleted_n = 0;
+  table_p->ta_old_buckets = NULL;
+  table_p->ta_old_bucket_n = 0;
+  table_p->ta_old_bucket_mask = 0;
+  table_p->ta_migrate_c = 0;
+  table_p->ta_inline = NULL;
+  table_p->ta_inline_size = 0;
+  table_p->ta_data_align = 0;
+  table_p->ta_linear.tl_magic = 0;
+  table_p->ta_linear.tl_bucket_c = 0;
+  table_p->ta_linear.tl_entry_c = 0;
+  table_p->ta_file_size = 0;
+  table_p->ta_entries_off = 0;
+  table_p->ta_mmap = NULL;
+  table_p->ta_mem_pool = mem_pool;
+  table_p->ta_alloc_func = alloc_func;
+  table_p->ta_resize_func = resize_func;
+  table_p->ta_free_func = free_func;
+  table_p->ta_arena = NULL;
+  table_p->ta_locks = NULL;
+  table_p->ta_adjust_n = 0;
+  table_p->ta_adjust_usecs = 0;
+  
+  SET_POINTER(error_p, TABLE_ERROR_NONE);
+  return table_p;
+}
+
+/*
+ * table_t *table_alloc_in_arena
+ *
+ * DESCRIPTION:
+ *
+ * Allocate a new table structure whose entries are carved out of
+ * large chunks of memory instead of being allocated one at a time.
+ * This saves the overhead of a malloc per entry and the table can be
+ * cleared or freed by freeing the chunks.  The space of deleted or
+ * resized entries is not reused until the table is cleared.
+ *
+ * RETURNS:
+ *
+ * A pointer to the new table structure which must be passed to
+ * table_free to be deallocated.  On error a NULL is returned.
+ *
+ * ARGUMENTS:
+ *
+ * bucket_n - Number of buckets for the hash table.  Our current hash
+ * value works best with base two numbers.  Set to 0 to take the
+ * library default of 1024.
+ *
+ * chunk_size - Size of the chunks of memory which the entries are
+ * allocated from.  Set to 0 to take the library default of 1mb.
+ *
+ * huge_pages_b - Set to 1 to map the chunks with huge pages if the
+ * system supports them.  This reduces TLB misses on large tables.
+ *
+ * error_p - Pointer to an integer which, if not NULL, will contain a
+ * table error code.
+ */
+table_t		*table_alloc_in_arena(const unsigned int bucket_n,
+				      const unsigned int chunk_size,
+				      const int huge_pages_b, int *error_p)
+{
+  table_t	*table_p;
+  arena_t	*arena_p;
+  
+  table_p = table_alloc(bucket_n, error_p);
+  if (table_p == NULL) {
+    return NULL;
+  }
+  
+  arena_p = (arena_t *)malloc(sizeof(arena_t));
+  if (arena_p == NULL) {
+    (void)table_free(table_p);
+    SET_POINTER(error_p, TABLE_ERROR_ALLOC);
+    return NULL;
+  }
+  
+  arena_p->ar_chunks = NULL;
+  arena_p->ar_next_p = NULL;
+  arena_p->ar_bounds_p = NULL;
+  if (chunk_size > 0) {
+    arena_p->ar_chunk_size = chunk_size;
+  }
+  else {
+    arena_p->ar_chunk_size = ARENA_CHUNK_SIZE;
+  }
+  arena_p->ar_align = sizeof(table_entry_t *);
+  arena_p->ar_huge_b = huge_pages_b;
+  table_p->ta_arena = arena_p;
+  
+  SET_POINTER(error_p, TABLE_ERROR_NONE);
+  return table_p;
+}
+
+/*
+ * int table_attr
+ *
+ * DESCRIPTION:
+ *
+ * Set the attributes for the table.  The available attributes are
+ * specified at the top of table.h.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Pointer to a table structure which we will be altering.
+ *
+ * attr - Attribute(s) that we will be applying to the table.
+ */
+int	table_attr(table_t *table_p, const int attr)
+{
+  int	ret;
+  
+  if (table_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (table_p->ta_magic != TABLE_MAGIC) {
+    return TABLE_ERROR_PNT;
+  }
+  if (table_p->ta_mmap != NULL) {
+    return TABLE_ERROR_MMAP_OP;
+  }
+  
+  /* finish any incremental growing before we change modes */
+  ret = migrate_buckets(table_p, table_p->ta_old_bucket_n);
+  if (ret != TABLE_ERROR_NONE) {
+    return ret;
+  }
+  
+  /* concurrent inserts only work with the bucket lists */
+  if (table_p->ta_locks != NULL
+      && (attr & (TABLE_FLAG_OPEN_ADDRESS | TABLE_FLAG_INCREMENTAL))) {
+    return TABLE_ERROR_CONCURRENT;
+  }
+  
+  /* the stored hash values depend on the hash function */
+  if ((attr & TABLE_FLAG_FAST_HASH)
+      != (table_p->ta_flags & TABLE_FLAG_FAST_HASH)
+      && table_p->ta_entry_n > 0) {
+    return TABLE_ERROR_NOT_EMPTY;
+  }
+  
+  /* are we switching between buckets and open addressing? */
+  if ((attr & TABLE_FLAG_OPEN_ADDRESS)
+      != (table_p->ta_flags & TABLE_FLAG_OPEN_ADDRESS)) {
+    if (table_p->ta_entry_n > 0) {
+      return TABLE_ERROR_NOT_EMPTY;
+    }
+    if (attr & TABLE_FLAG_OPEN_ADDRESS) {
+      ret = open_resize(table_p, table_p->ta_bucket_n);
+      if (ret != TABLE_ERROR_NONE) {
+	return ret;
+      }
+    }
+    else {
+      /* the empty slots work fine as empty buckets */
+      if (table_p->ta_free_func == NULL) {
+	free(table_p->ta_ctrl);
+      }
+      else if (! table_p->ta_free_func(table_p->ta_mem_pool,
+				       table_p->ta_ctrl,
+				       table_p->ta_bucket_n)) {
+	return TABLE_ERROR_FREE;
+      }
+      table_p->ta_ctrl = NULL;
+      table_p->ta_deleted_n = 0;
+      ret = inline_free(table_p);
+      if (ret != TABLE_ERROR_NONE) {
+	return ret;
+      }
+    }
+  }
+  
+  table_p->ta_flags = attr;
+  
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * int table_set_data_alignment
+ *
+ * DESCRIPTION:
+ *
+ * Set the alignment for the data in the table.  This is used when you
+ * want to store binary data types and refer to them directly out of
+ * the table storage.  For instance if you are storing integers as
+ * data in the table and want to be able to retrieve the location of
+ * the interger and then increment it as (*loc_p)++.  Otherwise you
+ * would have to memcpy it out to an integer, increment it, and memcpy
+ * it back.  If you are storing character data, no alignment is
+ * necessary.
+ *
+ * For most data elements, sizeof(long) is recommended unless you use
+ * smaller data types exclusively.
+ *
+ * WARNING: If necessary, you must set the data alignment before any
+ * data gets put into the table.  Otherwise a TABLE_ERROR_NOT_EMPTY
+ * error will be returned.
+ *
+ * NOTE: there is no way to set the key data alignment although it
+ * should automatically be long aligned.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Pointer to a table structure which we will be altering.
+ *
+ * alignment - Alignment requested for the data.  Must be a power of
+ * 2.  Set to 0 for none.
+ */
+int	table_set_data_alignment(table_t *table_p, const int alignment)
+{
+  int		val;
+  
+  if (table_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (table_p->ta_magic != TABLE_MAGIC) {
+    return TABLE_ERROR_PNT;
+  }
+  if (table_p->ta_mmap != NULL) {
+    return TABLE_ERROR_MMAP_OP;
+  }
+  if (table_p->ta_entry_n > 0) {
+    return TABLE_ERROR_NOT_EMPTY;
+  }
+  
+  /* defaults */
+  if (alignment < 2) {
+    table_p->ta_data_align = 0;
+  }
+  else {
+    /* verify we have a base 2 number */
+    for (val = 2; val < MAX_ALIGNMENT; val *= 2) {
+      if (val == alignment) {
+	break;
+      }
+    }
+    if (val >= MAX_ALIGNMENT) {
+      return TABLE_ERROR_ALIGNMENT;
+    }
+    table_p->ta_data_align = alignment;
+    
+    /* the data is only aligned if the entries are */
+    if (table_p->ta_arena != NULL
+	&& table_p->ta_arena->ar_align < alignment) {
+      table_p->ta_arena->ar_align = alignment;
+    }
+  }
+  
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * int table_set_inline_size
+ *
+ * DESCRIPTION:
+ *
+ * Store short entries directly in the slots of an open addressing
+ * table instead of allocating each one separately.  Entries whose key
+ * and data fit in the slot size are put in the slot array so no
+ * allocation is done for them and they sit next to their neighbors
+ * in memory.  Larger entries are allocated as usual.  This is only
+ * used by tables with the TABLE_FLAG_OPEN_ADDRESS flag.
+ *
+ * WARNING: The entries in the slots move when the table grows so any
+ * key or data pointers returned for them are only good until the next
+ * insert.
+ *
+ * WARNING: If necessary, you must set the data alignment before
+ * calling this and this must be called before any data gets put into
+ * the table.  Otherwise a TABLE_ERROR_NOT_EMPTY error will be
+ * returned.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Pointer to a table structure which we will be altering.
+ *
+ * key_size - Largest key in bytes that will be stored in the slots.
+ * Set to 0 to store all entries separately.
+ *
+ * data_size - Largest data in bytes that will be stored in the slots.
+ */
+int	table_set_inline_size(table_t *table_p, const int key_size,
+			      const int data_size)
+{
+  unsigned int	size, align;
+  int		ret;
+  
+  if (table_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (table_p->ta_magic != TABLE_MAGIC) {
+    return TABLE_ERROR_PNT;
+  }
+  if (table_p->ta_mmap != NULL) {
+    return TABLE_ERROR_MMAP_OP;
+  }
+  if (key_size < 0 || data_size < 0) {
+    return TABLE_ERROR_SIZE;
+  }
+  if (table_p->ta_entry_n > 0) {
+    return TABLE_ERROR_NOT_EMPTY;
+  }
+  
+  /* the old slot entries were the old size */
+  ret = inline_free(table_p);
+  if (ret != TABLE_ERROR_NONE) {
+    return ret;
+  }
+  
+  if (key_size == 0) {
+    size = 0;
+  }
+  else {
+    /* round up so each of the slot entries is aligned */
+    size = entry_size(table_p, key_size, data_size);
+    align = sizeof(long);
+    if (align < table_p->ta_data_align) {
+      align = table_p->ta_data_align;
+    }
+    size = (size + align - 1) & ~(align - 1);
+  }
+  table_p->ta_inline_size = size;
+  
+  /* rebuild the slots now, otherwise when we switch to open addressing */
+  if (table_p->ta_flags & TABLE_FLAG_OPEN_ADDRESS) {
+    return open_resize(table_p, table_p->ta_bucket_n);
+  }
+  
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * int table_set_concurrent
+ *
+ * DESCRIPTION:
+ *
+ * Allow a number of threads to insert into the table at the same
+ * time with table_insert_concurrent.  Each bucket is protected by one
+ * of a number of striped locks so threads only wait for each other
+ * when their keys land in buckets sharing the same lock.  Growing the
+ * table waits for the inserts in progress to finish and then holds
+ * them off while the buckets are rebuilt.
+ *
+ * WARNING: Only table_insert_concurrent may be called while other
+ * threads are inserting.  All other routines such as table_order
+ * must wait until all of the inserting threads have finished.
+ *
+ * WARNING: This only works with the bucket linked lists so it cannot
+ * be used with TABLE_FLAG_OPEN_ADDRESS or TABLE_FLAG_INCREMENTAL.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Pointer to a table structure which we will be altering.
+ *
+ * lock_n - Number of bucket locks.  Set to 0 to take the library
+ * default.  It will be rounded up to a power of 2.
+ */
+int	table_set_concurrent(table_t *table_p, const int lock_n)
+{
+#ifdef NO_THREADS
+  return TABLE_ERROR_CONCURRENT;
+#else
+  table_locks_t		*locks_p;
+  pthread_rwlockattr_t	attr;
+  unsigned int		stripe_n, stripe_c;
+  
+  if (table_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (table_p->ta_magic != TABLE_MAGIC) {
+    return TABLE_ERROR_PNT;
+  }
+  if (table_p->ta_mmap != NULL) {
+    return TABLE_ERROR_MMAP_OP;
+  }
+  if (lock_n < 0) {
+    return TABLE_ERROR_SIZE;
+  }
+  if (table_p->ta_flags & (TABLE_FLAG_OPEN_ADDRESS | TABLE_FLAG_INCREMENTAL)) {
+    return TABLE_ERROR_CONCURRENT;
+  }
+  if (table_p->ta_locks != NULL) {
+    return TABLE_ERROR_NONE;
+  }
+  
+  for (stripe_n = 1;
+       stripe_n < (lock_n == 0 ? CONCURRENT_LOCK_N : (unsigned int)lock_n);
+       stripe_n *= 2) {
+  }
+  
+  locks_p = (table_locks_t *)malloc(sizeof(table_locks_t));
+  if (locks_p == NULL) {
+    return TABLE_ERROR_ALLOC;
+  }
+  locks_p->lo_stripes =
+    (pthread_mutex_t *)malloc(stripe_n * sizeof(pthread_mutex_t));
+  if (locks_p->lo_stripes == NULL) {
+    free(locks_p);
+    return TABLE_ERROR_ALLOC;
+  }
+  
+  /*
+   * The inserts hold the grow lock for reading almost all of the time
+   * so a waiting grow has to keep new readers out or it may never get
+   * its turn.
+   */
+  (void)pthread_rwlockattr_init(&attr);
+#ifdef __GLIBC__
+  (void)pthread_rwlockattr_setkind_np(&attr,
+				      PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+  (void)pthread_rwlock_init(&locks_p->lo_grow_lock, &attr);
+  (void)pthread_rwlockattr_destroy(&attr);
+  (void)pthread_mutex_init(&locks_p->lo_alloc_lock, NULL);
+  for (stripe_c = 0; stripe_c < stripe_n; stripe_c++) {
+    (void)pthread_mutex_init(locks_p->lo_stripes + stripe_c, NULL);
+  }
+  locks_p->lo_stripe_n = stripe_n;
+  table_p->ta_locks = locks_p;
+  
+  return TABLE_ERROR_NONE;
+#endif
+}
+
+/*
+ * int table_clear
+ *
+ * DESCRIPTION:
+ *
+ * Clear out and free all elements in a table structure.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table structure pointer that we will be clearing.
+ */
+int	table_clear(table_t *table_p)
+{
+  int		final = TABLE_ERROR_NONE;
+  table_entry_t	*entry_p, *next_p;
+  table_entry_t	**bucket_p, **bounds_p;
+  
+  if (table_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (table_p->ta_magic != TABLE_MAGIC) {
+    return TABLE_ERROR_PNT;
+  }
+  if (table_p->ta_mmap != NULL) {
+    return TABLE_ERROR_MMAP_OP;
+  }
+  
+  /* finish any incremental growing before we walk the buckets */
+  final = migrate_buckets(table_p, table_p->ta_old_bucket_n);
+  if (final != TABLE_ERROR_NONE) {
+    return final;
+  }
+  
+  if (table_p->ta_arena != NULL) {
+    /* all of the entries are in the arena chunks */
+    memset(table_p->ta_buckets, 0,
+	   table_p->ta_bucket_n * sizeof(table_entry_t *));
+    arena_clear(table_p->ta_arena);
+  }
+  else {
+    /* free the table allocation and table structure */
+    bounds_p = table_p->ta_buckets + table_p->ta_bucket_n;
+    for (bucket_p = table_p->ta_buckets; bucket_p < bounds_p; bucket_p++) {
+      for (entry_p = *bucket_p; entry_p != NULL; entry_p = next_p) {
+	/* record the next pointer before we free */
+	next_p = entry_p->te_next_p;
+	if (ENTRY_INLINE(table_p, entry_p)) {
+	  /* the entry is in the slots */
+	}
+	else if (table_p->ta_free_func == NULL) {
+	  free(entry_p);
+	}
+	else if (! table_p->ta_free_func(table_p->ta_mem_pool, entry_p,
+					 entry_size(table_p,
+						    entry_p->te_key_size,
+						    entry_p->te_data_size))) {
+	  final = TABLE_ERROR_FREE;
+	}
+      }
+      
+      /* clear the bucket entry after we free its entries */
+      *bucket_p = NULL;
+    }
+  }
+  
+  /* reset table state info */
+  table_p->ta_entry_n = 0;
+  if (table_p->ta_ctrl != NULL) {
+    memset(table_p->ta_ctrl, OPEN_EMPTY, table_p->ta_bucket_n);
+    table_p->ta_deleted_n = 0;
+  }
+  table_p->ta_linear.tl_magic = 0;
+  table_p->ta_linear.tl_bucket_c = 0;
+  table_p->ta_linear.tl_entry_c = 0;
+  
+  return final;
+}
+
+/*
+ * int table_free
+ *
+ * DESCRIPTION:
+ *
+ * Deallocates a table structure.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table structure pointer that we will be freeing.
+ */
+int	table_free(table_t *table_p)
+{
+  int	ret;
+  
+  if (table_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (table_p->ta_magic != TABLE_MAGIC) {
+    return TABLE_ERROR_PNT;
+  }
+  if (table_p->ta_mmap != NULL) {
+    return TABLE_ERROR_MMAP_OP;
+  }
+  
+  ret = table_clear(table_p);
+  
+  if (table_p->ta_arena != NULL) {
+    free(table_p->ta_arena);
+    table_p->ta_arena = NULL;
+  }
+  if (table_p->ta_buckets != NULL) {
+    if (table_p->ta_free_func == NULL) {
+      free(table_p->ta_buckets);
+    }
+    else if (! table_p->ta_free_func(table_p->ta_mem_pool,
+				     table_p->ta_buckets,
+				     table_p->ta_bucket_n *
+				     sizeof(table_entry_t *))) {
+      return TABLE_ERROR_FREE;
+    }
+  }
+  if (inline_free(table_p) != TABLE_ERROR_NONE) {
+    return TABLE_ERROR_FREE;
+  }
+  if (locks_free(table_p) != TABLE_ERROR_NONE) {
+    return TABLE_ERROR_FREE;
+  }
+  if (table_p->ta_ctrl != NULL) {
+    if (table_p->ta_free_func == NULL) {
+      free(table_p->ta_ctrl);
+    }
+    else if (! table_p->ta_free_func(table_p->ta_mem_pool, table_p->ta_ctrl,
+				     table_p->ta_bucket_n)) {
+      return TABLE_ERROR_FREE;
+    }
+  }
+  table_p->ta_magic = 0;
+  if (table_p->ta_free_func == NULL) {
+    free(table_p);
+  }
+  else if (! table_p->ta_free_func(table_p->ta_mem_pool, table_p,
+				   sizeof(table_t))) {
+    if (ret == TABLE_ERROR_NONE) {
+      ret = TABLE_ERROR_FREE;
+    }
+  }
+  
+  return ret;
+}
+
+/*
+ * static int insert_sizes
+ *
+ * DESCRIPTION:
+ *
+ * Check the arguments of an insert and work out the sizes of its key
+ * and data.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table structure pointer into which we will be inserting.
+ *
+ * key_buf - Buffer of bytes of the key that we are inserting.
+ *
+ * key_size - Size of the key_buf buffer or < 0 to strlen it.
+ *
+ * data_buf - Buffer of bytes of the data that we are inserting.
+ *
+ * data_size - Size of the data_buf buffer or < 0 to strlen it.
+ *
+ * ksize_p - Pointer to an unsigned integer which will be set to the
+ * size of the key.
+ *
+ * dsize_p - Pointer to an unsigned integer which will be set to the
+ * size of the data.
+ */
+static	int	insert_sizes(const table_t *table_p,
+			     const void *key_buf, const int key_size,
+			     const void *data_buf, const int data_size,
+			     unsigned int *ksize_p, unsigned int *dsize_p)
+{
+  /* check the arguments */
+  if (table_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (table_p->ta_magic != TABLE_MAGIC) {
+    return TABLE_ERROR_PNT;
+  }
+  if (table_p->ta_mmap != NULL) {
+    return TABLE_ERROR_MMAP_OP;
+  }
+  if (key_buf == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  /* data_buf can be null but size must be >= 0, if it isn't null size != 0 */
+  if ((data_buf == NULL && data_size < 0)
+      || (data_buf != NULL && data_size == 0)) {
+    return TABLE_ERROR_SIZE;
+  }
+  
+  /* determine sizes of key and data */
+  if (key_size < 0) {
+    *ksize_p = strlen((char *)key_buf) + sizeof(char);
+  }
+  else {
+    *ksize_p = key_size;
+  }
+  if (data_size < 0) {
+    *dsize_p = strlen((char *)data_buf) + sizeof(char);
+  }
+  else {
+    *dsize_p = data_size;
+  }
+  
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * int table_insert_kd
+ *
+ * DESCRIPTION:
+ *
+ * Like table_insert except it passes back a pointer to the key and
+ * the data buffers after they have been inserted into the table
+ * structure.
+ *
+ * This routine adds a key/data pair both of which are made up of a
+ * buffer of bytes and an associated size.  Both the key and the data
+ * will be copied into buffers allocated inside the table.  If the key
+ * exists already, the associated data will be replaced if the
+ * overwrite flag is set, otherwise an error is returned.
+ *
+ * NOTE: be very careful changing the values since the table library
+ * provides the pointers to its memory.  The key can _never_ be
+ * changed otherwise you will not find it again.  The data can be
+ * changed but its length can never be altered unless you delete and
+ * re-insert it into the table.
+ *
+ * WARNING: The pointers to the key and data are not in any specific
+ * alignment.  Accessing the key and/or data as an short, integer, or
+ * long pointer directly can cause problems.
+ *
+ * WARNING: Replacing a data cell (not inserting) will cause the table
+ * linked list to be temporarily invalid.  Care must be taken with
+ * multiple threaded programs which are relying on the first/next
+ * linked list to be always valid.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table structure pointer into which we will be inserting a
+ * new key/data pair.
+ *
+ * key_buf - Buffer of bytes of the key that we are inserting.  If you
+ * are storing an (int) as the key (for example) then key_buf should
+ * be a (int *).
+ *
+ * key_size - Size of the key_buf buffer.  If set to < 0 then the
+ * library will do a strlen of key_buf and add 1 for the '\0'.  If you
+ * are storing an (int) as the key (for example) then key_size should
+ * be sizeof(int).
+ *
+ * data_buf - Buffer of bytes of the data that we are inserting.  If
+ * it is NULL then the library will allocate space for the data in the
+ * table without copying in any information.  If data_buf is NULL and
+ * data_size is 0 then the library will associate a NULL data pointer
+ * with the key.  If you are storing a (long) as the data (for
+ * example) then data_buf should be a (long *).
+ *
+ * data_size - Size of the data_buf buffer.  If set to < 0 then the
+ * library will do a strlen of data_buf and add 1 for the '\0'.  If
+ * you are storing an (long) as the key (for example) then key_size
+ * should be sizeof(long).
+ *
+ * key_buf_p - Pointer which, if not NULL, will be set to the address
+ * of the key storage that was allocated in the table.  If you are
+ * storing an (int) as the key (for example) then key_buf_p should be
+ * (int **) i.e. the address of a (int *).
+ *
+ * data_buf_p - Pointer which, if not NULL, will be set to the address
+ * of the data storage that was allocated in the table.  If you are
+ * storing an (long) as the data (for example) then data_buf_p should
+ * be (long **) i.e. the address of a (long *).
+ *
+ * overwrite - Flag which, if set to 1, will allow the overwriting of
+ * the data in the table with the new data if the key already exists
+ * in the table.
+ */
+int	table_insert_kd(table_t *table_p,
+			const void *key_buf, const int key_size,
+			const void *data_buf, const int data_size,
+			void **key_buf_p, void **data_buf_p,
+			const char overwrite_b)
+{
+  unsigned int	ksize, dsize, hash_val;
+  int		ret;
+  
+  ret = insert_sizes(table_p, key_buf, key_size, data_buf, data_size,
+		     &ksize, &dsize);
+  if (ret != TABLE_ERROR_NONE) {
+    return ret;
+  }
+  
+  /* get the bucket number via a hash function */
+  hash_val = key_hash(table_p, key_buf, ksize);
+  
+  return insert_hashed(table_p, key_buf, ksize, hash_val, data_buf, dsize,
+		       key_buf_p, data_buf_p, overwrite_b, NULL);
+}
+
+/*
+ * int table_insert
+ *
+ * DESCRIPTION:
+ *
+ * Exactly the same as table_insert_kd except it does not pass back a
+ * pointer to the key after they have been inserted into the table
+ * structure.  This is still here for backwards compatibility.
+ *
+ * See table_insert_kd for more information.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table structure pointer into which we will be inserting a
+ * new key/data pair.
+ *
+ * key_buf - Buffer of bytes of the key that we are inserting.  If you
+ * are storing an (int) as the key (for example) then key_buf should
+ * be a (int *).
+ *
+ * key_size - Size of the key_buf buffer.  If set to < 0 then the
+ * library will do a strlen of key_buf and add 1 for the '\0'.  If you
+ * are storing an (int) as the key (for example) then key_size should
+ * be sizeof(int).
+ *
+ * data_buf - Buffer of bytes of the data that we are inserting.  If
+ * it is NULL then the library will allocate space for the data in the
+ * table without copying in any information.  If data_buf is NULL and
+ * data_size is 0 then the library will associate a NULL data pointer
+ * with the key.  If you are storing a (long) as the data (for
+ * example) then data_buf should be a (long *).
+ *
+ * data_size - Size of the data_buf buffer.  If set to < 0 then the
+ * library will do a strlen of data_buf and add 1 for the '\0'.  If
+ * you are storing an (long) as the key (for example) then key_size
+ * should be sizeof(long).
+ *
+ * data_buf_p - Pointer which, if not NULL, will be set to the address
+ * of the data storage that was allocated in the table.  If you are
+ * storing an (long) as the data (for example) then data_buf_p should
+ * be (long **) i.e. the address of a (long *).
+ *
+ * overwrite - Flag which, if set to 1, will allow the overwriting of
+ * the data in the table with the new data if the key already exists
+ * in the table.
+ */
+int	table_insert(table_t *table_p,
+		     const void *key_buf, const int key_size,
+		     const void *data_buf, const int data_size,
+		     void **data_buf_p, const char overwrite_b)
+{
+  return table_insert_kd(table_p, key_buf, key_size, data_buf, data_size,
+			 NULL, data_buf_p, overwrite_b);
+}
+
+/*
+ * int table_insert_hash
+ *
+ * DESCRIPTION:
+ *
+ * Like table_insert except the key has already been hashed with
+ * table_hash so it is not hashed again.  This is for callers that
+ * need the hash to pick the table, as the sharded tables do.
+ *
+ * WARNING: The hash must have come from table_hash on this table or
+ * on one with the same TABLE_FLAG_FAST_HASH setting.  Otherwise the
+ * key will be put where it cannot be found.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table structure pointer into which we will be inserting a
+ * new key/data pair.
+ *
+ * key_buf - Buffer of bytes of the key that we are inserting.
+ *
+ * key_size - Size of the key_buf buffer.  If set to < 0 then the
+ * library will do a strlen of key_buf and add 1 for the '\0'.
+ *
+ * hash_val - Hash of the key from table_hash.
+ *
+ * data_buf - Buffer of bytes of the data that we are inserting.  See
+ * table_insert for when it is NULL.
+ *
+ * data_size - Size of the data_buf buffer.  If set to < 0 then the
+ * library will do a strlen of data_buf and add 1 for the '\0'.
+ *
+ * data_buf_p - Pointer which, if not NULL, will be set to the address
+ * of the data storage that was allocated in the table.
+ *
+ * overwrite - Flag which, if set to 1, will allow the overwriting of
+ * the data in the table with the new data if the key already exists
+ * in the table.
+ */
+int	table_insert_hash(table_t *table_p,
+			  const void *key_buf, const int key_size,
+			  const unsigned int hash_val,
+			  const void *data_buf, const int data_size,
+			  void **data_buf_p, const char overwrite_b)
+{
+  unsigned int	ksize, dsize;
+  int		ret;
+  
+  ret = insert_sizes(table_p, key_buf, key_size, data_buf, data_size,
+		     &ksize, &dsize);
+  if (ret != TABLE_ERROR_NONE) {
+    return ret;
+  }
+  
+  return insert_hashed(table_p, key_buf, ksize, hash_val, data_buf, dsize,
+		       NULL, data_buf_p, overwrite_b, NULL);
+}
+
+/*
+ * int table_upsert
+ *
+ * DESCRIPTION:
+ *
+ * Find a key in the table or add it if it is not there, in a single
+ * hash and probe of the table.  A new key gets zeroed data of the
+ * given size so nothing needs to be copied in and an existing key is
+ * not reported as an overwrite error.  This is handy for counting where
+ * the caller just increments a field of the data either way.
+ *
+ * NOTE: The same warnings about the data pointer apply as with
+ * table_insert_kd.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE whether or not the key was added.
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table structure pointer that we are searching and maybe
+ * inserting into.
+ *
+ * key_buf - Buffer of bytes of the key that we are looking for.
+ *
+ * key_size - Size of the key_buf buffer.  If set to < 0 then the
+ * library will do a strlen of key_buf and add 1 for the '\0'.
+ *
+ * data_size - Size of the data to allocate for a new key.
+ *
+ * data_buf_p - Pointer which will be set to the address of the key's
+ * data in the table.
+ *
+ * created_bp - Pointer to an integer which, if not NULL, will be set
+ * to 1 if the key was added or 0 if it was already in the table.
+ */
+int	table_upsert(table_t *table_p, const void *key_buf, const int key_size,
+		     const int data_size, void **data_buf_p, int *created_bp)
+{
+  unsigned int	ksize, dsize, hash_val;
+  int		created_b, ret;
+  
+  if (data_buf_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (data_size <= 0) {
+    return TABLE_ERROR_SIZE;
+  }
+  ret = insert_sizes(table_p, key_buf, key_size, NULL, 0, &ksize, &dsize);
+  if (ret != TABLE_ERROR_NONE) {
+    return ret;
+  }
+  dsize = data_size;
+  
+  /* a NULL data buffer allocates the space without copying anything */
+  hash_val = key_hash(table_p, key_buf, ksize);
+  ret = insert_hashed(table_p, key_buf, ksize, hash_val, NULL, dsize, NULL,
+		      data_buf_p, 0, &created_b);
+  if (ret != TABLE_ERROR_NONE) {
+    return ret;
+  }
+  
+  if (created_b) {
+    memset(*data_buf_p, 0, dsize);
+  }
+  SET_POINTER(created_bp, created_b);
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * int table_insert_batch
+ *
+ * DESCRIPTION:
+ *
+ * Add a number of key/data pairs to a table.  All of the keys are
+ * hashed first and the memory where they go is prefetched so the
+ * cache misses of the keys overlap before we probe and insert them in
+ * order.  If a key is already in the table then the merge function is
+ * called to combine the new data with the old, for example to add a
+ * count to the existing count.
+ *
+ * NOTE: No pointers into the table are passed back since adding the
+ * later keys of the batch may move the entries of the earlier ones.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.  The keys before the failing one will
+ * have been added.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table structure pointer into which we will be inserting
+ * the key/data pairs.
+ *
+ * key_bufs - Array of the buffers of bytes of the keys that we are
+ * inserting.
+ *
+ * key_sizes - Array of the sizes of the key buffers.  If a size is
+ * < 0 then the library will do a strlen of the key and add 1 for the
+ * '\0'.
+ *
+ * data_bufs - Buffer of the data for each of the keys one after the
+ * other.
+ *
+ * data_size - Size of the data of each key.
+ *
+ * key_n - Number of keys that we are inserting.
+ *
+ * merge_func - Function which merges the data into the data of an
+ * existing key.  If NULL then the existing data is left alone.
+ */
+int	table_insert_batch(table_t *table_p, const void **key_bufs,
+			   const int *key_sizes, const void *data_bufs,
+			   const int data_size, const int key_n,
+			   table_merge_t merge_func)
+{
+  unsigned int	ksizes[BATCH_MAX], hashes[BATCH_MAX];
+  int		key_c, batch_c, batch_n, ret;
+  const char	*data_p;
+  void		*old_p;
+  
+  if (table_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (table_p->ta_magic != TABLE_MAGIC) {
+    return TABLE_ERROR_PNT;
+  }
+  if (table_p->ta_mmap != NULL) {
+    return TABLE_ERROR_MMAP_OP;
+  }
+  if (key_bufs == NULL || key_sizes == NULL || data_bufs == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (data_size <= 0 || key_n < 0) {
+    return TABLE_ERROR_SIZE;
+  }
+  /* the other threads would need to be locked out */
+  if (table_p->ta_locks != NULL) {
+    return TABLE_ERROR_CONCURRENT;
+  }
+  
+  for (key_c = 0; key_c < key_n; key_c += batch_n) {
+    batch_n = key_n - key_c;
+    if (batch_n > BATCH_MAX) {
+      batch_n = BATCH_MAX;
+    }
+    
+    /* hash all of the keys and start loading where they go */
+    for (batch_c = 0; batch_c < batch_n; batch_c++) {
+      if (key_bufs[key_c + batch_c] == NULL) {
+	return TABLE_ERROR_ARG_NULL;
+      }
+      if (key_sizes[key_c + batch_c] < 0) {
+	ksizes[batch_c] = strlen((char *)key_bufs[key_c + batch_c])
+	  + sizeof(char);
+      }
+      else {
+	ksizes[batch_c] = key_sizes[key_c + batch_c];
+      }
+      hashes[batch_c] = key_hash(table_p, key_bufs[key_c + batch_c],
+				 ksizes[batch_c]);
+      prefetch_bucket(table_p, hashes[batch_c]);
+    }
+    
+    /* then the first entries of the chains as their heads arrive */
+    if (! (table_p->ta_flags & TABLE_FLAG_OPEN_ADDRESS)) {
+      for (batch_c = 0; batch_c < batch_n; batch_c++) {
+	PREFETCH(*bucket_head(table_p, hashes[batch_c]));
+      }
+    }
+    
+    /* by now the first of them should have arrived */
+    data_p = (const char *)data_bufs + key_c * data_size;
+    for (batch_c = 0; batch_c < batch_n; batch_c++, data_p += data_size) {
+      ret = insert_hashed(table_p, key_bufs[key_c + batch_c], ksizes[batch_c],
+			  hashes[batch_c], data_p, data_size, NULL, &old_p, 0,
+			  NULL);
+      if (ret == TABLE_ERROR_OVERWRITE) {
+	if (merge_func != NULL) {
+	  merge_func(old_p, data_p, data_size);
+	}
+      }
+      else if (ret != TABLE_ERROR_NONE) {
+	return ret;
+      }
+    }
+  }
+  
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * int table_insert_concurrent
+ *
+ * DESCRIPTION:
+ *
+ * Add a key/data pair to a table which was set up with
+ * table_set_concurrent while other threads may be doing the same.
+ * If the key is already in the table then the merge function is
+ * called to combine the new data with the old, for example to add a
+ * count to the existing count.
+ *
+ * NOTE: No pointers into the table are passed back since another
+ * thread may be changing the data as soon as we return.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE if the key was added.
+ *
+ * Failure - Table error code.  TABLE_ERROR_OVERWRITE if the key
+ * already existed and its data was merged.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table structure pointer into which we will be inserting a
+ * new key/data pair.
+ *
+ * key_buf - Buffer of bytes of the key that we are inserting.
+ *
+ * key_size - Size of the key_buf buffer.  If set to < 0 then the
+ * library will do a strlen of key_buf and add 1 for the '\0'.
+ *
+ * data_buf - Buffer of bytes of the data that we are inserting.
+ *
+ * data_size - Size of the data_buf buffer.  If set to < 0 then the
+ * library will do a strlen of data_buf and add 1 for the '\0'.
+ *
+ * merge_func - Function which merges the data into the data of an
+ * existing key.  If NULL then the existing data is left alone.
+ */
+int	table_insert_concurrent(table_t *table_p,
+				const void *key_buf, const int key_size,
+				const void *data_buf, const int data_size,
+				table_merge_t merge_func)
+{
+#ifdef NO_THREADS
+  return TABLE_ERROR_CONCURRENT;
+#else
+  table_locks_t		*locks_p;
+  pthread_mutex_t	*stripe_p;
+  table_entry_t		*entry_p, **bucket_p;
+  unsigned int		ksize, dsize, hash_val, entry_n, bucket;
+  void			*data_copy_p;
+  int			grow_b, ret;
+  
+  if (table_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (table_p->ta_magic != TABLE_MAGIC) {
+    return TABLE_ERROR_PNT;
+  }
+  if (table_p->ta_mmap != NULL) {
+    return TABLE_ERROR_MMAP_OP;
+  }
+  locks_p = table_p->ta_locks;
+  if (locks_p == NULL) {
+    return TABLE_ERROR_CONCURRENT;
+  }
+  if (key_buf == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if ((data_buf == NULL && data_size < 0)
+      || (data_buf != NULL && data_size == 0)) {
+    return TABLE_ERROR_SIZE;
+  }
+  
+  if (key_size < 0) {
+    ksize = strlen((char *)key_buf) + sizeof(char);
+  }
+  else {
+    ksize = key_size;
+  }
+  if (data_size < 0) {
+    dsize = strlen((char *)data_buf) + sizeof(char);
+  }
+  else {
+    dsize = data_size;
+  }
+  hash_val = key_hash(table_p, key_buf, ksize);
+  
+  /* the read lock keeps the buckets from being rebuilt under us */
+  (void)pthread_rwlock_rdlock(&locks_p->lo_grow_lock);
+  bucket = bucket_index(hash_val, table_p->ta_bucket_n,
+			table_p->ta_bucket_mask);
+  stripe_p = locks_p->lo_stripes + (bucket & (locks_p->lo_stripe_n - 1));
+  (void)pthread_mutex_lock(stripe_p);
+  bucket_p = table_p->ta_buckets + bucket;
+  
+  for (entry_p = *bucket_p; entry_p != NULL; entry_p = entry_p->te_next_p) {
+    if (entry_p->te_hash == hash_val
+	&& entry_p->te_key_size == ksize
+	&& memcmp(ENTRY_KEY_BUF(entry_p), key_buf, ksize) == 0) {
+      break;
+    }
+  }
+  
+  if (entry_p != NULL) {
+    if (merge_func != NULL && entry_p->te_data_size > 0) {
+      if (table_p->ta_data_align == 0) {
+	data_copy_p = ENTRY_DATA_BUF(table_p, entry_p);
+      }
+      else {
+	data_copy_p = entry_data_buf(table_p, entry_p);
+      }
+      merge_func(data_copy_p, data_buf, entry_p->te_data_size);
+    }
+    (void)pthread_mutex_unlock(stripe_p);
+    (void)pthread_rwlock_unlock(&locks_p->lo_grow_lock);
+    return TABLE_ERROR_OVERWRITE;
+  }
+  
+  /* the arena and the user's functions are not thread safe */
+  if (table_p->ta_arena != NULL || table_p->ta_alloc_func != NULL) {
+    (void)pthread_mutex_lock(&locks_p->lo_alloc_lock);
+    entry_p = entry_alloc(table_p, entry_size(table_p, ksize, dsize));
+    (void)pthread_mutex_unlock(&locks_p->lo_alloc_lock);
+  }
+  else {
+    entry_p = entry_alloc(table_p, entry_size(table_p, ksize, dsize));
+  }
+  if (entry_p == NULL) {
+    (void)pthread_mutex_unlock(stripe_p);
+    (void)pthread_rwlock_unlock(&locks_p->lo_grow_lock);
+    return TABLE_ERROR_ALLOC;
+  }
+  
+  entry_p->te_key_size = ksize;
+  entry_p->te_hash = hash_val;
+  memcpy(ENTRY_KEY_BUF(entry_p), key_buf, ksize);
+  entry_p->te_data_size = dsize;
+  if (dsize > 0 && data_buf != NULL) {
+    if (table_p->ta_data_align == 0) {
+      data_copy_p = ENTRY_DATA_BUF(table_p, entry_p);
+    }
+    else {
+      data_copy_p = entry_data_buf(table_p, entry_p);
+    }
+    memcpy(data_copy_p, data_buf, dsize);
+  }
+  
+  entry_p->te_next_p = *bucket_p;
+  *bucket_p = entry_p;
+  (void)pthread_mutex_unlock(stripe_p);
+  
+  entry_n = __sync_add_and_fetch(&table_p->ta_entry_n, 1);
+  grow_b = ((table_p->ta_flags & TABLE_FLAG_AUTO_ADJUST)
+	    && entry_n > table_p->ta_bucket_n * 2);
+  (void)pthread_rwlock_unlock(&locks_p->lo_grow_lock);
+  
+  if (! grow_b) {
+    return TABLE_ERROR_NONE;
+  }
+  
+  /* another thread may have grown the table while we waited */
+  ret = TABLE_ERROR_NONE;
+  (void)pthread_rwlock_wrlock(&locks_p->lo_grow_lock);
+  if (SHOULD_TABLE_GROW(table_p)) {
+    ret = table_adjust(table_p, table_p->ta_entry_n);
+  }
+  (void)pthread_rwlock_unlock(&locks_p->lo_grow_lock);
+  
+  return ret;
+#endif
+}
+
+/*
+ * int table_retrieve
+ *
+ * DESCRIPTION:
+ *
+ * This routine looks up a key made up of a buffer of bytes and an
+ * associated size in the table.  If found then it returns the
+ * associated data information.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table structure pointer into which we will be searching
+ * for the key.
+ *
+ * key_buf - Buffer of bytes of the key that we are searching for.  If
+ * you are looking for an (int) as the key (for example) then key_buf
+ * should be a (int *).
+ *
+ * key_size - Size of the key_buf buffer.  If set to < 0 then the
+ * library will do a strlen of key_buf and add 1 for the '\0'.  If you
+ * are looking for an (int) as the key (for example) then key_size
+ * should be sizeof(int).
+ *
+ * data_buf_p - Pointer which, if not NULL, will be set to the address
+ * of the data storage that was allocated in the table and that is
+ * associated with the key.  If a (long) was stored as the data (for
+ * example) then data_buf_p should be (long **) i.e. the address of a
+ * (long *).
+ *
+ * data_size_p - Pointer to an integer which, if not NULL, will be set
+ * to the size of the data stored in the table that is associated with
+ * the key.
+ */
+int	table_retrieve(table_t *table_p,
+		       const void *key_buf, const int key_size,
+		       void **data_buf_p, int *data_size_p)
+{
+  int		bucket;
+  unsigned int	ksize, hash_val;
+  table_entry_t	*entry_p, *next_p, **buckets;
+  
+  if (table_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (table_p->ta_magic != TABLE_MAGIC) {
+    return TABLE_ERROR_PNT;
+  }
+  if (key_buf == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  
+  /* find key size */
+  if (key_size < 0) {
+    ksize = strlen((char *)key_buf) + sizeof(char);
+  }
+  else {
+    ksize = key_size;
+  }
+  
+  /* get the bucket number via a has function */
+  hash_val = key_hash(table_p, key_buf, ksize);
+  buckets = table_p->ta_buckets;
+  next_p = NULL;
+  
+  if (table_p->ta_flags & TABLE_FLAG_OPEN_ADDRESS) {
+    bucket = open_find(table_p, key_buf, ksize, hash_val, NULL);
+    if (bucket < 0) {
+      entry_p = NULL;
+    }
+    else {
+      entry_p = buckets[bucket];
+    }
+  }
+  else {
+    /* look for the entry in this bucket, only check keys of the same hash */
+    next_p = *bucket_head(table_p, hash_val);
+    entry_p = TABLE_HEAD(table_p, next_p);
+    while (entry_p != NULL) {
+      if (entry_p->te_hash == hash_val
+	  && entry_p->te_key_size == ksize
+	  && memcmp(ENTRY_KEY_BUF(entry_p), key_buf, ksize) == 0) {
+	break;
+      }
+      next_p = entry_p->te_next_p;
+      entry_p = TABLE_NEXT(table_p, entry_p);
+    }
+  }
+  
+  /* not found or an offset in a mapped table's file was bad? */
+  if (entry_p == NULL) {
+    if (next_p != NULL) {
+      return TABLE_ERROR_FILE;
+    }
+    return TABLE_ERROR_NOT_FOUND;
+  }
+  
+  if (data_buf_p != NULL) {
+    if (entry_p->te_data_size == 0) {
+      *data_buf_p = NULL;
+    }
+    else {
+      if (table_p->ta_data_align == 0) {
+	*data_buf_p = ENTRY_DATA_BUF(table_p, entry_p);
+      }
+      else {
+	*data_buf_p = entry_data_buf(table_p, entry_p);
+      }
+    }
+  }
+  SET_POINTER(data_size_p, entry_p->te_data_size);
+  
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * int table_delete
+ *
+ * DESCRIPTION:
+ *
+ * This routine looks up a key made up of a buffer of bytes and an
+ * associated size in the table.  If found then it will be removed
+ * from the table.  The associated data can be passed back to the user
+ * if requested.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * NOTE: this could be an allocation error if the library is to return
+ * the data to the user.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table structure pointer from which we will be deleteing
+ * the key.
+ *
+ * key_buf - Buffer of bytes of the key that we are searching for to
+ * delete.  If you are deleting an (int) key (for example) then
+ * key_buf should be a (int *).
+ *
+ * key_size - Size of the key_buf buffer.  If set to < 0 then the
+ * library will do a strlen of key_buf and add 1 for the '\0'.  If you
+ * are deleting an (int) key (for example) then key_size should be
+ * sizeof(int).
+ *
+ * data_buf_p - Pointer which, if not NULL, will be set to the address
+ * of the data storage that was allocated in the table and that was
+ * associated with the key.  If a (long) was stored as the data (for
+ * example) then data_buf_p should be (long **) i.e. the address of a
+ * (long *).  If a pointer is passed in, the caller is responsible for
+ * freeing it after use.  If data_buf_p is NULL then the library will
+ * free up the data allocation itself.
+ *
+ * data_size_p - Pointer to an integer which, if not NULL, will be set
+ * to the size of the data that was stored in the table and that was
+ * associated with the key.
+ */
+int	table_delete(table_t *table_p,
+		     const void *key_buf, const int key_size,
+		     void **data_buf_p, int *data_size_p)
+{
+  int		bucket;
+  unsigned int	ksize, hash_val;
+  unsigned char	*data_copy_p;
+  table_entry_t	*entry_p, *last_p, **bucket_p;
+  
+  if (table_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (table_p->ta_magic != TABLE_MAGIC) {
+    return TABLE_ERROR_PNT;
+  }
+  if (table_p->ta_mmap != NULL) {
+    return TABLE_ERROR_MMAP_OP;
+  }
+  if (key_buf == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  
+  /* get the key size */
+  if (key_size < 0) {
+    ksize = strlen((char *)key_buf) + sizeof(char);
+  }
+  else {
+    ksize = key_size;
+  }
+  
+  /* find our bucket */
+  hash_val = key_hash(table_p, key_buf, ksize);
+  last_p = NULL;
+  
+  if (table_p->ta_flags & TABLE_FLAG_OPEN_ADDRESS) {
+    bucket = open_find(table_p, key_buf, ksize, hash_val, NULL);
+    if (bucket < 0) {
+      entry_p = NULL;
+    }
+    else {
+      entry_p = table_p->ta_buckets[bucket];
+      /* the slot may still be on the probe path of other keys */
+      table_p->ta_ctrl[bucket] = OPEN_DELETED;
+      table_p->ta_deleted_n++;
+    }
+    bucket_p = table_p->ta_buckets + bucket;
+  }
+  else {
+    bucket_p = bucket_head(table_p, hash_val);
+    
+    /* look for the entry in this bucket, only check keys of the same hash */
+    for (entry_p = *bucket_p;
+	 entry_p != NULL;
+	 last_p = entry_p, entry_p = entry_p->te_next_p) {
+      if (entry_p->te_hash == hash_val
+	  && entry_p->te_key_size == ksize
+	  && memcmp(ENTRY_KEY_BUF(entry_p), key_buf, ksize) == 0) {
+	break;
+      }
+    }
+  }
+  
+  /* did we find it? */
+  if (entry_p == NULL) {
+    return TABLE_ERROR_NOT_FOUND;
+  }
+  
+  /*
+   * NOTE: we may want to adjust the linear counters here if the entry
+   * we are deleting is the one we are pointing on or is ahead of the
+   * one in the bucket list
+   */
+  
+  /* remove entry from the linked list */
+  if (last_p == NULL) {
+    *bucket_p = entry_p->te_next_p;
+  }
+  else {
+    last_p->te_next_p = entry_p->te_next_p;
+  }
+  
+  /* free entry */
+  if (data_buf_p != NULL) {
+    if (entry_p->te_data_size == 0) {
+      *data_buf_p = NULL;
+    }
+    else {
+      /*
+       * if we were storing it compacted, we now need to malloc some
+       * space if the user wants the value after the delete.
+       */
+      if (table_p->ta_alloc_func == NULL) {
+	*data_buf_p = malloc(entry_p->te_data_size);
+      }
+      else {
+	*data_buf_p = table_p->ta_alloc_func(table_p->ta_mem_pool,
+					     entry_p->te_data_size);
+      }
+      if (*data_buf_p == NULL) {
+	return TABLE_ERROR_ALLOC;
+      }
+      if (table_p->ta_data_align == 0) {
+	data_copy_p = ENTRY_DATA_BUF(table_p, entry_p);
+      }
+      else {
+	data_copy_p = entry_data_buf(table_p, entry_p);
+      }
+      memcpy(*data_buf_p, data_copy_p, entry_p->te_data_size);
+    }
+  }
+  SET_POINTER(data_size_p, entry_p->te_data_size);
+  if (table_p->ta_arena != NULL || ENTRY_INLINE(table_p, entry_p)) {
+    /* the space is reclaimed when the arena is cleared or slot reused */
+  }
+  else if (table_p->ta_free_func == NULL) {
+    free(entry_p);
+  }
+  else if (! table_p->ta_free_func(table_p->ta_mem_pool, entry_p,
+				   entry_size(table_p,
+					      entry_p->te_key_size,
+					      entry_p->te_data_size))) {
+    return TABLE_ERROR_FREE;
+  }
+  
+  table_p->ta_entry_n--;
+  
+  /* do we need auto-adjust down? */
+  if ((table_p->ta_flags & TABLE_FLAG_AUTO_ADJUST)
+      && (table_p->ta_flags & TABLE_FLAG_ADJUST_DOWN)
+      && SHOULD_TABLE_SHRINK(table_p)) {
+    return table_adjust(table_p, table_p->ta_entry_n);
+  }
+  
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * int table_delete_first
+ *
+ * DESCRIPTION:
+ *
+ * This is like the table_delete routines except it deletes the first
+ * key/data pair in the table instead of an entry corresponding to a
+ * particular key.  The associated key and data information can be
+ * passed back to the user if requested.  This routines is handy to
+ * clear out a table.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * NOTE: this could be an allocation error if the library is to return
+ * the data to the user.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table structure pointer from which we will be deleteing
+ * the first key.
+ *
+ * key_buf_p - Pointer which, if not NULL, will be set to the address
+ * of the storage of the first key that was allocated in the table.
+ * If an (int) was stored as the first key (for example) then
+ * key_buf_p should be (int **) i.e. the address of a (int *).  If a
+ * pointer is passed in, the caller is responsible for freeing it
+ * after use.  If key_buf_p is NULL then the library will free up the
+ * key allocation itself.
+ *
+ * key_size_p - Pointer to an integer which, if not NULL, will be set
+ * to the size of the key that was stored in the table and that was
+ * associated with the key.
+ *
+ * data_buf_p - Pointer which, if not NULL, will be set to the address
+ * of the data storage that was allocated in the table and that was
+ * associated with the key.  If a (long) was stored as the data (for
+ * example) then data_buf_p should be (long **) i.e. the address of a
+ * (long *).  If a pointer is passed in, the caller is responsible for
+ * freeing it after use.  If data_buf_p is NULL then the library will
+ * free up the data allocation itself.
+ *
+ * data_size_p - Pointer to an integer which, if not NULL, will be set
+ * to the size of the data that was stored in the table and that was
+ * associated with the key.
+ */
+int	table_delete_first(table_t *table_p,
+			   void **key_buf_p, int *key_size_p,
+			   void **data_buf_p, int *data_size_p)
 {
-  int		bucket;
-  unsigned int	ksize, dsize, new_size, old_size, copy_size;
-  table_entry_t	*entry_p, *last_p, *new_entry_p;
-  void		*key_copy_p, *data_copy_p;
+  unsigned char		*data_copy_p;
+  table_entry_t		*entry_p;
+  table_linear_t	linear;
+  int			ret;
   
-  /* check the arguments */
   if (table_p == NULL) {
     return TABLE_ERROR_ARG_NULL;
   }
   if (table_p->ta_magic != TABLE_MAGIC) {
     return TABLE_ERROR_PNT;
   }
-  if (key_buf == NULL) {
-    return TABLE_ERROR_ARG_NULL;
-  }
-  /* data_buf can be null but size must be >= 0, if it isn't null size != 0 */
-  if ((data_buf == NULL && data_size < 0)
-      || (data_buf != NULL && data_size == 0)) {
-    return TABLE_ERROR_SIZE;
+  if (table_p->ta_mmap != NULL) {
+    return TABLE_ERROR_MMAP_OP;
   }
   
-  /* determine sizes of key and data */
-  if (key_size < 0) {
-    ksize = strlen((char *)key_buf) + sizeof(char);
-  }
-  else {
-    ksize = key_size;
-  }
-  if (data_size < 0) {
-    dsize = strlen((char *)data_buf) + sizeof(char);
+  /* finish any incremental growing before we walk the buckets */
+  ret = migrate_buckets(table_p, table_p->ta_old_bucket_n);
+  if (ret != TABLE_ERROR_NONE) {
+    return ret;
   }
-  else {
-    dsize = data_size;
+  
+  /* take the first entry */
+  entry_p = first_entry(table_p, &linear, NULL);
+  if (entry_p == NULL) {
+    return TABLE_ERROR_NOT_FOUND;
   }
   
-  /* get the bucket number via a hash function */
-  bucket = hash(key_buf, ksize, 0) % table_p->ta_bucket_n;
+  /*
+   * NOTE: we may want to adjust the linear counters here if the entry
+   * we are deleting is the one we are pointing on or is ahead of the
+   * one in the bucket list
+   */
   
-  /* look for the entry in this bucket, only check keys of the same size */
-  last_p = NULL;
-  for (entry_p = table_p->ta_buckets[bucket];
-       entry_p != NULL;
-       last_p = entry_p, entry_p = entry_p->te_next_p) {
-    if (entry_p->te_key_size == ksize
-	&& memcmp(ENTRY_KEY_BUF(entry_p), key_buf, ksize) == 0) {
-      break;
-    }
+  /* remove entry from the linked list */
+  table_p->ta_buckets[linear.tl_bucket_c] = entry_p->te_next_p;
+  if (table_p->ta_flags & TABLE_FLAG_OPEN_ADDRESS) {
+    table_p->ta_ctrl[linear.tl_bucket_c] = OPEN_DELETED;
+    table_p->ta_deleted_n++;
   }
   
-  /* did we find it?  then we are in replace mode. */
-  if (entry_p != NULL) {
-    
-    /* can we not overwrite existing data? */
-    if (! overwrite_b) {
-      SET_POINTER(key_buf_p, ENTRY_KEY_BUF(entry_p));
-      if (data_buf_p != NULL) {
-	if (entry_p->te_data_size == 0) {
-	  *data_buf_p = NULL;
-	}
-	else {
-	  if (table_p->ta_data_align == 0) {
-	    *data_buf_p = ENTRY_DATA_BUF(table_p, entry_p);
-	  }
-	  else {
-	    *data_buf_p = entry_data_buf(table_p, entry_p);
-	  }
-	}
-      }
-      return TABLE_ERROR_OVERWRITE;
+  /* free entry */
+  if (key_buf_p != NULL) {
+    if (entry_p->te_key_size == 0) {
+      *key_buf_p = NULL;
     }
-    
-    /* re-alloc entry's data if the new size != the old */
-    if (dsize != entry_p->te_data_size) {
-      
+    else {
       /*
-       * First we delete it from the list to keep the list whole.
-       * This properly preserves the linked list in case we have a
-       * thread marching through the linked list while we are
-       * inserting.  Maybe this is an unnecessary protection but it
-       * should not harm that much.
+       * if we were storing it compacted, we now need to malloc some
+       * space if the user wants the value after the delete.
        */
-      if (last_p == NULL) {
-	table_p->ta_buckets[bucket] = entry_p->te_next_p;
+      if (table_p->ta_alloc_func == NULL) {
+	*key_buf_p = malloc(entry_p->te_key_size);
       }
       else {
-	last_p->te_next_p = entry_p->te_next_p;
+	*key_buf_p = table_p->ta_alloc_func(table_p->ta_mem_pool,
+					    entry_p->te_key_size);
       }
-      
+      if (*key_buf_p == NULL) {
+	return TABLE_ERROR_ALLOC;
+      }
+      memcpy(*key_buf_p, ENTRY_KEY_BUF(entry_p), entry_p->te_key_size);
+    }
+  }
+  SET_POINTER(key_size_p, entry_p->te_key_size);
+  
+  if (data_buf_p != NULL) {
+    if (entry_p->te_data_size == 0) {
+      *data_buf_p = NULL;
+    }
+    else {
       /*
-       * Realloc the structure which may change its pointer. NOTE:
-       * this may change any previous data_key_p and data_copy_p
-       * pointers.
+       * if we were storing it compacted, we now need to malloc some
+       * space if the user wants the value after the delete.
        */
-      new_size = entry_size(table_p, entry_p->te_key_size, dsize);
-      if (table_p->ta_resize_func == NULL) {
-	/* if the alloc function has not been overriden do realloc */
-	if (table_p->ta_alloc_func == NULL) {
-	  entry_p = (table_entry_t *)realloc(entry_p, new_size);
-	  if (entry_p == NULL) {
-	    return TABLE_ERROR_ALLOC;
-	  }
-	}
-	else {
-	  old_size = new_size - dsize + entry_p->te_data_size;
-	  /*
-	   * if the user did override alloc but not resize, assume
-	   * that the user's allocation functions can't grok realloc
-	   * and do it ourselves the hard way.
-	   */
-	  new_entry_p =
-	    (table_entry_t *)table_p->ta_alloc_func(table_p->ta_mem_pool,
-						    new_size);
-	  if (new_entry_p == NULL) {
-	    return TABLE_ERROR_ALLOC;
-	  }
-	  if (new_size > old_size) {
-	    copy_size = old_size;
-	  }
-	  else {
-	    copy_size = new_size;
-	  }
-	  memcpy(new_entry_p, entry_p, copy_size);
-	  if (! table_p->ta_free_func(table_p->ta_mem_pool, entry_p,
-				      old_size)) {
-	    return TABLE_ERROR_FREE;
-	  }
-	  entry_p = new_entry_p;
-	}
+      if (table_p->ta_alloc_func == NULL) {
+	*data_buf_p = malloc(entry_p->te_data_size);
       }
       else {
-	old_size = new_size - dsize + entry_p->te_data_size;
-	entry_p = (table_entry_t *)
-	  table_p->ta_resize_func(table_p->ta_mem_pool, entry_p,
-				  old_size, new_size);
-	if (entry_p == NULL) {
-	  return TABLE_ERROR_ALLOC;
-	}
+	*data_buf_p = table_p->ta_alloc_func(table_p->ta_mem_pool,
+					     entry_p->te_data_size);
+      }
+      if (*data_buf_p == NULL) {
+	return TABLE_ERROR_ALLOC;
       }
-      
-      /* add it back to the front of the list */
-      entry_p->te_data_size = dsize;
-      entry_p->te_next_p = table_p->ta_buckets[bucket];
-      table_p->ta_buckets[bucket] = entry_p;
-    }
-    
-    /* copy or replace data in storage */
-    if (dsize > 0) {
       if (table_p->ta_data_align == 0) {
 	data_copy_p = ENTRY_DATA_BUF(table_p, entry_p);
       }
       else {
 	data_copy_p = entry_data_buf(table_p, entry_p);
       }
-      if (data_buf != NULL) {
-	memcpy(data_copy_p, data_buf, dsize);
-      }
-    }
-    else {
-      data_copy_p = NULL;
+      memcpy(*data_buf_p, data_copy_p, entry_p->te_data_size);
     }
-    
-    SET_POINTER(key_buf_p, ENTRY_KEY_BUF(entry_p));
-    SET_POINTER(data_buf_p, data_copy_p);
-    
-    /* returning from the section where we were overwriting table data */
-    return TABLE_ERROR_NONE;
+  }
+  SET_POINTER(data_size_p, entry_p->te_data_size);
+  if (table_p->ta_arena != NULL || ENTRY_INLINE(table_p, entry_p)) {
+    /* the space is reclaimed when the arena is cleared or slot reused */
+  }
+  else if (table_p->ta_free_func == NULL) {
+    free(entry_p);
+  }
+  else if (! table_p->ta_free_func(table_p->ta_mem_pool, entry_p,
+				   entry_size(table_p,
+					      entry_p->te_key_size,
+					      entry_p->te_data_size))) {
+    return TABLE_ERROR_FREE;
+  }
+  
+  table_p->ta_entry_n--;
+  
+  /* do we need auto-adjust down? */
+  if ((table_p->ta_flags & TABLE_FLAG_AUTO_ADJUST)
+      && (table_p->ta_flags & TABLE_FLAG_ADJUST_DOWN)
+      && SHOULD_TABLE_SHRINK(table_p)) {
+    return table_adjust(table_p, table_p->ta_entry_n);
+  }
+  
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * int table_info
+ *
+ * DESCRIPTION:
+ *
+ * Get some information about a table_p structure.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table structure pointer from which we are getting
+ * information.
+ *
+ * num_buckets_p - Pointer to an integer which, if not NULL, will
+ * contain the number of buckets in the table.
+ *
+ * num_entries_p - Pointer to an integer which, if not NULL, will
+ * contain the number of entries stored in the table.
+ */
+int	table_info(table_t *table_p, int *num_buckets_p, int *num_entries_p)
+{
+  if (table_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (table_p->ta_magic != TABLE_MAGIC) {
+    return TABLE_ERROR_PNT;
+  }
+  
+  SET_POINTER(num_buckets_p, table_p->ta_bucket_n);
+  SET_POINTER(num_entries_p, table_p->ta_entry_n);
+  
+  return TABLE_ERROR_NONE;
+}
+
+/*
+ * static void stats_entry
+ *
+ * DESCRIPTION:
+ *
+ * Add the memory of an entry that is not stored in a slot and the
+ * length of the chain or probe that finds it to our statistics.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table that the entry is in.
+ *
+ * entry_p - Entry that we are counting or NULL for only the length.
+ *
+ * len - Length of the chain or probe or -1 for none.
+ *
+ * stats_p - Statistics that we are adding to.
+ */
+static	void	stats_entry(const table_t *table_p,
+			    const table_entry_t *entry_p, int len,
+			    table_stats_t *stats_p)
+{
+  unsigned int	size;
+  
+  if (entry_p != NULL) {
+    size = entry_size(table_p, entry_p->te_key_size, entry_p->te_data_size);
+    stats_p->ts_entry_bytes += size;
+    stats_p->ts_padding_bytes += size - sizeof(struct table_shell_st)
+      - entry_p->te_key_size - entry_p->te_data_size;
   }
   
-  /*
-   * It is a new entry.
-   */
-  
-  /* allocate a new entry */
-  new_size = entry_size(table_p, ksize, dsize);
-  if (table_p->ta_alloc_func == NULL) {
-    entry_p = (table_entry_t *)malloc(new_size);
+  if (len < 0) {
+    return;
   }
-  else {
-    entry_p =
-      (table_entry_t *)table_p->ta_alloc_func(table_p->ta_mem_pool, new_size);
+  if (len > stats_p->ts_chain_max) {
+    stats_p->ts_chain_max = len;
   }
-  if (entry_p == NULL) {
-    return TABLE_ERROR_ALLOC;
+  if (len >= TABLE_STATS_CHAIN_N) {
+    len = TABLE_STATS_CHAIN_N - 1;
   }
+  stats_p->ts_chains[len]++;
+}
+
+/*
+ * static void stats_buckets
+ *
+ * DESCRIPTION:
+ *
+ * Add the bucket lists of a range of buckets to our statistics.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table that the buckets are in.
+ *
+ * bucket_p - First of the buckets.
+ *
+ * bounds_p - Just past the last of the buckets.
+ *
+ * stats_p - Statistics that we are adding to.
+ */
+static	void	stats_buckets(const table_t *table_p, table_entry_t **bucket_p,
+			      table_entry_t **bounds_p, table_stats_t *stats_p)
+{
+  table_entry_t	*entry_p;
+  int		len;
   
-  /* copy key into storage */
-  entry_p->te_key_size = ksize;
-  key_copy_p = ENTRY_KEY_BUF(entry_p);
-  memcpy(key_copy_p, key_buf, ksize);
-  
-  /* copy data in */
-  entry_p->te_data_size = dsize;
-  if (dsize > 0) {
-    if (table_p->ta_data_align == 0) {
-      data_copy_p = ENTRY_DATA_BUF(table_p, entry_p);
-    }
-    else {
-      data_copy_p = entry_data_buf(table_p, entry_p);
+  for (; bucket_p < bounds_p; bucket_p++) {
+    len = 0;
+    for (entry_p = *bucket_p; entry_p != NULL; entry_p = entry_p->te_next_p) {
+      stats_entry(table_p, entry_p, -1, stats_p);
+      len++;
     }
-    if (data_buf != NULL) {
-      memcpy(data_copy_p, data_buf, dsize);
+    if (len == 0) {
+      stats_p->ts_empty_n++;
     }
+    stats_entry(table_p, NULL, len, stats_p);
   }
-  else {
-    data_copy_p = NULL;
-  }
+}
+
+/*
+ * int table_stats
+ *
+ * DESCRIPTION:
+ *
+ * Get detailed statistics about a table to see why it is slow or uses
+ * a lot of memory: how full it is, how long the bucket chains or open
+ * addressing probes are, where its memory goes, and how often and
+ * how long it has been resized.  This walks the whole table.
+ *
+ * NOTE: The time spent moving buckets when growing incrementally is
+ * spread across the inserts and is not counted.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table structure pointer from which we are getting
+ * statistics.
+ *
+ * stats_p - Pointer to a table_stats_t structure which will be filled
+ * in with the statistics.
+ */
+int	table_stats(table_t *table_p, table_stats_t *stats_p)
+{
+  table_entry_t	*entry_p;
+  arena_chunk_t	*chunk_p;
+  unsigned int	group, group_mask, step;
+  int		slot;
   
-  SET_POINTER(key_buf_p, key_copy_p);
-  SET_POINTER(data_buf_p, data_copy_p);
+  if (table_p == NULL || stats_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (table_p->ta_magic != TABLE_MAGIC) {
+    return TABLE_ERROR_PNT;
+  }
+  if (table_p->ta_mmap != NULL) {
+    return TABLE_ERROR_MMAP_OP;
+  }
+  
+  memset(stats_p, 0, sizeof(*stats_p));
+  stats_p->ts_bucket_n = table_p->ta_bucket_n;
+  stats_p->ts_entry_n = table_p->ta_entry_n;
+  stats_p->ts_load = (double)table_p->ta_entry_n / table_p->ta_bucket_n;
+  stats_p->ts_deleted_n = table_p->ta_deleted_n;
+  stats_p->ts_adjust_n = table_p->ta_adjust_n;
+  stats_p->ts_adjust_secs = (double)table_p->ta_adjust_usecs / 1000000.0;
+  
+  if (table_p->ta_flags & TABLE_FLAG_OPEN_ADDRESS) {
+    stats_p->ts_bucket_bytes = table_p->ta_bucket_n
+      * (sizeof(table_entry_t *) + sizeof(unsigned char)
+	 + table_p->ta_inline_size);
+    group_mask = table_p->ta_bucket_n / OPEN_GROUP_SIZE - 1;
+  
+    for (slot = 0; slot < table_p->ta_bucket_n; slot++) {
+      if (table_p->ta_ctrl[slot] == OPEN_EMPTY
+	  || table_p->ta_ctrl[slot] == OPEN_DELETED) {
+	stats_p->ts_empty_n++;
+	continue;
+      }
   
-  /* insert into list, no need to append */
-  entry_p->te_next_p = table_p->ta_buckets[bucket];
-  table_p->ta_buckets[bucket] = entry_p;
+      /* follow the probe steps of open_find to the entry's group */
+      entry_p = table_p->ta_buckets[slot];
+      group = OPEN_GROUP(table_p, entry_p->te_hash);
+      for (step = 1;
+	   group != slot / OPEN_GROUP_SIZE && step <= group_mask + 1;
+	   step++) {
+	group = (group + step) & group_mask;
+      }
   
-  table_p->ta_entry_n++;
+      /* entries in the slots take no more space */
+      if (ENTRY_INLINE(table_p, entry_p)) {
+	stats_entry(table_p, NULL, step - 1, stats_p);
+      }
+      else {
+	stats_entry(table_p, entry_p, step - 1, stats_p);
+      }
+    }
+  }
+  else {
+    stats_p->ts_bucket_bytes =
+      (table_p->ta_bucket_n + table_p->ta_old_bucket_n)
+      * sizeof(table_entry_t *);
+    stats_buckets(table_p, table_p->ta_buckets,
+		  table_p->ta_buckets + table_p->ta_bucket_n, stats_p);
+    /* the old buckets that have not been moved still have entries */
+    if (table_p->ta_old_buckets != NULL) {
+      stats_buckets(table_p, table_p->ta_old_buckets + table_p->ta_migrate_c,
+		    table_p->ta_old_buckets + table_p->ta_old_bucket_n,
+		    stats_p);
+    }
+  }
   
-  /* do we need auto-adjust? */
-  if ((table_p->ta_flags & TABLE_FLAG_AUTO_ADJUST)
-      && SHOULD_TABLE_GROW(table_p)) {
-    return table_adjust(table_p, table_p->ta_entry_n);
+  if (table_p->ta_arena != NULL) {
+    for (chunk_p = table_p->ta_arena->ar_chunks;
+	 chunk_p != NULL;
+	 chunk_p = chunk_p->ac_next_p) {
+      stats_p->ts_arena_bytes += chunk_p->ac_size;
+    }
   }
   
   return TABLE_ERROR_NONE;
 }
 
 /*
- * int table_insert
+ * int table_adjust
  *
  * DESCRIPTION:
  *
- * Exactly the same as table_insert_kd except it does not pass back a
- * pointer to the key after they have been inserted into the table
- * structure.  This is still here for backwards compatibility.
- *
- * See table_insert_kd for more information.
+ * Set the number of buckets in a table to a certain value.
  *
  * RETURNS:
  *
@@ -1750,56 +5801,140 @@ int	table_insert_kd(table_t *table_p,
  *
  * ARGUMENTS:
  *
- * table_p - Table structure pointer into which we will be inserting a
- * new key/data pair.
- *
- * key_buf - Buffer of bytes of the key that we are inserting.  If you
- * are storing an (int) as the key (for example) then key_buf should
- * be a (int *).
- *
- * key_size - Size of the key_buf buffer.  If set to < 0 then the
- * library will do a strlen of key_buf and add 1 for the '\0'.  If you
- * are storing an (int) as the key (for example) then key_size should
- * be sizeof(int).
- *
- * data_buf - Buffer of bytes of the data that we are inserting.  If
- * it is NULL then the library will allocate space for the data in the
- * table without copying in any information.  If data_buf is NULL and
- * data_size is 0 then the library will associate a NULL data pointer
- * with the key.  If you are storing a (long) as the data (for
- * example) then data_buf should be a (long *).
- *
- * data_size - Size of the data_buf buffer.  If set to < 0 then the
- * library will do a strlen of data_buf and add 1 for the '\0'.  If
- * you are storing an (long) as the key (for example) then key_size
- * should be sizeof(long).
- *
- * data_buf_p - Pointer which, if not NULL, will be set to the address
- * of the data storage that was allocated in the table.  If you are
- * storing an (long) as the data (for example) then data_buf_p should
- * be (long **) i.e. the address of a (long *).
+ * table_p - Table structure pointer of which we are adjusting.
  *
- * overwrite - Flag which, if set to 1, will allow the overwriting of
- * the data in the table with the new data if the key already exists
- * in the table.
+ * bucket_n - Number buckets to adjust the table to.  Set to 0 to
+ * adjust the table to its number of entries.
  */
-int	table_insert(table_t *table_p,
-		     const void *key_buf, const int key_size,
-		     const void *data_buf, const int data_size,
-		     void **data_buf_p, const char overwrite_b)
+int	table_adjust(table_t *table_p, const int bucket_n)
 {
-  return table_insert_kd(table_p, key_buf, key_size, data_buf, data_size,
-			 NULL, data_buf_p, overwrite_b);
+  table_entry_t	*entry_p, *next_p;
+  table_entry_t	**buckets, **bucket_p, **bounds_p;
+  int		bucket, ret;
+  unsigned int	buck_n, buck_mask, bucket_size, size;
+  unsigned long long	start;
+  
+  if (table_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (table_p->ta_magic != TABLE_MAGIC) {
+    return TABLE_ERROR_PNT;
+  }
+  if (table_p->ta_mmap != NULL) {
+    return TABLE_ERROR_MMAP_OP;
+  }
+  
+  /* finish any incremental growing before we start another */
+  ret = migrate_buckets(table_p, table_p->ta_old_bucket_n);
+  if (ret != TABLE_ERROR_NONE) {
+    return ret;
+  }
+  
+  /* normalize to the number of entries */
+  if (bucket_n == 0) {
+    buck_n = table_p->ta_entry_n;
+  }
+  else {
+    buck_n = bucket_n;
+  }
+  
+  /* we must have at least 1 bucket */
+  if (buck_n == 0) {
+    buck_n = 1;
+  }
+  
+  if (table_p->ta_flags & TABLE_FLAG_OPEN_ADDRESS) {
+    /* this always re-sizes which also clears out the deleted slots */
+    return open_resize(table_p, buck_n);
+  }
+  
+  /* when we are auto-adjusting, round up to 2^X so we can mask */
+  if (table_p->ta_flags & TABLE_FLAG_AUTO_ADJUST) {
+    for (size = 1; size < buck_n; size *= 2) {
+    }
+    buck_n = size;
+  }
+  
+  /* make sure we have something to do */
+  if (buck_n == table_p->ta_bucket_n) {
+    return TABLE_ERROR_NONE;
+  }
+  
+  /* allocate a new bucket list */
+  start = usecs_now();
+  bucket_size = buck_n * sizeof(table_entry_t *);
+  if (table_p->ta_alloc_func == NULL) {
+    buckets = (table_entry_t **)malloc(bucket_size);
+  }
+  else {
+    buckets =
+      (table_entry_t **)table_p->ta_alloc_func(table_p->ta_mem_pool,
+					       bucket_size);
+  }
+  if (buckets == NULL) {
+    return TABLE_ERROR_ALLOC;
+  }
+  /*
+   * We zero it ourselves to save the necessity of having a
+   * table_mem_calloc_t memory override function.
+   */
+  memset(buckets, 0, bucket_size);
+  
+  /*
+   * run through each of the items in the current table and re-mod
+   * their stored hash values into the newest bucket sizes
+   */
+  buck_mask = BUCKET_MASK(buck_n);
+  bounds_p = table_p->ta_buckets + table_p->ta_bucket_n;
+  for (bucket_p = table_p->ta_buckets; bucket_p < bounds_p; bucket_p++) {
+    for (entry_p = *bucket_p; entry_p != NULL; entry_p = next_p) {
+      
+      /* we stored the full hash so we don't have to touch the key */
+      bucket = bucket_index(entry_p->te_hash, buck_n, buck_mask);
+      
+      /* record the next one now since we overwrite next below */
+      next_p = entry_p->te_next_p;
+      
+      /* insert into new list, no need to append */
+      entry_p->te_next_p = buckets[bucket];
+      buckets[bucket] = entry_p;
+      
+      /*
+       * NOTE: we may want to adjust the bucket_c linear entry here to
+       * keep it current
+       */
+    }
+    /* remove the old table pointers as we go by */
+    *bucket_p = NULL;
+  }
+  
+  /* replace the table buckets with the new ones */
+  if (table_p->ta_free_func == NULL) {
+    free(table_p->ta_buckets);
+  }
+  else if (! table_p->ta_free_func(table_p->ta_mem_pool,
+				   table_p->ta_buckets,
+				   table_p->ta_bucket_n *
+				   sizeof(table_entry_t *))) {
+    return TABLE_ERROR_FREE;
+  }
+  table_p->ta_buckets = buckets;
+  table_p->ta_bucket_n = buck_n;
+  table_p->ta_bucket_mask = buck_mask;
+  adjust_count(table_p, start);
+  
+  return TABLE_ERROR_NONE;
 }
 
 /*
- * int table_retrieve
+ * int table_reserve
  *
  * DESCRIPTION:
  *
- * This routine looks up a key made up of a buffer of bytes and an
- * associated size in the table.  If found then it returns the
- * associated data information.
+ * Grow a table so that it can hold a number of entries without having
+ * to grow again.  If you know roughly how many keys are coming this
+ * saves all of the rehashing that auto-adjusting does on the way up.
+ * The table is never shrunk.
  *
  * RETURNS:
  *
@@ -1809,35 +5944,13 @@ int	table_insert(table_t *table_p,
  *
  * ARGUMENTS:
  *
- * table_p - Table structure pointer into which we will be searching
- * for the key.
- *
- * key_buf - Buffer of bytes of the key that we are searching for.  If
- * you are looking for an (int) as the key (for example) then key_buf
- * should be a (int *).
- *
- * key_size - Size of the key_buf buffer.  If set to < 0 then the
- * library will do a strlen of key_buf and add 1 for the '\0'.  If you
- * are looking for an (int) as the key (for example) then key_size
- * should be sizeof(int).
- *
- * data_buf_p - Pointer which, if not NULL, will be set to the address
- * of the data storage that was allocated in the table and that is
- * associated with the key.  If a (long) was stored as the data (for
- * example) then data_buf_p should be (long **) i.e. the address of a
- * (long *).
- *
- * data_size_p - Pointer to an integer which, if not NULL, will be set
- * to the size of the data stored in the table that is associated with
- * the key.
+ * table_p - Table structure pointer which we are growing.
+ *
+ * entry_n - Number of entries that the table should be able to hold.
  */
-int	table_retrieve(table_t *table_p,
-		       const void *key_buf, const int key_size,
-		       void **data_buf_p, int *data_size_p)
+int	table_reserve(table_t *table_p, const int entry_n)
 {
-  int		bucket;
-  unsigned int	ksize;
-  table_entry_t	*entry_p, **buckets;
+  unsigned int	slot_n;
   
   if (table_p == NULL) {
     return TABLE_ERROR_ARG_NULL;
@@ -1845,120 +5958,81 @@ int	table_retrieve(table_t *table_p,
   if (table_p->ta_magic != TABLE_MAGIC) {
     return TABLE_ERROR_PNT;
   }
-  if (key_buf == NULL) {
-    return TABLE_ERROR_ARG_NULL;
-  }
-  
-  /* find key size */
-  if (key_size < 0) {
-    ksize = strlen((char *)key_buf) + sizeof(char);
+  if (table_p->ta_mmap != NULL) {
+    return TABLE_ERROR_MMAP_OP;
   }
-  else {
-    ksize = key_size;
+  if (entry_n < 0) {
+    return TABLE_ERROR_SIZE;
   }
   
-  /* get the bucket number via a has function */
-  bucket = hash(key_buf, ksize, 0) % table_p->ta_bucket_n;
-  
-  /* look for the entry in this bucket, only check keys of the same size */
-  buckets = table_p->ta_buckets;
-  for (entry_p = buckets[bucket];
-       entry_p != NULL;
-       entry_p = entry_p->te_next_p) {
-    if (entry_p->te_key_size == ksize
-	&& memcmp(ENTRY_KEY_BUF(entry_p), key_buf, ksize) == 0) {
-      break;
+  if (table_p->ta_flags & TABLE_FLAG_OPEN_ADDRESS) {
+    /* enough slots that the entries stay under 7/8ths of them */
+    slot_n = ((unsigned int)entry_n / 7 + 1) * 8;
+    if (slot_n <= table_p->ta_bucket_n) {
+      return TABLE_ERROR_NONE;
     }
+    return table_adjust(table_p, slot_n);
   }
   
-  /* not found? */
-  if (entry_p == NULL) {
-    return TABLE_ERROR_NOT_FOUND;
-  }
-  
-  if (data_buf_p != NULL) {
-    if (entry_p->te_data_size == 0) {
-      *data_buf_p = NULL;
-    }
-    else {
-      if (table_p->ta_data_align == 0) {
-	*data_buf_p = ENTRY_DATA_BUF(table_p, entry_p);
-      }
-      else {
-	*data_buf_p = entry_data_buf(table_p, entry_p);
-      }
-    }
+  /* one bucket for each entry, auto-adjusting grows at two */
+  if ((unsigned int)entry_n <= table_p->ta_bucket_n) {
+    return TABLE_ERROR_NONE;
   }
-  SET_POINTER(data_size_p, entry_p->te_data_size);
-  
-  return TABLE_ERROR_NONE;
+  return table_adjust(table_p, entry_n);
 }
 
 /*
- * int table_delete
+ * int table_type_size
  *
  * DESCRIPTION:
  *
- * This routine looks up a key made up of a buffer of bytes and an
- * associated size in the table.  If found then it will be removed
- * from the table.  The associated data can be passed back to the user
- * if requested.
+ * Return the size of the internal table type.
  *
  * RETURNS:
  *
- * Success - TABLE_ERROR_NONE
+ * The size of the table_t type.
  *
- * Failure - Table error code.
+ * ARGUMENTS:
  *
- * NOTE: this could be an allocation error if the library is to return
- * the data to the user.
+ * None.
+ */
+int	table_type_size(void)
+{
+  return sizeof(table_t);
+}
+
+/*
+ * unsigned int table_hash
  *
- * ARGUMENTS:
+ * DESCRIPTION:
  *
- * table_p - Table structure pointer from which we will be deleteing
- * the key.
+ * Hash a key with the same hash function that the table uses for its
+ * entries.  This is useful to estimate the number of unique keys or to
+ * partition keys between tables.
  *
- * key_buf - Buffer of bytes of the key that we are searching for to
- * delete.  If you are deleting an (int) key (for example) then
- * key_buf should be a (int *).
+ * RETURNS:
  *
- * key_size - Size of the key_buf buffer.  If set to < 0 then the
- * library will do a strlen of key_buf and add 1 for the '\0'.  If you
- * are deleting an (int) key (for example) then key_size should be
- * sizeof(int).
+ * The 32-bit hash value of the key or 0 if the arguments are invalid.
  *
- * data_buf_p - Pointer which, if not NULL, will be set to the address
- * of the data storage that was allocated in the table and that was
- * associated with the key.  If a (long) was stored as the data (for
- * example) then data_buf_p should be (long **) i.e. the address of a
- * (long *).  If a pointer is passed in, the caller is responsible for
- * freeing it after use.  If data_buf_p is NULL then the library will
- * free up the data allocation itself.
+ * ARGUMENTS:
  *
- * data_size_p - Pointer to an integer which, if not NULL, will be set
- * to the size of the data that was stored in the table and that was
- * associated with the key.
+ * table_p - Table whose hash function we are using.
+ *
+ * key_buf - Buffer of bytes of the key that we are hashing.
+ *
+ * key_size - Size of the key_buf buffer.  If set to < 0 then the
+ * library will do a strlen of key_buf and add 1 for the '\0'.
  */
-int	table_delete(table_t *table_p,
-		     const void *key_buf, const int key_size,
-		     void **data_buf_p, int *data_size_p)
+unsigned int	table_hash(const table_t *table_p, const void *key_buf,
+			   const int key_size)
 {
-  int		bucket;
   unsigned int	ksize;
-  unsigned char	*data_copy_p;
-  table_entry_t	*entry_p, *last_p;
   
-  if (table_p == NULL) {
-    return TABLE_ERROR_ARG_NULL;
-  }
-  if (table_p->ta_magic != TABLE_MAGIC) {
-    return TABLE_ERROR_PNT;
-  }
-  if (key_buf == NULL) {
-    return TABLE_ERROR_ARG_NULL;
+  if (table_p == NULL || table_p->ta_magic != TABLE_MAGIC
+      || key_buf == NULL) {
+    return 0;
   }
   
-  /* get the key size */
   if (key_size < 0) {
     ksize = strlen((char *)key_buf) + sizeof(char);
   }
@@ -1966,100 +6040,23 @@ int	table_delete(table_t *table_p,
     ksize = key_size;
   }
   
-  /* find our bucket */
-  bucket = hash(key_buf, ksize, 0) % table_p->ta_bucket_n;
-  
-  /* look for the entry in this bucket, only check keys of the same size */
-  for (last_p = NULL, entry_p = table_p->ta_buckets[bucket];
-       entry_p != NULL;
-       last_p = entry_p, entry_p = entry_p->te_next_p) {
-    if (entry_p->te_key_size == ksize
-	&& memcmp(ENTRY_KEY_BUF(entry_p), key_buf, ksize) == 0) {
-      break;
-    }
-  }
-  
-  /* did we find it? */
-  if (entry_p == NULL) {
-    return TABLE_ERROR_NOT_FOUND;
-  }
-  
-  /*
-   * NOTE: we may want to adjust the linear counters here if the entry
-   * we are deleting is the one we are pointing on or is ahead of the
-   * one in the bucket list
-   */
-  
-  /* remove entry from the linked list */
-  if (last_p == NULL) {
-    table_p->ta_buckets[bucket] = entry_p->te_next_p;
-  }
-  else {
-    last_p->te_next_p = entry_p->te_next_p;
-  }
-  
-  /* free entry */
-  if (data_buf_p != NULL) {
-    if (entry_p->te_data_size == 0) {
-      *data_buf_p = NULL;
-    }
-    else {
-      /*
-       * if we were storing it compacted, we now need to malloc some
-       * space if the user wants the value after the delete.
-       */
-      if (table_p->ta_alloc_func == NULL) {
-	*data_buf_p = malloc(entry_p->te_data_size);
-      }
-      else {
-	*data_buf_p = table_p->ta_alloc_func(table_p->ta_mem_pool,
-					     entry_p->te_data_size);
-      }
-      if (*data_buf_p == NULL) {
-	return TABLE_ERROR_ALLOC;
-      }
-      if (table_p->ta_data_align == 0) {
-	data_copy_p = ENTRY_DATA_BUF(table_p, entry_p);
-      }
-      else {
-	data_copy_p = entry_data_buf(table_p, entry_p);
-      }
-      memcpy(*data_buf_p, data_copy_p, entry_p->te_data_size);
-    }
-  }
-  SET_POINTER(data_size_p, entry_p->te_data_size);
-  if (table_p->ta_free_func == NULL) {
-    free(entry_p);
-  }
-  else if (! table_p->ta_free_func(table_p->ta_mem_pool, entry_p,
-				   entry_size(table_p,
-					      entry_p->te_key_size,
-					      entry_p->te_data_size))) {
-    return TABLE_ERROR_FREE;
-  }
-  
-  table_p->ta_entry_n--;
-  
-  /* do we need auto-adjust down? */
-  if ((table_p->ta_flags & TABLE_FLAG_AUTO_ADJUST)
-      && (table_p->ta_flags & TABLE_FLAG_ADJUST_DOWN)
-      && SHOULD_TABLE_SHRINK(table_p)) {
-    return table_adjust(table_p, table_p->ta_entry_n);
-  }
-  
-  return TABLE_ERROR_NONE;
+  return key_hash(table_p, key_buf, ksize);
 }
 
+/************************* linear access routines ****************************/
+
 /*
- * int table_delete_first
+ * int table_first
  *
  * DESCRIPTION:
  *
- * This is like the table_delete routines except it deletes the first
- * key/data pair in the table instead of an entry corresponding to a
- * particular key.  The associated key and data information can be
- * passed back to the user if requested.  This routines is handy to
- * clear out a table.
+ * Find first element in a table and pass back information about the
+ * key/data pair.  If any of the key/data pointers are NULL then they
+ * are ignored.
+ *
+ * NOTE: This function is not reentrant.  More than one thread cannot
+ * be doing a first and next on the same table at the same time.  Use
+ * the table_first_r version below for this.
  *
  * RETURNS:
  *
@@ -2067,45 +6064,36 @@ int	table_delete(table_t *table_p,
  *
  * Failure - Table error code.
  *
- * NOTE: this could be an allocation error if the library is to return
- * the data to the user.
- *
  * ARGUMENTS:
  *
- * table_p - Table structure pointer from which we will be deleteing
- * the first key.
+ * table_p - Table structure pointer from which we are getting the
+ * first element.
  *
  * key_buf_p - Pointer which, if not NULL, will be set to the address
- * of the storage of the first key that was allocated in the table.
- * If an (int) was stored as the first key (for example) then
- * key_buf_p should be (int **) i.e. the address of a (int *).  If a
- * pointer is passed in, the caller is responsible for freeing it
- * after use.  If key_buf_p is NULL then the library will free up the
- * key allocation itself.
+ * of the storage of the first key that is allocated in the table.  If
+ * an (int) is stored as the first key (for example) then key_buf_p
+ * should be (int **) i.e. the address of a (int *).
  *
  * key_size_p - Pointer to an integer which, if not NULL, will be set
- * to the size of the key that was stored in the table and that was
- * associated with the key.
+ * to the size of the key that is stored in the table and that is
+ * associated with the first key.
  *
  * data_buf_p - Pointer which, if not NULL, will be set to the address
- * of the data storage that was allocated in the table and that was
- * associated with the key.  If a (long) was stored as the data (for
- * example) then data_buf_p should be (long **) i.e. the address of a
- * (long *).  If a pointer is passed in, the caller is responsible for
- * freeing it after use.  If data_buf_p is NULL then the library will
- * free up the data allocation itself.
+ * of the data storage that is allocated in the table and that is
+ * associated with the first key.  If a (long) is stored as the data
+ * (for example) then data_buf_p should be (long **) i.e. the address
+ * of a (long *).
  *
  * data_size_p - Pointer to an integer which, if not NULL, will be set
- * to the size of the data that was stored in the table and that was
- * associated with the key.
+ * to the size of the data that is stored in the table and that is
+ * associated with the first key.
  */
-int	table_delete_first(table_t *table_p,
-			   void **key_buf_p, int *key_size_p,
-			   void **data_buf_p, int *data_size_p)
+int	table_first(table_t *table_p,
+		    void **key_buf_p, int *key_size_p,
+		    void **data_buf_p, int *data_size_p)
 {
-  unsigned char		*data_copy_p;
-  table_entry_t		*entry_p;
-  table_linear_t	linear;
+  table_entry_t	*entry_p;
+  int		ret;
   
   if (table_p == NULL) {
     return TABLE_ERROR_ARG_NULL;
@@ -2114,103 +6102,52 @@ int	table_delete_first(table_t *table_p,
     return TABLE_ERROR_PNT;
   }
   
-  /* take the first entry */
-  entry_p = first_entry(table_p, &linear);
-  if (entry_p == NULL) {
-    return TABLE_ERROR_NOT_FOUND;
+  /* finish any incremental growing before we walk the buckets */
+  ret = migrate_buckets(table_p, table_p->ta_old_bucket_n);
+  if (ret != TABLE_ERROR_NONE) {
+    return ret;
   }
   
-  /*
-   * NOTE: we may want to adjust the linear counters here if the entry
-   * we are deleting is the one we are pointing on or is ahead of the
-   * one in the bucket list
-   */
-  
-  /* remove entry from the linked list */
-  table_p->ta_buckets[linear.tl_bucket_c] = entry_p->te_next_p;
+  /* initialize our linear magic number */
+  table_p->ta_linear.tl_magic = LINEAR_MAGIC;
   
-  /* free entry */
-  if (key_buf_p != NULL) {
-    if (entry_p->te_key_size == 0) {
-      *key_buf_p = NULL;
-    }
-    else {
-      /*
-       * if we were storing it compacted, we now need to malloc some
-       * space if the user wants the value after the delete.
-       */
-      if (table_p->ta_alloc_func == NULL) {
-	*key_buf_p = malloc(entry_p->te_key_size);
-      }
-      else {
-	*key_buf_p = table_p->ta_alloc_func(table_p->ta_mem_pool,
-					    entry_p->te_key_size);
-      }
-      if (*key_buf_p == NULL) {
-	return TABLE_ERROR_ALLOC;
-      }
-      memcpy(*key_buf_p, ENTRY_KEY_BUF(entry_p), entry_p->te_key_size);
-    }
+  entry_p = first_entry(table_p, &table_p->ta_linear, &ret);
+  if (entry_p == NULL) {
+    return ret;
   }
-  SET_POINTER(key_size_p, entry_p->te_key_size);
   
+  SET_POINTER(key_buf_p, ENTRY_KEY_BUF(entry_p));
+  SET_POINTER(key_size_p, entry_p->te_key_size);
   if (data_buf_p != NULL) {
     if (entry_p->te_data_size == 0) {
       *data_buf_p = NULL;
     }
     else {
-      /*
-       * if we were storing it compacted, we now need to malloc some
-       * space if the user wants the value after the delete.
-       */
-      if (table_p->ta_alloc_func == NULL) {
-	*data_buf_p = malloc(entry_p->te_data_size);
-      }
-      else {
-	*data_buf_p = table_p->ta_alloc_func(table_p->ta_mem_pool,
-					     entry_p->te_data_size);
-      }
-      if (*data_buf_p == NULL) {
-	return TABLE_ERROR_ALLOC;
-      }
       if (table_p->ta_data_align == 0) {
-	data_copy_p = ENTRY_DATA_BUF(table_p, entry_p);
+	*data_buf_p = ENTRY_DATA_BUF(table_p, entry_p);
       }
       else {
-	data_copy_p = entry_data_buf(table_p, entry_p);
+	*data_buf_p = entry_data_buf(table_p, entry_p);
       }
-      memcpy(*data_buf_p, data_copy_p, entry_p->te_data_size);
     }
   }
   SET_POINTER(data_size_p, entry_p->te_data_size);
-  if (table_p->ta_free_func == NULL) {
-    free(entry_p);
-  }
-  else if (! table_p->ta_free_func(table_p->ta_mem_pool, entry_p,
-				   entry_size(table_p,
-					      entry_p->te_key_size,
-					      entry_p->te_data_size))) {
-    return TABLE_ERROR_FREE;
-  }
-  
-  table_p->ta_entry_n--;
-  
-  /* do we need auto-adjust down? */
-  if ((table_p->ta_flags & TABLE_FLAG_AUTO_ADJUST)
-      && (table_p->ta_flags & TABLE_FLAG_ADJUST_DOWN)
-      && SHOULD_TABLE_SHRINK(table_p)) {
-    return table_adjust(table_p, table_p->ta_entry_n);
-  }
   
   return TABLE_ERROR_NONE;
 }
 
 /*
- * int table_info
+ * int table_next
  *
  * DESCRIPTION:
  *
- * Get some information about a table_p structure.
+ * Find the next element in a table and pass back information about
+ * the key/data pair.  If any of the key/data pointers are NULL then
+ * they are ignored.
+ *
+ * NOTE: This function is not reentrant.  More than one thread cannot
+ * be doing a first and next on the same table at the same time.  Use
+ * the table_next_r version below for this.
  *
  * RETURNS:
  *
@@ -2220,36 +6157,82 @@ int	table_delete_first(table_t *table_p,
  *
  * ARGUMENTS:
  *
- * table_p - Table structure pointer from which we are getting
- * information.
+ * table_p - Table structure pointer from which we are getting the
+ * next element.
  *
- * num_buckets_p - Pointer to an integer which, if not NULL, will
- * contain the number of buckets in the table.
+ * key_buf_p - Pointer which, if not NULL, will be set to the address
+ * of the storage of the next key that is allocated in the table.  If
+ * an (int) is stored as the next key (for example) then key_buf_p
+ * should be (int **) i.e. the address of a (int *).
  *
- * num_entries_p - Pointer to an integer which, if not NULL, will
- * contain the number of entries stored in the table.
+ * key_size_p - Pointer to an integer which, if not NULL, will be set
+ * to the size of the key that is stored in the table and that is
+ * associated with the next key.
+ *
+ * data_buf_p - Pointer which, if not NULL, will be set to the address
+ * of the data storage that is allocated in the table and that is
+ * associated with the next key.  If a (long) is stored as the data
+ * (for example) then data_buf_p should be (long **) i.e. the address
+ * of a (long *).
+ *
+ * data_size_p - Pointer to an integer which, if not NULL, will be set
+ * to the size of the data that is stored in the table and that is
+ * associated with the next key.
  */
-int	table_info(table_t *table_p, int *num_buckets_p, int *num_entries_p)
+int	table_next(table_t *table_p,
+		   void **key_buf_p, int *key_size_p,
+		   void **data_buf_p, int *data_size_p)
 {
+  table_entry_t	*entry_p;
+  int		error;
+  
   if (table_p == NULL) {
     return TABLE_ERROR_ARG_NULL;
   }
   if (table_p->ta_magic != TABLE_MAGIC) {
     return TABLE_ERROR_PNT;
   }
+  if (table_p->ta_linear.tl_magic != LINEAR_MAGIC) {
+    return TABLE_ERROR_LINEAR;
+  }
   
-  SET_POINTER(num_buckets_p, table_p->ta_bucket_n);
-  SET_POINTER(num_entries_p, table_p->ta_entry_n);
+  /* move to the next entry */
+  entry_p = next_entry(table_p, &table_p->ta_linear, &error);
+  if (entry_p == NULL) {
+    return error;
+  }
+  
+  SET_POINTER(key_buf_p, ENTRY_KEY_BUF(entry_p));
+  SET_POINTER(key_size_p, entry_p->te_key_size);
+  if (data_buf_p != NULL) {
+    if (entry_p->te_data_size == 0) {
+      *data_buf_p = NULL;
+    }
+    else {
+      if (table_p->ta_data_align == 0) {
+	*data_buf_p = ENTRY_DATA_BUF(table_p, entry_p);
+      }
+      else {
+	*data_buf_p = entry_data_buf(table_p, entry_p);
+      }
+    }
+  }
+  SET_POINTER(data_size_p, entry_p->te_data_size);
   
   return TABLE_ERROR_NONE;
 }
 
 /*
- * int table_adjust
+ * int table_this
  *
  * DESCRIPTION:
  *
- * Set the number of buckets in a table to a certain value.
+ * Find the current element in a table and pass back information about
+ * the key/data pair.  If any of the key/data pointers are NULL then
+ * they are ignored.
+ *
+ * NOTE: This function is not reentrant.  Use the table_current_r
+ * version below.
  *
  * RETURNS:
  *
@@ -2259,17 +6242,34 @@ int	table_info(table_t *table_p, int *num_buckets_p, int *num_entries_p)
  *
  * ARGUMENTS:
  *
- * table_p - Table structure pointer of which we are adjusting.
+ * table_p - Table structure pointer from which we are getting the
+ * current element.
  *
- * bucket_n - Number buckets to adjust the table to.  Set to 0 to
- * adjust the table to its number of entries.
+ * key_buf_p - Pointer which, if not NULL, will be set to the address
+ * of the storage of the current key that is allocated in the table.
+ * If an (int) is stored as the current key (for example) then
+ * key_buf_p should be (int **) i.e. the address of a (int *).
+ *
+ * key_size_p - Pointer to an integer which, if not NULL, will be set
+ * to the size of the key that is stored in the table and that is
+ * associated with the current key.
+ *
+ * data_buf_p - Pointer which, if not NULL, will be set to the address
+ * of the data storage that is allocated in the table and that is
+ * associated with the current key.  If a (long) is stored as the data
+ * (for example) then data_buf_p should be (long **) i.e. the address
+ * of a (long *).
+ *
+ * data_size_p - Pointer to an integer which, if not NULL, will be set
+ * to the size of the data that is stored in the table and that is
+ * associated with the current key.
  */
-int	table_adjust(table_t *table_p, const int bucket_n)
+int	table_this(table_t *table_p,
+		   void **key_buf_p, int *key_size_p,
+		   void **data_buf_p, int *data_size_p)
 {
-  table_entry_t	*entry_p, *next_p;
-  table_entry_t	**buckets, **bucket_p, **bounds_p;
-  int		bucket;
-  unsigned int	buck_n, bucket_size;
+  table_entry_t	*entry_p = NULL;
+  int		ret;
   
   if (table_p == NULL) {
     return TABLE_ERROR_ARG_NULL;
@@ -2277,127 +6277,57 @@ int	table_adjust(table_t *table_p, const int bucket_n)
   if (table_p->ta_magic != TABLE_MAGIC) {
     return TABLE_ERROR_PNT;
   }
-  
-  /*
-   * NOTE: we walk through the entries and rehash them.  If we stored
-   * the hash value as a full int in the table-entry, all we would
-   * have to do is remod it.
-   */
-  
-  /* normalize to the number of entries */
-  if (bucket_n == 0) {
-    buck_n = table_p->ta_entry_n;
-  }
-  else {
-    buck_n = bucket_n;
-  }
-  
-  /* we must have at least 1 bucket */
-  if (buck_n == 0) {
-    buck_n = 1;
+  if (table_p->ta_linear.tl_magic != LINEAR_MAGIC) {
+    return TABLE_ERROR_LINEAR;
   }
   
-  /* make sure we have something to do */
-  if (buck_n == table_p->ta_bucket_n) {
-    return TABLE_ERROR_NONE;
+  /* if we removed an item that shorted the bucket list, we may get this */
+  if (table_p->ta_linear.tl_bucket_c >= table_p->ta_bucket_n) {
+    /*
+     * NOTE: this might happen if we delete an item which shortens the
+     * table bucket numbers.
+     */
+    return TABLE_ERROR_NOT_FOUND;
   }
   
-  /* allocate a new bucket list */
-  bucket_size = buck_n * sizeof(table_entry_t *);
-  if (table_p->ta_alloc_func == NULL) {
-    buckets = (table_entry_t **)malloc(bucket_size);
-  }
-  else {
-    buckets =
-      (table_entry_t **)table_p->ta_alloc_func(table_p->ta_mem_pool,
-					       bucket_size);
-  }
-  if (buckets == NULL) {
-    return TABLE_ERROR_ALLOC;
+  /* find the entry which is the nth in the list */
+  entry_p = nth_entry(table_p, table_p->ta_linear.tl_bucket_c,
+		      table_p->ta_linear.tl_entry_c, &ret);
+
+  /* is this a NOT_FOUND or a LINEAR error */
+  if (entry_p == NULL) {
+    return ret;
   }
-  /*
-   * We zero it ourselves to save the necessity of having a
-   * table_mem_calloc_t memory override function.
-   */
-  memset(buckets, 0, bucket_size);
   
-  /*
-   * run through each of the items in the current table and rehash
-   * them into the newest bucket sizes
-   */
-  bounds_p = table_p->ta_buckets + table_p->ta_bucket_n;
-  for (bucket_p = table_p->ta_buckets; bucket_p < bounds_p; bucket_p++) {
-    for (entry_p = *bucket_p; entry_p != NULL; entry_p = next_p) {
-      
-      /* hash the old data into the new table size */
-      bucket = hash(ENTRY_KEY_BUF(entry_p), entry_p->te_key_size, 0) % buck_n;
-      
-      /* record the next one now since we overwrite next below */
-      next_p = entry_p->te_next_p;
-      
-      /* insert into new list, no need to append */
-      entry_p->te_next_p = buckets[bucket];
-      buckets[bucket] = entry_p;
-      
-      /*
-       * NOTE: we may want to adjust the bucket_c linear entry here to
-       * keep it current
-       */
+  SET_POINTER(key_buf_p, ENTRY_KEY_BUF(entry_p));
+  SET_POINTER(key_size_p, entry_p->te_key_size);
+  if (data_buf_p != NULL) {
+    if (entry_p->te_data_size == 0) {
+      *data_buf_p = NULL;
+    }
+    else {
+      if (table_p->ta_data_align == 0) {
+	*data_buf_p = ENTRY_DATA_BUF(table_p, entry_p);
+      }
+      else {
+	*data_buf_p = entry_data_buf(table_p, entry_p);
+      }
     }
-    /* remove the old table pointers as we go by */
-    *bucket_p = NULL;
-  }
-  
-  /* replace the table buckets with the new ones */
-  if (table_p->ta_free_func == NULL) {
-    free(table_p->ta_buckets);
-  }
-  else if (! table_p->ta_free_func(table_p->ta_mem_pool,
-				   table_p->ta_buckets,
-				   table_p->ta_bucket_n *
-				   sizeof(table_entry_t *))) {
-    return TABLE_ERROR_FREE;
   }
-  table_p->ta_buckets = buckets;
-  table_p->ta_bucket_n = buck_n;
+  SET_POINTER(data_size_p, entry_p->te_data_size);
   
   return TABLE_ERROR_NONE;
 }
 
 /*
- * int table_type_size
- *
- * DESCRIPTION:
- *
- * Return the size of the internal table type.
- *
- * RETURNS:
- *
- * The size of the table_t type.
- *
- * ARGUMENTS:
- *
- * None.
- */
-int	table_type_size(void)
-{
-  return sizeof(table_t);
-}
-
-/************************* linear access routines ****************************/
-
-/*
- * int table_first
+ * int table_first_r
  *
  * DESCRIPTION:
  *
- * Find first element in a table and pass back information about the
- * key/data pair.  If any of the key/data pointers are NULL then they
- * are ignored.
- *
- * NOTE: This function is not reentrant.  More than one thread cannot
- * be doing a first and next on the same table at the same time.  Use
- * the table_first_r version below for this.
+ * Reetrant version of the table_first routine above.  Find first
+ * element in a table and pass back information about the key/data
+ * pair.  If any of the key/data pointers are NULL then they are
+ * ignored.
  *
  * RETURNS:
  *
@@ -2410,6 +6340,10 @@ int	table_type_size(void)
  * table_p - Table structure pointer from which we are getting the
  * first element.
  *
+ * linear_p - Pointer to a table linear structure which is initialized
+ * here.  The same pointer should then be passed to table_next_r
+ * below.
+ *
  * key_buf_p - Pointer which, if not NULL, will be set to the address
  * of the storage of the first key that is allocated in the table.  If
  * an (int) is stored as the first key (for example) then key_buf_p
@@ -2429,11 +6363,12 @@ int	table_type_size(void)
  * to the size of the data that is stored in the table and that is
  * associated with the first key.
  */
-int	table_first(table_t *table_p,
-		    void **key_buf_p, int *key_size_p,
-		    void **data_buf_p, int *data_size_p)
+int	table_first_r(table_t *table_p, table_linear_t *linear_p,
+		      void **key_buf_p, int *key_size_p,
+		      void **data_buf_p, int *data_size_p)
 {
   table_entry_t	*entry_p;
+  int		ret;
   
   if (table_p == NULL) {
     return TABLE_ERROR_ARG_NULL;
@@ -2442,12 +6377,21 @@ int	table_first(table_t *table_p,
     return TABLE_ERROR_PNT;
   }
   
+  /* finish any incremental growing before we walk the buckets */
+  ret = migrate_buckets(table_p, table_p->ta_old_bucket_n);
+  if (ret != TABLE_ERROR_NONE) {
+    return ret;
+  }
+  if (linear_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  
   /* initialize our linear magic number */
-  table_p->ta_linear.tl_magic = LINEAR_MAGIC;
+  linear_p->tl_magic = LINEAR_MAGIC;
   
-  entry_p = first_entry(table_p, &table_p->ta_linear);
+  entry_p = first_entry(table_p, linear_p, &ret);
   if (entry_p == NULL) {
-    return TABLE_ERROR_NOT_FOUND;
+    return ret;
   }
   
   SET_POINTER(key_buf_p, ENTRY_KEY_BUF(entry_p));
@@ -2471,17 +6415,14 @@ int	table_first(table_t *table_p,
 }
 
 /*
- * int table_next
+ * int table_next_r
  *
  * DESCRIPTION:
  *
- * Find the next element in a table and pass back information about
- * the key/data pair.  If any of the key/data pointers are NULL then
- * they are ignored.
- *
- * NOTE: This function is not reentrant.  More than one thread cannot
- * be doing a first and next on the same table at the same time.  Use
- * the table_next_r version below for this.
+ * Reetrant version of the table_next routine above.  Find next
+ * element in a table and pass back information about the key/data
+ * pair.  If any of the key/data pointers are NULL then they are
+ * ignored.
  *
  * RETURNS:
  *
@@ -2494,12 +6435,16 @@ int	table_first(table_t *table_p,
  * table_p - Table structure pointer from which we are getting the
  * next element.
  *
+ * linear_p - Pointer to a table linear structure which is incremented
+ * here.  The same pointer must have been passed to table_first_r
+ * first so that it can be initialized.
+ *
  * key_buf_p - Pointer which, if not NULL, will be set to the address
  * of the storage of the next key that is allocated in the table.  If
  * an (int) is stored as the next key (for example) then key_buf_p
  * should be (int **) i.e. the address of a (int *).
  *
- * key_size_p - Pointer to an integer which, if not NULL, will be set
+ * key_size_p - Pointer to an integer which, if not NULL will be set
  * to the size of the key that is stored in the table and that is
  * associated with the next key.
  *
@@ -2513,9 +6458,9 @@ int	table_first(table_t *table_p,
  * to the size of the data that is stored in the table and that is
  * associated with the next key.
  */
-int	table_next(table_t *table_p,
-		   void **key_buf_p, int *key_size_p,
-		   void **data_buf_p, int *data_size_p)
+int	table_next_r(table_t *table_p, table_linear_t *linear_p,
+		     void **key_buf_p, int *key_size_p,
+		     void **data_buf_p, int *data_size_p)
 {
   table_entry_t	*entry_p;
   int		error;
@@ -2526,12 +6471,15 @@ int	table_next(table_t *table_p,
   if (table_p->ta_magic != TABLE_MAGIC) {
     return TABLE_ERROR_PNT;
   }
-  if (table_p->ta_linear.tl_magic != LINEAR_MAGIC) {
+  if (linear_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (linear_p->tl_magic != LINEAR_MAGIC) {
     return TABLE_ERROR_LINEAR;
   }
   
   /* move to the next entry */
-  entry_p = next_entry(table_p, &table_p->ta_linear, &error);
+  entry_p = next_entry(table_p, linear_p, &error);
   if (entry_p == NULL) {
     return error;
   }
@@ -2557,16 +6505,14 @@ int	table_next(table_t *table_p,
 }
 
 /*
- * int table_this
+ * int table_this_r
  *
  * DESCRIPTION:
  *
- * Find the current element in a table and pass back information about
- * the key/data pair.  If any of the key/data pointers are NULL then
- * they are ignored.
- *
- * NOTE: This function is not reentrant.  Use the table_current_r
- * version below.
+ * Reetrant version of the table_this routine above.  Find current
+ * element in a table and pass back information about the key/data
+ * pair.  If any of the key/data pointers are NULL then they are
+ * ignored.
  *
  * RETURNS:
  *
@@ -2579,6 +6525,10 @@ int	table_next(table_t *table_p,
  * table_p - Table structure pointer from which we are getting the
  * current element.
  *
+ * linear_p - Pointer to a table linear structure which is accessed
+ * here.  The same pointer must have been passed to table_first_r
+ * first so that it can be initialized.
+ *
  * key_buf_p - Pointer which, if not NULL, will be set to the address
  * of the storage of the current key that is allocated in the table.
  * If an (int) is stored as the current key (for example) then
@@ -2598,12 +6548,12 @@ int	table_next(table_t *table_p,
  * to the size of the data that is stored in the table and that is
  * associated with the current key.
  */
-int	table_this(table_t *table_p,
-		   void **key_buf_p, int *key_size_p,
-		   void **data_buf_p, int *data_size_p)
+int	table_this_r(table_t *table_p, table_linear_t *linear_p,
+		     void **key_buf_p, int *key_size_p,
+		     void **data_buf_p, int *data_size_p)
 {
-  table_entry_t	*entry_p = NULL;
-  int		entry_c;
+  table_entry_t	*entry_p;
+  int		ret;
   
   if (table_p == NULL) {
     return TABLE_ERROR_ARG_NULL;
@@ -2611,33 +6561,17 @@ int	table_this(table_t *table_p,
   if (table_p->ta_magic != TABLE_MAGIC) {
     return TABLE_ERROR_PNT;
   }
-  if (table_p->ta_linear.tl_magic != LINEAR_MAGIC) {
-    return TABLE_ERROR_LINEAR;
+  if (linear_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
   }
-  
-  /* if we removed an item that shorted the bucket list, we may get this */
-  if (table_p->ta_linear.tl_bucket_c >= table_p->ta_bucket_n) {
-    /*
-     * NOTE: this might happen if we delete an item which shortens the
-     * table bucket numbers.
-     */
-    return TABLE_ERROR_NOT_FOUND;
+  if (linear_p->tl_magic != LINEAR_MAGIC) {
+    return TABLE_ERROR_LINEAR;
   }
   
   /* find the entry which is the nth in the list */
-  entry_p = table_p->ta_buckets[table_p->ta_linear.tl_bucket_c];
-  /* NOTE: we swap the order here to be more efficient */
-  for (entry_c = table_p->ta_linear.tl_entry_c; entry_c > 0; entry_c--) {
-    /* did we reach the end of the list? */
-    if (entry_p == NULL) {
-      break;
-    }
-    entry_p = entry_p->te_next_p;
-  }
-
-  /* is this a NOT_FOUND or a LINEAR error */
+  entry_p = this_entry(table_p, linear_p, &ret);
   if (entry_p == NULL) {
-    return TABLE_ERROR_NOT_FOUND;
+    return ret;
   }
   
   SET_POINTER(key_buf_p, ENTRY_KEY_BUF(entry_p));
@@ -2660,193 +6594,288 @@ int	table_this(table_t *table_p,
   return TABLE_ERROR_NONE;
 }
 
+/******************************** table files ********************************/
+
 /*
- * int table_first_r
+ * table_t *table_mmap
  *
  * DESCRIPTION:
  *
- * Reetrant version of the table_first routine above.  Find first
- * element in a table and pass back information about the key/data
- * pair.  If any of the key/data pointers are NULL then they are
- * ignored.
+ * Mmap a table from a file that had been written to disk earlier via
+ * table_write.  The table's buckets and entries are used right out of
+ * the mapping so a large table can be opened without reading it in.
+ * The mapping is read-only so the table can be retrieved from and
+ * walked but any operation that would change it returns
+ * TABLE_ERROR_MMAP_OP.
  *
- * RETURNS:
+ * NOTE: Only the header is checked.  Use table_read to check the
+ * whole file against its checksum.  The file offsets of the entries
+ * are checked as they are followed so a corrupted file returns
+ * TABLE_ERROR_FILE from the routines that use them.
  *
- * Success - TABLE_ERROR_NONE
+ * RETURNS:
  *
- * Failure - Table error code.
+ * A pointer to the new table structure which must be passed to
+ * table_munmap to be deallocated.  On error a NULL is returned.
  *
  * ARGUMENTS:
  *
- * table_p - Table structure pointer from which we are getting the
- * first element.
+ * path - Table file to mmap in.
  *
- * linear_p - Pointer to a table linear structure which is initialized
- * here.  The same pointer should then be passed to table_next_r
- * below.
+ * error_p - Pointer to an integer which, if not NULL, will contain a
+ * table error code.
+ */
+table_t		*table_mmap(const char *path, int *error_p)
+{
+#ifdef NO_MMAP
+  
+  /* no mmap support so we can't do it */
+  SET_POINTER(error_p, TABLE_ERROR_MMAP_NONE);
+  return NULL;
+  
+#else
+  
+  table_t	*table_p;
+  table_file_t	header;
+  void		*mmap_p;
+  off_t		size;
+  int		fd, ret;
+  
+  if (path == NULL) {
+    SET_POINTER(error_p, TABLE_ERROR_ARG_NULL);
+    return NULL;
+  }
+  
+  fd = open(path, O_RDONLY | O_BINARY);
+  if (fd < 0) {
+    SET_POINTER(error_p, TABLE_ERROR_OPEN);
+    return NULL;
+  }
+  
+  ret = file_read(fd, &header, sizeof(header));
+  if (ret == TABLE_ERROR_NONE) {
+    ret = file_header_check(&header);
+  }
+  /* make sure all of the file is there before we touch its pages */
+  if (ret == TABLE_ERROR_NONE) {
+    size = lseek(fd, 0, SEEK_END);
+    if (size < 0) {
+      ret = TABLE_ERROR_SEEK;
+    }
+    else if ((unsigned long long)size < header.tf_file_size) {
+      ret = TABLE_ERROR_FILE;
+    }
+  }
+  if (ret != TABLE_ERROR_NONE) {
+    (void)close(fd);
+    SET_POINTER(error_p, ret);
+    return NULL;
+  }
+  
+  mmap_p = mmap(NULL, header.tf_file_size, PROT_READ, MAP_SHARED, fd, 0);
+  (void)close(fd);
+  if (mmap_p == MAP_FAILED) {
+    SET_POINTER(error_p, TABLE_ERROR_MMAP);
+    return NULL;
+  }
+  
+  table_p = malloc(sizeof(table_t));
+  if (table_p == NULL) {
+    (void)munmap(mmap_p, header.tf_file_size);
+    SET_POINTER(error_p, TABLE_ERROR_ALLOC);
+    return NULL;
+  }
+  
+  /* the file's directory is our buckets and it never changes */
+  table_p->ta_magic = TABLE_MAGIC;
+  table_p->ta_flags = header.tf_flags & TABLE_FLAG_FAST_HASH;
+  table_p->ta_bucket_n = header.tf_bucket_n;
+  table_p->ta_bucket_mask = BUCKET_MASK(header.tf_bucket_n);
+  table_p->ta_entry_n = header.tf_entry_n;
+  table_p->ta_buckets =
+    (table_entry_t **)((char *)mmap_p + sizeof(table_file_t));
+  table_p->ta_ctrl = NULL;
+  table_p->ta_deleted_n = 0;
+  table_p->ta_old_buckets = NULL;
+  table_p->ta_old_bucket_n = 0;
+  table_p->ta_old_bucket_mask = 0;
+  table_p->ta_migrate_c = 0;
+  table_p->ta_inline = NULL;
+  table_p->ta_inline_size = 0;
+  table_p->ta_data_align = header.tf_data_align;
+  table_p->ta_linear.tl_magic = 0;
+  table_p->ta_linear.tl_bucket_c = 0;
+  table_p->ta_linear.tl_entry_c = 0;
+  table_p->ta_file_size = header.tf_file_size;
+  table_p->ta_entries_off = header.tf_entries_off;
+  table_p->ta_mmap = mmap_p;
+  table_p->ta_mem_pool = NULL;
+  table_p->ta_alloc_func = NULL;
+  table_p->ta_resize_func = NULL;
+  table_p->ta_free_func = NULL;
+  table_p->ta_arena = NULL;
+  table_p->ta_locks = NULL;
+  table_p->ta_adjust_n = 0;
+  table_p->ta_adjust_usecs = 0;
+  
+  SET_POINTER(error_p, TABLE_ERROR_NONE);
+  return table_p;
+  
+#endif
+}
+
+/*
+ * int table_munmap
  *
- * key_buf_p - Pointer which, if not NULL, will be set to the address
- * of the storage of the first key that is allocated in the table.  If
- * an (int) is stored as the first key (for example) then key_buf_p
- * should be (int **) i.e. the address of a (int *).
+ * DESCRIPTION:
  *
- * key_size_p - Pointer to an integer which, if not NULL, will be set
- * to the size of the key that is stored in the table and that is
- * associated with the first key.
+ * Unmmap a table that was previously mmapped using table_mmap.
  *
- * data_buf_p - Pointer which, if not NULL, will be set to the address
- * of the data storage that is allocated in the table and that is
- * associated with the first key.  If a (long) is stored as the data
- * (for example) then data_buf_p should be (long **) i.e. the address
- * of a (long *).
+ * RETURNS:
  *
- * data_size_p - Pointer to an integer which, if not NULL, will be set
- * to the size of the data that is stored in the table and that is
- * associated with the first key.
+ * Returns table error codes.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Mmaped table pointer to unmap.
  */
-int	table_first_r(table_t *table_p, table_linear_t *linear_p,
-		      void **key_buf_p, int *key_size_p,
-		      void **data_buf_p, int *data_size_p)
+int	table_munmap(table_t *table_p)
 {
-  table_entry_t	*entry_p;
+#ifdef NO_MMAP
   
-  if (table_p == NULL) {
-    return TABLE_ERROR_ARG_NULL;
-  }
-  if (table_p->ta_magic != TABLE_MAGIC) {
-    return TABLE_ERROR_PNT;
-  }
-  if (linear_p == NULL) {
-    return TABLE_ERROR_ARG_NULL;
-  }
+  /* no mmap support so we can't do it */
+  return TABLE_ERROR_MMAP_NONE;
   
-  /* initialize our linear magic number */
-  linear_p->tl_magic = LINEAR_MAGIC;
+#else
   
-  entry_p = first_entry(table_p, linear_p);
-  if (entry_p == NULL) {
-    return TABLE_ERROR_NOT_FOUND;
+  if (table_p == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (table_p->ta_magic != TABLE_MAGIC || table_p->ta_mmap == NULL) {
+    return TABLE_ERROR_PNT;
   }
   
-  SET_POINTER(key_buf_p, ENTRY_KEY_BUF(entry_p));
-  SET_POINTER(key_size_p, entry_p->te_key_size);
-  if (data_buf_p != NULL) {
-    if (entry_p->te_data_size == 0) {
-      *data_buf_p = NULL;
-    }
-    else {
-      if (table_p->ta_data_align == 0) {
-	*data_buf_p = ENTRY_DATA_BUF(table_p, entry_p);
-      }
-      else {
-	*data_buf_p = entry_data_buf(table_p, entry_p);
-      }
-    }
+  if (munmap(table_p->ta_mmap, table_p->ta_file_size) != 0) {
+    return TABLE_ERROR_MMAP;
   }
-  SET_POINTER(data_size_p, entry_p->te_data_size);
+  table_p->ta_magic = 0;
+  free(table_p);
   
   return TABLE_ERROR_NONE;
+  
+#endif
 }
 
 /*
- * int table_next_r
+ * table_t *table_read
  *
  * DESCRIPTION:
  *
- * Reetrant version of the table_next routine above.  Find next
- * element in a table and pass back information about the key/data
- * pair.  If any of the key/data pointers are NULL then they are
- * ignored.
+ * Read in a table from a file that had been written to disk earlier
+ * via table_write.  The whole file, header included, is checked
+ * against its checksum and its entries are inserted into a new table
+ * with the same flags and data alignment without hashing their keys
+ * again.
+ *
+ * NOTE: The file must have been written on a system with the same
+ * byte order and pointer size.
  *
  * RETURNS:
  *
- * Success - TABLE_ERROR_NONE
+ * Success - Pointer to the new table structure which must be passed
+ * to table_free to be deallocated.
  *
- * Failure - Table error code.
+ * Failure - NULL
  *
  * ARGUMENTS:
  *
- * table_p - Table structure pointer from which we are getting the
- * next element.
- *
- * linear_p - Pointer to a table linear structure which is incremented
- * here.  The same pointer must have been passed to table_first_r
- * first so that it can be initialized.
- *
- * key_buf_p - Pointer which, if not NULL, will be set to the address
- * of the storage of the next key that is allocated in the table.  If
- * an (int) is stored as the next key (for example) then key_buf_p
- * should be (int **) i.e. the address of a (int *).
- *
- * key_size_p - Pointer to an integer which, if not NULL will be set
- * to the size of the key that is stored in the table and that is
- * associated with the next key.
- *
- * data_buf_p - Pointer which, if not NULL, will be set to the address
- * of the data storage that is allocated in the table and that is
- * associated with the next key.  If a (long) is stored as the data
- * (for example) then data_buf_p should be (long **) i.e. the address
- * of a (long *).
+ * path - Table file to read in.
  *
- * data_size_p - Pointer to an integer which, if not NULL, will be set
- * to the size of the data that is stored in the table and that is
- * associated with the next key.
+ * error_p - Pointer to an integer which, if not NULL, will contain a
+ * table error code.
  */
-int	table_next_r(table_t *table_p, table_linear_t *linear_p,
-		     void **key_buf_p, int *key_size_p,
-		     void **data_buf_p, int *data_size_p)
+table_t	*table_read(const char *path, int *error_p)
 {
-  table_entry_t	*entry_p;
-  int		error;
+  table_t		*table_p;
+  table_file_t		header;
+  unsigned char		*buf;
+  unsigned long long	size;
+  int			fd, ret;
   
-  if (table_p == NULL) {
-    return TABLE_ERROR_ARG_NULL;
+  if (path == NULL) {
+    SET_POINTER(error_p, TABLE_ERROR_ARG_NULL);
+    return NULL;
   }
-  if (table_p->ta_magic != TABLE_MAGIC) {
-    return TABLE_ERROR_PNT;
+  
+  fd = open(path, O_RDONLY | O_BINARY);
+  if (fd < 0) {
+    SET_POINTER(error_p, TABLE_ERROR_OPEN);
+    return NULL;
   }
-  if (linear_p == NULL) {
-    return TABLE_ERROR_ARG_NULL;
+  
+  ret = file_read(fd, &header, sizeof(header));
+  if (ret == TABLE_ERROR_NONE) {
+    ret = file_header_check(&header);
   }
-  if (linear_p->tl_magic != LINEAR_MAGIC) {
-    return TABLE_ERROR_LINEAR;
+  if (ret != TABLE_ERROR_NONE) {
+    (void)close(fd);
+    SET_POINTER(error_p, ret);
+    return NULL;
   }
   
-  /* move to the next entry */
-  entry_p = next_entry(table_p, linear_p, &error);
-  if (entry_p == NULL) {
-    return error;
+  /* read in the rest of the file and make sure it is what was written */
+  size = header.tf_file_size - sizeof(header);
+  buf = (unsigned char *)malloc(size);
+  if (buf == NULL) {
+    (void)close(fd);
+    SET_POINTER(error_p, TABLE_ERROR_ALLOC);
+    return NULL;
+  }
+  ret = file_read(fd, buf, size);
+  (void)close(fd);
+  if (ret == TABLE_ERROR_NONE
+      && file_header_checksum(&header, file_checksum(buf, size, 0))
+      != header.tf_checksum) {
+    ret = TABLE_ERROR_FILE;
+  }
+  if (ret != TABLE_ERROR_NONE) {
+    free(buf);
+    SET_POINTER(error_p, ret);
+    return NULL;
   }
   
-  SET_POINTER(key_buf_p, ENTRY_KEY_BUF(entry_p));
-  SET_POINTER(key_size_p, entry_p->te_key_size);
-  if (data_buf_p != NULL) {
-    if (entry_p->te_data_size == 0) {
-      *data_buf_p = NULL;
+  table_p = table_alloc(header.tf_bucket_n, &ret);
+  if (table_p != NULL) {
+    ret = table_attr(table_p, header.tf_flags);
+    if (ret == TABLE_ERROR_NONE) {
+      ret = table_set_data_alignment(table_p, header.tf_data_align);
     }
-    else {
-      if (table_p->ta_data_align == 0) {
-	*data_buf_p = ENTRY_DATA_BUF(table_p, entry_p);
-      }
-      else {
-	*data_buf_p = entry_data_buf(table_p, entry_p);
-      }
+    if (ret == TABLE_ERROR_NONE) {
+      ret = table_reserve(table_p, header.tf_entry_n);
+    }
+    if (ret == TABLE_ERROR_NONE) {
+      ret = file_insert_entries(table_p, &header, buf);
+    }
+    if (ret != TABLE_ERROR_NONE) {
+      (void)table_free(table_p);
+      table_p = NULL;
     }
   }
-  SET_POINTER(data_size_p, entry_p->te_data_size);
+  free(buf);
   
-  return TABLE_ERROR_NONE;
+  SET_POINTER(error_p, ret);
+  return table_p;
 }
 
 /*
- * int table_this_r
+ * int table_write
  *
  * DESCRIPTION:
  *
- * Reetrant version of the table_this routine above.  Find current
- * element in a table and pass back information about the key/data
- * pair.  If any of the key/data pointers are NULL then they are
- * ignored.
+ * Write a table from memory to file.  The file has a header with a
+ * version and a checksum, a directory of buckets, and the entries
+ * packed by bucket with the file offsets of the next entry in their
+ * bucket.  It can be read back in with table_read.
  *
  * RETURNS:
  *
@@ -2856,87 +6885,127 @@ int	table_next_r(table_t *table_p, table_linear_t *linear_p,
  *
  * ARGUMENTS:
  *
- * table_p - Table structure pointer from which we are getting the
- * current element.
- *
- * linear_p - Pointer to a table linear structure which is accessed
- * here.  The same pointer must have been passed to table_first_r
- * first so that it can be initialized.
- *
- * key_buf_p - Pointer which, if not NULL, will be set to the address
- * of the storage of the current key that is allocated in the table.
- * If an (int) is stored as the current key (for example) then
- * key_buf_p should be (int **) i.e. the address of a (int *).
- *
- * key_size_p - Pointer to an integer which, if not NULL, will be set
- * to the size of the key that is stored in the table and that is
- * associated with the current key.
+ * table_p - Pointer to the table that we are writing to the file.
  *
- * data_buf_p - Pointer which, if not NULL, will be set to the address
- * of the data storage that is allocated in the table and that is
- * associated with the current key.  If a (long) is stored as the data
- * (for example) then data_buf_p should be (long **) i.e. the address
- * of a (long *).
+ * path - Table file to write out to.
  *
- * data_size_p - Pointer to an integer which, if not NULL, will be set
- * to the size of the data that is stored in the table and that is
- * associated with the current key.
+ * mode - Mode of the file.  This argument is passed on to open when
+ * the file is created.
  */
-int	table_this_r(table_t *table_p, table_linear_t *linear_p,
-		     void **key_buf_p, int *key_size_p,
-		     void **data_buf_p, int *data_size_p)
+int	table_write(const table_t *table_p, const char *path, const int mode)
 {
-  table_entry_t	*entry_p;
-  int		entry_c;
+  table_file_t		header;
+  table_entry_t		**entries, **offsets;
+  unsigned long long	offset;
+  unsigned int		*counts, bucket_n, bucket, mask, align, entry_c, count;
+  int			fd, ret;
   
-  if (table_p == NULL) {
+  if (table_p == NULL || path == NULL) {
     return TABLE_ERROR_ARG_NULL;
   }
   if (table_p->ta_magic != TABLE_MAGIC) {
     return TABLE_ERROR_PNT;
   }
-  if (linear_p->tl_magic != LINEAR_MAGIC) {
-    return TABLE_ERROR_LINEAR;
+  if (table_p->ta_mmap != NULL) {
+    return TABLE_ERROR_MMAP_OP;
   }
   
-  /* if we removed an item that shorted the bucket list, we may get this */
-  if (linear_p->tl_bucket_c >= table_p->ta_bucket_n) {
-    /*
-     * NOTE: this might happen if we delete an item which shortens the
-     * table bucket numbers.
-     */
-    return TABLE_ERROR_NOT_FOUND;
+  /* a directory bucket for each entry keeps the bucket lists short */
+  for (bucket_n = 1; bucket_n < table_p->ta_entry_n; bucket_n *= 2) {
   }
+  mask = BUCKET_MASK(bucket_n);
   
-  /* find the entry which is the nth in the list */
-  for (entry_c = linear_p->tl_entry_c,
-	 entry_p = table_p->ta_buckets[linear_p->tl_bucket_c];
-       entry_c > 0 && entry_p != NULL;
-       entry_c--, entry_p = entry_p->te_next_p) {
+  counts = (unsigned int *)calloc(bucket_n, sizeof(unsigned int));
+  offsets = (table_entry_t **)calloc(bucket_n, sizeof(table_entry_t *));
+  entries = NULL;
+  if (table_p->ta_entry_n > 0) {
+    entries = (table_entry_t **)malloc(table_p->ta_entry_n
+				       * sizeof(table_entry_t *));
+  }
+  if (counts == NULL || offsets == NULL
+      || (entries == NULL && table_p->ta_entry_n > 0)) {
+    free(counts);
+    free(offsets);
+    free(entries);
+    return TABLE_ERROR_ALLOC;
   }
   
-  if (entry_p == NULL) {
-    return TABLE_ERROR_NOT_FOUND;
+  /* count the entries of each directory bucket including any old buckets */
+  file_sort(table_p->ta_buckets, table_p->ta_buckets + table_p->ta_bucket_n,
+	    bucket_n, counts, NULL);
+  if (table_p->ta_old_buckets != NULL) {
+    file_sort(table_p->ta_old_buckets + table_p->ta_migrate_c,
+	      table_p->ta_old_buckets + table_p->ta_old_bucket_n,
+	      bucket_n, counts, NULL);
+  }
+  
+  /* turn the counts into positions and put the entries in bucket order */
+  entry_c = 0;
+  for (bucket = 0; bucket < bucket_n; bucket++) {
+    count = counts[bucket];
+    counts[bucket] = entry_c;
+    entry_c += count;
+  }
+  file_sort(table_p->ta_buckets, table_p->ta_buckets + table_p->ta_bucket_n,
+	    bucket_n, counts, entries);
+  if (table_p->ta_old_buckets != NULL) {
+    file_sort(table_p->ta_old_buckets + table_p->ta_migrate_c,
+	      table_p->ta_old_buckets + table_p->ta_old_bucket_n,
+	      bucket_n, counts, entries);
+  }
+  
+  /* lay out the entries after the directory */
+  align = FILE_ALIGN(table_p);
+  memset(&header, 0, sizeof(header));
+  header.tf_magic = TABLE_FILE_MAGIC;
+  header.tf_version = TABLE_FILE_VERSION;
+  header.tf_pointer_size = sizeof(table_entry_t *);
+  header.tf_flags = table_p->ta_flags;
+  header.tf_data_align = table_p->ta_data_align;
+  header.tf_bucket_n = bucket_n;
+  header.tf_entry_n = table_p->ta_entry_n;
+  header.tf_entries_off =
+    FILE_ROUND(sizeof(header) + bucket_n * sizeof(table_entry_t *), align);
+  offset = header.tf_entries_off;
+  for (entry_c = 0; entry_c < table_p->ta_entry_n; entry_c++) {
+    bucket = bucket_index(entries[entry_c]->te_hash, bucket_n, mask);
+    if (offsets[bucket] == NULL) {
+      offsets[bucket] = (table_entry_t *)(size_t)offset;
+    }
+    offset += FILE_ROUND(entry_size(table_p, entries[entry_c]->te_key_size,
+				    entries[entry_c]->te_data_size), align);
   }
+  header.tf_file_size = offset;
   
-  SET_POINTER(key_buf_p, ENTRY_KEY_BUF(entry_p));
-  SET_POINTER(key_size_p, entry_p->te_key_size);
-  if (data_buf_p != NULL) {
-    if (entry_p->te_data_size == 0) {
-      *data_buf_p = NULL;
+  fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, mode);
+  if (fd < 0) {
+    ret = TABLE_ERROR_OPEN;
+  }
+  else {
+    /* the header is written last once we have the checksum */
+    if (lseek(fd, sizeof(header), SEEK_SET) < 0) {
+      ret = TABLE_ERROR_SEEK;
     }
     else {
-      if (table_p->ta_data_align == 0) {
-	*data_buf_p = ENTRY_DATA_BUF(table_p, entry_p);
+      ret = file_write_entries(table_p, fd, &header, offsets, entries);
+    }
+    if (ret == TABLE_ERROR_NONE) {
+      if (lseek(fd, 0, SEEK_SET) < 0) {
+	ret = TABLE_ERROR_SEEK;
       }
-      else {
-	*data_buf_p = entry_data_buf(table_p, entry_p);
+      else if (write(fd, &header, sizeof(header)) != sizeof(header)) {
+	ret = TABLE_ERROR_WRITE;
       }
     }
+    if (close(fd) != 0 && ret == TABLE_ERROR_NONE) {
+      ret = TABLE_ERROR_WRITE;
+    }
   }
-  SET_POINTER(data_size_p, entry_p->te_data_size);
   
-  return TABLE_ERROR_NONE;
+  free(counts);
+  free(offsets);
+  free(entries);
+  return ret;
 }
 
 /******************************** table order ********************************/
@@ -2993,6 +7062,13 @@ table_entry_t	**table_order(table_t *table_p, table_compare_t compare,
     return NULL;
   }
   
+  /* finish any incremental growing before we walk the buckets */
+  ret = migrate_buckets(table_p, table_p->ta_old_bucket_n);
+  if (ret != TABLE_ERROR_NONE) {
+    SET_POINTER(error_p, ret);
+    return NULL;
+  }
+  
   /* there must be at least 1 element in the table for this to work */
   if (table_p->ta_entry_n == 0) {
     SET_POINTER(error_p, TABLE_ERROR_EMPTY);
@@ -3014,24 +7090,23 @@ table_entry_t	**table_order(table_t *table_p, table_compare_t compare,
   }
   
   /* get a pointer to all entries */
-  entry_p = first_entry(table_p, &linear);
-  if (entry_p == NULL) {
-    if (table_p->ta_free_func == NULL) {
-      free(entries);
-    }
-    else {
-      (void)table_p->ta_free_func(table_p->ta_mem_pool, entries, entries_size);
-    }
-    SET_POINTER(error_p, TABLE_ERROR_NOT_FOUND);
-    return NULL;
-  }
+  entry_p = first_entry(table_p, &linear, &ret);
   
   /* add all of the entries to the array */
   for (entries_p = entries;
        entry_p != NULL;
        entry_p = next_entry(table_p, &linear, &ret)) {
+    /* a corrupted mapped file can have more or fewer entries than it says */
+    if (entries_p == entries + table_p->ta_entry_n) {
+      ret = TABLE_ERROR_FILE;
+      break;
+    }
     *entries_p++ = entry_p;
   }
+  if (ret == TABLE_ERROR_NOT_FOUND
+      && entries_p != entries + table_p->ta_entry_n) {
+    ret = TABLE_ERROR_FILE;
+  }
   
   if (ret != TABLE_ERROR_NOT_FOUND) {
     if (table_p->ta_free_func == NULL) {
@@ -3055,10 +7130,8 @@ table_entry_t	**table_order(table_t *table_p, table_compare_t compare,
     comp_func = external_compare_align;
   }
   
-  /* now qsort the entire entries array from first to last element */
-  ret = split((unsigned char *)entries,
-	      (unsigned char *)(entries + table_p->ta_entry_n - 1),
-	      sizeof(table_entry_t *), comp_func, compare, table_p);
+  /* now sort the entire entries array */
+  ret = entry_sort(entries, table_p->ta_entry_n, comp_func, compare, table_p);
   if (ret != TABLE_ERROR_NONE) {
     if (table_p->ta_free_func == NULL) {
       free(entries);
@@ -3126,6 +7199,74 @@ int	table_order_free(table_t *table_p, table_entry_t **table_entries,
   return final;
 }
 
+#ifdef TABLE_BENCH
+
+/*
+ * int table_order_sort
+ *
+ * DESCRIPTION:
+ *
+ * Sort an array of entries from table_order again with either our
+ * entry sort or the split quick sort that it replaced.  This is only
+ * built for table_bench so it can compare the two.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Pointer to the table.
+ *
+ * table_entries - List of entry pointers returned by table_order that
+ * we are sorting.
+ *
+ * entry_n - Number of entries in the array.
+ *
+ * compare - Comparison function defined by the user.  Its definition
+ * is at the top of the table.h file.  If this is NULL then it will
+ * order the table my memcmp-ing the keys.
+ *
+ * split_b - Set to 1 to sort with split instead of our entry sort.
+ */
+int	table_order_sort(table_t *table_p, table_entry_t **table_entries,
+			 const int entry_n, table_compare_t compare,
+			 const int split_b)
+{
+  compare_t	comp_func;
+  
+  if (table_p == NULL || table_entries == NULL) {
+    return TABLE_ERROR_ARG_NULL;
+  }
+  if (table_p->ta_magic != TABLE_MAGIC) {
+    return TABLE_ERROR_PNT;
+  }
+  if (entry_n < 2) {
+    return TABLE_ERROR_NONE;
+  }
+  
+  if (compare == NULL) {
+    comp_func = local_compare;
+  }
+  else if (table_p->ta_data_align == 0) {
+    comp_func = external_compare;
+  }
+  else {
+    comp_func = external_compare_align;
+  }
+  
+  if (split_b) {
+    return split((unsigned char *)table_entries,
+		 (unsigned char *)(table_entries + entry_n - 1),
+		 sizeof(table_entry_t *), comp_func, compare, table_p);
+  }
+  return entry_sort(table_entries, entry_n, comp_func, compare, table_p);
+}
+
+#endif /* TABLE_BENCH */
+
 /*
  * int table_entry
  *
@@ -3250,6 +7391,13 @@ table_linear_t	*table_order_pos(table_t *table_p, table_compare_t compare,
     return NULL;
   }
   
+  /* finish any incremental growing before we walk the buckets */
+  ret = migrate_buckets(table_p, table_p->ta_old_bucket_n);
+  if (ret != TABLE_ERROR_NONE) {
+    SET_POINTER(error_p, ret);
+    return NULL;
+  }
+  
   /* there must be at least 1 element in the table for this to work */
   if (table_p->ta_entry_n == 0) {
     SET_POINTER(error_p, TABLE_ERROR_EMPTY);
@@ -3272,20 +7420,32 @@ table_linear_t	*table_order_pos(table_t *table_p, table_compare_t compare,
   }
   
   /* get a pointer to all entries */
-  entry_p = first_entry(table_p, &linear);
-  if (entry_p == NULL) {
-    SET_POINTER(error_p, TABLE_ERROR_NOT_FOUND);
-    return NULL;
-  }
+  entry_p = first_entry(table_p, &linear, &ret);
   
   /* add all of the entries to the array */
   for (linears_p = linears;
        entry_p != NULL;
        entry_p = next_entry(table_p, &linear, &ret)) {
+    /* a corrupted mapped file can have more or fewer entries than it says */
+    if (linears_p == linears + table_p->ta_entry_n) {
+      ret = TABLE_ERROR_FILE;
+      break;
+    }
     *linears_p++ = linear;
   }
+  if (ret == TABLE_ERROR_NOT_FOUND
+      && linears_p != linears + table_p->ta_entry_n) {
+    ret = TABLE_ERROR_FILE;
+  }
   
   if (ret != TABLE_ERROR_NOT_FOUND) {
+    if (table_p->ta_free_func == NULL) {
+      free(linears);
+    }
+    else {
+      (void)table_p->ta_free_func(table_p->ta_mem_pool, linears,
+				  table_p->ta_entry_n * sizeof(table_linear_t));
+    }
     SET_POINTER(error_p, ret);
     return NULL;
   }
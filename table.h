@@ -57,6 +57,8 @@ extern "C" {
 #define TABLE_ERROR_ALIGNMENT	18	/* invalid alignment value */
 #define TABLE_ERROR_COMPARE	19	/* problems with internal comparison */
 #define TABLE_ERROR_FREE	20	/* memory free error */
+#define TABLE_ERROR_CONCURRENT	21	/* not a valid concurrent operation */
+#define TABLE_ERROR_FILE	22	/* file is not a valid table */
 
 /*
  * Table flags set with table_attr.
@@ -67,7 +69,8 @@ extern "C" {
  * Whenever the number of entries gets above some threshold, the
  * number of buckets is realloced to a new size and each entry is
  * re-hashed.  Although this may take some time when it re-hashes, the
- * table will perform better over time.
+ * table will perform better over time.  The new size is rounded up to
+ * a power of 2 so buckets can be found with a mask instead of a mod.
  */
 #define TABLE_FLAG_AUTO_ADJUST	(1<<0)	
 
@@ -77,6 +80,60 @@ extern "C" {
  */
 #define TABLE_FLAG_ADJUST_DOWN	(1<<1)
 
+/*
+ * Use open addressing instead of the bucket linked lists.  Each
+ * bucket holds at most one entry and a byte of each entry's hash is
+ * kept in a separate control array which is searched 16 buckets at a
+ * time.  The number of buckets is a power of 2 and grows whenever the
+ * table is 7/8ths full whether or not auto-adjust is set.  This must
+ * be set before any entries are inserted.
+ */
+#define TABLE_FLAG_OPEN_ADDRESS	(1<<2)
+
+/*
+ * Hash the keys with a fast 64-bit hash which loads 8 bytes at a time
+ * instead of the default lookup2 hash.  The hash values depend on the
+ * byte order of the machine so the default is better for tables which
+ * are written to disk.  This must be set before any entries are
+ * inserted.
+ */
+#define TABLE_FLAG_FAST_HASH	(1<<3)
+
+/*
+ * If the auto-adjust flag is set, grow the table a little at a time
+ * instead of all at once.  When the table needs to grow a larger
+ * bucket array is allocated and each insert moves a few of the old
+ * buckets into it so no single insert pays for rehashing the whole
+ * table.  This is ignored by open addressing tables.
+ */
+#define TABLE_FLAG_INCREMENTAL	(1<<4)
+
+/* number of chain or probe lengths counted by table_stats */
+#define TABLE_STATS_CHAIN_N	8
+
+/* statistics about the shape and memory of a table from table_stats */
+typedef struct {
+  int		ts_bucket_n;		/* number of buckets or slots */
+  int		ts_entry_n;		/* number of entries */
+  double	ts_load;		/* entries per bucket or slot */
+  int		ts_empty_n;		/* buckets or slots with no entries */
+  int		ts_deleted_n;		/* deleted open addressing slots */
+  /*
+   * For bucket lists, the number of buckets with chains of each
+   * length.  For open addressing, the number of entries found in the
+   * first, second, etc. group of slots probed.  The last counts that
+   * length or longer.
+   */
+  int		ts_chains[TABLE_STATS_CHAIN_N];
+  int		ts_chain_max;		/* longest chain or probe */
+  unsigned long	ts_entry_bytes;		/* bytes of entries not in slots */
+  unsigned long	ts_padding_bytes;	/* entry bytes lost to alignment */
+  unsigned long	ts_bucket_bytes;	/* bytes of buckets, tags, and slots */
+  unsigned long	ts_arena_bytes;		/* bytes of the arena chunks */
+  int		ts_adjust_n;		/* times the table was resized */
+  double	ts_adjust_secs;		/* time spent resizing */
+} table_stats_t;
+
 /* structure to walk through the fields in a linear order */
 typedef struct {
   unsigned int	tl_magic;	/* magic structure to ensure correct init */
@@ -119,6 +176,32 @@ typedef int (*table_compare_t)(const void *key1, const int key1_size,
 			       const void *key2, const int key2_size,
 			       const void *data2, const int data2_size);
 
+/*
+ * void (*table_merge_t)
+ *
+ * DESCRIPTION
+ *
+ * Function which merges the data being inserted with
+ * table_insert_concurrent into the data of a key which is already in
+ * the table.  It is called with the key's lock held so no other
+ * thread is changing the data at the same time.
+ *
+ * RETURNS:
+ *
+ * None.
+ *
+ * ARGUMENTS:
+ *
+ * old_data <-> Pointer to the data in the table which should be
+ * updated.
+ *
+ * new_data -> Pointer to the data that was being inserted.
+ *
+ * data_size -> Size of the data.
+ */
+typedef void	(*table_merge_t)(void *old_data, const void *new_data,
+				 const int data_size);
+
 /*
  * int (*table_mem_alloc_t)
  *
@@ -278,6 +361,42 @@ table_t		*table_alloc_in_pool(const unsigned int bucket_n,
 				     table_mem_resize_t resize_func,
 				     table_mem_free_t free_func, int *error_p);
 
+/*
+ * table_t *table_alloc_in_arena
+ *
+ * DESCRIPTION:
+ *
+ * Allocate a new table structure whose entries are carved out of
+ * large chunks of memory instead of being allocated one at a time.
+ * This saves the overhead of a malloc per entry and the table can be
+ * cleared or freed by freeing the chunks.  The space of deleted or
+ * resized entries is not reused until the table is cleared.
+ *
+ * RETURNS:
+ *
+ * A pointer to the new table structure which must be passed to
+ * table_free to be deallocated.  On error a NULL is returned.
+ *
+ * ARGUMENTS:
+ *
+ * bucket_n - Number of buckets for the hash table.  Our current hash
+ * value works best with base two numbers.  Set to 0 to take the
+ * library default of 1024.
+ *
+ * chunk_size - Size of the chunks of memory which the entries are
+ * allocated from.  Set to 0 to take the library default of 1mb.
+ *
+ * huge_pages_b - Set to 1 to map the chunks with huge pages if the
+ * system supports them.  This reduces TLB misses on large tables.
+ *
+ * error_p - Pointer to an integer which, if not NULL, will contain a
+ * table error code.
+ */
+extern
+table_t		*table_alloc_in_arena(const unsigned int bucket_n,
+				      const unsigned int chunk_size,
+				      const int huge_pages_b, int *error_p);
+
 /*
  * int table_attr
  *
@@ -341,6 +460,81 @@ int	table_attr(table_t *table_p, const int attr);
 extern
 int	table_set_data_alignment(table_t *table_p, const int alignment);
 
+/*
+ * int table_set_inline_size
+ *
+ * DESCRIPTION:
+ *
+ * Store short entries directly in the slots of an open addressing
+ * table instead of allocating each one separately.  Entries whose key
+ * and data fit in the slot size are put in the slot array so no
+ * allocation is done for them and they sit next to their neighbors
+ * in memory.  Larger entries are allocated as usual.  This is only
+ * used by tables with the TABLE_FLAG_OPEN_ADDRESS flag.
+ *
+ * WARNING: The entries in the slots move when the table grows so any
+ * key or data pointers returned for them are only good until the next
+ * insert.
+ *
+ * WARNING: If necessary, you must set the data alignment before
+ * calling this and this must be called before any data gets put into
+ * the table.  Otherwise a TABLE_ERROR_NOT_EMPTY error will be
+ * returned.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Pointer to a table structure which we will be altering.
+ *
+ * key_size - Largest key in bytes that will be stored in the slots.
+ * Set to 0 to store all entries separately.
+ *
+ * data_size - Largest data in bytes that will be stored in the slots.
+ */
+extern
+int	table_set_inline_size(table_t *table_p, const int key_size,
+			      const int data_size);
+
+/*
+ * int table_set_concurrent
+ *
+ * DESCRIPTION:
+ *
+ * Allow a number of threads to insert into the table at the same
+ * time with table_insert_concurrent.  Each bucket is protected by one
+ * of a number of striped locks so threads only wait for each other
+ * when their keys land in buckets sharing the same lock.  Growing the
+ * table waits for the inserts in progress to finish and then holds
+ * them off while the buckets are rebuilt.
+ *
+ * WARNING: Only table_insert_concurrent may be called while other
+ * threads are inserting.  All other routines such as table_order
+ * must wait until all of the inserting threads have finished.
+ *
+ * WARNING: This only works with the bucket linked lists so it cannot
+ * be used with TABLE_FLAG_OPEN_ADDRESS or TABLE_FLAG_INCREMENTAL.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Pointer to a table structure which we will be altering.
+ *
+ * lock_n - Number of bucket locks.  Set to 0 to take the library
+ * default.  It will be rounded up to a power of 2.
+ */
+extern
+int	table_set_concurrent(table_t *table_p, const int lock_n);
+
 /*
  * int table_clear
  *
@@ -522,6 +716,194 @@ int	table_insert(table_t *table_p,
 		     const void *data_buf, const int data_size,
 		     void **data_buf_p, const char overwrite_b);
 
+/*
+ * int table_insert_hash
+ *
+ * DESCRIPTION:
+ *
+ * Like table_insert except the key has already been hashed with
+ * table_hash so it is not hashed again.  This is for callers that
+ * need the hash to pick the table, as the sharded tables do.
+ *
+ * WARNING: The hash must have come from table_hash on this table or
+ * on one with the same TABLE_FLAG_FAST_HASH setting.  Otherwise the
+ * key will be put where it cannot be found.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table structure pointer into which we will be inserting a
+ * new key/data pair.
+ *
+ * key_buf - Buffer of bytes of the key that we are inserting.
+ *
+ * key_size - Size of the key_buf buffer.  If set to < 0 then the
+ * library will do a strlen of key_buf and add 1 for the '\0'.
+ *
+ * hash_val - Hash of the key from table_hash.
+ *
+ * data_buf - Buffer of bytes of the data that we are inserting.  See
+ * table_insert for when it is NULL.
+ *
+ * data_size - Size of the data_buf buffer.  If set to < 0 then the
+ * library will do a strlen of data_buf and add 1 for the '\0'.
+ *
+ * data_buf_p - Pointer which, if not NULL, will be set to the address
+ * of the data storage that was allocated in the table.
+ *
+ * overwrite - Flag which, if set to 1, will allow the overwriting of
+ * the data in the table with the new data if the key already exists
+ * in the table.
+ */
+extern
+int	table_insert_hash(table_t *table_p,
+			  const void *key_buf, const int key_size,
+			  const unsigned int hash_val,
+			  const void *data_buf, const int data_size,
+			  void **data_buf_p, const char overwrite_b);
+
+/*
+ * int table_upsert
+ *
+ * DESCRIPTION:
+ *
+ * Find a key in the table or add it if it is not there, in a single
+ * hash and probe of the table.  A new key gets zeroed data of the
+ * given size so nothing needs to be copied in and an existing key is
+ * not reported as an overwrite error.  This is handy for counting where
+ * the caller just increments a field of the data either way.
+ *
+ * NOTE: The same warnings about the data pointer apply as with
+ * table_insert_kd.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE whether or not the key was added.
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table structure pointer that we are searching and maybe
+ * inserting into.
+ *
+ * key_buf - Buffer of bytes of the key that we are looking for.
+ *
+ * key_size - Size of the key_buf buffer.  If set to < 0 then the
+ * library will do a strlen of key_buf and add 1 for the '\0'.
+ *
+ * data_size - Size of the data to allocate for a new key.
+ *
+ * data_buf_p - Pointer which will be set to the address of the key's
+ * data in the table.
+ *
+ * created_bp - Pointer to an integer which, if not NULL, will be set
+ * to 1 if the key was added or 0 if it was already in the table.
+ */
+extern
+int	table_upsert(table_t *table_p, const void *key_buf, const int key_size,
+		     const int data_size, void **data_buf_p, int *created_bp);
+
+/*
+ * int table_insert_batch
+ *
+ * DESCRIPTION:
+ *
+ * Add a number of key/data pairs to a table.  All of the keys are
+ * hashed first and the memory where they go is prefetched so the
+ * cache misses of the keys overlap before we probe and insert them in
+ * order.  If a key is already in the table then the merge function is
+ * called to combine the new data with the old, for example to add a
+ * count to the existing count.
+ *
+ * NOTE: No pointers into the table are passed back since adding the
+ * later keys of the batch may move the entries of the earlier ones.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.  The keys before the failing one will
+ * have been added.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table structure pointer into which we will be inserting
+ * the key/data pairs.
+ *
+ * key_bufs - Array of the buffers of bytes of the keys that we are
+ * inserting.
+ *
+ * key_sizes - Array of the sizes of the key buffers.  If a size is
+ * < 0 then the library will do a strlen of the key and add 1 for the
+ * '\0'.
+ *
+ * data_bufs - Buffer of the data for each of the keys one after the
+ * other.
+ *
+ * data_size - Size of the data of each key.
+ *
+ * key_n - Number of keys that we are inserting.
+ *
+ * merge_func - Function which merges the data into the data of an
+ * existing key.  If NULL then the existing data is left alone.
+ */
+extern
+int	table_insert_batch(table_t *table_p, const void **key_bufs,
+			   const int *key_sizes, const void *data_bufs,
+			   const int data_size, const int key_n,
+			   table_merge_t merge_func);
+
+/*
+ * int table_insert_concurrent
+ *
+ * DESCRIPTION:
+ *
+ * Add a key/data pair to a table which was set up with
+ * table_set_concurrent while other threads may be doing the same.
+ * If the key is already in the table then the merge function is
+ * called to combine the new data with the old, for example to add a
+ * count to the existing count.
+ *
+ * NOTE: No pointers into the table are passed back since another
+ * thread may be changing the data as soon as we return.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE if the key was added.
+ *
+ * Failure - Table error code.  TABLE_ERROR_OVERWRITE if the key
+ * already existed and its data was merged.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table structure pointer into which we will be inserting a
+ * new key/data pair.
+ *
+ * key_buf - Buffer of bytes of the key that we are inserting.
+ *
+ * key_size - Size of the key_buf buffer.  If set to < 0 then the
+ * library will do a strlen of key_buf and add 1 for the '\0'.
+ *
+ * data_buf - Buffer of bytes of the data that we are inserting.
+ *
+ * data_size - Size of the data_buf buffer.  If set to < 0 then the
+ * library will do a strlen of data_buf and add 1 for the '\0'.
+ *
+ * merge_func - Function which merges the data into the data of an
+ * existing key.  If NULL then the existing data is left alone.
+ */
+extern
+int	table_insert_concurrent(table_t *table_p,
+				const void *key_buf, const int key_size,
+				const void *data_buf, const int data_size,
+				table_merge_t merge_func);
+
 /*
  * int table_retrieve
  *
@@ -697,6 +1079,36 @@ int	table_delete_first(table_t *table_p,
 extern
 int	table_info(table_t *table_p, int *num_buckets_p, int *num_entries_p);
 
+/*
+ * int table_stats
+ *
+ * DESCRIPTION:
+ *
+ * Get detailed statistics about a table to see why it is slow or uses
+ * a lot of memory: how full it is, how long the bucket chains or open
+ * addressing probes are, where its memory goes, and how often and
+ * how long it has been resized.  This walks the whole table.
+ *
+ * NOTE: The time spent moving buckets when growing incrementally is
+ * spread across the inserts and is not counted.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table structure pointer from which we are getting
+ * statistics.
+ *
+ * stats_p - Pointer to a table_stats_t structure which will be filled
+ * in with the statistics.
+ */
+extern
+int	table_stats(table_t *table_p, table_stats_t *stats_p);
+
 /*
  * int table_adjust
  *
@@ -720,6 +1132,31 @@ int	table_info(table_t *table_p, int *num_buckets_p, int *num_entries_p);
 extern
 int	table_adjust(table_t *table_p, const int bucket_n);
 
+/*
+ * int table_reserve
+ *
+ * DESCRIPTION:
+ *
+ * Grow a table so that it can hold a number of entries without having
+ * to grow again.  If you know roughly how many keys are coming this
+ * saves all of the rehashing that auto-adjusting does on the way up.
+ * The table is never shrunk.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table structure pointer which we are growing.
+ *
+ * entry_n - Number of entries that the table should be able to hold.
+ */
+extern
+int	table_reserve(table_t *table_p, const int entry_n);
+
 /*
  * int table_type_size
  *
@@ -738,6 +1175,32 @@ int	table_adjust(table_t *table_p, const int bucket_n);
 extern
 int	table_type_size(void);
 
+/*
+ * unsigned int table_hash
+ *
+ * DESCRIPTION:
+ *
+ * Hash a key with the same hash function that the table uses for its
+ * entries.  This is useful to estimate the number of unique keys or to
+ * partition keys between tables.
+ *
+ * RETURNS:
+ *
+ * The 32-bit hash value of the key or 0 if the arguments are invalid.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Table whose hash function we are using.
+ *
+ * key_buf - Buffer of bytes of the key that we are hashing.
+ *
+ * key_size - Size of the key_buf buffer.  If set to < 0 then the
+ * library will do a strlen of key_buf and add 1 for the '\0'.
+ */
+extern
+unsigned int	table_hash(const table_t *table_p, const void *key_buf,
+			   const int key_size);
+
 /*
  * int table_first
  *
@@ -1034,7 +1497,16 @@ int	table_this_r(table_t *table_p, table_linear_t *linear_p,
  * DESCRIPTION:
  *
  * Mmap a table from a file that had been written to disk earlier via
- * table_write.
+ * table_write.  The table's buckets and entries are used right out of
+ * the mapping so a large table can be opened without reading it in.
+ * The mapping is read-only so the table can be retrieved from and
+ * walked but any operation that would change it returns
+ * TABLE_ERROR_MMAP_OP.
+ *
+ * NOTE: Only the header is checked.  Use table_read to check the
+ * whole file against its checksum.  The file offsets of the entries
+ * are checked as they are followed so a corrupted file returns
+ * TABLE_ERROR_FILE from the routines that use them.
  *
  * RETURNS:
  *
@@ -1070,12 +1542,18 @@ extern
 int	table_munmap(table_t *table_p);
 
 /*
- * int table_read
+ * table_t *table_read
  *
  * DESCRIPTION:
  *
  * Read in a table from a file that had been written to disk earlier
- * via table_write.
+ * via table_write.  The whole file, header included, is checked
+ * against its checksum and its entries are inserted into a new table
+ * with the same flags and data alignment without hashing their keys
+ * again.
+ *
+ * NOTE: The file must have been written on a system with the same
+ * byte order and pointer size.
  *
  * RETURNS:
  *
@@ -1099,7 +1577,10 @@ table_t	*table_read(const char *path, int *error_p);
  *
  * DESCRIPTION:
  *
- * Write a table from memory to file.
+ * Write a table from memory to file.  The file has a header with a
+ * version and a checksum, a directory of buckets, and the entries
+ * packed by bucket with the file offsets of the next entry in their
+ * bucket.  It can be read back in with table_read.
  *
  * RETURNS:
  *
@@ -1185,6 +1666,45 @@ extern
 int	table_order_free(table_t *table_p, table_entry_t **table_entries,
 			 const int entry_n);
 
+#ifdef TABLE_BENCH
+
+/*
+ * int table_order_sort
+ *
+ * DESCRIPTION:
+ *
+ * Sort an array of entries from table_order again with either our
+ * entry sort or the split quick sort that it replaced.  This is only
+ * built for table_bench so it can compare the two.
+ *
+ * RETURNS:
+ *
+ * Success - TABLE_ERROR_NONE
+ *
+ * Failure - Table error code.
+ *
+ * ARGUMENTS:
+ *
+ * table_p - Pointer to the table.
+ *
+ * table_entries - List of entry pointers returned by table_order that
+ * we are sorting.
+ *
+ * entry_n - Number of entries in the array.
+ *
+ * compare - Comparison function defined by the user.  Its definition
+ * is at the top of the table.h file.  If this is NULL then it will
+ * order the table my memcmp-ing the keys.
+ *
+ * split_b - Set to 1 to sort with split instead of our entry sort.
+ */
+extern
+int	table_order_sort(table_t *table_p, table_entry_t **table_entries,
+			 const int entry_n, table_compare_t compare,
+			 const int split_b);
+
+#endif /* TABLE_BENCH */
+
 /*
  * int table_entry
  *
@@ -0,0 +1,507 @@
+/*
+ * Benchmark the table routines...
+ *
+ * Copyright 2008 by Gray Watson
+ *
+ * This file is part of the sortu package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+/* so we get table_order_sort to compare our sorts */
+#define TABLE_BENCH
+
+#include "table.h"
+
+#define DEFAULT_KEY_N	1000000		/* default number of keys */
+#define KEY_SIZE	24		/* max size of our keys */
+#define BATCH_SIZE	32		/* keys inserted in a batch */
+
+/* an engine configuration that we are benchmarking */
+typedef struct {
+  const char	*en_name;		/* name of the engine */
+  int		en_flags;		/* flags to pass to table_attr */
+  int		en_arena_b;		/* allocate entries in an arena */
+  int		en_inline_size;		/* max key size in the slots */
+} engine_t;
+
+static	engine_t	engines[] = {
+  { "chained",		TABLE_FLAG_AUTO_ADJUST },
+  { "open",		TABLE_FLAG_AUTO_ADJUST | TABLE_FLAG_OPEN_ADDRESS },
+  { "chained-fh",	TABLE_FLAG_AUTO_ADJUST | TABLE_FLAG_FAST_HASH },
+  { "open-fh",		TABLE_FLAG_AUTO_ADJUST | TABLE_FLAG_OPEN_ADDRESS
+			| TABLE_FLAG_FAST_HASH },
+  { "chained-ar",	TABLE_FLAG_AUTO_ADJUST | TABLE_FLAG_FAST_HASH, 1 },
+  { "chained-in",	TABLE_FLAG_AUTO_ADJUST | TABLE_FLAG_FAST_HASH
+			| TABLE_FLAG_INCREMENTAL },
+  { "open-ar",		TABLE_FLAG_AUTO_ADJUST | TABLE_FLAG_OPEN_ADDRESS
+			| TABLE_FLAG_FAST_HASH, 1 },
+  { "open-in",		TABLE_FLAG_AUTO_ADJUST | TABLE_FLAG_OPEN_ADDRESS
+			| TABLE_FLAG_FAST_HASH, 1, KEY_SIZE },
+  { NULL }
+};
+
+/* hash functions that we are benchmarking */
+static	engine_t	hashes[] = {
+  { "lookup2",		0 },
+  { "fast",		TABLE_FLAG_FAST_HASH },
+  { NULL }
+};
+
+/* short keys like state codes */
+static	char		*short_keys[] = {
+  "AL", "AK", "AZ", "AR", "CA", "CO", "CT", "DE", "FL", "GA", NULL
+};
+
+/* long keys like urls */
+static	char		*long_keys[] = {
+  "http://256.com/gray/docs/sortu/",
+  "https://github.com/j256/sortu/blob/master/README.md",
+  "https://www.example.com/search?q=hash+table+benchmarks&page=2",
+  "https://cdn.example.net/static/js/vendor/jquery-3.7.1.min.js?v=20240101",
+  "https://en.wikipedia.org/wiki/Hash_table#Open_addressing",
+  "http://localhost:8080/api/v1/users/12345/orders?status=shipped&sort=desc",
+  NULL
+};
+
+/* distributions of the counts that we are sorting by */
+static	const char	*sorts[] = {
+  "sorted", "reversed", "equal", "zipf", "random", NULL
+};
+
+static	char		*keys;			/* key buffer */
+static	int		*numbers;		/* number in each key */
+static	int		key_n;			/* number of keys */
+
+/*
+ * Return the current time in seconds.
+ */
+static	double	now(void)
+{
+  struct timeval	tv;
+  
+  (void)gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/*
+ * Print the rate of a timed test.
+ */
+static	void	report(const char *name, const char *test, const int op_n,
+		       const double start)
+{
+  double	elapsed = now() - start;
+  
+  (void)printf("%-10s %-16s %10d ops %8.3f secs %12.0f ops/sec\n",
+	       name, test, op_n, elapsed, op_n / elapsed);
+}
+
+/*
+ * Exit with a message if a table call failed.
+ */
+static	void	check(const int ret, const int expected, const char *what)
+{
+  if (ret != expected) {
+    (void)fprintf(stderr, "table_bench: %s failed: %s\n",
+		  what, table_strerror(ret));
+    exit(1);
+  }
+}
+
+/*
+ * Hash a list of keys over and over with the hash function of a table.
+ */
+static	void	run_hash(const engine_t *hash_p, const char *test,
+			 char **key_list, const int round_n)
+{
+  table_t	*tab;
+  char		**key_p;
+  int		round_c, ret, op_n = 0;
+  long		byte_n = 0;
+  unsigned int	total = 0;
+  double	start, elapsed;
+  
+  tab = table_alloc(0, &ret);
+  if (tab == NULL) {
+    check(ret, TABLE_ERROR_NONE, "table_alloc");
+  }
+  check(table_attr(tab, hash_p->en_flags), TABLE_ERROR_NONE, "table_attr");
+  
+  start = now();
+  for (round_c = 0; round_c < round_n; round_c++) {
+    for (key_p = key_list; *key_p != NULL; key_p++) {
+      total += table_hash(tab, *key_p, strlen(*key_p));
+      byte_n += strlen(*key_p);
+      op_n++;
+    }
+  }
+  elapsed = now() - start;
+  
+  /* print the total so the compiler can't skip the hashing */
+  (void)printf("%-10s %-16s %10d ops %8.3f secs %12.0f ops/sec "
+	       "%8.1f MB/sec (%x)\n",
+	       hash_p->en_name, test, op_n, elapsed, op_n / elapsed,
+	       byte_n / elapsed / (1024 * 1024), total);
+  
+  check(table_free(tab), TABLE_ERROR_NONE, "table_free");
+}
+
+/*
+ * Allocate a table configured for one engine.
+ */
+static	table_t	*engine_table(const engine_t *engine_p)
+{
+  table_t	*tab;
+  int		ret;
+  
+  if (engine_p->en_arena_b) {
+    tab = table_alloc_in_arena(0, 0, 0, &ret);
+  }
+  else {
+    tab = table_alloc(0, &ret);
+  }
+  if (tab == NULL) {
+    check(ret, TABLE_ERROR_NONE, "table_alloc");
+  }
+  check(table_attr(tab, engine_p->en_flags), TABLE_ERROR_NONE, "table_attr");
+  check(table_set_data_alignment(tab, sizeof(long)), TABLE_ERROR_NONE,
+	"table_set_data_alignment");
+  if (engine_p->en_inline_size > 0) {
+    check(table_set_inline_size(tab, engine_p->en_inline_size, sizeof(long)),
+	  TABLE_ERROR_NONE, "table_set_inline_size");
+  }
+  
+  return tab;
+}
+
+/*
+ * Add one to a count that is already in the table.
+ */
+static	void	merge_count(void *old_p, const void *new_p, const int size)
+{
+  (*(long *)old_p)++;
+}
+
+/*
+ * Count the keys in batches so their cache misses overlap.
+ */
+static	void	run_batch(const engine_t *engine_p)
+{
+  table_t	*tab;
+  const void	*batch_keys[BATCH_SIZE];
+  int		batch_sizes[BATCH_SIZE], batch_c, key_c;
+  long		counts[BATCH_SIZE];
+  double	start;
+  
+  tab = engine_table(engine_p);
+  
+  start = now();
+  batch_c = 0;
+  for (key_c = 0; key_c < key_n; key_c++) {
+    batch_keys[batch_c] = keys + key_c * KEY_SIZE;
+    batch_sizes[batch_c] = strlen(batch_keys[batch_c]);
+    counts[batch_c] = 1;
+    batch_c++;
+    if (batch_c == BATCH_SIZE || key_c == key_n - 1) {
+      check(table_insert_batch(tab, batch_keys, batch_sizes, counts,
+			       sizeof(long), batch_c, merge_count),
+	    TABLE_ERROR_NONE, "table_insert_batch");
+      batch_c = 0;
+    }
+  }
+  report(engine_p->en_name, "insert batch", key_n, start);
+  
+  check(table_free(tab), TABLE_ERROR_NONE, "table_free");
+}
+
+/*
+ * Run the tests against one engine.
+ */
+static	void	run_engine(const engine_t *engine_p)
+{
+  table_t	*tab;
+  table_entry_t	**entries;
+  long		*count_p, count;
+  char		*key_p, *deleted, miss[KEY_SIZE];
+  int		key_c, ret, entry_n, created_b, deleted_n, left_n;
+  double	start;
+  
+  tab = engine_table(engine_p);
+  deleted = calloc(key_n, sizeof(char));
+  if (deleted == NULL) {
+    (void)fprintf(stderr, "table_bench: could not allocate deleted keys\n");
+    exit(1);
+  }
+  
+  /* count the keys the way sortu does */
+  start = now();
+  for (key_c = 0; key_c < key_n; key_c++) {
+    key_p = keys + key_c * KEY_SIZE;
+    count = 1;
+    ret = table_insert(tab, key_p, strlen(key_p), &count, sizeof(count),
+		       (void **)&count_p, 0);
+    if (ret == TABLE_ERROR_OVERWRITE) {
+      (*count_p)++;
+    }
+    else {
+      check(ret, TABLE_ERROR_NONE, "table_insert");
+    }
+  }
+  report(engine_p->en_name, "insert", key_n, start);
+  
+  /* count them all again with the single probe upsert */
+  start = now();
+  for (key_c = 0; key_c < key_n; key_c++) {
+    key_p = keys + key_c * KEY_SIZE;
+    check(table_upsert(tab, key_p, strlen(key_p), sizeof(count),
+		       (void **)&count_p, &created_b),
+	  TABLE_ERROR_NONE, "table_upsert");
+    check(created_b, 0, "table_upsert created");
+    (*count_p)++;
+  }
+  report(engine_p->en_name, "upsert", key_n, start);
+  
+  start = now();
+  for (key_c = 0; key_c < key_n; key_c++) {
+    key_p = keys + key_c * KEY_SIZE;
+    check(table_retrieve(tab, key_p, strlen(key_p), NULL, NULL),
+	  TABLE_ERROR_NONE, "table_retrieve");
+  }
+  report(engine_p->en_name, "retrieve hit", key_n, start);
+  
+  start = now();
+  for (key_c = 0; key_c < key_n; key_c++) {
+    (void)sprintf(miss, "miss%d", key_c);
+    check(table_retrieve(tab, miss, strlen(miss), NULL, NULL),
+	  TABLE_ERROR_NOT_FOUND, "table_retrieve miss");
+  }
+  report(engine_p->en_name, "retrieve miss", key_n, start);
+  
+  start = now();
+  entries = table_order(tab, NULL, &entry_n, &ret);
+  if (entries == NULL) {
+    check(ret, TABLE_ERROR_NONE, "table_order");
+  }
+  report(engine_p->en_name, "order", entry_n, start);
+  check(table_order_free(tab, entries, entry_n), TABLE_ERROR_NONE,
+	"table_order_free");
+  
+  /*
+   * Delete every other key and make sure the rest are still there.
+   * The keys repeat so one that was deleted already must be missing.
+   */
+  deleted_n = 0;
+  start = now();
+  for (key_c = 0; key_c < key_n; key_c += 2) {
+    key_p = keys + key_c * KEY_SIZE;
+    ret = table_delete(tab, key_p, strlen(key_p), NULL, NULL);
+    if (deleted[numbers[key_c]]) {
+      check(ret, TABLE_ERROR_NOT_FOUND, "table_delete of a deleted key");
+    }
+    else {
+      check(ret, TABLE_ERROR_NONE, "table_delete");
+      deleted[numbers[key_c]] = 1;
+      deleted_n++;
+    }
+  }
+  report(engine_p->en_name, "delete", key_n / 2, start);
+  for (key_c = 0; key_c < key_n; key_c++) {
+    key_p = keys + key_c * KEY_SIZE;
+    ret = table_retrieve(tab, key_p, strlen(key_p), NULL, NULL);
+    if (deleted[numbers[key_c]]) {
+      check(ret, TABLE_ERROR_NOT_FOUND, "table_retrieve of a deleted key");
+    }
+    else {
+      check(ret, TABLE_ERROR_NONE, "table_retrieve after delete");
+    }
+  }
+  check(table_info(tab, NULL, &left_n), TABLE_ERROR_NONE, "table_info");
+  if (left_n != entry_n - deleted_n) {
+    (void)fprintf(stderr, "table_bench: %d of %d keys left after %d deletes\n",
+		  left_n, entry_n, deleted_n);
+    exit(1);
+  }
+  free(deleted);
+  
+  start = now();
+  check(table_free(tab), TABLE_ERROR_NONE, "table_free");
+  report(engine_p->en_name, "free", key_n, start);
+}
+
+/*
+ * Order two entries by their counts.
+ */
+static	int	count_compare(const void *key1, const int key1_size,
+			      const void *data1, const int data1_size,
+			      const void *key2, const int key2_size,
+			      const void *data2, const int data2_size)
+{
+  long	count1 = *(const long *)data1, count2 = *(const long *)data2;
+  
+  if (count1 < count2) {
+    return -1;
+  }
+  if (count1 > count2) {
+    return 1;
+  }
+  return 0;
+}
+
+/*
+ * Sort entries by a distribution of counts with split and with the
+ * entry sort that replaced it in table_order.
+ */
+static	void	run_sort(const char *sort)
+{
+  table_t	*tab;
+  table_entry_t	**entries, **work;
+  long		*counts, *count_p, count;
+  char		key[KEY_SIZE], test[32];
+  int		key_c, ret, entry_n, rank, split_b;
+  double	start;
+  
+  tab = table_alloc(0, &ret);
+  if (tab == NULL) {
+    check(ret, TABLE_ERROR_NONE, "table_alloc");
+  }
+  check(table_attr(tab, TABLE_FLAG_AUTO_ADJUST), TABLE_ERROR_NONE,
+	"table_attr");
+  check(table_set_data_alignment(tab, sizeof(long)), TABLE_ERROR_NONE,
+	"table_set_data_alignment");
+  
+  /* ordering the padded keys puts the entries in key order */
+  count = 0;
+  for (key_c = 0; key_c < key_n; key_c++) {
+    (void)sprintf(key, "key%010d", key_c);
+    check(table_insert(tab, key, strlen(key), &count, sizeof(count), NULL, 0),
+	  TABLE_ERROR_NONE, "table_insert");
+  }
+  entries = table_order(tab, NULL, &entry_n, &ret);
+  if (entries == NULL) {
+    check(ret, TABLE_ERROR_NONE, "table_order");
+  }
+  
+  /* the zipf counts get their ranks in a random order */
+  counts = malloc(sizeof(long) * entry_n);
+  work = malloc(sizeof(table_entry_t *) * entry_n);
+  if (counts == NULL || work == NULL) {
+    (void)fprintf(stderr, "table_bench: could not allocate sort arrays\n");
+    exit(1);
+  }
+  for (key_c = 0; key_c < entry_n; key_c++) {
+    counts[key_c] = key_c + 1;
+  }
+  for (key_c = entry_n - 1; key_c > 0; key_c--) {
+    rank = random() % (key_c + 1);
+    count = counts[key_c];
+    counts[key_c] = counts[rank];
+    counts[rank] = count;
+  }
+  
+  for (key_c = 0; key_c < entry_n; key_c++) {
+    if (strcmp(sort, "sorted") == 0) {
+      count = key_c;
+    }
+    else if (strcmp(sort, "reversed") == 0) {
+      count = entry_n - key_c;
+    }
+    else if (strcmp(sort, "equal") == 0) {
+      count = 1;
+    }
+    else if (strcmp(sort, "zipf") == 0) {
+      count = entry_n / counts[key_c];
+    }
+    else {
+      count = random();
+    }
+    check(table_entry(tab, entries[key_c], NULL, NULL, (void **)&count_p,
+		      NULL), TABLE_ERROR_NONE, "table_entry");
+    *count_p = count;
+  }
+  
+  for (split_b = 1; split_b >= 0; split_b--) {
+    memcpy(work, entries, sizeof(table_entry_t *) * entry_n);
+    (void)sprintf(test, "%s %s", (split_b ? "split" : "sort"), sort);
+    start = now();
+    check(table_order_sort(tab, work, entry_n, count_compare, split_b),
+	  TABLE_ERROR_NONE, "table_order_sort");
+    report("order", test, entry_n, start);
+  
+    /* make sure that it is sorted */
+    count = 0;
+    for (key_c = 0; key_c < entry_n; key_c++) {
+      check(table_entry(tab, work[key_c], NULL, NULL, (void **)&count_p,
+			NULL), TABLE_ERROR_NONE, "table_entry");
+      if (*count_p < count) {
+	(void)fprintf(stderr, "table_bench: %s is not sorted\n", test);
+	exit(1);
+      }
+      count = *count_p;
+    }
+  }
+  
+  free(work);
+  free(counts);
+  check(table_order_free(tab, entries, entry_n), TABLE_ERROR_NONE,
+	"table_order_free");
+  check(table_free(tab), TABLE_ERROR_NONE, "table_free");
+}
+
+int	main(int argc, char **argv)
+{
+  const engine_t	*engine_p, *hash_p;
+  const char		**sort_p;
+  int			key_c;
+  
+  if (argc > 1) {
+    key_n = atoi(argv[1]);
+  }
+  if (key_n <= 0) {
+    key_n = DEFAULT_KEY_N;
+  }
+  
+  /* build our keys, roughly half are unique */
+  keys = malloc(key_n * KEY_SIZE);
+  numbers = malloc(key_n * sizeof(int));
+  if (keys == NULL || numbers == NULL) {
+    (void)fprintf(stderr, "table_bench: could not allocate keys\n");
+    exit(1);
+  }
+  srandom(1);
+  for (key_c = 0; key_c < key_n; key_c++) {
+    numbers[key_c] = random() % key_n;
+    (void)sprintf(keys + key_c * KEY_SIZE, "key%d", numbers[key_c]);
+  }
+  
+  for (hash_p = hashes; hash_p->en_name != NULL; hash_p++) {
+    run_hash(hash_p, "hash short", short_keys, key_n);
+    run_hash(hash_p, "hash long", long_keys, key_n);
+  }
+  
+  for (engine_p = engines; engine_p->en_name != NULL; engine_p++) {
+    run_engine(engine_p);
+    run_batch(engine_p);
+  }
+  
+  for (sort_p = sorts; *sort_p != NULL; sort_p++) {
+    run_sort(*sort_p);
+  }
+  
+  free(keys);
+  free(numbers);
+  exit(0);
+}
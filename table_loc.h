@@ -20,10 +20,19 @@
 #ifndef __TABLE_LOC_H__
 #define __TABLE_LOC_H__
 
-#ifndef unix
+#if ! defined __unix__ && ! defined __APPLE__
 #define NO_MMAP
 #endif
 
+#ifndef NO_THREADS
+#include <pthread.h>
+#endif
+
+/* only some systems need to be told not to translate file newlines */
+#ifndef O_BINARY
+#define O_BINARY	0
+#endif
+
 #ifndef	BITSPERBYTE
 #define BITSPERBYTE	8
 #endif
@@ -50,14 +59,114 @@
  */
 #define MAX_QSORT_MANY		8
 
+/*
+ * Entry sorts of fewer than this many entries are just insertion
+ * sorted.  Ones of more than SORT_NINTHER_MANY entries pick their
+ * pivot from the medians of 3 sets of 3 entries.
+ */
+#define SORT_INSERT_MANY	24
+#define SORT_NINTHER_MANY	128
+
+/*
+ * Number of entries that may be moved while insertion sorting a
+ * partition that looks to already be sorted before we give up and
+ * partition it.
+ */
+#define SORT_PARTIAL_MAX	8
+
+/*
+ * Open addressing control bytes.  Full slots hold the low 7 bits of
+ * their entry's hash so all free slots have the high bit set.
+ */
+#define OPEN_EMPTY		0x80	/* slot has never been used */
+#define OPEN_DELETED		0xFE	/* slot entry has been deleted */
+#define OPEN_GROUP_SIZE		16	/* slots probed together */
+#define OPEN_MIN_SIZE		OPEN_GROUP_SIZE	/* min number of slots */
+
+#define MIGRATE_BUCKET_N	4	/* old buckets moved per insert */
+#define BATCH_MAX		32	/* keys hashed and prefetched at once */
+
+#define ARENA_CHUNK_SIZE	(1024 * 1024)	/* default arena chunk size */
+#define TABLE_FILE_MAGIC	0xFEEDD00D	/* start of the table files */
+#define TABLE_FILE_VERSION	1	/* version of the table file format */
+#define FILE_BLOCK_SIZE		(64 * 1024)	/* bytes checksummed at once */
+#define CONCURRENT_LOCK_N	256	/* default number of stripe locks */
+#define ARENA_HUGE_SIZE		(2 * 1024 * 1024) /* size of a huge page */
+
+/* odd 64-bit constants with mixed bits for the fast hash */
+#define WY_PRIME0		0xa0761d6478bd642fULL
+#define WY_PRIME1		0xe7037ed1a0b428dbULL
+#define WY_PRIME2		0x8ebc6af09c88c6e3ULL
+#define WY_PRIME3		0x589965cc75374cc3ULL
+
 /*
  * Macros.
  */
 
+/* start loading memory into the cache before we need it */
+#if defined __GNUC__
+#define PREFETCH(addr)		__builtin_prefetch(addr)
+#else
+#define PREFETCH(addr)
+#endif
+
+/* alignment of the entries in a table file */
+#define FILE_ALIGN(tab)	\
+	((tab)->ta_data_align > sizeof(table_entry_t *) \
+	 ? (tab)->ta_data_align : (unsigned int)sizeof(table_entry_t *))
+
+/* round a size up to an alignment which must be 2^X */
+#define FILE_ROUND(size, align)	\
+	(((size) + (align) - 1) & ~((unsigned long long)(align) - 1))
+
+/*
+ * The buckets and entries of a mapped table hold file offsets instead
+ * of pointers so we turn them into pointers into the mapping.  The
+ * offsets are checked by file_entry which returns NULL for a bad one
+ * so a NULL from a non-NULL pointer means that the file is corrupted.
+ */
+#define TABLE_HEAD(tab, pnt)	\
+	((tab)->ta_mmap == NULL || (pnt) == NULL ? (pnt) : \
+	 file_entry((tab), (size_t)(pnt), (tab)->ta_entries_off))
+
+/* the next entry must be after this one so a list cannot loop */
+#define TABLE_NEXT(tab, entry_p)	\
+	((tab)->ta_mmap == NULL || (entry_p)->te_next_p == NULL \
+	 ? (entry_p)->te_next_p \
+	 : file_entry((tab), (size_t)(entry_p)->te_next_p, \
+		      (char *)(entry_p) - (char *)(tab)->ta_mmap + 1))
+
 /* returns 1 when we should grow or shrink the table */
 #define SHOULD_TABLE_GROW(tab)	((tab)->ta_entry_n > (tab)->ta_bucket_n * 2)
 #define SHOULD_TABLE_SHRINK(tab) ((tab)->ta_entry_n < (tab)->ta_bucket_n / 2)
 
+/* mask to get a bucket from a hash or 0 if the number is not 2^X */
+#define BUCKET_MASK(bucket_n)	\
+	(((bucket_n) & ((bucket_n) - 1)) == 0 ? (bucket_n) - 1 : 0)
+
+/* returns 1 when another entry would make an open table 7/8ths used */
+#define SHOULD_OPEN_GROW(tab)	\
+	((tab)->ta_entry_n + (tab)->ta_deleted_n >= (tab)->ta_bucket_n / 8 * 7)
+
+/*
+ * Entry stored in an open addressing slot.  Its key size is set to 0
+ * if the slot's entry is allocated elsewhere.
+ */
+#define INLINE_ENTRY(tab, slot)	\
+	((table_entry_t *)((tab)->ta_inline + (slot) * (tab)->ta_inline_size))
+
+/* returns 1 if the entry is stored in the open addressing slots */
+#define ENTRY_INLINE(tab, entry_p)	\
+	((tab)->ta_inline != NULL \
+	 && (unsigned char *)(entry_p) >= (tab)->ta_inline \
+	 && (unsigned char *)(entry_p) \
+	 < (tab)->ta_inline + (tab)->ta_bucket_n * (tab)->ta_inline_size)
+
+/* tag stored in the control byte and the group where probing starts */
+#define OPEN_TAG(hash)		((unsigned char)((hash) & 0x7F))
+#define OPEN_GROUP(tab, hash)	\
+	(((hash) >> 7) & ((tab)->ta_bucket_n / OPEN_GROUP_SIZE - 1))
+
 /*
  * void HASH_MIX
  *
@@ -106,10 +215,53 @@
 #define ENTRY_DATA_BUF(tab_p, entry_p)	\
      (ENTRY_KEY_BUF(entry_p) + (entry_p)->te_key_size)
 
+/* align a pointer up to a power of 2 boundary */
+#define ARENA_ALIGN(pnt, align)	\
+	((char *)(((size_t)(pnt) + (align) - 1) & ~(size_t)((align) - 1)))
+
+/* space at the front of each chunk for its header */
+#define ARENA_HEADER_SIZE	\
+	((sizeof(arena_chunk_t) + MAX_ALIGNMENT - 1) & ~(MAX_ALIGNMENT - 1))
+#define ARENA_CHUNK_BUF(chunk_p)	((char *)(chunk_p) + ARENA_HEADER_SIZE)
+
 /*
  * Table structures...
  */
 
+/* chunk of memory that an arena allocates entries from */
+typedef struct arena_chunk_st {
+  struct arena_chunk_st	*ac_next_p;	/* next chunk in the arena */
+  size_t		ac_size;	/* size of chunk with the header */
+  int			ac_mmap_b;	/* chunk was mmap-ed not malloc-ed */
+} arena_chunk_t;
+
+/* arena which carves entries out of chunks */
+typedef struct {
+  arena_chunk_t		*ar_chunks;	/* list of our chunks */
+  char			*ar_next_p;	/* next free space in chunk */
+  char			*ar_bounds_p;	/* end of the current chunk */
+  size_t		ar_chunk_size;	/* size of new chunks */
+  unsigned int		ar_align;	/* alignment of allocations */
+  int			ar_huge_b;	/* use huge pages for the chunks */
+} arena_t;
+
+#ifndef NO_THREADS
+
+/* locks which let a number of threads insert into a table at once */
+typedef struct {
+  pthread_rwlock_t	lo_grow_lock;	/* held for writing while growing */
+  pthread_mutex_t	lo_alloc_lock;	/* protects the entry allocations */
+  unsigned int		lo_stripe_n;	/* number of stripe locks, 2^X */
+  pthread_mutex_t	*lo_stripes;	/* lock bucket & (stripe_n - 1) */
+} table_locks_t;
+
+#else
+
+/* no thread support */
+typedef void	table_locks_t;
+
+#endif
+
 /*
  * HACK: this should be equiv as the table_entry_t without the key_buf
  * char.  We use this with the ENTRY_SIZE() macro above which solves
@@ -120,6 +272,7 @@
 typedef struct table_shell_st {
   unsigned int		te_key_size;	/* size of data */
   unsigned int		te_data_size;	/* size of data */
+  unsigned int		te_hash;	/* full hash value of the key */
   struct table_shell_st	*te_next_p;	/* pointer to next in the list */
   /* NOTE: this does not have the te_key_buf field here */
 } table_shell_t;
@@ -135,6 +288,7 @@ typedef struct table_shell_st {
 typedef struct table_entry_st {
   unsigned int		te_key_size;	/* size of data */
   unsigned int		te_data_size;	/* size of data */
+  unsigned int		te_hash;	/* full hash value of the key */
   struct table_entry_st	*te_next_p;	/* pointer to next in the list */
   unsigned char		te_key_buf[1];	/* 1st byte of key buf */
 } table_entry_t;
@@ -147,26 +301,78 @@ typedef struct table_st {
   unsigned int		ta_magic;	/* magic number */
   unsigned int		ta_flags;	/* table's flags defined in table.h */
   unsigned int		ta_bucket_n;	/* num of buckets, should be 2^X */
+  unsigned int		ta_bucket_mask;	/* bucket_n - 1 if 2^X else 0 */
   unsigned int		ta_entry_n;	/* num of entries in all buckets */
   unsigned int		ta_data_align;	/* data alignment value */
   table_entry_t		**ta_buckets;	/* array of linked lists */
+  unsigned char		*ta_ctrl;	/* open addressing slot tags */
+  unsigned int		ta_deleted_n;	/* open addressing deleted slots */
+  table_entry_t		**ta_old_buckets; /* buckets being grown from */
+  unsigned int		ta_old_bucket_n; /* number of old buckets */
+  unsigned int		ta_old_bucket_mask; /* mask of the old buckets */
+  unsigned int		ta_migrate_c;	/* old buckets moved so far */
+  unsigned char		*ta_inline;	/* open addressing slot entries */
+  unsigned int		ta_inline_size;	/* size of each slot entry or 0 */
   table_linear_t	ta_linear;	/* linear tracking */
   unsigned long		ta_file_size;	/* size of on-disk space */
+  unsigned long		ta_entries_off;	/* file offset of the entries */
+  void			*ta_mmap;	/* mapped table file or NULL */
   
   void			*ta_mem_pool;	/* pointer to some memory pool */
   table_mem_alloc_t	ta_alloc_func;	/* memory allocation function */
   table_mem_resize_t	ta_resize_func;	/* memory resize function */
   table_mem_free_t	ta_free_func;	/* memory free function */
+  arena_t		*ta_arena;	/* arena for entries or NULL */
+  table_locks_t		*ta_locks;	/* concurrent insert locks or NULL */
+  unsigned int		ta_adjust_n;	/* number of times resized */
+  unsigned long long	ta_adjust_usecs; /* time spent resizing */
 } table_t;
 
 /* external table structure for debuggers */
 typedef table_t	table_ext_t;
 
+/*
+ * Start of the files written by table_write.  After it is a directory
+ * of pointer sized file offsets of the first entry in each bucket or
+ * 0 if the bucket is empty.  Then come the entries laid out as they
+ * are in memory, each aligned by FILE_ALIGN, with their te_next_p
+ * holding the file offset of the next entry in the bucket or 0.  A
+ * mapped file uses the directory as its buckets.
+ */
+typedef struct {
+  unsigned int		tf_magic;	/* TABLE_FILE_MAGIC */
+  unsigned int		tf_version;	/* TABLE_FILE_VERSION */
+  unsigned int		tf_pointer_size; /* size of pointers in the file */
+  unsigned int		tf_flags;	/* flags of the written table */
+  unsigned int		tf_data_align;	/* data alignment of the table */
+  unsigned int		tf_bucket_n;	/* buckets in the directory, 2^X */
+  unsigned int		tf_entry_n;	/* number of entries */
+  unsigned int		tf_checksum;	/* checksum of the file with this 0 */
+  unsigned long long	tf_entries_off;	/* file offset of the entries */
+  unsigned long long	tf_file_size;	/* size of the whole file */
+} table_file_t;
+
+/* buffer for writing a table file a block at a time */
+typedef struct {
+  int			fw_fd;		/* file we are writing */
+  unsigned int		fw_sum;		/* checksum of the written blocks */
+  unsigned int		fw_len;		/* bytes waiting in the buffer */
+  unsigned char		fw_buf[FILE_BLOCK_SIZE]; /* block being filled */
+} file_write_t;
+
 /* local comparison functions */
 typedef int	(*compare_t)(const void *element1_p, const void *element2_p,
 			     table_compare_t user_compare,
 			     const table_t *table_p, int *err_bp);
 
+/* how we are comparing the entries of an entry_sort */
+typedef struct {
+  compare_t		es_compare;	/* our comparison function */
+  table_compare_t	es_user_compare; /* user comparison or NULL */
+  table_t		*es_table;	/* table being sorted */
+  int			es_error_b;	/* set to 1 if a comparison failed */
+} entry_sort_t;
+
 /*
  * to map error to string
  */
@@ -196,6 +402,8 @@ static	error_str_t	errors[] = {
   { TABLE_ERROR_ALIGNMENT,	"invalid alignment value" },
   { TABLE_ERROR_COMPARE,	"problems with internal comparison" },
   { TABLE_ERROR_FREE,		"memory free error" },
+  { TABLE_ERROR_CONCURRENT,	"not a valid concurrent table operation" },
+  { TABLE_ERROR_FILE,		"file is not a valid table" },
   { 0 }
 };
 
@@ -0,0 +1,587 @@
+/*
+ * Test the table routines...
+ *
+ * Copyright 2008 by Gray Watson
+ *
+ * This file is part of the sortu package.
+ *
+ * Permission to use, copy, modify, and distribute this software for
+ * any purpose and without fee is hereby granted, provided that the
+ * above copyright notice and this permission notice appear in all
+ * copies, and that the name of Gray Watson not be used in advertising
+ * or publicity pertaining to distribution of the document or software
+ * without specific, written prior permission.
+ *
+ * Gray Watson makes no representations about the suitability of the
+ * software described herein for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "table.h"
+
+#define KEY_N		5000		/* number of keys in our tables */
+#define MMAP_KEY_N	50		/* keys in the mapped tables we damage */
+#define MODEL_KEY_N	20000		/* keys in the tables that we change */
+#define KEY_SIZE	64		/* max size of our keys */
+#define INLINE_SIZE	16		/* max key size in the inline slots */
+#define TABLE_FILE	"table_test.t"	/* table file that we write */
+#define BAD_FILE	"table_test_bad.t" /* corrupted copy of the file */
+
+/* a table configuration that we are testing */
+typedef struct {
+  const char	*co_name;		/* name of the configuration */
+  int		co_flags;		/* flags to pass to table_attr */
+  int		co_align;		/* data alignment of the table */
+  int		co_inline_size;		/* max key size in the slots */
+} config_t;
+
+static	config_t	configs[] = {
+  { "chained",		TABLE_FLAG_AUTO_ADJUST },
+  { "chained-align",	TABLE_FLAG_AUTO_ADJUST | TABLE_FLAG_FAST_HASH,
+			sizeof(long) },
+  { "chained-incr",	TABLE_FLAG_AUTO_ADJUST | TABLE_FLAG_INCREMENTAL },
+  { "chained-incr-align", TABLE_FLAG_AUTO_ADJUST | TABLE_FLAG_INCREMENTAL
+			| TABLE_FLAG_FAST_HASH, sizeof(long) },
+  { "open",		TABLE_FLAG_AUTO_ADJUST | TABLE_FLAG_OPEN_ADDRESS },
+  { "open-inline",	TABLE_FLAG_AUTO_ADJUST | TABLE_FLAG_OPEN_ADDRESS
+			| TABLE_FLAG_FAST_HASH, sizeof(long), INLINE_SIZE },
+  { NULL }
+};
+
+/*
+ * Exit with a message if a table call did not return what we expected.
+ */
+static	void	check(const int ret, const int expected, const char *name,
+		      const char *what)
+{
+  if (ret != expected) {
+    (void)fprintf(stderr, "table_test: %s: %s returned '%s' not '%s'\n",
+		  name, what, table_strerror(ret), table_strerror(expected));
+    exit(1);
+  }
+}
+
+/*
+ * Exit with a message if a test failed.
+ */
+static	void	fail(const char *name, const char *what)
+{
+  (void)fprintf(stderr, "table_test: %s: %s\n", name, what);
+  exit(1);
+}
+
+/*
+ * Build the key for a key number.  Every third key is too long to be
+ * stored inline.
+ */
+static	int	make_key(const int key_c, char *key)
+{
+  if (key_c % 3 == 0) {
+    return sprintf(key, "a key that is too long for the slots %d", key_c);
+  }
+  return sprintf(key, "key%d", key_c);
+}
+
+/*
+ * Allocate a table for a configuration and add a number of our keys to
+ * it.
+ */
+static	table_t	*config_table(const config_t *config_p, const int key_n)
+{
+  table_t	*tab;
+  char		key[KEY_SIZE];
+  long		value;
+  int		key_c, key_size, ret;
+  
+  tab = table_alloc(0, &ret);
+  if (tab == NULL) {
+    check(ret, TABLE_ERROR_NONE, config_p->co_name, "table_alloc");
+  }
+  check(table_attr(tab, config_p->co_flags), TABLE_ERROR_NONE,
+	config_p->co_name, "table_attr");
+  check(table_set_data_alignment(tab, config_p->co_align), TABLE_ERROR_NONE,
+	config_p->co_name, "table_set_data_alignment");
+  if (config_p->co_inline_size > 0) {
+    check(table_set_inline_size(tab, config_p->co_inline_size, sizeof(long)),
+	  TABLE_ERROR_NONE, config_p->co_name, "table_set_inline_size");
+  }
+  
+  for (key_c = 0; key_c < key_n; key_c++) {
+    key_size = make_key(key_c, key);
+    value = key_c;
+    check(table_insert(tab, key, key_size, &value, sizeof(value), NULL, 0),
+	  TABLE_ERROR_NONE, config_p->co_name, "table_insert");
+  }
+  
+  return tab;
+}
+
+/*
+ * Make sure that a table has a number of our keys and their data.
+ */
+static	void	verify_table(table_t *tab, const config_t *config_p,
+			     const int key_n)
+{
+  char		key[KEY_SIZE];
+  void		*data_p;
+  long		value;
+  int		key_c, key_size, data_size, entry_n;
+  
+  check(table_info(tab, NULL, &entry_n), TABLE_ERROR_NONE,
+	config_p->co_name, "table_info");
+  if (entry_n != key_n) {
+    fail(config_p->co_name, "table has the wrong number of entries");
+  }
+  
+  for (key_c = 0; key_c < key_n; key_c++) {
+    key_size = make_key(key_c, key);
+    check(table_retrieve(tab, key, key_size, &data_p, &data_size),
+	  TABLE_ERROR_NONE, config_p->co_name, "table_retrieve");
+    if (config_p->co_align > 0
+	&& (unsigned long)data_p % config_p->co_align != 0) {
+      fail(config_p->co_name, "data is not aligned");
+    }
+    /* the data of the unaligned tables may not be aligned */
+    memcpy(&value, data_p, sizeof(value));
+    if (data_size != sizeof(long) || value != key_c) {
+      fail(config_p->co_name, "data does not match what was inserted");
+    }
+  }
+}
+
+/*
+ * Copy the table file to our bad file, cutting it to a size and
+ * flipping a bit in one of its bytes.
+ */
+static	void	copy_file(const char *name, const long size,
+			  const long flip_offset, const int flip_bit)
+{
+  FILE		*from, *to;
+  long		offset;
+  int		ch;
+  
+  from = fopen(TABLE_FILE, "rb");
+  to = fopen(BAD_FILE, "wb");
+  if (from == NULL || to == NULL) {
+    fail(name, "could not open the table files");
+  }
+  for (offset = 0; offset < size && (ch = getc(from)) != EOF; offset++) {
+    if (offset == flip_offset) {
+      ch ^= flip_bit;
+    }
+    (void)putc(ch, to);
+  }
+  (void)fclose(from);
+  if (fclose(to) != 0) {
+    fail(name, "could not write the bad table file");
+  }
+}
+
+/*
+ * Return the size of the table file.
+ */
+static	long	file_size(const config_t *config_p)
+{
+  FILE		*fp;
+  long		size;
+  
+  fp = fopen(TABLE_FILE, "rb");
+  if (fp == NULL || fseek(fp, 0, SEEK_END) != 0) {
+    fail(config_p->co_name, "could not size the table file");
+  }
+  size = ftell(fp);
+  (void)fclose(fp);
+  
+  return size;
+}
+
+/*
+ * Make sure that reading our bad file fails because it is not a valid
+ * table.
+ */
+static	void	read_bad(const config_t *config_p, const char *what)
+{
+  table_t	*tab;
+  int		ret;
+  
+  tab = table_read(BAD_FILE, &ret);
+  if (tab != NULL) {
+    fail(config_p->co_name, what);
+  }
+  check(ret, TABLE_ERROR_FILE, config_p->co_name, what);
+}
+
+/*
+ * Write a table out, read it back in, and then make sure that bad
+ * copies of the file are not accepted.
+ */
+static	void	test_file(const config_t *config_p)
+{
+  table_t	*tab;
+  long		size;
+  int		ret;
+  
+  tab = config_table(config_p, KEY_N);
+  check(table_write(tab, TABLE_FILE, 0666), TABLE_ERROR_NONE,
+	config_p->co_name, "table_write");
+  check(table_free(tab), TABLE_ERROR_NONE, config_p->co_name, "table_free");
+  
+  tab = table_read(TABLE_FILE, &ret);
+  if (tab == NULL) {
+    check(ret, TABLE_ERROR_NONE, config_p->co_name, "table_read");
+  }
+  verify_table(tab, config_p, KEY_N);
+  check(table_free(tab), TABLE_ERROR_NONE, config_p->co_name, "table_free");
+  
+  size = file_size(config_p);
+  
+  copy_file(config_p->co_name, 0, -1, 0);
+  read_bad(config_p, "read of an empty file");
+  copy_file(config_p->co_name, 20, -1, 0);
+  read_bad(config_p, "read of a truncated header");
+  copy_file(config_p->co_name, size - 1, -1, 0);
+  read_bad(config_p, "read of a truncated file");
+  /* the flags are after the magic, version, and pointer size */
+  copy_file(config_p->co_name, size, 12, TABLE_FLAG_FAST_HASH);
+  read_bad(config_p, "read of a file with a changed hash flag");
+  copy_file(config_p->co_name, size, size / 2, 1);
+  read_bad(config_p, "read of a file with a changed entry");
+  copy_file(config_p->co_name, size, size - 1, 0x80);
+  read_bad(config_p, "read of a file with a changed last byte");
+  
+  (void)remove(TABLE_FILE);
+  (void)remove(BAD_FILE);
+}
+
+/*
+ * Walk and look up the keys of a mapped table whose file may have been
+ * damaged.  Every call must either work or say that the file is bad.
+ */
+static	void	walk_mapped(table_t *tab, const config_t *config_p)
+{
+  table_entry_t	**entries;
+  table_linear_t	linear;
+  char		key[KEY_SIZE];
+  void		*key_p, *this_p;
+  int		key_c, key_size, entry_n, ret;
+  
+  for (ret = table_first(tab, NULL, NULL, NULL, NULL);
+       ret == TABLE_ERROR_NONE;
+       ret = table_next(tab, NULL, NULL, NULL, NULL)) {
+  }
+  if (ret != TABLE_ERROR_NOT_FOUND) {
+    check(ret, TABLE_ERROR_FILE, config_p->co_name, "table_next");
+  }
+  
+  for (ret = table_first_r(tab, &linear, &key_p, NULL, NULL, NULL);
+       ret == TABLE_ERROR_NONE;
+       ret = table_next_r(tab, &linear, &key_p, NULL, NULL, NULL)) {
+    check(table_this_r(tab, &linear, &this_p, NULL, NULL, NULL),
+	  TABLE_ERROR_NONE, config_p->co_name, "table_this_r");
+    if (this_p != key_p) {
+      fail(config_p->co_name, "table_this_r returned another entry");
+    }
+  }
+  if (ret != TABLE_ERROR_NOT_FOUND) {
+    check(ret, TABLE_ERROR_FILE, config_p->co_name, "table_next_r");
+  }
+  
+  for (key_c = 0; key_c < MMAP_KEY_N; key_c++) {
+    key_size = make_key(key_c, key);
+    ret = table_retrieve(tab, key, key_size, NULL, NULL);
+    if (ret != TABLE_ERROR_NONE && ret != TABLE_ERROR_NOT_FOUND) {
+      check(ret, TABLE_ERROR_FILE, config_p->co_name, "table_retrieve");
+    }
+  }
+  
+  entries = table_order(tab, NULL, &entry_n, &ret);
+  if (entries == NULL) {
+    if (ret != TABLE_ERROR_EMPTY) {
+      check(ret, TABLE_ERROR_FILE, config_p->co_name, "table_order");
+    }
+  }
+  else {
+    check(table_order_free(tab, entries, entry_n), TABLE_ERROR_NONE,
+	  config_p->co_name, "table_order_free");
+  }
+}
+
+/*
+ * Map a table file and make sure that a damaged copy of it is either
+ * not mapped or only returns errors instead of going outside of the
+ * mapping.  The checksum is not checked when mapping so we flip the
+ * bits of every byte of the file in turn.
+ */
+static	void	test_mmap(const config_t *config_p)
+{
+  table_t	*tab;
+  long		size, offset;
+  int		ret;
+  
+  tab = config_table(config_p, MMAP_KEY_N);
+  check(table_write(tab, TABLE_FILE, 0666), TABLE_ERROR_NONE,
+	config_p->co_name, "table_write");
+  check(table_free(tab), TABLE_ERROR_NONE, config_p->co_name, "table_free");
+  
+  tab = table_mmap(TABLE_FILE, &ret);
+  if (tab == NULL) {
+    check(ret, TABLE_ERROR_NONE, config_p->co_name, "table_mmap");
+  }
+  verify_table(tab, config_p, MMAP_KEY_N);
+  walk_mapped(tab, config_p);
+  check(table_munmap(tab), TABLE_ERROR_NONE, config_p->co_name,
+	"table_munmap");
+  
+  size = file_size(config_p);
+  for (offset = 0; offset < size; offset++) {
+    copy_file(config_p->co_name, size, offset, 0xff);
+    tab = table_mmap(BAD_FILE, &ret);
+    if (tab == NULL) {
+      check(ret, TABLE_ERROR_FILE, config_p->co_name, "table_mmap");
+      continue;
+    }
+    walk_mapped(tab, config_p);
+    check(table_munmap(tab), TABLE_ERROR_NONE, config_p->co_name,
+	  "table_munmap");
+  }
+  
+  (void)remove(TABLE_FILE);
+  (void)remove(BAD_FILE);
+}
+
+/*
+ * Look up a key and make sure that it matches what our model of the
+ * table says.
+ */
+static	void	check_key(table_t *tab, const config_t *config_p,
+			  const long *values, const int key_c)
+{
+  char		key[KEY_SIZE];
+  void		*data_p;
+  long		value;
+  int		key_size, data_size, ret;
+  
+  key_size = make_key(key_c, key);
+  ret = table_retrieve(tab, key, key_size, &data_p, &data_size);
+  if (values[key_c] < 0) {
+    check(ret, TABLE_ERROR_NOT_FOUND, config_p->co_name,
+	  "table_retrieve of a deleted key");
+    return;
+  }
+  check(ret, TABLE_ERROR_NONE, config_p->co_name, "table_retrieve");
+  memcpy(&value, data_p, sizeof(value));
+  if (data_size != sizeof(long) || value != values[key_c]) {
+    fail(config_p->co_name, "data does not match the last insert");
+  }
+}
+
+/*
+ * Make sure that an entry found by walking the table matches what our
+ * model says and that we have not seen it already.  The number of a
+ * key is its data mod MODEL_KEY_N.
+ */
+static	void	check_entry(const config_t *config_p, const long *values,
+			    char *seen, const void *key_p, const int key_size,
+			    const void *data_p, const int data_size)
+{
+  char		key[KEY_SIZE];
+  long		value;
+  int		key_c;
+  
+  memcpy(&value, data_p, sizeof(value));
+  if (data_size != sizeof(long) || value < 0) {
+    fail(config_p->co_name, "entry has bad data");
+  }
+  key_c = value % MODEL_KEY_N;
+  if (values[key_c] != value) {
+    fail(config_p->co_name, "entry does not match the last insert");
+  }
+  if (make_key(key_c, key) != key_size || memcmp(key, key_p, key_size) != 0) {
+    fail(config_p->co_name, "entry has the wrong key");
+  }
+  if (seen[key_c]) {
+    fail(config_p->co_name, "entry was found twice");
+  }
+  seen[key_c] = 1;
+}
+
+/*
+ * Insert, overwrite, upsert, delete, and look up keys as the table
+ * grows so that the incremental tables do them while their buckets
+ * are being moved, then walk and order the table and compare it with
+ * our model of what should be in it.
+ */
+static	void	test_model(const config_t *config_p)
+{
+  table_t	*tab;
+  table_entry_t	**entries;
+  void		*key_p, *data_p;
+  char		key[KEY_SIZE], *seen;
+  long		*values, value;
+  int		key_c, old_c, key_size, data_size, bucket_n, last_n, grow_n;
+  int		entry_n, present_n, entry_c, check_n, created_b, ret;
+  int		created_n, found_n;
+  
+  values = (long *)malloc(sizeof(long) * MODEL_KEY_N);
+  seen = (char *)malloc(MODEL_KEY_N);
+  if (values == NULL || seen == NULL) {
+    fail(config_p->co_name, "could not allocate the model");
+  }
+  for (key_c = 0; key_c < MODEL_KEY_N; key_c++) {
+    values[key_c] = -1;
+  }
+  
+  tab = config_table(config_p, 0);
+  present_n = 0;
+  last_n = 0;
+  grow_n = 0;
+  check_n = 0;
+  created_n = 0;
+  found_n = 0;
+  for (key_c = 0; key_c < MODEL_KEY_N; key_c++) {
+    /* each new key moves some of the old buckets while growing */
+    key_size = make_key(key_c, key);
+    value = key_c;
+    check(table_insert(tab, key, key_size, &value, sizeof(value), NULL, 0),
+	  TABLE_ERROR_NONE, config_p->co_name, "table_insert");
+    values[key_c] = value;
+    present_n++;
+  
+    /* older keys may be in either the old or the new buckets */
+    if (key_c % 3 == 0) {
+      old_c = key_c / 2;
+      key_size = make_key(old_c, key);
+      value = old_c + MODEL_KEY_N;
+      check(table_insert(tab, key, key_size, &value, sizeof(value), NULL, 1),
+	    TABLE_ERROR_NONE, config_p->co_name, "table_insert overwrite");
+      if (values[old_c] < 0) {
+	present_n++;
+      }
+      values[old_c] = value;
+    }
+    if (key_c % 5 == 0) {
+      old_c = key_c / 3;
+      key_size = make_key(old_c, key);
+      ret = table_delete(tab, key, key_size, NULL, NULL);
+      if (values[old_c] < 0) {
+	check(ret, TABLE_ERROR_NOT_FOUND, config_p->co_name,
+	      "table_delete of a deleted key");
+      }
+      else {
+	check(ret, TABLE_ERROR_NONE, config_p->co_name, "table_delete");
+	values[old_c] = -1;
+	present_n--;
+      }
+    }
+  
+    /* upsert keys that are still there and ones that were deleted */
+    if (key_c % 7 == 0) {
+      old_c = key_c / 4;
+      key_size = make_key(old_c, key);
+      check(table_upsert(tab, key, key_size, sizeof(value), &data_p,
+			 &created_b), TABLE_ERROR_NONE, config_p->co_name,
+	    "table_upsert");
+      memcpy(&value, data_p, sizeof(value));
+      if (values[old_c] < 0) {
+	if (created_b != 1 || value != 0) {
+	  fail(config_p->co_name, "upsert did not create zeroed data");
+	}
+	created_n++;
+	present_n++;
+      }
+      else {
+	if (created_b != 0 || value != values[old_c]) {
+	  fail(config_p->co_name, "upsert did not find the key");
+	}
+	found_n++;
+      }
+      value = old_c + MODEL_KEY_N * 2;
+      memcpy(data_p, &value, sizeof(value));
+      values[old_c] = value;
+    }
+  
+    check_key(tab, config_p, values, key_c);
+    check_key(tab, config_p, values, key_c / 2);
+    check_key(tab, config_p, values, key_c / 3);
+    check_key(tab, config_p, values, key_c / 4);
+  
+    check(table_info(tab, &bucket_n, &entry_n), TABLE_ERROR_NONE,
+	  config_p->co_name, "table_info");
+    if (entry_n != present_n) {
+      fail(config_p->co_name, "table has the wrong number of entries");
+    }
+    if (bucket_n != last_n) {
+      grow_n++;
+      last_n = bucket_n;
+    }
+  
+    /* look up all of the keys now and then, starting when it grows */
+    if (key_c % 256 == 0 || grow_n != check_n) {
+      for (old_c = 0; old_c <= key_c; old_c++) {
+	check_key(tab, config_p, values, old_c);
+      }
+      check_n = grow_n;
+    }
+  }
+  if (grow_n < 3) {
+    fail(config_p->co_name, "table did not grow");
+  }
+  if (created_n == 0 || found_n == 0) {
+    fail(config_p->co_name, "upsert did not create and find keys");
+  }
+  for (key_c = 0; key_c < MODEL_KEY_N; key_c++) {
+    check_key(tab, config_p, values, key_c);
+  }
+  
+  /* the walks finish any growing first */
+  memset(seen, 0, MODEL_KEY_N);
+  entry_c = 0;
+  for (ret = table_first(tab, &key_p, &key_size, &data_p, &data_size);
+       ret == TABLE_ERROR_NONE;
+       ret = table_next(tab, &key_p, &key_size, &data_p, &data_size)) {
+    check_entry(config_p, values, seen, key_p, key_size, data_p, data_size);
+    entry_c++;
+  }
+  check(ret, TABLE_ERROR_NOT_FOUND, config_p->co_name, "table_next");
+  if (entry_c != present_n) {
+    fail(config_p->co_name, "walk did not find every key");
+  }
+  
+  entries = table_order(tab, NULL, &entry_n, &ret);
+  if (entries == NULL) {
+    check(ret, TABLE_ERROR_NONE, config_p->co_name, "table_order");
+  }
+  if (entry_n != present_n) {
+    fail(config_p->co_name, "order did not find every key");
+  }
+  memset(seen, 0, MODEL_KEY_N);
+  for (entry_c = 0; entry_c < entry_n; entry_c++) {
+    check(table_entry(tab, entries[entry_c], &key_p, &key_size, &data_p,
+		      &data_size), TABLE_ERROR_NONE, config_p->co_name,
+	  "table_entry");
+    check_entry(config_p, values, seen, key_p, key_size, data_p, data_size);
+  }
+  check(table_order_free(tab, entries, entry_n), TABLE_ERROR_NONE,
+	config_p->co_name, "table_order_free");
+  
+  check(table_free(tab), TABLE_ERROR_NONE, config_p->co_name, "table_free");
+  free(values);
+  free(seen);
+}
+
+int	main(int argc, char **argv)
+{
+  const config_t	*config_p;
+  
+  for (config_p = configs; config_p->co_name != NULL; config_p++) {
+    test_file(config_p);
+    test_mmap(config_p);
+    test_model(config_p);
+  }
+  
+  return 0;
+}
@@ -4,8 +4,10 @@ TEST1=sortu_test1.t
 TEST2=sortu_test2.t
 EXPECTED=sortu_exp.t
 OUTPUT=sortu_out.t
+TABLE=sortu_table.t
+STATE=sortu_state.t
 
-rm -f $TEST1 $TEST2 $EXPECTED $OUTPUT
+rm -f $TEST1 $TEST2 $EXPECTED $OUTPUT $TABLE $STATE
 
 check () {
     if [ $ERROR -ne 0 ]; then
@@ -276,8 +278,165 @@ EOF
 ERROR=$?
 check
 
+########################################
+
+NAME="standard input"
+
+cat > $TEST1 <<EOF
+3
+1
+3
+EOF
+
+cat > $EXPECTED <<EOF
+1 1
+2 3
+EOF
+
+./sortu < $TEST1 > $OUTPUT
+ERROR=$?
+check
+
+########################################
+
+NAME="long lines"
+
+LONG=`awk 'BEGIN { for (i = 0; i < 3000; i++) printf "a"; }'`
+printf '%s\n%sb\n%s\n' $LONG $LONG $LONG > $TEST1
+
+cat > $EXPECTED <<EOF
+3001 1
+3000 2
+EOF
+
+./sortu -F '%l %n' < $TEST1 > $OUTPUT
+ERROR=$?
+check
+
+########################################
+
+NAME="no trailing newline"
+
+printf '2\n1\n2' > $TEST1
+
+cat > $EXPECTED <<EOF
+1 1
+2 2
+EOF
+
+./sortu $TEST1 > $OUTPUT
+ERROR=$?
+check
+
 ###############################################################################
 
+NAME="jobs argument"
+
+cat > $TEST1 <<EOF
+3
+1
+3
+EOF
+
+cat > $TEST2 <<EOF
+2
+1
+4
+EOF
+
+cat > $EXPECTED <<EOF
+2 3
+2 1
+1 2
+1 4
+EOF
+
+./sortu -j 2 -o $TEST1 $TEST2 > $OUTPUT
+ERROR=$?
+check
+
+########################################
+
+NAME="jobs splitting a file into chunks"
+
+# lines of different lengths so the small chunks end in the middle of them
+awk 'BEGIN {
+    for (i = 0; i < 500; i++) {
+	printf "key%d %d ", i % 7, i % 13;
+	for (j = 0; j < i % 5; j++) {
+	    printf "x";
+	}
+	printf "\n";
+    }
+}' > $TEST1
+
+./sortu -o $TEST1 > $EXPECTED \
+    && ./sortu -j 3 -o --chunk-size 16 $TEST1 > $OUTPUT
+ERROR=$?
+check
+
+./sortu -o -f 2 $TEST1 > $EXPECTED \
+    && ./sortu -j 3 -o -f 2 --chunk-size 16 $TEST1 > $OUTPUT
+ERROR=$?
+check
+
+########################################
+
+NAME="shards argument"
+
+cat > $TEST1 <<EOF
+b
+a
+c
+a
+EOF
+
+cat > $TEST2 <<EOF
+d
+c
+a
+EOF
+
+cat > $EXPECTED <<EOF
+1 b
+1 d
+2 c
+3 a
+EOF
+
+./sortu -j 2 --shards 3 $TEST1 $TEST2 > $OUTPUT
+ERROR=$?
+check
+
+########################################
+
+NAME="shared table argument"
+
+cat > $TEST1 <<EOF
+3
+1
+3
+EOF
+
+cat > $TEST2 <<EOF
+2
+1
+4
+EOF
+
+cat > $EXPECTED <<EOF
+2 3
+2 1
+1 2
+1 4
+EOF
+
+./sortu -j 2 -o --shared-table $TEST1 $TEST2 > $OUTPUT
+ERROR=$?
+check
+
+########################################
+
 NAME="key sort argument"
 
 cat > $TEST1 <<EOF
@@ -320,6 +479,25 @@ check
 
 ########################################
 
+NAME="loose field multiple delimiters argument"
+
+cat > $TEST1 <<EOF
+one,  two,,three	four,	 five  six,seven
+one two three,,,four five six		z
+1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20
+EOF
+
+cat > $EXPECTED <<EOF
+1 6
+2 six
+EOF
+
+./sortu -d ', 	' -f 6 -l $TEST1 > $OUTPUT
+ERROR=$?
+check
+
+########################################
+
 NAME="minimum match argument"
 
 cat > $TEST1 <<EOF
@@ -381,6 +559,25 @@ check
 
 ########################################
 
+NAME="case insensitive field argument"
+
+cat > $TEST1 <<EOF
+1 AB
+2 ab
+3 Cd
+EOF
+
+cat > $EXPECTED <<EOF
+1 cd
+2 ab
+EOF
+
+./sortu -i -f 2 $TEST1 > $OUTPUT
+ERROR=$?
+check
+
+########################################
+
 NAME="number argument"
 
 cat > $TEST1 <<EOF
@@ -401,6 +598,55 @@ check
 
 ########################################
 
+NAME="number zero and negative argument"
+
+cat > $TEST1 <<EOF
+0
+-5
+3
+0
+-5
+0
+EOF
+
+cat > $EXPECTED <<EOF
+2 -5
+3 0
+1 3
+EOF
+
+./sortu -n -k $TEST1 > $OUTPUT
+ERROR=$?
+check
+
+########################################
+
+NAME="number range argument"
+
+cat > $TEST1 <<EOF
+5
+-2
+2
+7
+3
+2
+-2
+EOF
+
+cat > $EXPECTED <<EOF
+2 -2
+2 2
+1 3
+1 5
+1 7
+EOF
+
+./sortu -n -k --number-range=2,5 $TEST1 > $OUTPUT
+ERROR=$?
+check
+
+########################################
+
 NAME="number float argument"
 
 cat > $TEST1 <<EOF
@@ -441,6 +687,253 @@ check
 
 ########################################
 
+NAME="open table argument"
+
+cat > $TEST1 <<EOF
+3
+1
+2
+1
+EOF
+
+cat > $EXPECTED <<EOF
+1 2
+1 3
+2 1
+EOF
+
+./sortu --open-table $TEST1 > $OUTPUT
+ERROR=$?
+check
+
+########################################
+
+NAME="inline keys argument"
+
+cat > $TEST1 <<EOF
+3
+a-much-longer-key
+1
+a-much-longer-key
+1
+EOF
+
+cat > $EXPECTED <<EOF
+1 3
+2 1
+2 a-much-longer-key
+EOF
+
+./sortu --inline-keys 4 $TEST1 > $OUTPUT
+ERROR=$?
+check
+
+########################################
+
+NAME="expected keys argument"
+
+cat > $TEST1 <<EOF
+3
+1
+2
+1
+EOF
+
+cat > $EXPECTED <<EOF
+1 2
+1 3
+2 1
+EOF
+
+./sortu --expected-keys 10k $TEST1 > $OUTPUT
+ERROR=$?
+check
+
+########################################
+
+NAME="estimate keys argument"
+
+cat > $TEST1 <<EOF
+b
+a
+c
+a
+EOF
+
+cat > $EXPECTED <<EOF
+1 b
+1 c
+2 a
+EOF
+
+./sortu --estimate-keys $TEST1 > $OUTPUT
+ERROR=$?
+check
+
+########################################
+
+NAME="table stats argument"
+
+cat > $TEST1 <<EOF
+b
+a
+c
+a
+EOF
+
+cat > $EXPECTED <<EOF
+1 b
+1 c
+2 a
+EOF
+
+./sortu --table-stats $TEST1 > $OUTPUT 2> /dev/null
+ERROR=$?
+check
+
+########################################
+
+NAME="save table and lookup arguments"
+
+cat > $TEST1 <<EOF
+b
+a
+c
+a
+EOF
+
+cat > $TEST2 <<EOF
+a
+d
+c
+EOF
+
+cat > $EXPECTED <<EOF
+2 a
+0 d
+1 c
+EOF
+
+./sortu --save-table $TABLE $TEST1 > /dev/null \
+    && ./sortu --lookup $TABLE < $TEST2 > $OUTPUT
+ERROR=$?
+check
+
+########################################
+
+NAME="state argument"
+
+cat > $TEST1 <<EOF
+a
+b
+a
+EOF
+
+cat > $EXPECTED <<EOF
+1 b
+3 a
+EOF
+
+./sortu --state $STATE $TEST1 > /dev/null \
+    && printf 'a\nb' >> $TEST1 \
+    && ./sortu --state $STATE $TEST1 > $OUTPUT
+ERROR=$?
+check
+
+########################################
+
+NAME="state refuses other key options"
+
+cat > $TEST1 <<EOF
+a 1
+b 2
+EOF
+
+cat > $EXPECTED <<EOF
+EOF
+
+rm -f $STATE
+./sortu --state $STATE $TEST1 > /dev/null \
+    && printf 'a 3\n' >> $TEST1 \
+    && ! ./sortu --state $STATE -f 2 $TEST1 > $OUTPUT 2> /dev/null
+ERROR=$?
+check
+
+########################################
+
+NAME="emit partial and merge arguments"
+
+cat > $TEST1 <<EOF
+b
+a
+b
+EOF
+
+cat > $TEST2 <<EOF
+         3 a
+         1 c
+EOF
+
+cat > $EXPECTED <<EOF
+1 c
+2 b
+4 a
+EOF
+
+./sortu --emit-partial $TABLE $TEST1 \
+    && ./sortu --merge $TABLE $TEST2 > $OUTPUT
+ERROR=$?
+check
+
+########################################
+
+NAME="merge refuses percentage output"
+
+cat > $TEST1 <<EOF
+b
+a
+b
+EOF
+
+cat > $EXPECTED <<EOF
+EOF
+
+./sortu -p $TEST1 > $TEST2 \
+    && ! ./sortu --merge $TEST2 > $OUTPUT 2> /dev/null
+ERROR=$?
+check
+
+########################################
+
+NAME="merge keys starting with spaces"
+
+printf ' lead\n lead\n  5 x\n' > $TEST1
+
+printf '         2   5 x\n         4  lead\n' > $EXPECTED
+
+./sortu $TEST1 > $TEST2 \
+    && ./sortu --merge $TEST2 $TEST2 > $OUTPUT \
+    && cmp -s $OUTPUT $EXPECTED
+ERROR=$?
+check
+
+########################################
+
+NAME="merge refuses counts that are too large"
+
+cat > $TEST2 <<EOF
+99999999999999999999999 a
+EOF
+
+cat > $EXPECTED <<EOF
+EOF
+
+! ./sortu --merge $TEST2 > $OUTPUT 2> /dev/null
+ERROR=$?
+check
+
+########################################
+
 NAME="percentage show argument"
 
 cat > $TEST1 <<EOF
@@ -553,4 +1046,4 @@ check
 
 ###############################################################################
 
-rm -f $TEST1 $TEST2 $EXPECTED $OUTPUT
+rm -f $TEST1 $TEST2 $EXPECTED $OUTPUT $TABLE $STATE